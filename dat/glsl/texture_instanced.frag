@@ -0,0 +1,22 @@
+uniform sampler2D sampler1;
+uniform sampler2D sampler2;
+
+in vec2 tex_coord;
+in vec4 colour;
+in float inter;
+out vec4 colour_out;
+
+void main(void) {
+   vec4 colour1 = texture(sampler1, tex_coord);
+   if (inter >= 1.0) {
+      colour_out = colour * colour1;
+      return;
+   }
+   vec4 colour2 = texture(sampler2, tex_coord);
+   /* Same as texture_interpolate.frag. */
+   if (colour1.a <= 0.0)
+      colour1.rgb = vec3(0.0);
+   if (colour2.a <= 0.0)
+      colour2.rgb = vec3(0.0);
+   colour_out = colour * mix(colour2, colour1, inter);
+}
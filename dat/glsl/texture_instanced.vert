@@ -0,0 +1,19 @@
+uniform mat4 projection;
+
+in vec4 vertex;
+in vec3 inst_mat0;
+in vec3 inst_mat1;
+in vec4 inst_tex;
+in vec4 inst_colour;
+in float inst_inter;
+out vec2 tex_coord;
+out vec4 colour;
+out float inter;
+
+void main(void) {
+   vec3 v = vec3( vertex.xy, 1.0 );
+   tex_coord = inst_tex.xy + vertex.xy * inst_tex.zw;
+   colour = inst_colour;
+   inter = inst_inter;
+   gl_Position = projection * vec4( dot(inst_mat0, v), dot(inst_mat1, v), 0.0, 1.0 );
+}
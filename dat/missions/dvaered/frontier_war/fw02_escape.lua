@@ -6,7 +6,7 @@
  <chance>10</chance>
  <done>Dvaered Sabotage</done>
  <location>Bar</location>
- <cond>var.peek("loyal2klank") == true</cond>
+ <cond cache="1">var.peek("loyal2klank") == true</cond>
  <faction>Dvaered</faction>
  <notes>
   <campaign>Frontier Invasion</campaign>
@@ -7,7 +7,7 @@
  <done>Dvaered Escape</done>
  <location>Bar</location>
  <faction>Dvaered</faction>
- <cond>var.peek("dv_pirate_debt") == false</cond>
+ <cond cache="1">var.peek("dv_pirate_debt") == false</cond>
  <notes>
   <campaign>Frontier Invasion</campaign>
   <done_evt name="Repay General Klank"/>
@@ -5,7 +5,7 @@
  <priority>2</priority>
  <chance>100</chance>
  <location>Bar</location>
- <cond>var.peek("flfbase_intro") == 2</cond>
+ <cond cache="1">var.peek("flfbase_intro") == 2</cond>
  <spob>Sindbad</spob>
  <notes>
   <done_misn name="Deal with the FLF agent">If you return Gregar to Sindbad</done_misn>
@@ -7,7 +7,7 @@
  <location>Computer</location>
  <faction>FLF</faction>
  <faction>Frontier</faction>
- <cond>not diff.isApplied( "flf_dead" )</cond>
+ <cond cache="1">not diff.isApplied( "flf_dead" )</cond>
 </mission>
  --]]
 --[[
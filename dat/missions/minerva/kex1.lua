@@ -5,7 +5,7 @@
  <location>Bar</location>
  <chance>100</chance>
  <spob>Minerva Station</spob>
- <cond>player.evtDone("Chicken Rendezvous")</cond>
+ <cond cache="1">player.evtDone("Chicken Rendezvous")</cond>
  <notes>
   <campaign>Minerva</campaign>
   <done_evt name="Chicken Rendezvous" />
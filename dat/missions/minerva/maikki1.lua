@@ -6,7 +6,7 @@
  <chance>100</chance>
  <location>Bar</location>
  <spob>Minerva Station</spob>
- <cond>var.peek("minerva_altercation_probability")~=nil</cond>
+ <cond cache="1">var.peek("minerva_altercation_probability")~=nil</cond>
  <notes>
   <campaign>Minerva</campaign>
   <requires name="Minerva Altercation 1" />
@@ -2,7 +2,7 @@
 <?xml version='1.0' encoding='utf8'?>
 <mission name="Pirate Commodity Run">
  <priority>5</priority>
- <cond>false or var.peek("commodity_runs_active") == nil or var.peek("commodity_runs_active") &lt; 3</cond>
+ <cond cache="1">false or var.peek("commodity_runs_active") == nil or var.peek("commodity_runs_active") &lt; 3</cond>
  <chance>90</chance>
  <location>Computer</location>
  <faction>Wild Ones</faction>
@@ -15,7 +15,7 @@
  <faction>Soromid</faction>
  <faction>Traders Society</faction>
  <faction>Za'lek</faction>
- <cond>not diff.isApplied( "flf_dead" )</cond>
+ <cond cache="1">not diff.isApplied( "flf_dead" )</cond>
  <notes>
   <campaign>Nexus show their teeth</campaign>
  </notes>
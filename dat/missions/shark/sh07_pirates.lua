@@ -7,7 +7,7 @@
  <chance>50</chance>
  <location>Bar</location>
  <spob>Darkshed</spob>
- <cond>not diff.isApplied( "flf_dead" )</cond>
+ <cond cache="1">not diff.isApplied( "flf_dead" )</cond>
  <notes>
   <campaign>Nexus show their teeth</campaign>
  </notes>
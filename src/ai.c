@@ -74,6 +74,7 @@
 
 #include "array.h"
 #include "board.h"
+#include "camera.h"
 #include "conf.h"
 #include "faction.h"
 #include "gatherable.h"
@@ -87,8 +88,11 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "ntracing.h"
+#include "opengl.h"
 #include "physics.h"
 #include "pilot.h"
+#include "pilot_ew.h"
+#include "player.h"
 #include "rng.h"
 #include "space.h"
 
@@ -110,12 +114,16 @@ static AI_Profile *profiles  = NULL;      /**< Array of AI_Profiles loaded. */
 static nlua_env    equip_env = LUA_NOREF; /**< Equipment enviornment. */
 static IntList     ai_qtquery;            /**< Quadtree query. */
 static double ai_dt = 0.; /**< Current update tick, useful in some cases. **/
+static unsigned int ai_lodFrame = 0; /**< Frame counter for the AI LOD. */
+static int          ai_lodThink = 0; /**< Pilots that thought this frame. */
+static int          ai_lodSkip  = 0; /**< Pilots that held this frame. */
 
 /*
  * prototypes
  */
 /* Internal C routines */
 static void ai_run( nlua_env env, int nargs );
+static int  ai_loadLibs( nlua_env env );
 static int  ai_loadProfile( AI_Profile *prof, const char *filename );
 static int  ai_setMemory( void );
 static void ai_create( Pilot *pilot );
@@ -687,6 +695,21 @@ int nlua_loadAI( nlua_env env )
    return 0;
 }
 
+/**
+ * @brief Loads the libraries of the AI profile environments.
+ *
+ *    @param env Environment to load into.
+ *    @return 0 on success.
+ */
+static int ai_loadLibs( nlua_env env )
+{
+   nlua_loadStandard( env );
+
+   /* Register C functions in Lua */
+   nlua_register( env, "ai", aiL_methods, 0 );
+   return 0;
+}
+
 /**
  * @brief Initializes an AI_Profile and adds it to the stack.
  *
@@ -709,13 +732,9 @@ static int ai_loadProfile( AI_Profile *prof, const char *filename )
    prof->name[len] = '\0';
 
    /* Create Lua. */
-   env = nlua_newEnv( filename );
-   nlua_loadStandard( env );
+   env       = nlua_newEnvLibs( filename, ai_loadLibs );
    prof->env = env;
 
-   /* Register C functions in Lua */
-   nlua_register( env, "ai", aiL_methods, 0 );
-
    /* Mark as an ai. */
    lua_pushboolean( naevL, 1 );
    nlua_setenv( naevL, env, "__ai" );
@@ -800,6 +819,82 @@ void ai_exit( void )
    il_destroy( &ai_qtquery );
 }
 
+/**
+ * @brief Gets the number of frames between the thinks of a pilot.
+ *
+ * Pilots that are far from the player and not doing anything of interest only
+ * think every few frames, holding their acceleration and turn in between.
+ *
+ *    @param p Pilot to check.
+ *    @return Number of frames between thinks, 1 to think every frame.
+ */
+int ai_thinkRate( const Pilot *p )
+{
+   double cx, cy, d2;
+
+   if ( conf.ai_lod <= 1 )
+      return 1;
+
+   /* Pilots the player or missions are likely to be paying attention to. */
+   if ( pilot_isWithPlayer( p ) || pilot_isFlag( p, PILOT_MANUAL_CONTROL ) ||
+        pilot_isFlag( p, PILOT_COMBAT ) )
+      return 1;
+
+   /* Nobody is watching while a new system is warmed up. */
+   if ( space_isWarmup() )
+      return conf.ai_lod;
+   if ( player.p == NULL )
+      return 1;
+   if ( ( p->target == PLAYER_ID ) || ( player.p->target == p->id ) )
+      return 1;
+
+   /* Detected by the player, even if fuzzily. */
+   if ( pilot_inRangePilot( player.p, p, NULL ) != 0 )
+      return 1;
+
+   /* Near the screen. */
+   cam_getPos( &cx, &cy );
+   d2 = pow2( cx - p->solid.pos.x ) + pow2( cy - p->solid.pos.y );
+   if ( d2 < pow2( MAX( SCREEN_W, SCREEN_H ) / cam_getZoom() ) )
+      return 1;
+
+   return conf.ai_lod;
+}
+
+/**
+ * @brief Has a pilot think if it is its turn according to its rate.
+ *
+ * Pilots are spread out over the frames by their ID so that the cost is
+ * amortized instead of all the low detail pilots thinking at once.
+ *
+ *    @param pilot Pilot that may think.
+ *    @param dt Current delta tick.
+ */
+void ai_thinkLOD( Pilot *pilot, double dt )
+{
+   int rate = ai_thinkRate( pilot );
+   if ( ( ai_lodFrame + pilot->id ) % (unsigned int)rate != 0 ) {
+      ai_lodSkip++;
+      return;
+   }
+   ai_lodThink++;
+   /* The movement helpers divide by the tick, so thinking with the whole
+    * interval keeps the held turn from overshooting. */
+   ai_think( pilot, dt * (double)rate, 1 );
+}
+
+/**
+ * @brief Advances the AI level of detail scheduling to the next frame.
+ */
+void ai_lodUpdate( void )
+{
+   NTracingPlotI( "ai: thinks", ai_lodThink );
+   NTracingPlotI( "ai: held", ai_lodSkip );
+   ai_lodFrame++;
+   ai_lodThink = 0;
+   ai_lodSkip  = 0;
+}
+
 /**
  * @brief Heart of the AI, brains of the pilot.
  *
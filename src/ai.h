@@ -98,6 +98,9 @@ void ai_refuel( Pilot *refueler, unsigned int target );
 void ai_getDistress( const Pilot *p, const Pilot *distressed,
                      const Pilot *attacker );
 void ai_think( Pilot *pilot, double dt, int dotask );
+int      ai_thinkRate( const Pilot *p );
+void     ai_thinkLOD( Pilot *pilot, double dt );
+void     ai_lodUpdate( void );
 AIMemory ai_setPilot( Pilot *p );
 void     ai_unsetPilot( AIMemory oldmem );
 void     ai_thinkSetup( double dt );
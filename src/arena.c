@@ -0,0 +1,312 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file arena.c
+ *
+ * @brief Arena allocators for short-lived memory.
+ *
+ * There are two kinds of arenas. Scratch arenas are owned by a single thread
+ * and are released with marks once the caller is done with the memory. The
+ * frame arena can be used from any thread, but all its memory is freed at the
+ * start of every update, so it can only be used from the update routine.
+ */
+/** @cond */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "arena.h"
+
+#include "log.h"
+#include "ntracing.h"
+
+#define ARENA_ALIGN 16 /**< Alignment of all allocations. */
+#define ARENA_SCRATCH_BLOCK                                                    \
+   ( 64 * 1024 ) /**< Default block size of scratch arenas. */
+#define ARENA_FRAME_SIZE                                                       \
+   ( 256 * 1024 ) /**< Initial size of the frame arena. */
+
+#define ARENA_ALIGNED( x ) ( ( ( x ) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) )
+
+/**
+ * @brief Block of memory of an arena.
+ */
+struct ArenaBlock_ {
+   ArenaBlock *next; /**< Next block. */
+   size_t      size; /**< Usable size of the block. */
+   size_t      used; /**< Bytes used of the block. */
+   char       *data; /**< Aligned start of the data. */
+};
+
+/**
+ * @brief Allocation that did not fit in the frame arena.
+ */
+typedef struct ArenaOverflow_ {
+   struct ArenaOverflow_ *next; /**< Next overflow allocation. */
+} ArenaOverflow;
+
+static SDL_TLSID      arena_tls = 0; /**< Per-thread scratch arena. */
+static char          *frame_data = NULL;   /**< Frame arena memory. */
+static size_t         frame_size = 0;      /**< Size of frame_data. */
+static SDL_atomic_t   frame_used;          /**< Bytes used of frame_data. */
+static SDL_atomic_t   frame_nalloc;        /**< Allocations this frame. */
+static SDL_mutex     *frame_lock = NULL;   /**< Lock for the overflow list. */
+static ArenaOverflow *frame_overflow = NULL; /**< Allocations that did not fit. */
+static size_t frame_overflowSize = 0; /**< Bytes allocated in frame_overflow. */
+
+/*
+ * Prototypes.
+ */
+static ArenaBlock *arena_newBlock( const Arena *arena, size_t size );
+static void        arena_freeScratch( void *data );
+
+/**
+ * @brief Initializes the arena subsystem.
+ */
+void arena_init( void )
+{
+   arena_tls  = SDL_TLSCreate();
+   frame_lock = SDL_CreateMutex();
+   frame_size = ARENA_FRAME_SIZE;
+   frame_data = nmalloc( frame_size );
+   SDL_AtomicSet( &frame_used, 0 );
+   SDL_AtomicSet( &frame_nalloc, 0 );
+}
+
+/**
+ * @brief Cleans up the arena subsystem.
+ */
+void arena_exit( void )
+{
+   Arena *scratch;
+
+   arena_frameReset();
+   nfree( frame_data );
+   frame_data = NULL;
+   frame_size = 0;
+   SDL_DestroyMutex( frame_lock );
+   frame_lock = NULL;
+
+   /* Thread local storage is not cleaned up for the main thread. */
+   scratch = SDL_TLSGet( arena_tls );
+   if ( scratch != NULL ) {
+      arena_freeScratch( scratch );
+      SDL_TLSSet( arena_tls, NULL, NULL );
+   }
+}
+
+/**
+ * @brief Creates a new arena.
+ *
+ *    @param arena Arena to create.
+ *    @param name Name of the arena used for tracing.
+ *    @param blocksize Size of the blocks of memory to allocate.
+ */
+void arena_create( Arena *arena, const char *name, size_t blocksize )
+{
+   arena->name      = name;
+   arena->blocksize = blocksize;
+   arena->first     = NULL;
+   arena->cur       = NULL;
+}
+
+/**
+ * @brief Frees all the memory of an arena.
+ */
+void arena_destroy( Arena *arena )
+{
+   ArenaBlock *b = arena->first;
+   while ( b != NULL ) {
+      ArenaBlock *next = b->next;
+      nfree( b );
+      b = next;
+   }
+   arena->first = NULL;
+   arena->cur   = NULL;
+}
+
+/**
+ * @brief Allocates a new block for an arena.
+ */
+static ArenaBlock *arena_newBlock( const Arena *arena, size_t size )
+{
+   ArenaBlock *b;
+   size      = MAX( size, arena->blocksize );
+   b         = nmalloc( sizeof( ArenaBlock ) + size + ARENA_ALIGN );
+   b->next   = NULL;
+   b->size   = size;
+   b->used   = 0;
+   b->data   = (char *)ARENA_ALIGNED( (uintptr_t)( b + 1 ) );
+   return b;
+}
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ *    @param arena Arena to allocate from.
+ *    @param size Size to allocate.
+ *    @return Newly allocated memory aligned to 16 bytes.
+ */
+void *arena_alloc( Arena *arena, size_t size )
+{
+   ArenaBlock *b = arena->cur;
+   void       *ptr;
+
+   size = ARENA_ALIGNED( MAX( size, 1 ) );
+
+   /* Find a block with space, reusing the ones after the current. */
+   if ( b == NULL ) {
+      if ( arena->first == NULL )
+         arena->first = arena_newBlock( arena, size );
+      b       = arena->first;
+      b->used = 0;
+   }
+   while ( b->used + size > b->size ) {
+      if ( ( b->next == NULL ) || ( b->next->size < size ) ) {
+         ArenaBlock *nb = arena_newBlock( arena, size );
+         nb->next       = b->next;
+         b->next        = nb;
+      }
+      b       = b->next;
+      b->used = 0;
+   }
+   arena->cur = b;
+
+   ptr = &b->data[b->used];
+   b->used += size;
+   return ptr;
+}
+
+/**
+ * @brief Frees all the allocations of an arena, keeping the memory around.
+ */
+void arena_reset( Arena *arena )
+{
+   arena->cur = NULL;
+}
+
+/**
+ * @brief Gets the current position of an arena.
+ */
+ArenaMark arena_mark( Arena *arena )
+{
+   ArenaMark mark;
+   mark.arena  = arena;
+   mark.block  = arena->cur;
+   mark.offset = ( arena->cur != NULL ) ? arena->cur->used : 0;
+   return mark;
+}
+
+/**
+ * @brief Frees everything allocated in an arena since a mark.
+ */
+void arena_release( const ArenaMark *mark )
+{
+   Arena *arena = mark->arena;
+   arena->cur   = mark->block;
+   if ( arena->cur != NULL )
+      arena->cur->used = mark->offset;
+}
+
+/**
+ * @brief Frees a scratch arena when its thread is done.
+ */
+static void arena_freeScratch( void *data )
+{
+   Arena *arena = data;
+   arena_destroy( arena );
+   free( arena );
+}
+
+/**
+ * @brief Gets the scratch arena of the current thread.
+ *
+ * Users should get a mark with arena_mark and release it once done with the
+ * memory, so that the arena can be used by the callers as well.
+ *
+ *    @return The scratch arena of the thread.
+ */
+Arena *arena_scratch( void )
+{
+   Arena *arena = SDL_TLSGet( arena_tls );
+   if ( arena != NULL )
+      return arena;
+
+   arena = malloc( sizeof( Arena ) );
+   arena_create( arena, "scratch", ARENA_SCRATCH_BLOCK );
+   SDL_TLSSet( arena_tls, arena, arena_freeScratch );
+   return arena;
+}
+
+/**
+ * @brief Allocates memory from the frame arena.
+ *
+ * Thread safe, but the memory is only valid until the next update.
+ *
+ *    @param size Size to allocate.
+ *    @return Newly allocated memory aligned to 16 bytes.
+ */
+void *arena_frameAlloc( size_t size )
+{
+   ArenaOverflow *o;
+   size_t         offset;
+
+   size = ARENA_ALIGNED( MAX( size, 1 ) );
+   SDL_AtomicAdd( &frame_nalloc, 1 );
+   offset = (size_t)SDL_AtomicAdd( &frame_used, (int)size );
+   if ( offset + size <= frame_size )
+      return &frame_data[offset];
+
+   /* Didn't fit, fall back to the heap until the next reset. */
+   o = nmalloc( ARENA_ALIGNED( sizeof( ArenaOverflow ) ) + size );
+   SDL_mutexP( frame_lock );
+   o->next        = frame_overflow;
+   frame_overflow = o;
+   frame_overflowSize += size;
+   SDL_mutexV( frame_lock );
+   return (char *)o + ARENA_ALIGNED( sizeof( ArenaOverflow ) );
+}
+
+/**
+ * @brief Frees all the memory allocated from the frame arena.
+ *
+ * Called at the start of every update, and grows the arena if the previous
+ * update did not fit.
+ */
+void arena_frameReset( void )
+{
+   size_t used = (size_t)SDL_AtomicGet( &frame_used );
+
+   NTracingPlotI( "arena: frame bytes", (int64_t)used );
+   NTracingPlotI( "arena: frame allocations",
+                  SDL_AtomicGet( &frame_nalloc ) );
+
+   /* Free the overflow. */
+   while ( frame_overflow != NULL ) {
+      ArenaOverflow *o = frame_overflow;
+      frame_overflow   = o->next;
+      nfree( o );
+   }
+
+   /* Grow to fit everything next time. */
+   if ( frame_overflowSize > 0 ) {
+      size_t newsize = frame_size;
+      while ( newsize < used )
+         newsize *= 2;
+      nfree( frame_data );
+      frame_size = newsize;
+      frame_data = nmalloc( frame_size );
+      DEBUG( _( "Frame arena grown to %zu bytes" ), frame_size );
+   }
+   frame_overflowSize = 0;
+
+   SDL_AtomicSet( &frame_used, 0 );
+   SDL_AtomicSet( &frame_nalloc, 0 );
+}
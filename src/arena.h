@@ -0,0 +1,52 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+typedef struct ArenaBlock_ ArenaBlock;
+
+/**
+ * @brief Bump allocator that frees everything at once.
+ *
+ * Not thread safe, each thread should use its own (see arena_scratch).
+ */
+typedef struct Arena_ {
+   const char *name;      /**< Name used for tracing. */
+   ArenaBlock *first;     /**< First block of memory. */
+   ArenaBlock *cur;       /**< Block currently being allocated from. */
+   size_t      blocksize; /**< Default size of new blocks. */
+} Arena;
+
+/**
+ * @brief Position in an arena that can be restored to free everything
+ * allocated after it.
+ */
+typedef struct ArenaMark_ {
+   Arena      *arena;  /**< Arena the mark belongs to. */
+   ArenaBlock *block;  /**< Block at the time of the mark. */
+   size_t      offset; /**< Offset in the block at the time of the mark. */
+} ArenaMark;
+
+/* Subsystem. */
+void arena_init( void );
+void arena_exit( void );
+
+/* Generic arenas. */
+void      arena_create( Arena *arena, const char *name, size_t blocksize );
+void      arena_destroy( Arena *arena );
+void     *arena_alloc( Arena *arena, size_t size );
+void      arena_reset( Arena *arena );
+ArenaMark arena_mark( Arena *arena );
+void      arena_release( const ArenaMark *mark );
+
+/* Per-thread scratch arena, use with arena_mark/arena_release. */
+Arena *arena_scratch( void );
+
+/* Frame arena, can be used from any thread and is freed at the start of every
+ * update. */
+void *arena_frameAlloc( size_t size );
+void  arena_frameReset( void );
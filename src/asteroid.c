@@ -30,6 +30,14 @@
 #include "rng.h"
 #include "sound.h"
 #include "space.h"
+#include "threadpool.h"
+
+#define ASTEROID_SLEEP_RANGE                                                   \
+   5000. /**< Distance from the camera to the edge of a field to sleep. */
+#define ASTEROID_SLEEP_DT 0.5 /**< Time step of sleeping fields. */
+#define ASTEROID_UPDATE_GRAIN 256 /**< Minimum asteroids per update job. */
+#define ASTEROID_QT_MARGIN                                                     \
+   16 /**< Distance asteroids move before being reinserted in the quadtree. */
 
 /**
  * @brief Represents a small asteroid debris rendered in the player frame.
@@ -52,8 +60,6 @@ static const double SCAN_FADE =
 static Debris *debris_stack =
    NULL; /**< All the debris in the current system (array.h). */
 static glTexture **debris_gfx = NULL; /**< Graphics to use for debris. */
-static double      asteroid_dt =
-   0.; /**< Used as a global variable when threading. */
 
 /*
  * Useful data for asteroids.
@@ -74,19 +80,32 @@ static int astgroup_cmp( const void *p1, const void *p2 );
 static int astgroup_parse( AsteroidTypeGroup *ag, const char *file );
 static int asttype_load( void );
 
-static int  asteroid_updateSingle( Asteroid *a );
+static void asteroid_updateMove( const AsteroidAnchor *ast, Asteroid *a,
+                                 double dt, int sleeping );
+static void asteroid_updateState( const AsteroidAnchor *ast, Asteroid *a,
+                                  double dt );
+static void asteroid_updateRange( void *data, int start, int end );
+static void asteroid_updateQuadtree( Job *job, void *data );
 static void asteroid_renderSingle( const Asteroid *a );
 static void debris_renderSingle( const Debris *d, double cx, double cy );
 static void debris_init( Debris *deb );
 static int  asteroid_init( Asteroid *ast, const AsteroidAnchor *field );
 
-static int asteroid_updateSingle( Asteroid *a )
+/**
+ * @brief Moves an asteroid.
+ *
+ * Only touches the asteroid itself, so it can be run in parallel.
+ *
+ *    @param ast Anchor of the asteroid.
+ *    @param a Asteroid to move.
+ *    @param dt Time step.
+ *    @param sleeping Whether the field is catching up on a long time step.
+ */
+static void asteroid_updateMove( const AsteroidAnchor *ast, Asteroid *a,
+                                 double dt, int sleeping )
 {
-   const AsteroidAnchor *ast = &cur_system->asteroids[a->parent];
-   double                dt  = asteroid_dt;
-   double                offx, offy, d;
-   int                   forced;
-   int                   setvel = 0;
+   double offx, offy, d;
+   int    setvel = 0;
 
    /* Push back towards center. */
    offx = ast->pos.x - a->sol.pos.x;
@@ -100,11 +119,12 @@ static int asteroid_updateSingle( Asteroid *a )
    } else if ( ast->has_exclusion ) {
       /* Push away from exclusion areas. */
       for ( int k = 0; k < array_size( cur_system->astexclude ); k++ ) {
-         AsteroidExclusion *exc = &cur_system->astexclude[k];
-         double             ex, ey, ed;
+         const AsteroidExclusion *exc = &cur_system->astexclude[k];
+         double                   ex, ey, ed;
 
          /* Ignore exclusion zones that shouldn't affect. */
-         if ( !exc->affects )
+         if ( vec2_dist2( &ast->pos, &exc->pos ) >=
+              pow2( ast->radius + exc->radius ) )
             continue;
 
          ex = a->sol.pos.x - exc->pos.x;
@@ -128,14 +148,43 @@ static int asteroid_updateSingle( Asteroid *a )
       }
    }
 
-   /* Update position. */
+   /* Update position. Motion is linear so long steps can be done at once, but
+    * then there is no previous position to sweep collisions from. */
    /* TODO use physics.c */
    a->sol.pre = a->sol.pos;
    a->sol.pos.x += a->sol.vel.x * dt;
    a->sol.pos.y += a->sol.vel.y * dt;
+   if ( sleeping )
+      a->sol.pre = a->sol.pos;
 
    /* Update angle. */
    a->ang += a->spin * dt;
+}
+
+/**
+ * @brief Updates the state of an asteroid.
+ *
+ * Uses the random number generator and may touch pilots, so it has to be run
+ * on the main thread.
+ *
+ *    @param ast Anchor of the asteroid.
+ *    @param a Asteroid to update.
+ *    @param dt Time step.
+ */
+static void asteroid_updateState( const AsteroidAnchor *ast, Asteroid *a,
+                                  double dt )
+{
+   int forced;
+
+   /* Skip inexistent asteroids. */
+   if ( a->state == ASTEROID_XX ) {
+      a->timer -= dt;
+      if ( a->timer < 0. ) {
+         a->state     = ASTEROID_XX_TO_BG;
+         a->timer_max = a->timer = 1. + 3. * RNGF();
+      }
+      return;
+   }
 
    /* igure out state change if applicable. */
    forced = a->timer < 0.; /* Forced by Lua or whatever. */
@@ -153,8 +202,6 @@ static int asteroid_updateSingle( Asteroid *a )
             a->state =
                ASTEROID_FG - 1; /* So it gets turned back into ASTEROID_FG. */
          else
-            /* This should be thread safe as a single pilot can only target a
-             * single asteroid. */
             pilot_untargetAsteroid( a->parent, a->id );
          FALLTHROUGH;
       case ASTEROID_XB:
@@ -192,7 +239,57 @@ static int asteroid_updateSingle( Asteroid *a )
       else
          a->scan_alpha = MAX( a->scan_alpha - SCAN_FADE * dt, 0. );
    }
-   return 0;
+}
+
+/**
+ * @brief Moves a range of asteroids of an anchor.
+ */
+static void asteroid_updateRange( void *data, int start, int end )
+{
+   AsteroidAnchor *ast = data;
+   for ( int j = start; j < end; j++ ) {
+      Asteroid *a = &ast->asteroids[j];
+      if ( a->state != ASTEROID_XX )
+         asteroid_updateMove( ast, a, ast->upd_dt, ast->slept );
+   }
+}
+
+/**
+ * @brief Rebuilds the quadtree of an anchor.
+ */
+static void asteroid_updateQuadtree( Job *job, void *data )
+{
+   AsteroidAnchor *ast = data;
+   (void)job;
+   for ( int j = 0; j < array_size( ast->asteroids ); j++ ) {
+      Asteroid *a = &ast->asteroids[j];
+      int       x, y, w2, h2, px, py;
+
+      /* Only foreground asteroids can be hit. */
+      if ( a->state != ASTEROID_FG ) {
+         if ( a->qt_elem >= 0 ) {
+            qt_remove( &ast->qt, a->qt_elem );
+            a->qt_elem = -1;
+         }
+         continue;
+      }
+
+      x  = round( a->sol.pos.x );
+      y  = round( a->sol.pos.y );
+      px = round( a->sol.pre.x );
+      py = round( a->sol.pre.y );
+      w2 = ceil( a->gfx->sw * 0.5 );
+      h2 = ceil( a->gfx->sh * 0.5 );
+      if ( a->qt_elem < 0 )
+         a->qt_elem = qt_insert( &ast->qt, j, MIN( x, px ) - w2,
+                                 MIN( y, py ) - h2, MAX( x, px ) + w2,
+                                 MAX( y, py ) + h2 );
+      else
+         a->qt_elem = qt_move( &ast->qt, a->qt_elem, j, MIN( x, px ) - w2,
+                               MIN( y, py ) - h2, MAX( x, px ) + w2,
+                               MAX( y, py ) + h2 );
+   }
+   qt_cleanup_lazy( &ast->qt );
 }
 
 /**
@@ -202,57 +299,70 @@ static int asteroid_updateSingle( Asteroid *a )
  */
 void asteroids_update( double dt )
 {
+   Job   *root;
+   double cx, cy;
+   vec2   cam;
+
    NTracingZone( _ctx, 1 );
 
-   /* Asteroids/Debris update */
+   /* Figure out which fields to update. Fields far away from the camera only
+    * get updated every now and then with a longer time step. */
+   cam_getPos( &cx, &cy );
+   vec2_cset( &cam, cx, cy );
    for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
       AsteroidAnchor *ast = &cur_system->asteroids[i];
       ast->has_exclusion  = 0;
 
       for ( int k = 0; k < array_size( cur_system->astexclude ); k++ ) {
-         AsteroidExclusion *exc = &cur_system->astexclude[k];
+         const AsteroidExclusion *exc = &cur_system->astexclude[k];
          if ( vec2_dist2( &ast->pos, &exc->pos ) <
-              pow2( ast->radius + exc->radius ) ) {
-            exc->affects       = 1;
+              pow2( ast->radius + exc->radius ) )
             ast->has_exclusion = 1;
-         } else
-            exc->affects = 0;
       }
 
-      /* Now just thread it and zoom. */
-      asteroid_dt = dt;
-      for ( int j = 0; j < array_size( ast->asteroids ); j++ ) {
-         Asteroid *a = &ast->asteroids[j];
-         /* Skip inexistent asteroids. */
-         if ( a->state == ASTEROID_XX ) {
-            a->timer -= dt;
-            if ( a->timer < 0. ) {
-               a->state     = ASTEROID_XX_TO_BG;
-               a->timer_max = a->timer = 1. + 3. * RNGF();
-            }
-            continue;
-         }
-         asteroid_updateSingle( a );
+      ast->sleep_dt += dt;
+      if ( ( vec2_dist2( &ast->pos, &cam ) >=
+             pow2( ast->radius + ASTEROID_SLEEP_RANGE ) ) &&
+           ( ast->sleep_dt < ASTEROID_SLEEP_DT ) ) {
+         ast->upd_dt = 0.;
+         continue;
       }
+      /* Catches up on all the time slept when waking up. */
+      ast->upd_dt   = ast->sleep_dt;
+      ast->slept    = ( ast->sleep_dt > dt );
+      ast->sleep_dt = 0.;
+   }
 
-      /* Do quadtree stuff. Can't be threaded. */
-      qt_clear( &ast->qt );
-      for ( int j = 0; j < array_size( ast->asteroids ); j++ ) {
-         const Asteroid *a = &ast->asteroids[j];
-         /* Add to quadtree if in foreground. */
-         if ( a->state == ASTEROID_FG ) {
-            int x, y, w2, h2, px, py;
-            x  = round( a->sol.pos.x );
-            y  = round( a->sol.pos.y );
-            px = round( a->sol.pre.x );
-            py = round( a->sol.pre.y );
-            w2 = ceil( a->gfx->sw * 0.5 );
-            h2 = ceil( a->gfx->sh * 0.5 );
-            qt_insert( &ast->qt, j, MIN( x, px ) - w2, MIN( y, py ) - h2,
-                       MAX( x, px ) + w2, MAX( y, py ) + h2 );
-         }
-      }
+   /* Move the asteroids in parallel. */
+   root = job_create( NULL, NULL, NULL );
+   for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
+      AsteroidAnchor *ast = &cur_system->asteroids[i];
+      if ( ast->upd_dt > 0. )
+         job_run( job_createFor( array_size( ast->asteroids ),
+                                 ASTEROID_UPDATE_GRAIN, asteroid_updateRange,
+                                 ast, root ) );
    }
+   job_run( root );
+   job_wait( root );
+
+   /* State changes can't be threaded. */
+   for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
+      AsteroidAnchor *ast = &cur_system->asteroids[i];
+      if ( ast->upd_dt <= 0. )
+         continue;
+      for ( int j = 0; j < array_size( ast->asteroids ); j++ )
+         asteroid_updateState( ast, &ast->asteroids[j], ast->upd_dt );
+   }
+
+   /* Rebuild the quadtrees of the updated fields in parallel. */
+   root = job_create( NULL, NULL, NULL );
+   for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
+      AsteroidAnchor *ast = &cur_system->asteroids[i];
+      if ( ast->upd_dt > 0. )
+         job_run( job_create( asteroid_updateQuadtree, ast, root ) );
+   }
+   job_run( root );
+   job_wait( root );
 
    /* Only have to update stuff if not simulating. */
    if ( !space_isSimulation() ) {
@@ -331,6 +441,7 @@ void asteroids_init( void )
       qy = round( ast->pos.y );
       qr = ceil( ast->radius );
       qt_create( &ast->qt, qx - qr, qy - qr, qx + qr, qy + qr, 2, 5 );
+      qt_set_margin( &ast->qt, ASTEROID_QT_MARGIN );
       ast->qt_init = 1;
 
       /* Add the asteroids to the anchor */
@@ -343,7 +454,8 @@ void asteroids_init( void )
             if ( asteroid_init( &a, ast ) ) {
                continue;
             }
-            a.id = array_size( ast->asteroids );
+            a.id      = array_size( ast->asteroids );
+            a.qt_elem = -1;
             if ( r > 0.6 )
                a.state = ASTEROID_FG;
             else if ( r > 0.8 )
@@ -368,6 +480,10 @@ void asteroids_init( void )
                   cur_system->name );
       }
 
+      /* Fields far away won't get updated for a while. */
+      ast->sleep_dt = 0.;
+      asteroid_updateQuadtree( NULL, ast );
+
       density_max = MAX( density_max, ast->density );
    }
 
@@ -882,11 +998,13 @@ void asteroids_renderOverlay( void )
    NTracingZone( _ctx, 1 );
 
    /* Render the debris. */
+   gl_batchBegin();
    for ( int j = 0; j < array_size( debris_stack ); j++ ) {
       const Debris *d = &debris_stack[j];
       if ( d->height > 1. )
          debris_renderSingle( d, cx, cy );
    }
+   gl_batchEnd();
 
    NTracingZoneEnd( _ctx );
 }
@@ -904,6 +1022,9 @@ void asteroids_render( void )
 
    NTracingZone( _ctx, 1 );
 
+   /* Everything here is sprites, so batch them up. */
+   gl_batchBegin();
+
    /* Render the asteroids & debris. */
    for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
       const AsteroidAnchor *ast = &cur_system->asteroids[i];
@@ -931,6 +1052,8 @@ void asteroids_render( void )
    /* Render gatherable stuff. */
    gatherable_render();
 
+   gl_batchEnd();
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -986,6 +1109,7 @@ static void asteroid_renderSingle( const Asteroid *a )
       return;
    col   = cFontWhite;
    col.a = a->scan_alpha;
+   gl_batchFlush();
    gl_gameToScreenCoords( &nx, &ny, a->sol.pos.x, a->sol.pos.y );
    gl_printRaw( &gl_smallFont, nx + a->gfx->sw / 2, ny - gl_smallFont.h / 2,
                 &col, -1., _( at->scanned_msg ) );
@@ -1296,3 +1420,9 @@ void asteroid_collideQueryIL( AsteroidAnchor *anc, IntList *il, int x1, int y1,
 {
    qt_query( &anc->qt, il, x1, y1, x2, y2 );
 }
+
+void asteroid_collideQueryTemp( const AsteroidAnchor *anc, QuadtreeTemp *tmp,
+                                IntList *il, int x1, int y1, int x2, int y2 )
+{
+   qt_query_temp( &anc->qt, tmp, il, x1, y1, x2, y2 );
+}
@@ -103,6 +103,7 @@ typedef struct Asteroid_ {
    double timer_max;  /**< Internal timer initial value. */
    double scan_alpha; /**< Alpha value for scanning stuff. */
    int    scanned;    /**< Wether the player already scanned this asteroid. */
+   int    qt_elem;    /**< Element in the quadtree or -1. */
 } Asteroid;
 
 /**
@@ -128,16 +129,19 @@ typedef struct AsteroidAnchor_ {
    Quadtree qt;      /**< Handles collisions. */
    int      qt_init; /**< Whether or not the quadtree has been initialized. */
    int      has_exclusion; /**< Used for updating. */
+   /* Sleeping when far away. */
+   double sleep_dt; /**< Time elapsed since the field was last updated. */
+   double upd_dt;   /**< Time step of the current update, 0 if sleeping. */
+   int    slept;    /**< Whether the current update catches up on sleep. */
 } AsteroidAnchor;
 
 /**
  * @brief Represents an asteroid exclusion zone.
  */
 typedef struct AsteroidExclusion_ {
-   char  *label;   /**< Label used for unidiffs. */
-   vec2   pos;     /**< Position in the system (from center). */
-   double radius;  /**< Radius of the exclusion zone. */
-   int    affects; /**< Temporary internal value when rendering. */
+   char  *label;  /**< Label used for unidiffs. */
+   vec2   pos;    /**< Position in the system (from center). */
+   double radius; /**< Radius of the exclusion zone. */
 } AsteroidExclusion;
 
 /* Initialization and parsing. */
@@ -169,3 +173,5 @@ void asteroid_hit( Asteroid *a, const Damage *dmg, int max_rarity,
 void asteroid_explode( Asteroid *a, int max_rarity, double mine_bonus );
 void asteroid_collideQueryIL( AsteroidAnchor *anc, IntList *il, int x1, int y1,
                               int x2, int y2 );
+void asteroid_collideQueryTemp( const AsteroidAnchor *anc, QuadtreeTemp *tmp,
+                                IntList *il, int x1, int y1, int x2, int y2 );
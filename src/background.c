@@ -234,7 +234,7 @@ void background_renderDust( const double dt )
    glVertexAttribDivisor( shaders.dust.brightness, 1 );
 
    // glDrawArrays( GL_POINTS, 0, ndust );
-   glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, ndust );
+   gl_drawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, ndust );
 
    glVertexAttribDivisor( shaders.dust.shape, 0 );
    glVertexAttribDivisor( shaders.dust.vertex, 0 );
@@ -5,27 +5,76 @@
  * @file collision.c
  *
  * @brief Deals with 2d collisions.
+ *
+ * Polygon edges are tested several at a time with SSE2 or AVX when available,
+ * falling back to scalar code otherwise.
  */
 
 /** @cond */
 #include "naev.h"
 
 #include "SDL.h"
+#if defined( __AVX__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
 /** @endcond */
 
 #include "collision.h"
 
+#include "arena.h"
 #include "array.h"
 #include "log.h"
 #include "physics.h"
+#include "rng.h"
+
+#if defined( __AVX__ )
+#define POLY_SIMD 8 /**< Number of edges tested at once. */
+#elif defined( __SSE2__ )
+#define POLY_SIMD 4 /**< Number of edges tested at once. */
+#else
+#define POLY_SIMD 1 /**< Number of edges tested at once. */
+#endif
+#define POLY_BOX_MARGIN                                                        \
+   1.f /**< Margin when discarding edges by bounding box. */
+#define POLY_SIDE_MARGIN                                                       \
+   0.05f /**< Relative margin when discarding edges by side. */
 
 /*
  * Prototypes
  */
-static int PointInPolygon( const CollPolyView *at, const vec2 *ap, float x,
-                           float y );
-static int LineOnPolygon( const CollPolyView *at, const vec2 *ap, float x1,
-                          float y1, float x2, float y2, vec2 *crash );
+static void poly_computeNormals( CollPolyView *view );
+static int  poly_windingEdge( const CollPolyView *at, int i, int j, float px,
+                              float py );
+static int  poly_windingScalar( const CollPolyView *at, float px, float py );
+static int  poly_winding( const CollPolyView *at, float px, float py );
+static int  poly_edgeMayHit( const CollPolyView *at, int i, int j, float x1,
+                             float y1, float x2, float y2 );
+static int  poly_edgeCandidate( const CollPolyView *at, int start, float x1,
+                                float y1, float x2, float y2 );
+static uint64_t trans_bits( const glTransMap *map, const uint64_t *row,
+                            int x );
+static int      trans_firstBit( uint64_t v );
+static int  PointInPolygon( const CollPolyView *at, const vec2 *ap, float x,
+                            float y );
+static int  LineOnPolygon( const CollPolyView *at, const vec2 *ap, float x1,
+                           float y1, float x2, float y2, vec2 *crash );
+
+/**
+ * @brief Computes the edge normals of a polygon view.
+ *
+ * The normals are allocated the same way as the points, so they have to be
+ * set up before calling.
+ */
+static void poly_computeNormals( CollPolyView *view )
+{
+   for ( int i = 0; i < view->npt; i++ ) {
+      int j       = ( i + 1 < view->npt ) ? i + 1 : 0;
+      view->nx[i] = -( view->y[j] - view->y[i] );
+      view->ny[i] = view->x[j] - view->x[i];
+   }
+}
 
 /**
  * @brief Loads a polygon from an xml node.
@@ -85,10 +134,19 @@ void poly_load( CollPoly *polygon, xmlNodePtr base, const char *name )
       } while ( xml_nextNode( cur ) );
 
       view->npt = array_size( view->x );
-      if ( array_size( view->y ) != view->npt )
+      if ( array_size( view->y ) != view->npt ) {
          WARN( _( "Polygon with mismatch of number of |x|=%d and |y|=%d "
                   "coordinates detected!" ),
                view->npt, array_size( view->y ) );
+         view->npt = MIN( view->npt, array_size( view->y ) );
+      }
+
+      /* Precompute the edges. */
+      view->nx = array_create_size( float, view->npt );
+      view->ny = array_create_size( float, view->npt );
+      array_resize( &view->nx, view->npt );
+      array_resize( &view->ny, view->npt );
+      poly_computeNormals( view );
    } while ( xml_nextNode( node ) );
 
    /* Compute useful offsets. */
@@ -123,10 +181,62 @@ void poly_free( CollPoly *poly )
       CollPolyView *view = &poly->views[i];
       array_free( view->x );
       array_free( view->y );
+      array_free( view->nx );
+      array_free( view->ny );
    }
    array_free( poly->views );
 }
 
+/**
+ * @brief Gets 64 pixels of a row of a transparency map.
+ *
+ *    @param map Transparency map the row belongs to.
+ *    @param row Row to get pixels of.
+ *    @param x First pixel to get, the rest are the following ones.
+ *    @return The pixels with the first one in the lowest bit.
+ */
+static uint64_t trans_bits( const glTransMap *map, const uint64_t *row, int x )
+{
+   int      w = x / 64;
+   int      s = x % 64;
+   uint64_t v = row[w] >> s;
+   /* Pixels past the end of the row are padding, so they are 0. */
+   if ( ( s > 0 ) && ( w + 1 < map->words ) )
+      v |= row[w + 1] << ( 64 - s );
+   return v;
+}
+
+/**
+ * @brief Gets the index of the lowest set bit of a non-zero word.
+ */
+static int trans_firstBit( uint64_t v )
+{
+   int i = 0;
+   if ( ( v & UINT64_C( 0xffffffff ) ) == 0 ) {
+      v >>= 32;
+      i += 32;
+   }
+   if ( ( v & UINT64_C( 0xffff ) ) == 0 ) {
+      v >>= 16;
+      i += 16;
+   }
+   if ( ( v & UINT64_C( 0xff ) ) == 0 ) {
+      v >>= 8;
+      i += 8;
+   }
+   while ( ( v & 1 ) == 0 ) {
+      v >>= 1;
+      i++;
+   }
+   return i;
+}
+
+/**
+ * @brief Gets a mask of the first n bits, n being at most 64.
+ */
+#define TRANS_MASK( n )                                                        \
+   ( ( ( n ) >= 64 ) ? ~UINT64_C( 0 ) : ( UINT64_C( 1 ) << ( n ) ) - 1 )
+
 /**
  * @brief Checks whether or not two sprites collide.
  *
@@ -149,12 +259,12 @@ int CollideSprite( const glTexture *at, const int asx, const int asy,
                    const vec2 *ap, const glTexture *bt, const int bsx,
                    const int bsy, const vec2 *bp, vec2 *crash )
 {
-   int x, y;
-   int ax1, ax2, ay1, ay2;
-   int bx1, bx2, by1, by2;
-   int inter_x0, inter_x1, inter_y0, inter_y1;
-   int rasy, rbsy;
-   int abx, aby, bbx, bby;
+   int               ax1, ax2, ay1, ay2;
+   int               bx1, bx2, by1, by2;
+   int               inter_x0, inter_x1, inter_y0, inter_y1;
+   int               rasy, rbsy;
+   const glTransMap *ma, *mb;
+   const int16_t    *boxa, *boxb;
 
 #if DEBUGGING
    /* Make sure the surfaces have transparency maps. */
@@ -196,23 +306,34 @@ int CollideSprite( const glTexture *at, const int asx, const int asy,
    rasy = at->sy - asy - 1;
    rbsy = bt->sy - bsy - 1;
 
-   /* set up the base points */
-   abx = asx * (int)( at->sw ) - ax1;
-   aby = rasy * (int)( at->sh ) - ay1;
-   bbx = bsx * (int)( bt->sw ) - bx1;
-   bby = rbsy * (int)( bt->sh ) - by1;
-
-   for ( y = inter_y0; y <= inter_y1; y++ )
-      for ( x = inter_x0; x <= inter_x1; x++ )
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ( ( !gl_isTrans( at, abx + x, aby + y ) ) &&
-              ( !gl_isTrans( bt, bbx + x, bby + y ) ) ) {
+   /* only look where both sprites have pixels */
+   ma       = at->trans;
+   mb       = bt->trans;
+   boxa     = gl_transBox( ma, asx, rasy );
+   boxb     = gl_transBox( mb, bsx, rbsy );
+   inter_x0 = MAX( inter_x0, MAX( ax1 + boxa[0], bx1 + boxb[0] ) );
+   inter_x1 = MIN( inter_x1, MIN( ax1 + boxa[2], bx1 + boxb[2] ) );
+   inter_y0 = MAX( inter_y0, MAX( ay1 + boxa[1], by1 + boxb[1] ) );
+   inter_y1 = MIN( inter_y1, MIN( ay1 + boxa[3], by1 + boxb[3] ) );
+   if ( ( inter_x0 > inter_x1 ) || ( inter_y0 > inter_y1 ) )
+      return 0;
 
+   for ( int y = inter_y0; y <= inter_y1; y++ ) {
+      const uint64_t *ra = gl_transRow( ma, asx, rasy, y - ay1 );
+      const uint64_t *rb = gl_transRow( mb, bsx, rbsy, y - by1 );
+      /* test 64 pixels at a time */
+      for ( int x = inter_x0; x <= inter_x1; x += 64 ) {
+         uint64_t m = trans_bits( ma, ra, x - ax1 ) &
+                      trans_bits( mb, rb, x - bx1 ) &
+                      TRANS_MASK( inter_x1 - x + 1 );
+         if ( m != 0 ) {
             /* Set the crash position. */
-            crash->x = x;
+            crash->x = x + trans_firstBit( m );
             crash->y = y;
             return 1;
          }
+      }
+   }
 
    return 0;
 }
@@ -234,12 +355,12 @@ int CollideSpritePolygon( const CollPolyView *at, const vec2 *ap,
                           const glTexture *bt, int bsx, int bsy, const vec2 *bp,
                           vec2 *crash )
 {
-   int x, y;
-   int ax1, ax2, ay1, ay2;
-   int bx1, bx2, by1, by2;
-   int inter_x0, inter_x1, inter_y0, inter_y1;
-   int rbsy;
-   int bbx, bby;
+   int               ax1, ax2, ay1, ay2;
+   int               bx1, bx2, by1, by2;
+   int               inter_x0, inter_x1, inter_y0, inter_y1;
+   int               rbsy;
+   const glTransMap *mb;
+   const int16_t    *boxb;
 
 #if DEBUGGING
    /* Make sure the surfaces have transparency maps. */
@@ -276,15 +397,25 @@ int CollideSpritePolygon( const CollPolyView *at, const vec2 *ap,
    /* real vertical sprite value (flipped) */
    rbsy = bt->sy - bsy - 1;
 
-   /* set up the base points */
-   bbx = bsx * (int)( bt->sw ) - bx1;
-   bby = rbsy * (int)( bt->sh ) - by1;
-   for ( y = inter_y0; y <= inter_y1; y++ ) {
-      for ( x = inter_x0; x <= inter_x1; x++ ) {
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ( ( !gl_isTrans( bt, bbx + x, bby + y ) ) ) {
-            if ( PointInPolygon( at, ap, (float)x, (float)y ) ) {
-               crash->x = x;
+   /* only look where the sprite has pixels */
+   mb       = bt->trans;
+   boxb     = gl_transBox( mb, bsx, rbsy );
+   inter_x0 = MAX( inter_x0, bx1 + boxb[0] );
+   inter_x1 = MIN( inter_x1, bx1 + boxb[2] );
+   inter_y0 = MAX( inter_y0, by1 + boxb[1] );
+   inter_y1 = MIN( inter_y1, by1 + boxb[3] );
+
+   for ( int y = inter_y0; y <= inter_y1; y++ ) {
+      const uint64_t *rb = gl_transRow( mb, bsx, rbsy, y - by1 );
+      for ( int x = inter_x0; x <= inter_x1; x += 64 ) {
+         uint64_t m =
+            trans_bits( mb, rb, x - bx1 ) & TRANS_MASK( inter_x1 - x + 1 );
+         /* only test the pixels that are set */
+         while ( m != 0 ) {
+            int px = x + trans_firstBit( m );
+            m &= m - 1;
+            if ( PointInPolygon( at, ap, (float)px, (float)y ) ) {
+               crash->x = px;
                crash->y = y;
                return 1;
             }
@@ -346,8 +477,9 @@ int CollidePolygon( const CollPolyView *at, const vec2 *ap,
       xabs = bt->x[i] + VX( *bp );
       yabs = bt->y[i] + VY( *bp );
 
-      if ( ( xabs < inter_x0 ) || ( xabs > inter_x1 ) || ( yabs < inter_y0 ) ||
-           ( yabs > inter_y1 ) ) {
+      /* Points outside of the shared bounding box can't be in at. */
+      if ( ( xabs >= inter_x0 ) && ( xabs <= inter_x1 ) &&
+           ( yabs >= inter_y0 ) && ( yabs <= inter_y1 ) ) {
          if ( PointInPolygon( at, ap, xabs, yabs ) ) {
             crash->x = (int)xabs;
             crash->y = (int)yabs;
@@ -378,18 +510,31 @@ int CollidePolygon( const CollPolyView *at, const vec2 *ap,
 /**
  * @brief Rotates a polygon.
  *
+ * The rotated points are allocated from an arena and should not be freed.
+ *
  *    @param[out] rpolygon Rotated polygon.
  *    @param[in] ipolygon Input polygon.
  *    @param[in] theta Rotation angle (radian).
+ *    @param[in] arena Arena to allocate from, or NULL to use the frame arena.
  */
 void poly_rotate( CollPolyView *rpolygon, const CollPolyView *ipolygon,
-                  float theta )
+                  float theta, Arena *arena )
 {
-   float ct, st;
-
-   rpolygon->npt  = ipolygon->npt;
-   rpolygon->x    = malloc( ipolygon->npt * sizeof( float ) );
-   rpolygon->y    = malloc( ipolygon->npt * sizeof( float ) );
+   float  ct, st;
+   size_t size = ipolygon->npt * sizeof( float );
+
+   rpolygon->npt = ipolygon->npt;
+   if ( arena != NULL ) {
+      rpolygon->x  = arena_alloc( arena, size );
+      rpolygon->y  = arena_alloc( arena, size );
+      rpolygon->nx = arena_alloc( arena, size );
+      rpolygon->ny = arena_alloc( arena, size );
+   } else {
+      rpolygon->x  = arena_frameAlloc( size );
+      rpolygon->y  = arena_frameAlloc( size );
+      rpolygon->nx = arena_frameAlloc( size );
+      rpolygon->ny = arena_frameAlloc( size );
+   }
    rpolygon->xmin = 0;
    rpolygon->xmax = 0;
    rpolygon->ymin = 0;
@@ -408,6 +553,10 @@ void poly_rotate( CollPolyView *rpolygon, const CollPolyView *ipolygon,
       rpolygon->y[i] = d;
       rpolygon->ymin = MIN( rpolygon->ymin, d );
       rpolygon->ymax = MAX( rpolygon->ymax, d );
+
+      /* Normals rotate with the edges. */
+      rpolygon->nx[i] = ipolygon->nx[i] * ct - ipolygon->ny[i] * st;
+      rpolygon->ny[i] = ipolygon->nx[i] * st + ipolygon->ny[i] * ct;
    }
 }
 
@@ -428,6 +577,218 @@ const CollPolyView *poly_view( const CollPoly *poly, double dir )
    return &poly->views[s];
 }
 
+/*
+ * Vector helpers to test POLY_SIMD edges at once.
+ */
+#if POLY_SIMD == 8
+typedef __m256 PolyVec;
+#define PV_SET1( a ) _mm256_set1_ps( a )
+#define PV_LOAD( p ) _mm256_loadu_ps( p )
+#define PV_ADD( a, b ) _mm256_add_ps( a, b )
+#define PV_SUB( a, b ) _mm256_sub_ps( a, b )
+#define PV_MUL( a, b ) _mm256_mul_ps( a, b )
+#define PV_MIN( a, b ) _mm256_min_ps( a, b )
+#define PV_MAX( a, b ) _mm256_max_ps( a, b )
+#define PV_AND( a, b ) _mm256_and_ps( a, b )
+#define PV_OR( a, b ) _mm256_or_ps( a, b )
+#define PV_ANDNOT( a, b ) _mm256_andnot_ps( a, b )
+#define PV_GT( a, b ) _mm256_cmp_ps( a, b, _CMP_GT_OQ )
+#define PV_LT( a, b ) _mm256_cmp_ps( a, b, _CMP_LT_OQ )
+#define PV_LE( a, b ) _mm256_cmp_ps( a, b, _CMP_LE_OQ )
+#define PV_MASK( a ) _mm256_movemask_ps( a )
+#define PV_STORE( p, a ) _mm256_storeu_ps( p, a )
+#elif POLY_SIMD == 4
+typedef __m128 PolyVec;
+#define PV_SET1( a ) _mm_set1_ps( a )
+#define PV_LOAD( p ) _mm_loadu_ps( p )
+#define PV_ADD( a, b ) _mm_add_ps( a, b )
+#define PV_SUB( a, b ) _mm_sub_ps( a, b )
+#define PV_MUL( a, b ) _mm_mul_ps( a, b )
+#define PV_MIN( a, b ) _mm_min_ps( a, b )
+#define PV_MAX( a, b ) _mm_max_ps( a, b )
+#define PV_AND( a, b ) _mm_and_ps( a, b )
+#define PV_OR( a, b ) _mm_or_ps( a, b )
+#define PV_ANDNOT( a, b ) _mm_andnot_ps( a, b )
+#define PV_GT( a, b ) _mm_cmpgt_ps( a, b )
+#define PV_LT( a, b ) _mm_cmplt_ps( a, b )
+#define PV_LE( a, b ) _mm_cmple_ps( a, b )
+#define PV_MASK( a ) _mm_movemask_ps( a )
+#define PV_STORE( p, a ) _mm_storeu_ps( p, a )
+#endif /* POLY_SIMD */
+
+/**
+ * @brief Gets the contribution of an edge to the winding number of a point.
+ *
+ *    @param at Polygon to test.
+ *    @param i Index of the start point of the edge.
+ *    @param j Index of the end point of the edge.
+ *    @param px X coordinate of the point relative to the polygon.
+ *    @param py Y coordinate of the point relative to the polygon.
+ *    @return 1 if the edge crosses upwards left of the point, -1 if it crosses
+ *          downwards right of the point, 0 otherwise.
+ */
+static int poly_windingEdge( const CollPolyView *at, int i, int j, float px,
+                             float py )
+{
+   float l = at->nx[i] * ( px - at->x[i] ) + at->ny[i] * ( py - at->y[i] );
+   if ( at->y[i] <= py )
+      return ( at->y[j] > py ) && ( l > 0.f );
+   return -( ( at->y[j] <= py ) && ( l < 0.f ) );
+}
+
+/**
+ * @brief Computes the winding number of a point one edge at a time.
+ *
+ * Reference implementation of poly_winding.
+ */
+static int poly_windingScalar( const CollPolyView *at, float px, float py )
+{
+   int wn = 0;
+   for ( int i = 0; i < at->npt - 1; i++ )
+      wn += poly_windingEdge( at, i, i + 1, px, py );
+   return wn + poly_windingEdge( at, at->npt - 1, 0, px, py );
+}
+
+/**
+ * @brief Computes the winding number of a point around a polygon.
+ *
+ *    @param at Polygon to test.
+ *    @param px X coordinate of the point relative to the polygon.
+ *    @param py Y coordinate of the point relative to the polygon.
+ *    @return Winding number of the point, 0 if it is outside.
+ */
+static int poly_winding( const CollPolyView *at, float px, float py )
+{
+   int i  = 0;
+   int wn = 0;
+#if POLY_SIMD > 1
+   float   sum[POLY_SIMD];
+   PolyVec one  = PV_SET1( 1.f );
+   PolyVec zero = PV_SET1( 0.f );
+   PolyVec vpx  = PV_SET1( px );
+   PolyVec vpy  = PV_SET1( py );
+   PolyVec acc  = zero;
+   /* Edges starting at i end at i+1, so the last point can't start a block. */
+   for ( ; i + POLY_SIMD < at->npt; i += POLY_SIMD ) {
+      PolyVec yi = PV_LOAD( &at->y[i] );
+      PolyVec yj = PV_LOAD( &at->y[i + 1] );
+      PolyVec l  = PV_ADD(
+         PV_MUL( PV_LOAD( &at->nx[i] ), PV_SUB( vpx, PV_LOAD( &at->x[i] ) ) ),
+         PV_MUL( PV_LOAD( &at->ny[i] ), PV_SUB( vpy, yi ) ) );
+      PolyVec below = PV_LE( yi, vpy );
+      PolyVec up = PV_AND( below, PV_AND( PV_GT( yj, vpy ), PV_GT( l, zero ) ) );
+      PolyVec down =
+         PV_ANDNOT( below, PV_AND( PV_LE( yj, vpy ), PV_LT( l, zero ) ) );
+      acc = PV_ADD( acc, PV_SUB( PV_AND( up, one ), PV_AND( down, one ) ) );
+   }
+   PV_STORE( sum, acc );
+   for ( int k = 0; k < POLY_SIMD; k++ )
+      wn += (int)sum[k];
+#endif /* POLY_SIMD > 1 */
+   for ( ; i < at->npt - 1; i++ )
+      wn += poly_windingEdge( at, i, i + 1, px, py );
+   return wn + poly_windingEdge( at, at->npt - 1, 0, px, py );
+}
+
+/**
+ * @brief Checks whether an edge may intersect a segment.
+ *
+ * Conservative test, only discards edges whose bounding box does not overlap
+ * the segment or whose line has both points of the segment on the same side.
+ *
+ *    @param at Polygon to test.
+ *    @param i Index of the start point of the edge.
+ *    @param j Index of the end point of the edge.
+ *    @param x1 X coordinate of the first point relative to the polygon.
+ *    @param y1 Y coordinate of the first point relative to the polygon.
+ *    @param x2 X coordinate of the second point relative to the polygon.
+ *    @param y2 Y coordinate of the second point relative to the polygon.
+ *    @return 1 if the edge may intersect the segment.
+ */
+static int poly_edgeMayHit( const CollPolyView *at, int i, int j, float x1,
+                            float y1, float x2, float y2 )
+{
+   float l1, l2, m;
+   if ( ( MAX( at->x[i], at->x[j] ) + POLY_BOX_MARGIN < MIN( x1, x2 ) ) ||
+        ( MIN( at->x[i], at->x[j] ) - POLY_BOX_MARGIN > MAX( x1, x2 ) ) ||
+        ( MAX( at->y[i], at->y[j] ) + POLY_BOX_MARGIN < MIN( y1, y2 ) ) ||
+        ( MIN( at->y[i], at->y[j] ) - POLY_BOX_MARGIN > MAX( y1, y2 ) ) )
+      return 0;
+   l1 = at->nx[i] * ( x1 - at->x[i] ) + at->ny[i] * ( y1 - at->y[i] );
+   l2 = at->nx[i] * ( x2 - at->x[i] ) + at->ny[i] * ( y2 - at->y[i] );
+   m  = POLY_SIDE_MARGIN * ( FABS( at->nx[i] ) + FABS( at->ny[i] ) );
+   return !( ( ( l1 > m ) && ( l2 > m ) ) || ( ( l1 < -m ) && ( l2 < -m ) ) );
+}
+
+/**
+ * @brief Finds the next edge that may intersect a segment.
+ *
+ * Only goes over the edges going from point i to point i+1, the closing edge
+ * has to be tested separately.
+ *
+ *    @param at Polygon to test.
+ *    @param start Edge to start looking from.
+ *    @param x1 X coordinate of the first point relative to the polygon.
+ *    @param y1 Y coordinate of the first point relative to the polygon.
+ *    @param x2 X coordinate of the second point relative to the polygon.
+ *    @param y2 Y coordinate of the second point relative to the polygon.
+ *    @return Index of the edge or -1 if there are no more.
+ */
+static int poly_edgeCandidate( const CollPolyView *at, int start, float x1,
+                               float y1, float x2, float y2 )
+{
+   int i = start;
+#if POLY_SIMD > 1
+   PolyVec vx1  = PV_SET1( x1 );
+   PolyVec vy1  = PV_SET1( y1 );
+   PolyVec vx2  = PV_SET1( x2 );
+   PolyVec vy2  = PV_SET1( y2 );
+   PolyVec sxlo = PV_SET1( MIN( x1, x2 ) - POLY_BOX_MARGIN );
+   PolyVec sxhi = PV_SET1( MAX( x1, x2 ) + POLY_BOX_MARGIN );
+   PolyVec sylo = PV_SET1( MIN( y1, y2 ) - POLY_BOX_MARGIN );
+   PolyVec syhi = PV_SET1( MAX( y1, y2 ) + POLY_BOX_MARGIN );
+   PolyVec marg = PV_SET1( POLY_SIDE_MARGIN );
+   PolyVec sign = PV_SET1( -0.f );
+   for ( ; i + POLY_SIMD < at->npt; i += POLY_SIMD ) {
+      PolyVec xi = PV_LOAD( &at->x[i] );
+      PolyVec xj = PV_LOAD( &at->x[i + 1] );
+      PolyVec yi = PV_LOAD( &at->y[i] );
+      PolyVec yj = PV_LOAD( &at->y[i + 1] );
+      PolyVec nx = PV_LOAD( &at->nx[i] );
+      PolyVec ny = PV_LOAD( &at->ny[i] );
+      PolyVec l1, l2, m, miss;
+      int     mask;
+
+      /* Bounding boxes. */
+      miss = PV_OR( PV_LT( PV_MAX( xi, xj ), sxlo ),
+                    PV_GT( PV_MIN( xi, xj ), sxhi ) );
+      miss = PV_OR( miss, PV_LT( PV_MAX( yi, yj ), sylo ) );
+      miss = PV_OR( miss, PV_GT( PV_MIN( yi, yj ), syhi ) );
+
+      /* Both points of the segment on the same side of the edge. */
+      l1 = PV_ADD( PV_MUL( nx, PV_SUB( vx1, xi ) ),
+                   PV_MUL( ny, PV_SUB( vy1, yi ) ) );
+      l2 = PV_ADD( PV_MUL( nx, PV_SUB( vx2, xi ) ),
+                   PV_MUL( ny, PV_SUB( vy2, yi ) ) );
+      m  = PV_MUL( marg, PV_ADD( PV_ANDNOT( sign, nx ), PV_ANDNOT( sign, ny ) ) );
+      miss = PV_OR( miss, PV_AND( PV_GT( l1, m ), PV_GT( l2, m ) ) );
+      m    = PV_SUB( PV_SET1( 0.f ), m );
+      miss = PV_OR( miss, PV_AND( PV_LT( l1, m ), PV_LT( l2, m ) ) );
+
+      mask = ~PV_MASK( miss ) & ( ( 1 << POLY_SIMD ) - 1 );
+      if ( mask == 0 )
+         continue;
+      for ( int k = 0; k < POLY_SIMD; k++ )
+         if ( mask & ( 1 << k ) )
+            return i + k;
+   }
+#endif /* POLY_SIMD > 1 */
+   for ( ; i < at->npt - 1; i++ )
+      if ( poly_edgeMayHit( at, i, i + 1, x1, y1, x2, y2 ) )
+         return i;
+   return -1;
+}
+
 /**
  * @brief Checks whether or not a point is inside a polygon.
  *
@@ -440,35 +801,16 @@ const CollPolyView *poly_view( const CollPoly *poly, double dir )
 static int PointInPolygon( const CollPolyView *at, const vec2 *ap, float x,
                            float y )
 {
-   float vprod, sprod, angle;
-   float dxi, dxip, dyi, dyip;
-
-   /* See if the pixel is inside the polygon:
-      We increment the angle when doing a loop along all the points
-      If the final angle is 0, we are outside the polygon
-      Otherwise, the angle should be +/- 2pi*/
-   angle = 0.0;
-   for ( int i = 0; i <= at->npt - 2; i++ ) {
-      dxi   = at->x[i] + VX( *ap ) - x;
-      dxip  = at->x[i + 1] + VX( *ap ) - x;
-      dyi   = at->y[i] + VY( *ap ) - y;
-      dyip  = at->y[i + 1] + VY( *ap ) - y;
-      sprod = dxi * dxip + dyi * dyip;
-      vprod = dxi * dyip - dyi * dxip;
-      angle += atan2( vprod, sprod );
-   }
-   dxi   = at->x[at->npt - 1] + VX( *ap ) - x;
-   dxip  = at->x[0] + VX( *ap ) - x;
-   dyi   = at->y[at->npt - 1] + VY( *ap ) - y;
-   dyip  = at->y[0] + VY( *ap ) - y;
-   sprod = dxi * dxip + dyi * dyip;
-   vprod = dxi * dyip - dyi * dxip;
-   angle += atan2( vprod, sprod );
-
-   if ( FABS( angle ) < DOUBLE_TOL )
+   float px = (float)( x - ap->x );
+   float py = (float)( y - ap->y );
+
+   /* Quick bounding box check. */
+   if ( ( px < at->xmin ) || ( px > at->xmax ) || ( py < at->ymin ) ||
+        ( py > at->ymax ) )
       return 0;
 
-   return 1;
+   /* The point is inside if the polygon winds around it. */
+   return ( poly_winding( at, px, py ) != 0 );
 }
 
 /**
@@ -487,16 +829,24 @@ static int LineOnPolygon( const CollPolyView *at, const vec2 *ap, float x1,
                           float y1, float x2, float y2, vec2 *crash )
 {
    float xi, xip, yi, yip;
+   float lx1 = (float)( x1 - ap->x );
+   float ly1 = (float)( y1 - ap->y );
+   float lx2 = (float)( x2 - ap->x );
+   float ly2 = (float)( y2 - ap->y );
 
    /* In this function, we are only looking for one collision point. */
 
-   xi  = at->x[at->npt - 1] + ap->x;
-   xip = at->x[0] + ap->x;
-   yi  = at->y[at->npt - 1] + ap->y;
-   yip = at->y[0] + ap->y;
-   if ( CollideLineLine( x1, y1, x2, y2, xi, yi, xip, yip, crash ) == 1 )
-      return 1;
-   for ( int i = 0; i <= at->npt - 2; i++ ) {
+   if ( poly_edgeMayHit( at, at->npt - 1, 0, lx1, ly1, lx2, ly2 ) ) {
+      xi  = at->x[at->npt - 1] + ap->x;
+      xip = at->x[0] + ap->x;
+      yi  = at->y[at->npt - 1] + ap->y;
+      yip = at->y[0] + ap->y;
+      if ( CollideLineLine( x1, y1, x2, y2, xi, yi, xip, yip, crash ) == 1 )
+         return 1;
+   }
+   /* Only do the exact test on the edges that can be hit. */
+   for ( int i = poly_edgeCandidate( at, 0, lx1, ly1, lx2, ly2 ); i >= 0;
+         i     = poly_edgeCandidate( at, i + 1, lx1, ly1, lx2, ly2 ) ) {
       xi  = at->x[i] + ap->x;
       xip = at->x[i + 1] + ap->x;
       yi  = at->y[i] + ap->y;
@@ -731,6 +1081,7 @@ int CollideLinePolygon( const vec2 *ap, double ad, double al,
 {
    double ep[2];
    double xi, yi, xip, yip;
+   float  lx1, ly1, lx2, ly2;
    int    real_hits;
    vec2   tmp_crash;
 
@@ -800,21 +1151,28 @@ int CollideLinePolygon( const vec2 *ap, double ad, double al,
    }
 
    /*
-    * Now we check any line of the polygon
+    * Now we check any line of the polygon that can be hit
     */
-   xi  = (double)bt->x[bt->npt - 1] + bp->x;
-   xip = (double)bt->x[0] + bp->x;
-   yi  = (double)bt->y[bt->npt - 1] + bp->y;
-   yip = (double)bt->y[0] + bp->y;
-   if ( CollideLineLine( ap->x, ap->y, ep[0], ep[1], xi, yi, xip, yip,
-                         &tmp_crash ) ) {
-      crash[real_hits].x = tmp_crash.x;
-      crash[real_hits].y = tmp_crash.y;
-      real_hits++;
-      if ( real_hits == 2 )
-         return 1;
+   lx1 = (float)( ap->x - bp->x );
+   ly1 = (float)( ap->y - bp->y );
+   lx2 = (float)( ep[0] - bp->x );
+   ly2 = (float)( ep[1] - bp->y );
+   if ( poly_edgeMayHit( bt, bt->npt - 1, 0, lx1, ly1, lx2, ly2 ) ) {
+      xi  = (double)bt->x[bt->npt - 1] + bp->x;
+      xip = (double)bt->x[0] + bp->x;
+      yi  = (double)bt->y[bt->npt - 1] + bp->y;
+      yip = (double)bt->y[0] + bp->y;
+      if ( CollideLineLine( ap->x, ap->y, ep[0], ep[1], xi, yi, xip, yip,
+                            &tmp_crash ) ) {
+         crash[real_hits].x = tmp_crash.x;
+         crash[real_hits].y = tmp_crash.y;
+         real_hits++;
+         if ( real_hits == 2 )
+            return 1;
+      }
    }
-   for ( int i = 0; i <= bt->npt - 2; i++ ) {
+   for ( int i = poly_edgeCandidate( bt, 0, lx1, ly1, lx2, ly2 ); i >= 0;
+         i     = poly_edgeCandidate( bt, i + 1, lx1, ly1, lx2, ly2 ) ) {
       xi  = (double)bt->x[i] + bp->x;
       xip = (double)bt->x[i + 1] + bp->x;
       yi  = (double)bt->y[i] + bp->y;
@@ -942,11 +1300,12 @@ int CollideCircleSprite( const vec2 *ap, double ar, const glTexture *bt,
                          const int bsx, const int bsy, const vec2 *bp,
                          vec2 *crash )
 {
-   int r, acx, acy, ax1, ax2, ay1, ay2;
-   int bx1, bx2, by1, by2;
-   int inter_x0, inter_x1, inter_y0, inter_y1;
-   int rbsy;
-   int bbx, bby;
+   int               r, acx, acy, ax1, ax2, ay1, ay2;
+   int               bx1, bx2, by1, by2;
+   int               inter_x0, inter_x1, inter_y0, inter_y1;
+   int               rbsy;
+   const glTransMap *mb;
+   const int16_t    *boxb;
 
 #if DEBUGGING
    /* Make sure the surfaces have transparency maps. */
@@ -986,18 +1345,35 @@ int CollideCircleSprite( const vec2 *ap, double ar, const glTexture *bt,
    /* real vertical sprite value (flipped) */
    rbsy = bt->sy - bsy - 1;
 
-   /* set up the base points */
-   bbx = bsx * (int)( bt->sw ) - bx1;
-   bby = rbsy * (int)( bt->sh ) - by1;
+   /* only look where the sprite has pixels */
+   mb       = bt->trans;
+   boxb     = gl_transBox( mb, bsx, rbsy );
+   inter_y0 = MAX( inter_y0, by1 + boxb[1] );
+   inter_y1 = MIN( inter_y1, by1 + boxb[3] );
+
    for ( int y = inter_y0; y <= inter_y1; y++ ) {
-      for ( int x = inter_x0; x <= inter_x1; x++ ) {
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ( ( !gl_isTrans( bt, bbx + x, bby + y ) ) ) {
-            if ( pow2( x - acx ) + pow2( y - acy ) <= r * r ) {
-               crash->x = x;
-               crash->y = y;
-               return 1;
-            }
+      const uint64_t *rb;
+      int             x0, x1, dx;
+      int             rem = r * r - pow2( y - acy );
+      if ( rem < 0 )
+         continue;
+
+      /* span of the row inside the circle, |x-acx| <= dx */
+      dx = (int)sqrt( (double)rem );
+      while ( pow2( dx + 1 ) <= rem )
+         dx++;
+      while ( pow2( dx ) > rem )
+         dx--;
+      x0 = MAX( MAX( inter_x0, acx - dx ), bx1 + boxb[0] );
+      x1 = MIN( MIN( inter_x1, acx + dx ), bx1 + boxb[2] );
+
+      rb = gl_transRow( mb, bsx, rbsy, y - by1 );
+      for ( int x = x0; x <= x1; x += 64 ) {
+         uint64_t m = trans_bits( mb, rb, x - bx1 ) & TRANS_MASK( x1 - x + 1 );
+         if ( m != 0 ) {
+            crash->x = x + trans_firstBit( m );
+            crash->y = y;
+            return 1;
          }
       }
    }
@@ -1195,3 +1571,100 @@ double CollideCircleIntersection( const vec2 *p1, double r1, const vec2 *p2,
 
    return A1 + A2;
 }
+
+/**
+ * @brief Gets the time elapsed since a performance counter in milliseconds.
+ */
+static double poly_benchmarkMs( Uint64 t )
+{
+   return 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+          (double)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Logs the performance of the polygon tests.
+ *
+ * Points and segments are taken at random around the bounding box of each
+ * polygon, and the results of the vectorized tests are checked against the
+ * scalar ones.
+ *
+ *    @param polys Polygons to test.
+ *    @param npolys Number of polygons.
+ *    @param n Number of tests to do of each kind.
+ */
+void poly_benchmark( const CollPoly *const *polys, int npolys, int n )
+{
+   Uint64 t;
+   double tsimd, tscalar;
+   int    hits, mismatch, nedges;
+   float *px, *py;
+   char  *inside;
+   vec2   o, crash;
+
+   if ( npolys <= 0 )
+      return;
+
+   /* Random points around the polygons. */
+   px = malloc( 4 * n * sizeof( float ) );
+   py = &px[2 * n];
+   for ( int i = 0; i < 2 * n; i++ ) {
+      const CollPolyView *v = &polys[i % npolys]->views[0];
+      px[i] = v->xmin + ( RNGF() * 1.5 - 0.25 ) * ( v->xmax - v->xmin );
+      py[i] = v->ymin + ( RNGF() * 1.5 - 0.25 ) * ( v->ymax - v->ymin );
+   }
+   vectnull( &o );
+   nedges = 0;
+   for ( int i = 0; i < npolys; i++ )
+      nedges += polys[i]->views[0].npt;
+
+   /* Point in polygon, each sample is compared so that mismatches can't
+    * cancel each other out. */
+   inside   = malloc( n );
+   hits     = 0;
+   mismatch = 0;
+   t        = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ ) {
+      inside[i] =
+         ( poly_winding( &polys[i % npolys]->views[0], px[i], py[i] ) != 0 );
+      hits += inside[i];
+   }
+   tsimd = poly_benchmarkMs( t );
+   t     = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ )
+      mismatch +=
+         ( ( poly_windingScalar( &polys[i % npolys]->views[0], px[i], py[i] ) !=
+             0 ) != inside[i] );
+   tscalar = poly_benchmarkMs( t );
+   free( inside );
+   LOG( _( "Polygons: %d polygons with %.1f edges on average (%d wide "
+           "vectors)" ),
+        npolys, (double)nedges / (double)npolys, POLY_SIMD );
+   LOG( _( "Polygons: %d point tests in %.3f ms (scalar %.3f ms), %d hits, %d "
+           "mismatches" ),
+        n, tsimd, tscalar, hits, mismatch );
+
+   /* Segments against polygons. */
+   hits = 0;
+   t    = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ )
+      hits += LineOnPolygon( &polys[i % npolys]->views[0], &o, px[i], py[i],
+                             px[n + i], py[n + i], &crash );
+   tsimd = poly_benchmarkMs( t );
+   LOG( _( "Polygons: %d segment tests in %.3f ms, %d hits" ), n, tsimd,
+        hits );
+
+   /* Polygons against polygons. */
+   hits = 0;
+   t    = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ ) {
+      vec2 p;
+      vec2_cset( &p, px[i], py[i] );
+      hits += CollidePolygon( &polys[i % npolys]->views[0], &o,
+                              &polys[( i * 7 + 3 ) % npolys]->views[0], &p,
+                              &crash );
+   }
+   tsimd = poly_benchmarkMs( t );
+   LOG( _( "Polygons: %d polygon tests in %.3f ms, %d hits" ), n, tsimd, hits );
+
+   free( px );
+}
@@ -3,16 +3,23 @@
  */
 #pragma once
 
+#include "arena.h"
 #include "nxml.h" // IWYU pragma: keep
 #include "opengl_tex.h"
 #include "vec2.h"
 
 /**
  * @brief Represents a polygon used for collision detection.
+ *
+ * Stored as a structure of arrays so that the edges can be tested several at
+ * a time. Edge i goes from point i to point i+1, with the last one closing the
+ * polygon.
  */
 typedef struct CollPolyView_ {
    float *x;    /**< List of X coordinates of the points. */
    float *y;    /**< List of Y coordinates of the points. */
+   float *nx;   /**< X component of the (unnormalized) left normal of edges. */
+   float *ny;   /**< Y component of the (unnormalized) left normal of edges. */
    float  xmin; /**< Min of x. */
    float  xmax; /**< Max of x. */
    float  ymin; /**< Min of y. */
@@ -30,13 +37,16 @@ typedef struct CollPoly_ {
 void poly_load( CollPoly *polygon, xmlNodePtr node, const char *name );
 void poly_free( CollPoly *polygon );
 
-/* Rotates a polygon. */
+/* Rotates a polygon, allocating from an arena or the frame arena if NULL. */
 void poly_rotate( CollPolyView *rpolygon, const CollPolyView *ipolygon,
-                  float theta );
+                  float theta, Arena *arena );
 
 /* Gets a polygon view for an angle. */
 const CollPolyView *poly_view( const CollPoly *poly, double dir );
 
+/* Logs the performance of the polygon tests. */
+void poly_benchmark( const CollPoly *const *polys, int npolys, int n );
+
 /* Returns 1 if collision is detected */
 int CollideSprite( const glTexture *at, const int asx, const int asy,
                    const vec2 *ap, const glTexture *bt, const int bsx,
@@ -21,6 +21,7 @@
 #include "faction.h"
 #include "gatherable.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nxml.h"
 #include "opengl.h"
@@ -35,6 +36,9 @@
 Commodity         *commodity_stack = NULL; /**< Contains all the commodities. */
 static Commodity **commodity_temp =
    NULL; /**< Contains all the temporary commodities. */
+static NameIndex commodity_nameidx; /**< Commodity indices by name. */
+static NameIndex
+   commodity_tempidx; /**< Temporary commodity indices by name. */
 
 /* @TODO remove externs. */
 extern int *econ_comm;
@@ -165,14 +169,12 @@ Commodity *commodity_get( const char *name )
  */
 Commodity *commodity_getW( const char *name )
 {
-   const Commodity q = { .name = (char *)name };
-   Commodity *r = bsearch( &q, commodity_stack, array_size( commodity_stack ),
-                           sizeof( Commodity ), commodity_cmp );
-   if ( r != NULL )
-      return r;
-   for ( int i = 0; i < array_size( commodity_temp ); i++ )
-      if ( strcmp( commodity_temp[i]->name, name ) == 0 )
-         return commodity_temp[i];
+   int id = nidx_get( &commodity_nameidx, name );
+   if ( id >= 0 )
+      return &commodity_stack[id];
+   id = nidx_get( &commodity_tempidx, name );
+   if ( id >= 0 )
+      return commodity_temp[id];
    return NULL;
 }
 
@@ -436,12 +438,10 @@ int commodity_checkIllegal( const Commodity *com, int faction )
  */
 int commodity_isTemp( const char *name )
 {
-   for ( int i = 0; i < array_size( commodity_temp ); i++ )
-      if ( strcmp( commodity_temp[i]->name, name ) == 0 )
-         return 1;
-   for ( int i = 0; i < array_size( commodity_stack ); i++ )
-      if ( strcmp( commodity_stack[i].name, name ) == 0 )
-         return 0;
+   if ( nidx_get( &commodity_tempidx, name ) >= 0 )
+      return 1;
+   if ( nidx_get( &commodity_nameidx, name ) >= 0 )
+      return 0;
 
    WARN( _( "Commodity '%s' not found in stack" ), name );
    return 0;
@@ -457,8 +457,12 @@ int commodity_isTemp( const char *name )
 Commodity *commodity_newTemp( const char *name, const char *desc )
 {
    Commodity **c;
-   if ( commodity_temp == NULL )
+   if ( commodity_temp == NULL ) {
       commodity_temp = array_create( Commodity * );
+      nidx_create( &commodity_tempidx );
+   }
+   if ( nidx_get( &commodity_tempidx, name ) < 0 )
+      nidx_set( &commodity_tempidx, name, array_size( commodity_temp ) );
 
    c                   = &array_grow( &commodity_temp );
    *c                  = calloc( 1, sizeof( Commodity ) );
@@ -555,6 +559,9 @@ int commodity_load( void )
    /* Sort. */
    qsort( commodity_stack, array_size( commodity_stack ), sizeof( Commodity ),
           commodity_cmp );
+   nidx_create( &commodity_nameidx );
+   for ( int i = 0; i < array_size( commodity_stack ); i++ )
+      nidx_set( &commodity_nameidx, commodity_stack[i].name, i );
 
    /* Load into commodity stack. */
    for ( int i = 0; i < array_size( commodity_stack ); i++ ) {
@@ -597,6 +604,9 @@ void commodity_free( void )
    array_free( commodity_temp );
    commodity_temp = NULL;
 
+   nidx_free( &commodity_nameidx );
+   nidx_free( &commodity_tempidx );
+
    /* More clean up. */
    array_free( econ_comm );
    econ_comm = NULL;
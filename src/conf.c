@@ -153,6 +153,9 @@ void conf_setDefaults( void )
    conf.devautosave              = 0;
    conf.lua_enet                 = 0;
    conf.lua_repl                 = 0;
+   conf.ai_lod                   = AI_LOD_DEFAULT;
+   conf.linopt_cache             = 1;
+   conf.fast_warmup              = 1;
    conf.lastversion              = strdup( "" );
    conf.translation_warning_seen = 0;
    memset( &conf.last_played, 0, sizeof( time_t ) );
@@ -173,7 +176,8 @@ void conf_setDefaults( void )
    input_setDefault( 1 );
 
    /* Debugging. */
-   conf.fpu_except = 0; /* Causes many issues. */
+   conf.fpu_except    = 0; /* Causes many issues. */
+   conf.deterministic = 0;
 
    /* Editor. */
    if ( nfile_dirExists( "../dat/" ) )
@@ -437,6 +441,9 @@ int conf_loadConfig( const char *file )
       conf_loadBool( lEnv, "devmode", conf.devmode );
       conf_loadBool( lEnv, "devautosave", conf.devautosave );
       conf_loadBool( lEnv, "lua_enet", conf.lua_enet );
+      conf_loadInt( lEnv, "ai_lod", conf.ai_lod );
+      conf_loadBool( lEnv, "linopt_cache", conf.linopt_cache );
+      conf_loadBool( lEnv, "fast_warmup", conf.fast_warmup );
       conf_loadBool( lEnv, "lua_repl", conf.lua_repl );
       conf_loadBool( lEnv, "conf_nosave", conf.nosave );
       conf_loadString( lEnv, "lastversion", conf.lastversion );
@@ -446,6 +453,7 @@ int conf_loadConfig( const char *file )
 
       /* Debugging. */
       conf_loadBool( lEnv, "fpu_except", conf.fpu_except );
+      conf_loadBool( lEnv, "deterministic", conf.deterministic );
 
       /* Editor. */
       conf_loadString( lEnv, "dev_data_dir", conf.dev_data_dir );
@@ -1177,6 +1185,22 @@ int conf_saveConfig( const char *file )
    conf_saveBool( "lua_repl", conf.lua_repl );
    conf_saveEmptyLine();
 
+   conf_saveComment( _( "Number of frames between AI thinks of pilots that are "
+                        "far away from the player and not fighting (1 or less "
+                        "makes all pilots think every frame)" ) );
+   conf_saveInt( "ai_lod", conf.ai_lod );
+   conf_saveEmptyLine();
+
+   conf_saveComment( _( "Save the solutions of the ship equipment optimizer to "
+                        "the cache directory to reuse them between runs" ) );
+   conf_saveBool( "linopt_cache", conf.linopt_cache );
+   conf_saveEmptyLine();
+
+   conf_saveComment( _( "Simulate new systems with coarser steps and without "
+                        "weapon collisions before the player arrives" ) );
+   conf_saveBool( "fast_warmup", conf.fast_warmup );
+   conf_saveEmptyLine();
+
    conf_saveComment(
       _( "Save the config every time game exits (rewriting this bit)" ) );
    conf_saveInt( "conf_nosave", conf.nosave );
@@ -1203,6 +1227,11 @@ int conf_saveConfig( const char *file )
    conf_saveBool( "fpu_except", conf.fpu_except );
    conf_saveEmptyLine();
 
+   conf_saveComment( _( "Runs the simulation updates serially instead of on "
+                        "the thread pool, useful for replays and debugging" ) );
+   conf_saveBool( "deterministic", conf.deterministic );
+   conf_saveEmptyLine();
+
    /* Editor. */
    conf_saveComment( _( "Path where the main data is stored at" ) );
    conf_saveString( "dev_data_dir", conf.dev_data_dir );
@@ -81,6 +81,7 @@
 #define FONT_SIZE_SMALL_DEFAULT 11   /**< Default small font size. */
 #define LOW_MEMORY_DEFAULT 0         /**< Default for low memory mode. */
 #define MAX_3D_TEX_SIZE 256          /**< Maximum 3D texture size. */
+#define AI_LOD_DEFAULT 4 /**< Frames between thinks of low detail AI pilots. */
 /* Audio options */
 #define USE_EFX_DEFAULT 1 /**< Whether or not to use EFX (if using OpenAL). */
 #define MUTE_SOUND_DEFAULT 0      /**< Whether sound should be disabled. */
@@ -198,15 +199,19 @@ typedef struct PlayerConf_s {
    int   devmode;               /**< Developer mode. */
    int   devautosave;           /**< Developer mode autosave. */
    int   lua_enet;              /**< Enable the lua-enet library. */
-   int   lua_repl;    /**< Enable the experimental CLI based on lua-repl. */
-   int   nosave;      /**< Disables conf saving. */
-   char *lastversion; /**< The last version the game was ran in. */
+   int   lua_repl;     /**< Enable the experimental CLI based on lua-repl. */
+   int   ai_lod;       /**< Frames between thinks of low detail AI pilots. */
+   int   linopt_cache; /**< Save linear optimization solutions to disk. */
+   int   fast_warmup;  /**< Use the fast simulation when entering systems. */
+   int   nosave;       /**< Disables conf saving. */
+   char *lastversion;  /**< The last version the game was ran in. */
    int   translation_warning_seen; /**< No need to warn about incomplete game
                                       translations again. */
    time_t last_played;             /**< Date the game was last played. */
 
    /* Debugging. */
-   int fpu_except; /**< Enable FPU exceptions? */
+   int fpu_except;    /**< Enable FPU exceptions? */
+   int deterministic; /**< Force serial simulation updates. */
 
    /* Editor. */
    char *dev_data_dir; /**< Path where most data should be. */
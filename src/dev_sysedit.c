@@ -24,6 +24,7 @@
 #include "dev_uniedit.h"
 #include "dialogue.h"
 #include "economy.h"
+#include "map.h"
 #include "ndata.h"
 #include "nstring.h"
 #include "opengl.h"
@@ -1936,6 +1937,7 @@ static void sysedit_editJumpClose( unsigned int wid, const char *unused )
       jp_rmFlag( j, JP_HIDDEN );
       jp_rmFlag( j, JP_EXITONLY );
    }
+   map_jumpDistInvalidate();
    j->hide = atof( window_getInput( sysedit_widEdit, "inpHide" ) );
 
    window_close( wid, unused );
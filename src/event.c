@@ -94,6 +94,7 @@ static int          event_parseFile( const char *file, EventData *temp );
 static int          event_parseXML( EventData *temp, const xmlNodePtr parent );
 static void         event_freeData( EventData *event );
 static int          event_create( int dataid, unsigned int *id );
+static int          event_loadLibs( nlua_env env );
 int                 events_saveActive( xmlTextWriterPtr writer );
 int                 events_loadActive( xmlNodePtr parent );
 static int          events_parseActive( xmlNodePtr parent );
@@ -187,6 +188,25 @@ static unsigned int event_genID( void )
    return id;
 }
 
+/**
+ * @brief Loads the libraries of the event environments.
+ *
+ *    @param env Environment to load into.
+ *    @return 0 on success.
+ */
+static int event_loadLibs( nlua_env env )
+{
+   nlua_loadStandard( env );
+   nlua_loadEvt( env );
+   nlua_loadHook( env );
+   nlua_loadCamera( env );
+   nlua_loadTex( env );
+   nlua_loadBackground( env );
+   nlua_loadMusic( env );
+   nlua_loadTk( env );
+   return 0;
+}
+
 /**
  * @brief Creates an event.
  *
@@ -217,15 +237,7 @@ static int event_create( int dataid, unsigned int *id )
    data     = &event_data[dataid];
 
    /* Open the new state. */
-   ev->env = nlua_newEnv( data->sourcefile );
-   nlua_loadStandard( ev->env );
-   nlua_loadEvt( ev->env );
-   nlua_loadHook( ev->env );
-   nlua_loadCamera( ev->env );
-   nlua_loadTex( ev->env );
-   nlua_loadBackground( ev->env );
-   nlua_loadMusic( ev->env );
-   nlua_loadTk( ev->env );
+   ev->env = nlua_newEnvLibs( data->sourcefile, event_loadLibs );
 
    /* Create the "mem" table for persistence. */
    lua_newtable( naevL );
@@ -693,7 +705,7 @@ static int event_parseFile( const char *file, EventData *temp )
    }
 
    /* Check to see if syntax is valid. */
-   ret = luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+   ret = nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Event Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
@@ -21,6 +21,7 @@
 #include "colour.h"
 #include "hook.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_system.h"
@@ -127,6 +128,7 @@ typedef struct Faction_ {
 } Faction;
 
 static Faction *faction_stack = NULL; /**< Faction stack. */
+static NameIndex faction_nameidx;      /**< Faction indices by name. */
 static int     *faction_grid  = NULL; /**< Grid of faction status. */
 static size_t   faction_mgrid = 0;    /**< Allocated memory. */
 
@@ -144,6 +146,7 @@ static int    faction_parse( Faction *temp, const char *file );
 static int    faction_parseSocial( const char *file );
 static void faction_addStandingScript( Faction *temp, const char *scriptname );
 static void faction_computeGrid( void );
+static void faction_reindex( void );
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -155,6 +158,17 @@ static int faction_cmp( const void *p1, const void *p2 )
    return strcmp( f1->name, f2->name );
 }
 
+/**
+ * @brief Rebuilds the name index of the factions.
+ */
+static void faction_reindex( void )
+{
+   nidx_clear( &faction_nameidx );
+   /* Go backwards so the first faction with a name wins. */
+   for ( int i = array_size( faction_stack ) - 1; i >= 0; i-- )
+      nidx_set( &faction_nameidx, faction_stack[i].name, i );
+}
+
 /**
  * @brief Gets a faction ID by name.
  *
@@ -170,23 +184,9 @@ static int faction_getRaw( const char *name )
    if ( strcmp( name, "Escort" ) == 0 )
       return FACTION_PLAYER;
 
-   if ( name != NULL ) {
-      int i;
-      for ( i = 0; i < array_size( faction_stack ); i++ )
-         if ( strcmp( faction_stack[i].name, name ) == 0 )
-            break;
-
-      if ( i != array_size( faction_stack ) )
-         return i;
-
-      /* Dynamic factions are why we can't have nice things.
-      const Faction f = { .name = (char*)name };
-      Faction *found = bsearch( &f, faction_stack, array_size(faction_stack),
-      sizeof(Faction), faction_cmp ); if (found != NULL) return found -
-      faction_stack;
-      */
-   }
-   return -1;
+   /* Dynamic factions are added at the end of the stack so it is not sorted,
+    * but they are kept in the index. */
+   return nidx_get( &faction_nameidx, name );
 }
 
 /**
@@ -2044,6 +2044,8 @@ int factions_load( void )
    /* Sort by name. */
    qsort( faction_stack, array_size( faction_stack ), sizeof( Faction ),
           faction_cmp );
+   nidx_create( &faction_nameidx );
+   faction_reindex();
    faction_player = faction_get( "Player" );
 
    /* Second pass - sets allies and enemies */
@@ -2202,6 +2204,7 @@ void factions_free( void )
       faction_freeOne( &faction_stack[i] );
    array_free( faction_stack );
    faction_stack = NULL;
+   nidx_free( &faction_nameidx );
 
    /* Clean up faction grid. */
    free( faction_grid );
@@ -2392,6 +2395,7 @@ void factions_clearDynamic( void )
       faction_freeOne( f );
       array_erase( &faction_stack, f, f + 1 );
    }
+   faction_reindex();
    faction_computeGrid();
 }
 
@@ -2449,6 +2453,10 @@ int faction_dynAdd( int base, const char *name, const char *display,
    if ( colour != NULL )
       f->colour = *colour;
 
+   /* Only the first faction with a name can be looked up. */
+   if ( nidx_get( &faction_nameidx, name ) < 0 )
+      nidx_set( &faction_nameidx, name, f - faction_stack );
+
    /* TODO make this incremental. */
    faction_computeGrid();
 
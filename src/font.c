@@ -9,6 +9,11 @@
  * We use distance fields [1] to render high quality fonts with the help of
  * some shaders. Characters are generated on demand using a texture atlas.
  *
+ * Glyphs are rasterized with FreeType when first needed, but the distance
+ * fields are built on the job system, so glyphs are laid out with their real
+ * metrics but not drawn until they are ready. Built glyphs are saved in the
+ * cache directory so that later runs can upload them directly.
+ *
  * [1]:
  * https://steamcdn-a.akamaihd.net/apps/valve/2007/SIGGRAPH2007_AlphaTestedMagnification.pdf
  */
@@ -21,6 +26,8 @@
 #include "linebreakdef.h"
 #include <wctype.h>
 
+#include "SDL_mutex.h"
+
 #include "naev.h"
 /** @endcond */
 
@@ -28,9 +35,14 @@
 
 #include "array.h"
 #include "distance_field.h"
+#include "gettext.h"
 #include "log.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "ntracing.h"
+#include "threadpool.h"
+#include "toolkit.h"
 #include "utf8.h"
 
 #define MAX_EFFECT_RADIUS                                                      \
@@ -40,6 +52,12 @@
 #define DEFAULT_TEXTURE_SIZE                                                   \
    1024             /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_PREWARM_MAX                                                       \
+   1024 /**< Max number of common characters of the language to pre-warm. */
+#define FONT_ATLAS_PATH "fonts/" /**< Glyph atlas cache directory. */
+#define FONT_ATLAS_MAGIC                                                       \
+   "NFAT" /**< Magic number of the glyph atlas cache files. */
+#define FONT_ATLAS_VERSION 1 /**< Version of the glyph atlas cache files. */
 
 /**
  * OpenGL rendering stuff. Since we can't actually render with multiple threads
@@ -79,14 +97,16 @@ typedef struct glFontGlyph_s {
    int      tex_index; /**< Might be on different texture. */
    GLushort vbo_id;    /**< VBO index to use. */
    int      next;      /**< Stored as a linked list. */
+   int      pending;   /**< Distance field is still being built. */
 } glFontGlyph;
 
 /**
  * @brief Stores a font character.
  */
 typedef struct font_char_s {
-   GLubyte *data;     /**< Data of the character. */
-   GLfloat *dataf;    /**< Float data of the character. */
+   GLubyte *data; /**< Data of the character, the padded bitmap until the
+                     distance field is built. */
+   int      sdf;      /**< Distance field still has to be built. */
    int      w;        /**< Width. */
    int      h;        /**< Height. */
    int      ft_index; /**< HACK: Index into the array of fallback fonts. */
@@ -105,10 +125,12 @@ typedef struct font_char_s {
  * fallback reasons.
  */
 typedef struct glFontFile_s {
-   char    *name;     /**< Font file name. */
-   int      refcount; /**< Reference counting. */
-   FT_Byte *data;     /**< Font data buffer. */
-   size_t   datasize; /**< Font data size. */
+   char      *name;     /**< Font file name. */
+   int        refcount; /**< Reference counting. */
+   FT_Byte   *data;     /**< Font data buffer. */
+   size_t     datasize; /**< Font data size. */
+   int        hashed;   /**< Whether md5 has been computed. */
+   md5_byte_t md5[16];  /**< Hash of the font data. */
 } glFontFile;
 
 /**
@@ -119,6 +141,35 @@ typedef struct glFontStashFreetype_s {
    FT_Face     face; /**< Face structure. */
 } glFontStashFreetype;
 
+/**
+ * @brief Glyph stored in the atlas cache files.
+ *
+ * The files have a FontAtlasHeader, followed by the glyphs and then the
+ * distance fields of all the glyphs.
+ */
+typedef struct FontAtlasGlyph_ {
+   uint32_t codepoint; /**< Real character. */
+   int32_t  ft_index;  /**< Index into the array of fallback fonts. */
+   int32_t  w;         /**< Width. */
+   int32_t  h;         /**< Height. */
+   int32_t  off_x;     /**< X offset when rendering. */
+   int32_t  off_y;     /**< Y offset when rendering. */
+   float    adv_x;     /**< X advancement on the screen. */
+   float    m;         /**< Distance units corresponding to 1 "pixel". */
+   uint32_t offset;    /**< Offset of the distance field in the data. */
+} FontAtlasGlyph;
+
+/**
+ * @brief Header of the glyph atlas cache files.
+ */
+typedef struct FontAtlasHeader_ {
+   char       magic[4]; /**< FONT_ATLAS_MAGIC. */
+   uint32_t   version;  /**< FONT_ATLAS_VERSION. */
+   md5_byte_t key[16];  /**< Hash of the font files and parameters. */
+   uint32_t   nglyphs;  /**< Number of glyphs. */
+   uint32_t   datasize; /**< Size of the distance field data. */
+} FontAtlasHeader;
+
 /**
  * @brief Font structure.
  */
@@ -141,6 +192,13 @@ typedef struct glFontStash_s {
    int          mvbo;          /**< Amount of vbo memory. */
    glFontGlyph *glyphs;        /**< Unicode glyphs. */
    int          lut[HASH_LUT_SIZE]; /**< Look up table. */
+   int          vbo_dirty; /**< VBO data has to be uploaded. */
+
+   /* Atlas cache. */
+   int atlas_state; /**< 0 not loaded, 1 loaded, -1 not to be saved. */
+   int atlas_dirty; /**< Glyphs have been built since loading. */
+   FontAtlasGlyph *atlas; /**< Array (array.h): Built glyphs to save. */
+   GLubyte *atlas_data;   /**< Array (array.h): Their distance fields. */
 
    /* Freetype stuff. */
    glFontStashFreetype *ft;
@@ -159,6 +217,21 @@ glFont gl_defFont;     /**< Default font. */
 glFont gl_smallFont;   /**< Small font. */
 glFont gl_defFontMono; /**< Default mono font. */
 
+/**
+ * @brief Glyph whose distance field is being built on the job system.
+ */
+typedef struct FontGlyphJob_ {
+   int         stash; /**< Index of the font stash in avail_fonts. */
+   int         glyph; /**< Index of the glyph in the stash. */
+   int         h;     /**< Font height. */
+   font_char_t ch;    /**< Character being built. */
+} FontGlyphJob;
+
+static SDL_mutex     *font_lock = NULL; /**< Lock for font_done. */
+static FontGlyphJob **font_done =
+   NULL; /**< Array (array.h): Glyphs built but not uploaded. */
+static Job *font_jobs = NULL; /**< Parent of the glyphs being built. */
+
 /* Last used colour. */
 static const glColour *font_lastCol =
    NULL; /**< Stores last colour used (activated by FONT_COLOUR_CODE). */
@@ -175,6 +248,22 @@ static const glColour *gl_fontGetColour( uint32_t ch );
 static uint32_t        font_nextChar( const char *s, size_t *i );
 /* Get unicode glyphs from cache. */
 static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
+static glFontGlyph *gl_fontNewGlyph( glFontStash *stsh, uint32_t ch,
+                                     const font_char_t *ft_char );
+static void gl_fontAddChar( glFontStash *stsh, glFontGlyph *glyph,
+                            const font_char_t *ch );
+static void gl_fontBuildChar( font_char_t *c, int h );
+static void gl_fontBuildJob( Job *job, void *data );
+static void gl_fontProcessGlyphs( void );
+static void gl_fontWaitGlyphs( void );
+static int  gl_fontCanDefer( void );
+static void gl_fontActivateVBO( const glFontStash *stsh );
+static void gl_fontUpdateVBO( glFontStash *stsh );
+/* Atlas cache. */
+static int  gl_fontAtlasPath( glFontStash *stsh, char *path, size_t len,
+                              md5_byte_t key[16] );
+static void gl_fontAtlasLoad( glFontStash *stsh );
+static void gl_fontAtlasSave( glFontStash *stsh );
 /* Render.
  * TODO this should be changed to be more like font-stash
  * (https://github.com/akrinke/Font-Stash) In particular, instead of writing
@@ -202,10 +291,37 @@ static glFontStash *gl_fontGetStash( const glFont *font )
    return &avail_fonts[font->id];
 }
 
+/**
+ * @brief Activates the VBOs of a font stash for rendering.
+ */
+static void gl_fontActivateVBO( const glFontStash *stsh )
+{
+   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2,
+                               GL_SHORT, 0 );
+   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2,
+                               GL_FLOAT, 0 );
+}
+
+/**
+ * @brief Uploads the VBO data of a font stash after adding glyphs.
+ */
+static void gl_fontUpdateVBO( glFontStash *stsh )
+{
+   int n = 8 * stsh->nvbo;
+   gl_vboData( stsh->vbo_tex, sizeof( GLfloat ) * n, stsh->vbo_tex_data );
+   gl_vboData( stsh->vbo_vert, sizeof( GLshort ) * n, stsh->vbo_vert_data );
+   stsh->vbo_dirty = 0;
+
+   /* Since the VBOs have possibly changed, we have to reset the data. */
+   gl_fontActivateVBO( stsh );
+}
+
 /**
  * @brief Adds a font glyph to the texture stash.
+ *
+ * The VBO data is not uploaded, gl_fontUpdateVBO has to be called afterwards.
  */
-static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
+static int gl_fontAddGlyphTex( glFontStash *stsh, const font_char_t *ch,
                                glFontGlyph *glyph )
 {
    int        n;
@@ -295,12 +411,8 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
    /* Upload data. */
    glBindTexture( GL_TEXTURE_2D, tex->id );
    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-   if ( ch->dataf != NULL )
-      glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h, GL_RED,
-                       GL_FLOAT, ch->dataf );
-   else
-      glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h, GL_RED,
-                       GL_UNSIGNED_BYTE, ch->data );
+   glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h, GL_RED,
+                    GL_UNSIGNED_BYTE, ch->data );
    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 
    /* Check for error. */
@@ -372,9 +484,7 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
    vbo_vert[5] = vy;
    vbo_vert[6] = vx + vw; /* Bottom right. */
    vbo_vert[7] = vy;
-   /* Update vbos. */
-   gl_vboData( stsh->vbo_tex, sizeof( GLfloat ) * n, stsh->vbo_tex_data );
-   gl_vboData( stsh->vbo_vert, sizeof( GLshort ) * n, stsh->vbo_vert_data );
+   stsh->vbo_dirty = 1;
 
    /* Add space for the new character. */
    gr->x += ch->w;
@@ -383,12 +493,6 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
    glyph->vbo_id    = ( n - 8 ) / 2;
    glyph->tex_index = tex - stsh->tex;
 
-   /* Since the VBOs have possibly changed, we have to reset the data. */
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2,
-                               GL_SHORT, 0 );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2,
-                               GL_FLOAT, 0 );
-
    return 0;
 }
 
@@ -1257,7 +1361,6 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
    for ( int i = 0; i < len; i++ ) {
       FT_UInt              glyph_index;
       int                  w, h, rw, rh, b;
-      double               vmax;
       FT_Bitmap            bitmap;
       FT_GlyphSlot         slot;
       glFontStashFreetype *ft = &stsh->ft[i];
@@ -1293,34 +1396,30 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
       h = bitmap.rows;
 
       /* Store data. */
-      c->data  = NULL;
-      c->dataf = NULL;
       if ( bitmap.buffer == NULL ) {
          /* Space characters tend to have no buffer. */
          b       = 0;
          rw      = w;
          rh      = h;
-         c->data = malloc( sizeof( GLubyte ) * w * h );
-         memset( c->data, 0, sizeof( GLubyte ) * w * h );
-         vmax = 1.0; /* arbitrary */
+         c->data = calloc( MAX( w * h, 1 ), sizeof( GLubyte ) );
+         c->sdf  = 0;
+         c->m    = ( 2. * stsh->h ) / FONT_DISTANCE_FIELD_SIZE; /* vmax = 1 */
       } else {
-         GLubyte *buffer;
-         /* Create a larger image using an extra border and center glyph. */
+         /* Create a larger image using an extra border and center glyph. The
+          * distance field is built later by gl_fontBuildChar. */
          b = 1 + ( ( MAX_EFFECT_RADIUS + 1 ) * FONT_DISTANCE_FIELD_SIZE - 1 ) /
                     stsh->h;
-         rw     = w + b * 2;
-         rh     = h + b * 2;
-         buffer = calloc( rw * rh, sizeof( GLubyte ) );
+         rw      = w + b * 2;
+         rh      = h + b * 2;
+         c->data = calloc( rw * rh, sizeof( GLubyte ) );
          for ( int v = 0; v < h; v++ )
             for ( int u = 0; u < w; u++ )
-               buffer[( b + v ) * rw + ( b + u )] = bitmap.buffer[v * w + u];
-         /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh, &vmax );
-         free( buffer );
+               c->data[( b + v ) * rw + ( b + u )] = bitmap.buffer[v * w + u];
+         c->sdf = 1;
+         c->m   = 0.;
       }
       c->w        = rw;
       c->h        = rh;
-      c->m        = ( 2. * vmax * stsh->h ) / FONT_DISTANCE_FIELD_SIZE;
       c->off_x    = slot->bitmap_left - b;
       c->off_y    = slot->bitmap_top + b;
       c->adv_x    = (GLfloat)slot->metrics.horiAdvance / 64.;
@@ -1377,13 +1476,13 @@ static void gl_fontRenderStartH( const glFontStash *stsh, const mat4 *H,
    font_restoreLast = 0;
    gl_fontKernStart();
 
+   /* Upload the glyphs that finished building since last time. */
+   gl_fontProcessGlyphs();
+
    /* Activate the appropriate VBOs. */
    glEnableVertexAttribArray( shaders.font.vertex );
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2,
-                               GL_SHORT, 0 );
    glEnableVertexAttribArray( shaders.font.tex_coord );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2,
-                               GL_FLOAT, 0 );
+   gl_fontActivateVBO( stsh );
 
    /* Depth testing is used to draw the outline under the glyph. */
    if ( outlineR > 0. )
@@ -1477,38 +1576,38 @@ static uint32_t hashint( uint32_t a )
 }
 
 /**
- * @brief Gets or caches a glyph to render.
+ * @brief Looks up a glyph that has already been created.
  */
-static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+static glFontGlyph *gl_fontFindGlyph( glFontStash *stsh, uint32_t ch )
 {
-   int          i;
-   unsigned int h;
-
    /* Use hash table and linked lists to find the glyph. */
-   h = hashint( ch ) & ( HASH_LUT_SIZE - 1 );
-   i = stsh->lut[h];
+   int i = stsh->lut[hashint( ch ) & ( HASH_LUT_SIZE - 1 )];
    while ( i != -1 ) {
       if ( stsh->glyphs[i].codepoint == ch )
          return &stsh->glyphs[i];
       i = stsh->glyphs[i].next;
    }
+   return NULL;
+}
 
-   /* Glyph not found, have to generate. */
+/**
+ * @brief Creates a new glyph and adds it to the look up table.
+ */
+static glFontGlyph *gl_fontNewGlyph( glFontStash *stsh, uint32_t ch,
+                                     const font_char_t *ft_char )
+{
    glFontGlyph *glyph;
-   font_char_t  ft_char;
-   int          idx;
-
-   /* Load data from freetype. */
-   if ( font_makeChar( stsh, &ft_char, ch ) )
-      return NULL;
+   int          i, idx;
+   unsigned int h = hashint( ch ) & ( HASH_LUT_SIZE - 1 );
 
    /* Create new character. */
    glyph            = &array_grow( &stsh->glyphs );
    glyph->codepoint = ch;
-   glyph->adv_x     = ft_char.adv_x;
-   glyph->m         = ft_char.m;
-   glyph->ft_index  = ft_char.ft_index;
+   glyph->adv_x     = ft_char->adv_x;
+   glyph->m         = ft_char->m;
+   glyph->ft_index  = ft_char->ft_index;
    glyph->next      = -1;
+   glyph->pending   = 0;
    idx              = glyph - stsh->glyphs;
 
    /* Insert in linked list. */
@@ -1524,16 +1623,397 @@ static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
          i = stsh->glyphs[i].next;
       }
    }
+   return glyph;
+}
+
+/**
+ * @brief Adds a built character to the texture stash and the atlas cache.
+ */
+static void gl_fontAddChar( glFontStash *stsh, glFontGlyph *glyph,
+                            const font_char_t *ch )
+{
+   FontAtlasGlyph ag;
+   int            n;
 
    /* Find empty texture and render char. */
-   gl_fontAddGlyphTex( stsh, &ft_char, glyph );
+   gl_fontAddGlyphTex( stsh, ch, glyph );
+   glyph->m = ch->m;
+
+   /* Keep a copy to save. */
+   ag.codepoint = glyph->codepoint;
+   ag.ft_index  = ch->ft_index;
+   ag.w         = ch->w;
+   ag.h         = ch->h;
+   ag.off_x     = ch->off_x;
+   ag.off_y     = ch->off_y;
+   ag.adv_x     = ch->adv_x;
+   ag.m         = ch->m;
+   ag.offset    = array_size( stsh->atlas_data );
+   array_push_back( &stsh->atlas, ag );
+   n = array_size( stsh->atlas_data );
+   array_resize( &stsh->atlas_data, n + ch->w * ch->h );
+   memcpy( &stsh->atlas_data[n], ch->data, ch->w * ch->h );
+}
 
-   free( ft_char.data );
-   free( ft_char.dataf );
+/**
+ * @brief Builds the distance field of a character, replacing its bitmap.
+ *
+ * Can be called from any thread.
+ */
+static void gl_fontBuildChar( font_char_t *c, int h )
+{
+   double vmax;
+   float *dataf;
+
+   if ( !c->sdf )
+      return;
+
+   /* Compute signed distance field with buffered glyph. The textures only
+    * have 8 bits, so there is no need to keep the floats. */
+   dataf = make_distance_mapbf( c->data, c->w, c->h, &vmax );
+   for ( int i = 0; i < c->w * c->h; i++ )
+      c->data[i] = (GLubyte)round( CLAMP( 0., 1., dataf[i] ) * 255. );
+   free( dataf );
+   c->m   = ( 2. * vmax * h ) / FONT_DISTANCE_FIELD_SIZE;
+   c->sdf = 0;
+}
+
+/**
+ * @brief Job that builds the distance field of a glyph.
+ */
+static void gl_fontBuildJob( Job *job, void *data )
+{
+   (void)job;
+   FontGlyphJob *fj = data;
+   gl_fontBuildChar( &fj->ch, fj->h );
+
+   SDL_mutexP( font_lock );
+   array_push_back( &font_done, fj );
+   SDL_mutexV( font_lock );
+}
+
+/**
+ * @brief Uploads the glyphs that have finished building.
+ *
+ * Has to be called from the main thread. The VBOs of the last stash updated
+ * may be left active.
+ */
+static void gl_fontProcessGlyphs( void )
+{
+   FontGlyphJob **done;
+
+   if ( font_lock == NULL )
+      return;
+
+   SDL_mutexP( font_lock );
+   done      = font_done;
+   font_done = NULL;
+   SDL_mutexV( font_lock );
+   if ( done == NULL )
+      return;
+
+   for ( int i = 0; i < array_size( done ); i++ ) {
+      FontGlyphJob *fj    = done[i];
+      glFontStash  *stsh  = &avail_fonts[fj->stash];
+      glFontGlyph  *glyph = &stsh->glyphs[fj->glyph];
+      gl_fontAddChar( stsh, glyph, &fj->ch );
+      glyph->pending    = 0;
+      stsh->atlas_dirty = 1;
+      free( fj->ch.data );
+      free( fj );
+   }
+   array_free( done );
+
+   for ( int i = 0; i < array_size( avail_fonts ); i++ )
+      if ( avail_fonts[i].vbo_dirty )
+         gl_fontUpdateVBO( &avail_fonts[i] );
+
+   /* Windows are only rendered when they change. */
+   toolkit_rerender();
+}
+
+/**
+ * @brief Waits for all the glyphs being built and uploads them.
+ */
+static void gl_fontWaitGlyphs( void )
+{
+   if ( font_jobs != NULL ) {
+      job_run( font_jobs );
+      job_wait( font_jobs );
+      font_jobs = NULL;
+   }
+   gl_fontProcessGlyphs();
+}
+
+/**
+ * @brief Checks to see if glyphs can be drawn once they are ready.
+ *
+ * That is only the case for the framebuffers that are redrawn, in particular
+ * not for Lua canvases which may be drawn only once.
+ */
+static int gl_fontCanDefer( void )
+{
+   if ( gl_screen.current_fbo == 0 )
+      return 1;
+   for ( int i = 0; i < OPENGL_NUM_FBOS; i++ )
+      if ( gl_screen.current_fbo == gl_screen.fbo[i] )
+         return 1;
+   return 0;
+}
+
+/**
+ * @brief Gets or caches a glyph to render.
+ *
+ * New glyphs are laid out right away, but may be pending until their distance
+ * field is built.
+ */
+static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+{
+   glFontGlyph  *glyph;
+   font_char_t   ft_char;
+   FontGlyphJob *fj;
+
+   glyph = gl_fontFindGlyph( stsh, ch );
+   if ( glyph != NULL )
+      return glyph;
+
+   /* Try the glyphs built in previous runs. */
+   if ( stsh->atlas_state == 0 ) {
+      gl_fontAtlasLoad( stsh );
+      glyph = gl_fontFindGlyph( stsh, ch );
+      if ( glyph != NULL )
+         return glyph;
+   }
+
+   /* Glyph not found, have to generate. Load data from freetype. */
+   if ( font_makeChar( stsh, &ft_char, ch ) )
+      return NULL;
+   glyph = gl_fontNewGlyph( stsh, ch, &ft_char );
+
+   /* Nothing to build. */
+   if ( !ft_char.sdf ) {
+      gl_fontAddChar( stsh, glyph, &ft_char );
+      gl_fontUpdateVBO( stsh );
+      stsh->atlas_dirty = 1;
+      free( ft_char.data );
+      return glyph;
+   }
+
+   /* Build the distance field in the background. */
+   fj             = malloc( sizeof( FontGlyphJob ) );
+   fj->stash      = stsh - avail_fonts;
+   fj->glyph      = glyph - stsh->glyphs;
+   fj->h          = stsh->h;
+   fj->ch         = ft_char;
+   glyph->pending = 1;
+   if ( font_jobs == NULL )
+      font_jobs = job_create( NULL, NULL, NULL );
+   job_run( job_create( gl_fontBuildJob, fj, font_jobs ) );
 
    return glyph;
 }
 
+/**
+ * @brief Gets the path of the atlas cache file of a font stash.
+ *
+ * The key depends on the contents of the font files, the font height and the
+ * distance field parameters.
+ *
+ *    @param stsh Font stash to get path of.
+ *    @param[out] path Path of the cache file.
+ *    @param len Size of path.
+ *    @param[out] key Key of the cache file.
+ *    @return 0 on success.
+ */
+static int gl_fontAtlasPath( glFontStash *stsh, char *path, size_t len,
+                             md5_byte_t key[16] )
+{
+   static int  dirstate = 0; /* 0 unchecked, 1 usable, -1 unavailable. */
+   md5_state_t md5;
+   char        digest[33];
+   int32_t     params[4] = { FONT_ATLAS_VERSION, stsh->h,
+                             FONT_DISTANCE_FIELD_SIZE, MAX_EFFECT_RADIUS };
+
+   if ( dirstate == 0 ) {
+      char dirpath[PATH_MAX];
+      snprintf( dirpath, sizeof( dirpath ), "%s%s", nfile_cachePath(),
+                FONT_ATLAS_PATH );
+      dirstate = ( nfile_dirMakeExist( dirpath ) == 0 ) ? 1 : -1;
+   }
+   if ( dirstate < 0 )
+      return -1;
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)params, sizeof( params ) );
+   for ( int i = 0; i < array_size( stsh->ft ); i++ ) {
+      glFontFile *file = stsh->ft[i].file;
+      if ( !file->hashed ) {
+         md5_state_t fmd5;
+         md5_init( &fmd5 );
+         md5_append( &fmd5, file->data, file->datasize );
+         md5_finish( &fmd5, file->md5 );
+         file->hashed = 1;
+      }
+      md5_append( &md5, file->md5, sizeof( file->md5 ) );
+   }
+   md5_finish( &md5, key );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &digest[i * 2], 3, "%02x", key[i] );
+   snprintf( path, len, "%s%s%s", nfile_cachePath(), FONT_ATLAS_PATH, digest );
+   return 0;
+}
+
+/**
+ * @brief Loads the glyphs built in previous runs into a font stash.
+ */
+static void gl_fontAtlasLoad( glFontStash *stsh )
+{
+   FontAtlasHeader       hdr;
+   const FontAtlasGlyph *glyphs;
+   const GLubyte        *data;
+   md5_byte_t            key[16];
+   char                  path[PATH_MAX];
+   char                 *buf;
+   size_t                size;
+
+   stsh->atlas_state = 1;
+   if ( gl_fontAtlasPath( stsh, path, sizeof( path ), key ) )
+      return;
+   if ( !nfile_fileExists( path ) )
+      return;
+   buf = nfile_readFile( &size, path );
+   if ( buf == NULL )
+      return;
+
+   /* Make sure the file is complete and for the same fonts. */
+   if ( size < sizeof( FontAtlasHeader ) ) {
+      free( buf );
+      return;
+   }
+   memcpy( &hdr, buf, sizeof( FontAtlasHeader ) );
+   if ( ( memcmp( hdr.magic, FONT_ATLAS_MAGIC, sizeof( hdr.magic ) ) != 0 ) ||
+        ( hdr.version != FONT_ATLAS_VERSION ) ||
+        ( memcmp( hdr.key, key, sizeof( hdr.key ) ) != 0 ) ||
+        ( size != sizeof( FontAtlasHeader ) +
+                     sizeof( FontAtlasGlyph ) * (size_t)hdr.nglyphs +
+                     hdr.datasize ) ) {
+      free( buf );
+      return;
+   }
+   glyphs = (const FontAtlasGlyph *)&buf[sizeof( FontAtlasHeader )];
+   data   = (const GLubyte *)&glyphs[hdr.nglyphs];
+
+   for ( uint32_t i = 0; i < hdr.nglyphs; i++ ) {
+      const FontAtlasGlyph *ag = &glyphs[i];
+      font_char_t           ch;
+      glFontGlyph          *glyph;
+      if ( ( ag->ft_index < 0 ) || ( ag->ft_index >= array_size( stsh->ft ) ) ||
+           ( ag->w < 0 ) || ( ag->h < 0 ) || ( ag->h > stsh->th ) ||
+           ( ag->w > stsh->tw ) ||
+           ( (size_t)ag->offset + (size_t)ag->w * ag->h > hdr.datasize ) ) {
+         WARN( _( "Font atlas cache '%s' is corrupt!" ), path );
+         break;
+      }
+      if ( gl_fontFindGlyph( stsh, ag->codepoint ) != NULL )
+         continue;
+      ch.data     = (GLubyte *)&data[ag->offset];
+      ch.sdf      = 0;
+      ch.w        = ag->w;
+      ch.h        = ag->h;
+      ch.ft_index = ag->ft_index;
+      ch.off_x    = ag->off_x;
+      ch.off_y    = ag->off_y;
+      ch.adv_x    = ag->adv_x;
+      ch.m        = ag->m;
+      glyph       = gl_fontNewGlyph( stsh, ag->codepoint, &ch );
+      gl_fontAddChar( stsh, glyph, &ch );
+   }
+   free( buf );
+
+   if ( stsh->vbo_dirty )
+      gl_fontUpdateVBO( stsh );
+}
+
+/**
+ * @brief Saves the glyphs built so far so later runs don't have to.
+ */
+static void gl_fontAtlasSave( glFontStash *stsh )
+{
+   FontAtlasHeader hdr;
+   md5_byte_t      key[16];
+   char            path[PATH_MAX];
+   char           *buf;
+   size_t          nglyphs, size;
+
+   if ( ( stsh->atlas_state != 1 ) || !stsh->atlas_dirty )
+      return;
+   if ( gl_fontAtlasPath( stsh, path, sizeof( path ), key ) )
+      return;
+
+   nglyphs = array_size( stsh->atlas );
+   memset( &hdr, 0, sizeof( hdr ) );
+   memcpy( hdr.magic, FONT_ATLAS_MAGIC, sizeof( hdr.magic ) );
+   hdr.version  = FONT_ATLAS_VERSION;
+   hdr.nglyphs  = nglyphs;
+   hdr.datasize = array_size( stsh->atlas_data );
+   memcpy( hdr.key, key, sizeof( hdr.key ) );
+
+   size = sizeof( FontAtlasHeader ) + sizeof( FontAtlasGlyph ) * nglyphs +
+          hdr.datasize;
+   buf = malloc( size );
+   memcpy( buf, &hdr, sizeof( FontAtlasHeader ) );
+   memcpy( &buf[sizeof( FontAtlasHeader )], stsh->atlas,
+           sizeof( FontAtlasGlyph ) * nglyphs );
+   memcpy( &buf[sizeof( FontAtlasHeader ) + sizeof( FontAtlasGlyph ) * nglyphs],
+           stsh->atlas_data, hdr.datasize );
+   if ( nfile_writeFile( buf, size, path ) != 0 )
+      WARN( _( "Unable to save font atlas cache '%s'!" ), path );
+   free( buf );
+   stsh->atlas_dirty = 0;
+}
+
+/**
+ * @brief Starts building the glyphs of the characters that will most likely
+ * be needed.
+ *
+ * These are the ASCII characters and the most common characters of the active
+ * language. Glyphs already loaded from the atlas cache are not rebuilt.
+ *
+ *    @param font Font to pre-warm.
+ */
+void gl_fontPrewarm( const glFont *font )
+{
+   glFontStash *stsh = gl_fontGetStash( font );
+   uint32_t    *common;
+
+   NTracingZone( _ctx, 1 );
+
+   if ( stsh->atlas_state == 0 )
+      gl_fontAtlasLoad( stsh );
+
+   common = gettext_commonChars( FONT_PREWARM_MAX );
+   for ( uint32_t ch = 0x20; ch < 0x7f; ch++ )
+      array_push_back( &common, ch );
+   for ( int i = 0; i < array_size( common ); i++ ) {
+      uint32_t ch    = common[i];
+      int      found = 0;
+      if ( gl_fontFindGlyph( stsh, ch ) != NULL )
+         continue;
+      /* Don't warn about characters missing from the fonts. */
+      for ( int j = 0; j < array_size( stsh->ft ); j++ ) {
+         if ( FT_Get_Char_Index( stsh->ft[j].face, ch ) != 0 ) {
+            found = 1;
+            break;
+         }
+      }
+      if ( found )
+         gl_fontGetGlyph( stsh, ch );
+   }
+   array_free( common );
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief Call at the start of a string/line.
  */
@@ -1601,20 +2081,28 @@ static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch,
       return -1;
    }
 
+   /* Glyphs that are not ready are skipped, unless the result may be kept. */
+   if ( glyph->pending && !gl_fontCanDefer() ) {
+      gl_fontWaitGlyphs();
+      gl_fontActivateVBO( stsh );
+   }
+
    /* Kern if possible. */
    scale      = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
    kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
    if ( kern_adv_x )
       mat4_translate_x( &font_projection_mat, kern_adv_x / scale );
 
-   /* Activate texture. */
-   glBindTexture( GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id );
+   if ( !glyph->pending ) {
+      /* Activate texture. */
+      glBindTexture( GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id );
 
-   glUniform1f( shaders.font.m, glyph->m );
-   gl_uniformMat4( shaders.font.projection, &font_projection_mat );
+      glUniform1f( shaders.font.m, glyph->m );
+      gl_uniformMat4( shaders.font.projection, &font_projection_mat );
 
-   /* Draw the element. */
-   glDrawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
+      /* Draw the element. */
+      gl_drawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
+   }
 
    /* Translate matrix. */
    mat4_translate_x( &font_projection_mat, glyph->adv_x / scale );
@@ -1685,6 +2173,8 @@ int gl_fontInit( glFont *font, const char *fname, const unsigned int h,
          return -1;
       }
    }
+   if ( font_lock == NULL )
+      font_lock = SDL_CreateMutex();
 
    /* Replace name if NULL. */
    if ( fname == NULL )
@@ -1753,8 +2243,10 @@ int gl_fontInit( glFont *font, const char *fname, const unsigned int h,
    /* Initialize the unicode support. */
    for ( int i = 0; i < HASH_LUT_SIZE; i++ )
       stsh->lut[i] = -1;
-   stsh->glyphs = array_create( glFontGlyph );
-   stsh->tex    = array_create( glFontTex );
+   stsh->glyphs     = array_create( glFontGlyph );
+   stsh->tex        = array_create( glFontTex );
+   stsh->atlas      = array_create( FontAtlasGlyph );
+   stsh->atlas_data = array_create( GLubyte );
 
    /* Set up VBOs. */
    stsh->mvbo          = 256;
@@ -1869,6 +2361,11 @@ static int gl_fontstashAddFallback( glFontStash *stsh, const char *fname,
    /* Save stuff. */
    array_push_back( &stsh->ft, ft );
 
+   /* Glyphs built so far may not match the atlas cache of the new set of
+    * fonts. */
+   if ( stsh->atlas_state != 0 )
+      stsh->atlas_state = -1;
+
    /* Success. */
    return 0;
 }
@@ -1893,6 +2390,12 @@ void gl_freeFont( glFont *font )
       return;
    /* Not references and must eliminate. */
 
+   /* Finish building the glyphs and save them for next time. */
+   gl_fontWaitGlyphs();
+   gl_fontAtlasSave( stsh );
+   array_free( stsh->atlas );
+   array_free( stsh->atlas_data );
+
    for ( int i = 0; i < array_size( stsh->ft ); i++ )
       gl_fontstashftDestroy( &stsh->ft[i] );
    array_free( stsh->ft );
@@ -1932,6 +2435,10 @@ static void gl_fontstashftDestroy( glFontStashFreetype *ft )
  */
 void gl_fontExit( void )
 {
+   gl_fontWaitGlyphs();
+   SDL_DestroyMutex( font_lock );
+   font_lock = NULL;
+
    FT_Done_FreeType( font_library );
    font_library = NULL;
    array_free( avail_fonts );
@@ -21,6 +21,7 @@
 #include "log.h"
 #include "msgcat.h"
 #include "ndata.h"
+#include "utf8.h"
 
 typedef struct translation {
    char     *language;   /**< Language code (allocated string). */
@@ -340,6 +341,81 @@ double gettext_languageCoverage( const char *lang )
    return (double)translated / gettext_nstrings;
 }
 
+/**
+ * @brief Character and how many times it appears in the translations.
+ */
+typedef struct CharCount_ {
+   uint32_t ch;    /**< Character. */
+   uint32_t count; /**< Times it appears. */
+} CharCount;
+
+/**
+ * @brief Sorts characters by decreasing count.
+ */
+static int gettext_cmpCharCount( const void *p1, const void *p2 )
+{
+   const CharCount *c1 = p1;
+   const CharCount *c2 = p2;
+   if ( c1->count != c2->count )
+      return ( c1->count > c2->count ) ? -1 : +1;
+   return (int)c1->ch - (int)c2->ch;
+}
+
+/**
+ * @brief Gets the most common non-ASCII characters of the active translation.
+ *
+ * Only characters of the Basic Multilingual Plane are considered.
+ *
+ * @param n Maximum number of characters to get.
+ * @return Array (array.h) of characters, most common first, or NULL if there
+ * are no translations.
+ */
+uint32_t *gettext_commonChars( int n )
+{
+   uint32_t  *counts, *out;
+   CharCount *chars;
+
+   if ( ( gettext_activeTranslation == NULL ) ||
+        ( array_size( gettext_activeTranslation->chain ) == 0 ) )
+      return NULL;
+
+   counts = calloc( 0x10000, sizeof( uint32_t ) );
+   for ( int i = 0; i < array_size( gettext_activeTranslation->chain ); i++ ) {
+      const msgcat_t *cat = &gettext_activeTranslation->chain[i];
+      uint32_t        nstr = msgcat_nstrings( cat );
+      for ( uint32_t j = 0; j < nstr; j++ ) {
+         size_t      len, k;
+         const char *s = msgcat_translation( cat, j, &len );
+         if ( s == NULL )
+            break;
+         k = 0;
+         while ( k < len ) {
+            uint32_t ch = u8_nextchar( s, &k );
+            if ( ( ch >= 0x80 ) && ( ch < 0x10000 ) )
+               counts[ch]++;
+            else if ( ch == 0 )
+               k++; /* Plural forms are separated by '\0'. */
+         }
+      }
+   }
+
+   chars = array_create( CharCount );
+   for ( uint32_t ch = 0x80; ch < 0x10000; ch++ ) {
+      CharCount c = { .ch = ch, .count = counts[ch] };
+      if ( c.count > 0 )
+         array_push_back( &chars, c );
+   }
+   free( counts );
+   qsort( chars, array_size( chars ), sizeof( CharCount ),
+          gettext_cmpCharCount );
+
+   out = array_create_size( uint32_t, MIN( n, array_size( chars ) ) );
+   for ( int i = 0; i < MIN( n, array_size( chars ) ); i++ )
+      array_push_back( &out, chars[i].ch );
+   array_free( chars );
+   return out;
+}
+
 /* The function is almost the same as p_() but msgctxt and msgid can be string
  * variables.
  */
@@ -22,6 +22,7 @@ const char     *gettext_getLanguage( void );
 void            gettext_setLanguage( const char *lang );
 LanguageOption *gettext_languageOptions( void );
 double          gettext_languageCoverage( const char *lang );
+uint32_t       *gettext_commonChars( int n );
 
 const char *gettext_ngettext( const char *msgid, const char *msgid_plural,
                               uint64_t n );
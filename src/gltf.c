@@ -928,7 +928,7 @@ static void renderMeshPrimitiveShadow( const GltfObject    *obj,
    glEnableVertexAttribArray( shd->vertex );
 
    glUniformMatrix4fv( shd->Hmodel, 1, GL_FALSE, H->ptr );
-   glDrawElements( GL_TRIANGLES, mesh->nidx, GL_UNSIGNED_INT, 0 );
+   gl_drawElements( GL_TRIANGLES, mesh->nidx, GL_UNSIGNED_INT, 0 );
 }
 static void renderMeshShadow( const GltfObject *obj, const Mesh *mesh,
                               const mat4 *H )
@@ -1043,7 +1043,7 @@ static void renderMeshPrimitive( const GltfObject    *obj,
       glDisable( GL_CULL_FACE );
    if ( mat->blend ) /* Don't write depth for transparent objects. */
       glDepthMask( GL_FALSE );
-   glDrawElements( GL_TRIANGLES, mesh->nidx, GL_UNSIGNED_INT, 0 );
+   gl_drawElements( GL_TRIANGLES, mesh->nidx, GL_UNSIGNED_INT, 0 );
    if ( mat->double_sided )
       glEnable( GL_CULL_FACE );
    if ( mat->blend )
@@ -1140,7 +1140,7 @@ static void gltf_renderShadow( const GltfObject *obj, int scene, const mat4 *H,
    glActiveTexture( GL_TEXTURE0 );
    glBindTexture( GL_TEXTURE_2D, light_tex[i] );
 
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    gl_checkErr();
    /* Second pass for Y and back into the proper framebuffer. */
    shd = &shadow_shader_blurY;
@@ -1156,7 +1156,7 @@ static void gltf_renderShadow( const GltfObject *obj, int scene, const mat4 *H,
    glActiveTexture( GL_TEXTURE0 );
    glBindTexture( GL_TEXTURE_2D, *shadow_tex );
 
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    /* Clean up. */
    glBindBuffer( GL_ARRAY_BUFFER, 0 );
    glDisableVertexAttribArray( shd->vertex );
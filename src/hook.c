@@ -20,8 +20,14 @@
  * other hooks to fail.
  *
  * Therefore we must tread carefully. Hooks are serious business.
+ *
+ * Hooks are kept sorted by id for lookups, and in a list per stack so running
+ * a stack only has to look at its own hooks. Timer and date hooks are also
+ * kept in hierarchical timer wheels so that only the ones that are due have to
+ * be looked at every frame.
  */
 /** @cond */
+#include <math.h>
 #include <stdlib.h>
 
 #include "naev.h"
@@ -29,17 +35,20 @@
 
 #include "hook.h"
 
+#include "arena.h"
 #include "array.h"
 #include "claim.h"
 #include "event.h"
 #include "log.h"
 #include "menu.h"
 #include "mission.h"
+#include "nameindex.h"
 #include "nlua_commodity.h"
 #include "nlua_evt.h"
 #include "nlua_hook.h"
 #include "nlua_outfit.h"
 #include "nlua_pilot.h"
+#include "nlua_prof.h"
 #include "nlua_ship.h"
 #include "player.h"
 #include "space.h"
@@ -73,11 +82,10 @@ typedef enum HookType_e {
  * @brief Internal representation of a hook.
  */
 typedef struct Hook_ {
-   struct Hook_ *next; /**< Linked list. */
-
    unsigned int id;      /**< unique id */
-   char        *stack;   /**< stack it's a part of */
-   int          created; /**< Hook has just been created. */
+   const char  *stack;   /**< stack it's a part of (interned) */
+   int          stackid; /**< Index of the stack in hook_stacks. */
+   unsigned int created; /**< Creation serial, to not run new hooks. */
    int delete;           /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating.
                   */
@@ -85,12 +93,18 @@ typedef struct Hook_ {
 
    /* Timer information. */
    int    is_timer; /**< Whether or not is actually a timer. */
-   double ms;       /**< Milliseconds left. */
+   double t;        /**< Time at which the timer expires. */
 
    /* Date information. */
    int     is_date; /**< Whether or not it is a date hook. */
    ntime_t res;     /**< Resolution to display. */
-   ntime_t acc;     /**< Accumulated resolution. */
+   ntime_t due;     /**< Date at which the hook has to run next. */
+
+   /* Timer wheel information. */
+   struct Hook_  *wnext; /**< Next hook in the wheel slot. */
+   struct Hook_  *wprev; /**< Previous hook in the wheel slot. */
+   struct Hook_ **whead; /**< Head of the wheel slot, NULL if not in one. */
+   int64_t        tick;  /**< Tick the hook is scheduled for. */
 
    HookType_t type; /**< Type of hook. */
    union {
@@ -109,13 +123,50 @@ typedef struct Hook_ {
    } u; /**< Type specific data. */
 } Hook;
 
+/**
+ * @brief Hooks belonging to a stack.
+ */
+typedef struct HookStack_ {
+   char  *name;  /**< Name of the stack. */
+   Hook **hooks; /**< Hooks of the stack in order of creation (array.h). */
+} HookStack;
+
+#define HOOK_WHEEL_BITS 6 /**< Bits of the tick per wheel level. */
+#define HOOK_WHEEL_SLOTS ( 1 << HOOK_WHEEL_BITS ) /**< Slots per level. */
+#define HOOK_WHEEL_LEVELS 4 /**< Levels of the timer wheels. */
+#define HOOK_TIMER_TICK 0.05 /**< Duration of a timer wheel tick. */
+#define HOOK_DATE_TICK 1000  /**< Duration of a date wheel tick (1 STU). */
+
+/**
+ * @brief Hierarchical timer wheel.
+ *
+ * Level l holds hooks that are less than HOOK_WHEEL_SLOTS^(l+1) ticks away,
+ * and gets cascaded into the lower levels as time goes by.
+ */
+typedef struct HookWheel_ {
+   int64_t cur; /**< Last tick that was processed. */
+   Hook   *slots[HOOK_WHEEL_LEVELS][HOOK_WHEEL_SLOTS]; /**< Wheel slots. */
+   Hook   *far; /**< Hooks too far away for the wheel. */
+   Hook   *due; /**< Hooks whose tick has been reached. */
+} HookWheel;
+
 /*
  * the stack
  */
 static unsigned int hook_id           = 0;    /**< Unique hook id generator. */
-static Hook        *hook_list         = NULL; /**< Stack of hooks. */
-static int          hook_runningstack = 0;    /**< Check if stack is running. */
+static Hook       **hook_all          = NULL; /**< Hooks sorted by id. */
+static int          hook_sorted       = 1; /**< Whether hook_all is sorted. */
+static HookStack   *hook_stacks       = NULL; /**< Hook stacks (array.h). */
+static NameIndex    hook_stackidx;            /**< Stack indices by name. */
+static unsigned int hook_serial       = 0; /**< Creation serial generator. */
+static unsigned int hook_generation   = 0; /**< Increases on hook_cleanup. */
+static int          hook_ndelete      = 0; /**< Hooks pending deletion. */
+static int          hook_runningstack = 0; /**< Check if stack is running. */
 static int hook_loadingstack = 0; /**< Check if the hooks are being loaded. */
+static HookWheel hook_timers;     /**< Wheel of timer hooks. */
+static HookWheel hook_dates;      /**< Wheel of date hooks. */
+static double    hook_timer_now = 0.; /**< Current time of the timers. */
+static ntime_t   hook_date_now  = 0;  /**< Current date of the date hooks. */
 
 /*
  * prototypes
@@ -125,10 +176,20 @@ static int  hooks_executeParam( const char *stack, const HookParam *param );
 static void hooks_updateDateExecute( ntime_t change );
 /* intern */
 static void         hook_rmRaw( Hook *h );
+static void         hook_setDelete( Hook *h );
 static void         hooks_purgeList( void );
 static Hook        *hook_get( unsigned int id );
 static unsigned int hook_genID( void );
 static Hook        *hook_new( HookType_t type, const char *stack );
+static int          hook_stackGet( const char *stack, int create );
+static void         hook_setTimer( Hook *h, double ms );
+static void         hook_setDate( Hook *h, ntime_t resolution );
+static Hook       **hook_collectDue( HookWheel *w, Arena *arena, int *n );
+/* Timer wheels. */
+static void hw_insert( HookWheel *w, Hook *h, int64_t tick );
+static void hw_remove( Hook *h );
+static void hw_reinsert( HookWheel *w, Hook **list );
+static void hw_advance( HookWheel *w, int64_t tick );
 static int          hook_parseParam( const HookParam *param );
 static int  hook_runMisn( Hook *hook, const HookParam *param, int claims );
 static int  hook_runEvent( Hook *hook, const HookParam *param, int claims );
@@ -320,7 +381,7 @@ static int hook_runMisn( Hook *hook, const HookParam *param, int claims )
    /* Make sure it's valid. */
    if ( hook->u.misn.parent == 0 ) {
       WARN( _( "Trying to run hook with nonexistent parent: deleting" ) );
-      hook->delete = 1; /* so we delete it */
+      hook_setDelete( hook ); /* so we delete it */
       return -1;
    }
 
@@ -329,7 +390,7 @@ static int hook_runMisn( Hook *hook, const HookParam *param, int claims )
    if ( misn == NULL ) {
       WARN( _( "Trying to run hook with parent not in player mission stack: "
                "deleting" ) );
-      hook->delete = 1; /* so we delete it. */
+      hook_setDelete( hook ); /* so we delete it. */
       return -1;
    }
 
@@ -393,7 +454,7 @@ static int hook_runEvent( Hook *hook, const HookParam *param, int claims )
       WARN( _( "Hook [%s] '%d' -> '%s' failed, event does not exist. Deleting "
                "hook." ),
             hook->stack, id, hook->u.event.func );
-      hook->delete = 1; /* Set for deletion. */
+      hook_setDelete( hook ); /* Set for deletion. */
       return -1;
    }
 
@@ -452,13 +513,13 @@ static int hook_run( Hook *hook, const HookParam *param, int claims )
        * Note that the function will not do any checks nor has arguments, since
        * it is C-side. */
       if ( hook->once )
-         hook->delete = 1;
+         hook_setDelete( hook );
       ret = hook->u.func.func( hook->u.func.data );
       break;
 
    default:
       WARN( _( "Invalid hook type '%d', deleting." ), hook->type );
-      hook->delete = 1;
+      hook_setDelete( hook );
       return -1;
    }
 
@@ -479,13 +540,44 @@ static unsigned int hook_genID( void )
       return id;
 
    /* Must check ids for collisions. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( id == h->id )      /* Check for collision. */
-         return hook_genID(); /* recursively try again */
+   for ( int i = 0; i < array_size( hook_all ); i++ )
+      if ( id == hook_all[i]->id ) /* Check for collision. */
+         return hook_genID();      /* recursively try again */
 
    return id;
 }
 
+/**
+ * @brief Gets the index of a stack.
+ *
+ *    @param stack Name of the stack.
+ *    @param create Whether or not to create the stack if it doesn't exist.
+ *    @return Index of the stack in hook_stacks, or -1 if not found.
+ */
+static int hook_stackGet( const char *stack, int create )
+{
+   int        id;
+   HookStack *hs;
+
+   if ( hook_stacks == NULL ) {
+      if ( !create )
+         return -1;
+      hook_stacks = array_create( HookStack );
+      nidx_create( &hook_stackidx );
+   }
+
+   id = nidx_get( &hook_stackidx, stack );
+   if ( ( id >= 0 ) || !create )
+      return id;
+
+   id        = array_size( hook_stacks );
+   hs        = &array_grow( &hook_stacks );
+   hs->name  = strdup( stack );
+   hs->hooks = array_create( Hook * );
+   nidx_set( &hook_stackidx, stack, id );
+   return id;
+}
+
 /**
  * @brief Generates and allocates a new hook.
  *
@@ -497,19 +589,19 @@ static Hook *hook_new( HookType_t type, const char *stack )
 {
    /* Get and create new hook. */
    Hook *new_hook = calloc( 1, sizeof( Hook ) );
-   if ( hook_list == NULL )
-      hook_list = new_hook;
-   else {
-      /* Put at front, O(1). */
-      new_hook->next = hook_list;
-      hook_list      = new_hook;
-   }
 
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup( stack );
-   new_hook->created = 1;
+   new_hook->stackid = hook_stackGet( stack, 1 );
+   new_hook->stack   = hook_stacks[new_hook->stackid].name;
+   new_hook->created = ++hook_serial;
+
+   /* Ids only go up, so it stays sorted. */
+   if ( hook_all == NULL )
+      hook_all = array_create( Hook * );
+   array_push_back( &hook_all, new_hook );
+   array_push_back( &hook_stacks[new_hook->stackid].hooks, new_hook );
 
    /** @TODO fix this hack. */
    if ( strcmp( stack, "safe" ) == 0 )
@@ -579,8 +671,7 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func,
    new_hook->u.misn.func   = strdup( func );
 
    /* Timer information. */
-   new_hook->is_timer = 1;
-   new_hook->ms       = ms;
+   hook_setTimer( new_hook, ms );
 
    return new_hook->id;
 }
@@ -604,8 +695,7 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func,
    new_hook->u.event.func   = strdup( func );
 
    /* Timer information. */
-   new_hook->is_timer = 1;
-   new_hook->ms       = ms;
+   hook_setTimer( new_hook, ms );
 
    return new_hook->id;
 }
@@ -622,8 +712,7 @@ unsigned int hook_addTimerFunc( int ( *func )( void * ), void *data, double ms )
    new_hook->u.func.data = data;
 
    /* Timer information. */
-   new_hook->is_timer = 1;
-   new_hook->ms       = ms;
+   hook_setTimer( new_hook, ms );
 
    return new_hook->id;
 }
@@ -643,43 +732,236 @@ unsigned int hook_addFunc( int ( *func )( void * ), void *data,
    return new_hook->id;
 }
 
+/**
+ * @brief Marks a hook for deletion.
+ */
+static void hook_setDelete( Hook *h )
+{
+   if ( h->delete )
+      return;
+   h->delete = 1;
+   hook_ndelete++;
+}
+
 /**
  * @brief Purges the list of deletable hooks.
  */
 static void hooks_purgeList( void )
 {
-   Hook *h, *hl;
+   int n;
 
    /* Do not run while stack is being run. */
-   if ( hook_runningstack )
+   if ( hook_runningstack || ( hook_ndelete == 0 ) )
       return;
 
+   /* Remove from the stacks. */
+   for ( int i = 0; i < array_size( hook_stacks ); i++ ) {
+      Hook **hooks = hook_stacks[i].hooks;
+      n            = 0;
+      for ( int j = 0; j < array_size( hooks ); j++ )
+         if ( !hooks[j]->delete )
+            hooks[n++] = hooks[j];
+      array_resize( &hook_stacks[i].hooks, n );
+   }
+
    /* Second pass to delete. */
-   hl = NULL;
-   h  = hook_list;
+   n = 0;
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
+      if ( h->delete )
+         hook_free( h );
+      else
+         hook_all[n++] = h;
+   }
+   array_resize( &hook_all, n );
+   hook_ndelete = 0;
+}
+
+/**
+ * @brief Adds a hook to a timer wheel.
+ *
+ *    @param w Wheel to add to.
+ *    @param h Hook to add, must not be in a wheel already.
+ *    @param tick Tick at which the hook is due.
+ */
+static void hw_insert( HookWheel *w, Hook *h, int64_t tick )
+{
+   Hook  **head;
+   int64_t d = tick - w->cur;
+
+   h->tick = tick;
+   if ( d <= 0 )
+      head = &w->due;
+   else {
+      head = &w->far;
+      for ( int l = 0; l < HOOK_WHEEL_LEVELS; l++ ) {
+         int shift = HOOK_WHEEL_BITS * l;
+         if ( d < ( (int64_t)HOOK_WHEEL_SLOTS << shift ) ) {
+            head = &w->slots[l][( tick >> shift ) & ( HOOK_WHEEL_SLOTS - 1 )];
+            break;
+         }
+      }
+   }
+
+   h->whead = head;
+   h->wprev = NULL;
+   h->wnext = *head;
+   if ( *head != NULL )
+      ( *head )->wprev = h;
+   *head = h;
+}
+
+/**
+ * @brief Removes a hook from the timer wheel it is in, if any.
+ */
+static void hw_remove( Hook *h )
+{
+   if ( h->whead == NULL )
+      return;
+   if ( h->wprev != NULL )
+      h->wprev->wnext = h->wnext;
+   else
+      *h->whead = h->wnext;
+   if ( h->wnext != NULL )
+      h->wnext->wprev = h->wprev;
+   h->whead = NULL;
+   h->wnext = NULL;
+   h->wprev = NULL;
+}
+
+/**
+ * @brief Reinserts all the hooks of a list of a wheel, moving them closer to
+ * the due list.
+ */
+static void hw_reinsert( HookWheel *w, Hook **list )
+{
+   Hook *h = *list;
+   *list   = NULL;
    while ( h != NULL ) {
-      /* Find valid timer hooks. */
-      if ( h->delete ) {
+      Hook *next = h->wnext;
+      hw_insert( w, h, h->tick );
+      h = next;
+   }
+}
 
-         if ( hl == NULL )
-            hook_list = h->next;
-         else
-            hl->next = h->next;
+/**
+ * @brief Advances a timer wheel, moving the hooks that are due to the due list.
+ *
+ *    @param w Wheel to advance.
+ *    @param tick Tick to advance to.
+ */
+static void hw_advance( HookWheel *w, int64_t tick )
+{
+   const int64_t mask = HOOK_WHEEL_SLOTS - 1;
+
+   /* Way behind, faster to just reschedule everything. */
+   if ( tick - w->cur > HOOK_WHEEL_SLOTS * HOOK_WHEEL_SLOTS ) {
+      w->cur = tick;
+      for ( int l = 0; l < HOOK_WHEEL_LEVELS; l++ )
+         for ( int i = 0; i < HOOK_WHEEL_SLOTS; i++ )
+            hw_reinsert( w, &w->slots[l][i] );
+      hw_reinsert( w, &w->far );
+      return;
+   }
 
-         /* Free. */
-         h->next = NULL;
-         hook_free( h );
+   while ( w->cur < tick ) {
+      int top = 0;
+      w->cur++;
+
+      /* Find the levels that wrapped around. */
+      while ( ( top < HOOK_WHEEL_LEVELS ) &&
+              ( ( w->cur &
+                  ( ( (int64_t)1 << ( HOOK_WHEEL_BITS * ( top + 1 ) ) ) -
+                    1 ) ) == 0 ) )
+         top++;
+
+      /* Cascade them down from the top. */
+      if ( top == HOOK_WHEEL_LEVELS )
+         hw_reinsert( w, &w->far );
+      for ( int l = MIN( top, HOOK_WHEEL_LEVELS - 1 ); l > 0; l-- )
+         hw_reinsert(
+            w, &w->slots[l][( w->cur >> ( HOOK_WHEEL_BITS * l ) ) & mask] );
+
+      /* Everything in the current slot is now due. */
+      hw_reinsert( w, &w->slots[0][w->cur & mask] );
+   }
+}
 
-         /* Last. */
-         h = hl;
-      }
+/**
+ * @brief Compares hooks by id.
+ */
+static int hook_cmpID( const void *p1, const void *p2 )
+{
+   const Hook *h1 = *(const Hook **)p1;
+   const Hook *h2 = *(const Hook **)p2;
+   return ( h1->id > h2->id ) - ( h1->id < h2->id );
+}
 
-      hl = h;
-      if ( h == NULL )
-         h = hook_list;
-      else
-         h = h->next;
+/**
+ * @brief Compares hooks so the newest ones go first.
+ */
+static int hook_cmpNewest( const void *p1, const void *p2 )
+{
+   return hook_cmpID( p2, p1 );
+}
+
+/**
+ * @brief Gets the hooks of a wheel that have to run.
+ *
+ *    @param w Wheel to get the hooks from.
+ *    @param arena Arena to allocate the list from.
+ *    @param[out] n Number of hooks that have to run.
+ *    @return The hooks that have to run, newest first like the stacks.
+ */
+static Hook **hook_collectDue( HookWheel *w, Arena *arena, int *n )
+{
+   Hook **due;
+   int    ndue = 0;
+
+   for ( const Hook *h = w->due; h != NULL; h = h->wnext )
+      ndue++;
+   due = arena_alloc( arena, sizeof( Hook * ) * ndue );
+
+   /* The due list only has a tick of precision, so check the exact time. */
+   *n = 0;
+   for ( Hook *h = w->due; h != NULL; h = h->wnext ) {
+      if ( h->delete )
+         continue;
+      if ( h->is_timer ? ( h->t > hook_timer_now )
+                       : ( h->due > hook_date_now ) )
+         continue;
+      due[( *n )++] = h;
    }
+   qsort( due, *n, sizeof( Hook * ), hook_cmpNewest );
+   return due;
+}
+
+/**
+ * @brief Sets up a hook as a timer.
+ *
+ *    @param h Hook to set up.
+ *    @param ms Time to wait.
+ */
+static void hook_setTimer( Hook *h, double ms )
+{
+   h->is_timer = 1;
+   h->t        = hook_timer_now + ms;
+   hw_insert( &hook_timers, h, (int64_t)floor( h->t / HOOK_TIMER_TICK ) );
+}
+
+/**
+ * @brief Sets up a hook as a date hook.
+ *
+ *    @param h Hook to set up.
+ *    @param resolution Time between each run of the hook.
+ */
+static void hook_setDate( Hook *h, ntime_t resolution )
+{
+   h->is_date = 1;
+   h->res     = resolution;
+   h->due     = hook_date_now + resolution;
+   hw_remove( h );
+   hw_insert( &hook_dates, h, h->due / HOOK_DATE_TICK );
 }
 
 /**
@@ -696,49 +978,68 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
+   ArenaMark    mark;
+   Hook       **due;
+   int          n;
+   unsigned int gen;
+
    /* Don't update without player. */
    if ( ( player.p == NULL ) || player_isFlag( PLAYER_CREATING ) )
       return;
 
-   /* Clear creation flags. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next ) {
-      h->created = 0;
-      if ( h->is_date )
-         h->ran_once = 0;
-   }
+   /* Advance the date and get the hooks that have to run. */
+   hook_date_now += change;
+   hw_advance( &hook_dates, hook_date_now / HOOK_DATE_TICK );
+   if ( hook_dates.due == NULL )
+      return;
+   mark = arena_mark( arena_scratch() );
+   due  = hook_collectDue( &hook_dates, mark.arena, &n );
+   gen  = hook_generation;
+   for ( int i = 0; i < n; i++ )
+      due[i]->ran_once = 0;
 
    hook_runningstack++; /* running hooks */
    for ( int j = 1; j >= 0; j-- ) {
-      for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+      for ( int i = 0; i < n; i++ ) {
+         Hook *h = due[i];
          /* Not be deleting. */
          if ( h->delete )
             continue;
-         /* Find valid date hooks. */
-         if ( h->is_date == 0 )
-            continue;
-         /* Don't update newly created hooks. */
-         if ( h->created != 0 )
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if ( j == 1 )
-            h->acc += change;
-         if ( h->acc < h->res )
-            continue;
 
          /* Time is modified at the end. */
-         if ( j == 0 )
-            h->acc %= h->res; /* We'll skip all buggers. */
+         if ( j == 0 ) {
+            /* We'll skip all buggers. */
+            ntime_t acc = ( hook_date_now - h->due + h->res ) % h->res;
+            h->due      = hook_date_now - acc + h->res;
+         }
          if ( h->ran_once )
             continue;
 
          /* Run the date hook. */
          hook_run( h, NULL, j );
          /* Date hooks are not deleted. */
+
+         /* If hook_cleanup was run, the hooks are gone. */
+         if ( gen != hook_generation )
+            break;
       }
+      if ( gen != hook_generation )
+         break;
    }
    hook_runningstack--; /* not running hooks anymore */
 
+   /* Schedule the next run. */
+   if ( gen == hook_generation ) {
+      for ( int i = 0; i < n; i++ ) {
+         Hook *h = due[i];
+         if ( h->delete )
+            continue;
+         hw_remove( h );
+         hw_insert( &hook_dates, h, h->due / HOOK_DATE_TICK );
+      }
+   }
+   arena_release( &mark );
+
    /* Second pass to delete. */
    hooks_purgeList();
 }
@@ -754,9 +1055,7 @@ unsigned int hook_addDateMisn( unsigned int parent, const char *func,
    new_hook->u.misn.func   = strdup( func );
 
    /* Timer information. */
-   new_hook->is_date = 1;
-   new_hook->res     = resolution;
-   new_hook->acc     = 0;
+   hook_setDate( new_hook, resolution );
 
    return new_hook->id;
 }
@@ -772,9 +1071,7 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func,
    new_hook->u.event.func   = strdup( func );
 
    /* Timer information. */
-   new_hook->is_date = 1;
-   new_hook->res     = resolution;
-   new_hook->acc     = 0;
+   hook_setDate( new_hook, resolution );
 
    return new_hook->id;
 }
@@ -784,43 +1081,49 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func,
  */
 void hooks_update( double dt )
 {
-   Hook *h;
+   ArenaMark    mark;
+   Hook       **due;
+   int          n;
+   unsigned int gen;
 
    /* Don't update without player. */
    if ( ( player.p == NULL ) || player_isFlag( PLAYER_CREATING ) ||
         player_isFlag( PLAYER_DESTROYED ) )
       return;
 
-   /* Clear creation flags. */
-   for ( h = hook_list; h != NULL; h = h->next )
-      h->created = 0;
+   /* Advance the timers and get the ones that have to run. Hooks created
+    * while running are not in the list, so they don't run until next frame. */
+   hook_timer_now += dt;
+   hw_advance( &hook_timers,
+               (int64_t)floor( hook_timer_now / HOOK_TIMER_TICK ) );
+   if ( hook_timers.due == NULL )
+      return;
+   mark = arena_mark( arena_scratch() );
+   due  = hook_collectDue( &hook_timers, mark.arena, &n );
+   gen  = hook_generation;
 
    hook_runningstack++; /* running hooks */
    for ( int j = 1; j >= 0; j-- ) {
-      for ( h = hook_list; h != NULL; h = h->next ) {
+      for ( int i = 0; i < n; i++ ) {
+         Hook *h = due[i];
          /* Not be deleting. */
          if ( h->delete )
             continue;
-         /* Find valid timer hooks. */
-         if ( h->is_timer == 0 )
-            continue;
-         /* Don't update newly created hooks. */
-         if ( h->created != 0 )
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if ( j == 1 )
-            h->ms -= dt;
-         if ( h->ms > 0. )
-            continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
+
+         /* If hook_cleanup was run, the hooks are gone. */
+         if ( gen != hook_generation )
+            break;
          if ( h->ran_once ) /* Remove when run. */
             hook_rmRaw( h );
       }
+      if ( gen != hook_generation )
+         break;
    }
    hook_runningstack--; /* not running hooks anymore */
+   arena_release( &mark );
 
    /* Second pass to delete. */
    hooks_purgeList();
@@ -857,7 +1160,7 @@ void hook_rm( unsigned int id )
  */
 static void hook_rmRaw( Hook *h )
 {
-   h->delete = 1;
+   hook_setDelete( h );
    hookL_unsetarg( h->id );
 }
 
@@ -868,9 +1171,11 @@ static void hook_rmRaw( Hook *h )
  */
 void hook_rmMisnParent( unsigned int parent )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
       if ( ( h->type == HOOK_TYPE_MISN ) && ( parent == h->u.misn.parent ) )
-         h->delete = 1;
+         hook_setDelete( h );
+   }
 }
 
 /**
@@ -880,9 +1185,11 @@ void hook_rmMisnParent( unsigned int parent )
  */
 void hook_rmEventParent( unsigned int parent )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
       if ( ( h->type == HOOK_TYPE_EVENT ) && ( parent == h->u.event.parent ) )
-         h->delete = 1;
+         hook_setDelete( h );
+   }
 }
 
 /**
@@ -894,9 +1201,11 @@ void hook_rmEventParent( unsigned int parent )
 int hook_hasMisnParent( unsigned int parent )
 {
    int num = 0;
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      const Hook *h = hook_all[i];
       if ( ( h->type == HOOK_TYPE_MISN ) && ( parent == h->u.misn.parent ) )
          num++;
+   }
 
    return num;
 }
@@ -910,32 +1219,42 @@ int hook_hasMisnParent( unsigned int parent )
 int hook_hasEventParent( unsigned int parent )
 {
    int num = 0;
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      const Hook *h = hook_all[i];
       if ( ( h->type == HOOK_TYPE_EVENT ) && ( parent == h->u.event.parent ) )
          num++;
+   }
 
    return num;
 }
 
 static int hooks_executeParam( const char *stack, const HookParam *param )
 {
-   int run;
+   int          run, sid, prof;
+   unsigned int serial, gen;
 
    /* Don't update if player is dead. */
    if ( ( player.p == NULL ) || player_isFlag( PLAYER_DESTROYED ) )
       return 0;
 
-   /* Reset the current stack's ran and creation flags. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( strcmp( stack, h->stack ) == 0 ) {
-         h->ran_once = 0;
-         h->created  = 0;
-      }
+   /* Reset the current stack's ran flags. */
+   sid = hook_stackGet( stack, 0 );
+   if ( sid >= 0 )
+      for ( int i = 0; i < array_size( hook_stacks[sid].hooks ); i++ )
+         hook_stacks[sid].hooks[i]->ran_once = 0;
+
+   /* Hooks created while running have a higher serial. */
+   serial = hook_serial;
+   gen    = hook_generation;
 
-   run = 0;
+   run  = 0;
+   prof = nlua_prof_active ? nlua_profPush( stack ) : 0;
    hook_runningstack++; /* running hooks */
-   for ( int j = 1; j >= 0; j-- ) {
-      for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+   for ( int j = 1; ( sid >= 0 ) && ( j >= 0 ); j-- ) {
+      /* Newest hooks go first. The array may grow while running, so it has to
+       * be fetched again every time. */
+      for ( int i = array_size( hook_stacks[sid].hooks ) - 1; i >= 0; i-- ) {
+         Hook *h = hook_stacks[sid].hooks[i];
          /* Should be deleted. */
          if ( h->delete )
             continue;
@@ -943,24 +1262,23 @@ static int hooks_executeParam( const char *stack, const HookParam *param )
          if ( h->ran_once )
             continue;
          /* Don't update newly created hooks. */
-         if ( h->created != 0 )
-            continue;
-         /* Doesn't match stack. */
-         if ( strcmp( stack, h->stack ) != 0 )
+         if ( h->created > serial )
             continue;
 
          /* Run hook. */
          hook_run( h, param, j );
          run++;
 
-         /* If hook_cleanup was run, hook_list will be NULL */
-         if ( hook_list == NULL )
+         /* If hook_cleanup was run, the hooks are gone. */
+         if ( gen != hook_generation )
             break;
       }
-      if ( hook_list == NULL )
+      if ( gen != hook_generation )
          break;
    }
    hook_runningstack--; /* not running hooks anymore */
+   if ( prof )
+      nlua_profLeave( prof );
 
    /* Free reference parameters. */
    if ( param != NULL ) {
@@ -1056,11 +1374,19 @@ int hooks_run( const char *stack )
  */
 static Hook *hook_get( unsigned int id )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( h->id == id )
-         return h;
+   const Hook  key  = { .id = id };
+   const Hook *pkey = &key;
+   Hook      **found;
+
+   /* Loading saves can change the ids. */
+   if ( !hook_sorted ) {
+      qsort( hook_all, array_size( hook_all ), sizeof( Hook * ), hook_cmpID );
+      hook_sorted = 1;
+   }
 
-   return NULL;
+   found = bsearch( &pkey, hook_all, array_size( hook_all ), sizeof( Hook * ),
+                    hook_cmpID );
+   return ( found != NULL ) ? *found : NULL;
 }
 
 /**
@@ -1141,8 +1467,8 @@ static void hook_free( Hook *h )
    /* Remove from all the pilots. */
    pilots_rmHook( h->id );
 
-   /* Generic freeing. */
-   free( h->stack );
+   /* Remove from the timer wheels. */
+   hw_remove( h );
 
    /* Free type specific. */
    switch ( h->type ) {
@@ -1166,19 +1492,34 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup( void )
 {
-   Hook *h;
-
    /* Clear queued hooks. */
    hq_clear();
 
-   h = hook_list;
-   while ( h != NULL ) {
-      Hook *hn = h->next;
-      hook_free( h );
-      h = hn;
+   /* The wheels are cleared at once, so the hooks don't have to unlink. */
+   memset( &hook_timers, 0, sizeof( HookWheel ) );
+   memset( &hook_dates, 0, sizeof( HookWheel ) );
+   hook_timer_now = 0.;
+   hook_date_now  = 0;
+
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      hook_all[i]->whead = NULL;
+      hook_free( hook_all[i] );
+   }
+   array_free( hook_all );
+   for ( int i = 0; i < array_size( hook_stacks ); i++ ) {
+      free( hook_stacks[i].name );
+      array_free( hook_stacks[i].hooks );
    }
+   if ( hook_stacks != NULL )
+      nidx_free( &hook_stackidx );
+   array_free( hook_stacks );
+
    /* safe defaults just in case */
-   hook_list = NULL;
+   hook_all     = NULL;
+   hook_stacks  = NULL;
+   hook_sorted  = 1;
+   hook_ndelete = 0;
+   hook_generation++;
 }
 
 /**
@@ -1186,7 +1527,8 @@ void hook_cleanup( void )
  */
 void hook_clear( void )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
       if ( h->delete )
          continue;
       hook_rmRaw( h );
@@ -1198,11 +1540,12 @@ void hook_clear( void )
  */
 void hook_clearMissionTimers( unsigned int parent )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
       if ( !h->is_timer )
          continue;
       if ( ( h->type == HOOK_TYPE_MISN ) && ( parent == h->u.misn.parent ) )
-         h->delete = 1;
+         hook_setDelete( h );
    }
 }
 
@@ -1211,11 +1554,12 @@ void hook_clearMissionTimers( unsigned int parent )
  */
 void hook_clearEventTimers( unsigned int parent )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+   for ( int i = 0; i < array_size( hook_all ); i++ ) {
+      Hook *h = hook_all[i];
       if ( !h->is_timer )
          continue;
       if ( ( h->type == HOOK_TYPE_EVENT ) && ( parent == h->u.event.parent ) )
-         h->delete = 1;
+         hook_setDelete( h );
    }
 }
 
@@ -1261,7 +1605,9 @@ static int hook_needSave( Hook *h )
 int hook_save( xmlTextWriterPtr writer )
 {
    xmlw_startElem( writer, "hooks" );
-   for ( Hook *h = hook_list; h != NULL; h = h->next ) {
+   /* Newest first. */
+   for ( int i = array_size( hook_all ) - 1; i >= 0; i-- ) {
+      Hook *h = hook_all[i];
 
       if ( !hook_needSave( h ) )
          continue; /* no need to save it */
@@ -1324,8 +1670,8 @@ int hook_load( xmlNodePtr parent )
    hook_loadingstack = 0;
 
    /* Set ID gen to highest hook. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      hook_id = MAX( h->id, hook_id );
+   for ( int i = 0; i < array_size( hook_all ); i++ )
+      hook_id = MAX( hook_all[i]->id, hook_id );
 
    return 0;
 }
@@ -1340,7 +1686,7 @@ static int hook_parse( xmlNodePtr base )
 {
    xmlNodePtr   node, cur;
    char        *func, *stack, *stype;
-   unsigned int parent, id, new_id;
+   unsigned int parent, id;
    HookType_t   type;
    Hook        *h;
    int          is_date;
@@ -1414,10 +1760,10 @@ static int hook_parse( xmlNodePtr base )
          /* Create the hook. */
          switch ( type ) {
          case HOOK_TYPE_MISN:
-            new_id = hook_addMisn( parent, func, stack );
+            hook_addMisn( parent, func, stack );
             break;
          case HOOK_TYPE_EVENT:
-            new_id = hook_addEvent( parent, func, stack );
+            hook_addEvent( parent, func, stack );
             break;
          default:
             WARN( _( "Save has unsupported hook type." ) );
@@ -1426,14 +1772,14 @@ static int hook_parse( xmlNodePtr base )
 
          /* Set the id. */
          if ( id != 0 ) {
-            h     = hook_get( new_id );
-            h->id = id;
+            /* The new hook is always the last one. */
+            h           = array_back( hook_all );
+            h->id       = id;
+            hook_sorted = 0;
 
             /* Additional info. */
-            if ( is_date ) {
-               h->is_date = 1;
-               h->res     = res;
-            }
+            if ( is_date )
+               hook_setDate( h, res );
          }
       }
    } while ( xml_nextNode( node ) );
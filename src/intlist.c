@@ -24,12 +24,19 @@ void il_create( IntList *il, int num_fields )
    il->cap          = il_fixed_cap;
    il->num_fields   = num_fields;
    il->free_element = -1;
+   il->arena        = NULL;
+}
+
+void il_createArena( IntList *il, int num_fields, Arena *arena )
+{
+   il_create( il, num_fields );
+   il->arena = arena;
 }
 
 void il_destroy( IntList *il )
 {
    // Free the buffer only if it was heap allocated.
-   if ( il->data != il->fixed )
+   if ( ( il->data != il->fixed ) && ( il->arena == NULL ) )
       free( il->data );
 }
 
@@ -66,9 +73,16 @@ int il_push_back( IntList *il )
       // Use double the size for the new capacity.
       const int new_cap = new_pos * 2;
 
+      // Arena lists just copy into a bigger buffer, the old one is freed with
+      // the arena.
+      if ( il->arena != NULL ) {
+         int *data = arena_alloc( il->arena, new_cap * sizeof( *il->data ) );
+         memcpy( data, il->data, il->cap * sizeof( *il->data ) );
+         il->data = data;
+      }
       // If we're pointing to the fixed buffer, allocate a new array on the
       // heap and copy the fixed buffer contents to it.
-      if ( il->cap == il_fixed_cap ) {
+      else if ( il->cap == il_fixed_cap ) {
          il->data = malloc( new_cap * sizeof( *il->data ) );
          memcpy( il->data, il->fixed, sizeof( il->fixed ) );
       } else {
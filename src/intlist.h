@@ -14,6 +14,8 @@
  */
 #pragma once
 
+#include "arena.h"
+
 typedef struct IntList IntList;
 enum { il_fixed_cap = 128 };
 
@@ -38,6 +40,9 @@ struct IntList {
    // Stores an index to the free element or -1 if the free list
    // is empty.
    int free_element;
+
+   // Arena to grow into instead of the heap, or NULL.
+   Arena *arena;
 };
 
 // ---------------------------------------------------------------------------------
@@ -47,6 +52,10 @@ struct IntList {
 // 'num_fields' specifies the number of integer fields each element has.
 void il_create( IntList *il, int num_fields );
 
+// Creates a new list that grows into an arena instead of the heap. The
+// memory is only valid until the arena is released.
+void il_createArena( IntList *il, int num_fields, Arena *arena );
+
 // Destroys the specified list.
 void il_destroy( IntList *il );
 
@@ -11,6 +11,7 @@
 
 #include "map.h"
 
+#include "arena.h"
 #include "array.h"
 #include "colour.h"
 #include "conf.h"
@@ -163,6 +164,7 @@ static void map_selectCur( void );
 static void map_genModeList( void );
 static void map_update_commod_av_price();
 static void map_onClose( unsigned int wid, const char *str );
+static void map_jumpDistFree( void );
 
 /**
  * @brief Initializes the map subsystem.
@@ -186,6 +188,8 @@ void map_exit( void )
       decorator_stack = NULL;
    }
 
+   map_jumpDistFree();
+
    ovr_exit();
 }
 
@@ -1286,7 +1290,7 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor,
          glEnableVertexAttribArray( shaders.nebula_map.vertex );
          gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_map.vertex, 0,
                                      2, GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up. */
          glDisableVertexAttribArray( shaders.nebula_map.vertex );
@@ -1316,7 +1320,7 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor,
          glEnableVertexAttribArray( sys->ms->vertex );
          gl_vboActivateAttribOffset( gl_squareVBO, sys->ms->vertex, 0, 2,
                                      GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up. */
          glDisableVertexAttribArray( sys->ms->vertex );
@@ -2779,146 +2783,130 @@ void map_toggleNotes()
  * none.
  */
 /**
- * @brief Node structure for A* pathfinding.
+ * @brief Node structure for A* pathfinding, indexed by system id.
  */
 typedef struct SysNode_ {
-   struct SysNode_ *next;  /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem      *sys;    /**< System in node. */
-   int              g;      /**< step */
-   double           d;      /**< the distance to go access the systems. */
-   const vec2      *pos;    /**< position of the entry of the system. */
-} SysNode;                  /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+   int         parent; /**< Id of the parent system, -1 if none. */
+   int         g;      /**< step, -1 if not visited yet. */
+   double      d;      /**< the distance to go access the systems. */
+   const vec2 *pos;    /**< position of the entry of the system. */
+   int         heap;   /**< Position in the open heap, -1 if not in it. */
+} SysNode;             /**< System Node for use in A* pathfinding. */
+/**
+ * @brief Binary heap of open nodes for A* pathfinding.
+ */
+typedef struct SysHeap_ {
+   SysNode *nodes; /**< Nodes indexed by system id. */
+   int     *heap;  /**< Ids of the systems in the open set. */
+   int      n;     /**< Number of systems in the open set. */
+} SysHeap;
+/**
+ * @brief Cached jump distances for one set of pathfinding options.
+ */
+typedef struct JumpDistCache_ {
+   int  *dist;     /**< Matrix of jumps between systems, -1 if unreachable. */
+   char *computed; /**< Whether or not a row of dist is up to date. */
+} JumpDistCache;
+static JumpDistCache
+   map_jumpdist[4];           /**< Caches by ignore_known and show_hidden. */
+static int map_jumpdistN = 0; /**< Number of systems the caches are for. */
 /* prototypes */
-static SysNode *A_newNode( StarSystem *sys );
-static int      A_g( const SysNode *n );
-static double   A_d( const SysNode *n );
-static int      A_less( const SysNode *op1, const SysNode *op2 );
-static SysNode *A_add( SysNode *first, SysNode *cur );
-static SysNode *A_rm( SysNode *first, const StarSystem *cur );
-static SysNode *A_in( SysNode *first, const StarSystem *cur );
-static SysNode *A_lowest( SysNode *first );
-static void     A_freeList( SysNode *first );
-static int      map_decorator_parse( MapDecorator *temp, const char *file );
-/** @brief Creates a new node link to star system. */
-static SysNode *A_newNode( StarSystem *sys )
-{
-   SysNode *n = malloc( sizeof( SysNode ) );
-
-   n->next = NULL;
-   n->sys  = sys;
-
-   n->gnext = A_gc;
-   A_gc     = n;
-
-   return n;
-}
-/** @brief Gets the g from a node. */
-static int A_g( const SysNode *n )
-{
-   return n->g;
-}
-/** @brief Gets the d from a node. */
-static double A_d( const SysNode *n )
-{
-   return n->d;
-}
+static int  A_less( const SysNode *op1, const SysNode *op2 );
+static int  A_usable( const JumpPoint *jp, int ignore_known, int show_hidden );
+static void A_swap( SysHeap *h, int i, int j );
+static void A_up( SysHeap *h, int i );
+static void A_down( SysHeap *h, int i );
+static void A_push( SysHeap *h, int id );
+static int  A_pop( SysHeap *h );
+static void map_jumpDistRow( int *row, const StarSystem *start,
+                             int ignore_known, int show_hidden );
+static int  map_decorator_parse( MapDecorator *temp, const char *file );
 /** @brief op1 is less than op2. */
 static int A_less( const SysNode *op1, const SysNode *op2 )
 {
-   return ( A_g( op1 ) < A_g( op2 ) ) ||
-          ( A_g( op1 ) == A_g( op2 ) && A_d( op1 ) < A_d( op2 ) );
+   return ( op1->g < op2->g ) || ( op1->g == op2->g && op1->d < op2->d );
 }
-/** @brief Adds a node to the linked list. */
-static SysNode *A_add( SysNode *first, SysNode *cur )
+/** @brief Checks to see if a jump can be used for pathfinding. */
+static int A_usable( const JumpPoint *jp, int ignore_known, int show_hidden )
 {
-   SysNode *n;
-
-   if ( first == NULL )
-      return cur;
+   /* Make sure it's reachable */
+   if ( !ignore_known ) {
+      if ( !jp_isKnown( jp ) )
+         return 0;
+      if ( !sys_isKnown( jp->target ) && !space_sysReachable( jp->target ) )
+         return 0;
+   }
+   if ( jp_isFlag( jp, JP_EXITONLY ) )
+      return 0;
 
-   n = first;
-   while ( n->next != NULL )
-      n = n->next;
-   n->next = cur;
+   /* Skip hidden jumps if they're not specifically requested */
+   if ( !show_hidden && jp_isFlag( jp, JP_HIDDEN ) )
+      return 0;
 
-   return first;
+   return 1;
 }
-/* @brief Removes a node from a linked list. */
-static SysNode *A_rm( SysNode *first, const StarSystem *cur )
+/** @brief Swaps two elements of the heap. */
+static void A_swap( SysHeap *h, int i, int j )
 {
-   SysNode *n, *p;
-
-   if ( first->sys == cur ) {
-      n           = first->next;
-      first->next = NULL;
-      return n;
-   }
-
-   p = first;
-   n = p->next;
-   do {
-      if ( n->sys == cur ) {
-         p->next = n->next;
-         n->next = NULL;
-         break;
-      }
-      p = n;
-   } while ( ( n = n->next ) != NULL );
-
-   return first;
+   int t                     = h->heap[i];
+   h->heap[i]                = h->heap[j];
+   h->heap[j]                = t;
+   h->nodes[h->heap[i]].heap = i;
+   h->nodes[h->heap[j]].heap = j;
 }
-/** @brief Checks to see if node is in linked list. */
-static SysNode *A_in( SysNode *first, const StarSystem *cur )
+/** @brief Moves an element up the heap until it is in place. */
+static void A_up( SysHeap *h, int i )
 {
-   SysNode *n;
-
-   if ( first == NULL )
-      return NULL;
-
-   n = first;
-   do {
-      if ( n->sys == cur )
-         return n;
-   } while ( ( n = n->next ) != NULL );
-   return NULL;
+   while ( i > 0 ) {
+      int p = ( i - 1 ) / 2;
+      if ( !A_less( &h->nodes[h->heap[i]], &h->nodes[h->heap[p]] ) )
+         break;
+      A_swap( h, i, p );
+      i = p;
+   }
+}
+/** @brief Moves an element down the heap until it is in place. */
+static void A_down( SysHeap *h, int i )
+{
+   for ( ;; ) {
+      int l = 2 * i + 1;
+      int r = l + 1;
+      int m = i;
+      if ( ( l < h->n ) &&
+           A_less( &h->nodes[h->heap[l]], &h->nodes[h->heap[m]] ) )
+         m = l;
+      if ( ( r < h->n ) &&
+           A_less( &h->nodes[h->heap[r]], &h->nodes[h->heap[m]] ) )
+         m = r;
+      if ( m == i )
+         break;
+      A_swap( h, i, m );
+      i = m;
+   }
 }
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode *A_lowest( SysNode *first )
+/** @brief Adds a node to the open set, or updates it if its cost went down. */
+static void A_push( SysHeap *h, int id )
 {
-   SysNode *lowest, *n;
-
-   if ( first == NULL )
-      return NULL;
-
-   n      = first;
-   lowest = n;
-   do {
-      if ( A_less( n, lowest ) )
-         lowest = n;
-   } while ( ( n = n->next ) != NULL );
-   return lowest;
+   SysNode *n = &h->nodes[id];
+   if ( n->heap < 0 ) {
+      n->heap         = h->n;
+      h->heap[h->n++] = id;
+   }
+   A_up( h, n->heap );
 }
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
+/** @brief Removes the lowest ranking node from the open set. */
+static int A_pop( SysHeap *h )
 {
-   SysNode *p, *n;
-
-   if ( first == NULL )
-      return;
-
-   p = NULL;
-   n = first;
-   do {
-      free( p );
-      p = n;
-   } while ( ( n = n->gnext ) != NULL );
-   free( p );
+   int id = h->heap[0];
+   h->n--;
+   if ( h->n > 0 ) {
+      h->heap[0]                = h->heap[h->n];
+      h->nodes[h->heap[0]].heap = 0;
+      A_down( h, 0 );
+   }
+   h->nodes[id].heap = -1;
+   return id;
 }
-
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
 void map_setZoom( unsigned int wid, double zoom )
 {
@@ -2946,14 +2934,12 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
                               int show_hidden, StarSystem **old_data,
                               double *o_distance )
 {
-   int         j, ojumps;
+   int         j, ojumps, nsys, found;
    StarSystem *ssys, *esys, **res;
+   SysNode    *cur;
+   SysHeap     h;
+   ArenaMark   mark;
 
-   SysNode *cur, *neighbour;
-   SysNode *open, *closed;
-   SysNode *ocost, *ccost;
-
-   A_gc   = NULL;
    res    = old_data;
    ojumps = array_size( old_data );
 
@@ -2991,85 +2977,75 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
       }
    }
 
-   /* start the linked lists */
-   open = closed = NULL;
-   cur           = A_newNode( ssys );
-   cur->parent   = NULL;
-   cur->g        = 0;
-   cur->d        = 0.0;
-   cur->pos      = p_pos_entry;
-   open = A_add( open, cur ); /* Initial open node is the start system */
+   /* Nodes are freed all at once at the end. */
+   nsys    = array_size( system_getAll() );
+   mark    = arena_mark( arena_scratch() );
+   h.nodes = arena_alloc( mark.arena, sizeof( SysNode ) * nsys );
+   h.heap  = arena_alloc( mark.arena, sizeof( int ) * nsys );
+   h.n     = 0;
+   for ( int i = 0; i < nsys; i++ ) {
+      h.nodes[i].g    = -1;
+      h.nodes[i].heap = -1;
+   }
+
+   /* Initial open node is the start system */
+   cur         = &h.nodes[ssys->id];
+   cur->parent = -1;
+   cur->g      = 0;
+   cur->d      = 0.0;
+   cur->pos    = p_pos_entry;
+   A_push( &h, ssys->id );
+
+   j     = 0;
+   found = 0;
+   while ( h.n > 0 ) {
+      int         cost;
+      int         id   = A_pop( &h );
+      StarSystem *csys = system_getIndex( id );
+      cur              = &h.nodes[id];
 
-   j = 0;
-   while ( ( cur = A_lowest( open ) ) ) {
-      int cost;
       /* End condition. */
-      if ( cur->sys == esys )
+      if ( csys == esys ) {
+         found = 1;
          break;
+      }
 
       /* Break if infinite loop. */
       j++;
       if ( j > MAP_LOOP_PROT )
          break;
 
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost = A_g( cur ) + 1; /* Base unit is jump and always increases by 1. */
+      cost = cur->g + 1; /* Base unit is jump and always increases by 1. */
 
-      for ( int i = 0; i < array_size( cur->sys->jumps ); i++ ) {
-         JumpPoint  *jp  = &cur->sys->jumps[i];
+      for ( int i = 0; i < array_size( csys->jumps ); i++ ) {
+         JumpPoint  *jp  = &csys->jumps[i];
          StarSystem *sys = jp->target;
+         SysNode    *neighbour;
 
-         /* Make sure it's reachable */
-         if ( !ignore_known ) {
-            if ( !jp_isKnown( jp ) )
-               continue;
-            if ( !sys_isKnown( sys ) && !space_sysReachable( sys ) )
-               continue;
-         }
-         if ( jp_isFlag( jp, JP_EXITONLY ) )
-            continue;
-
-         /* Skip hidden jumps if they're not specifically requested */
-         if ( !show_hidden && jp_isFlag( jp, JP_HIDDEN ) )
+         if ( !A_usable( jp, ignore_known, show_hidden ) )
             continue;
 
          /* Update cost */
-         const SysNode n_cost = { .g = cost,
-                                  .d = A_d( cur ) +
-                                       ( ( cur->pos != NULL )
-                                            ? vec2_dist( cur->pos, &jp->pos )
-                                            : 0.0 ) };
-
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in( closed, sys );
-         if ( ( ccost != NULL ) && !A_less( &n_cost, ccost ) )
+         const SysNode n_cost = {
+            .g = cost,
+            .d = cur->d +
+                 ( ( cur->pos != NULL ) ? vec2_dist( cur->pos, &jp->pos )
+                                        : 0.0 ) };
+
+         /* Ignore if it was already reached with a better cost, whether it is
+          * still open or already closed. */
+         neighbour = &h.nodes[sys->id];
+         if ( ( neighbour->g >= 0 ) && !A_less( &n_cost, neighbour ) )
             continue;
-         // closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in( open, sys );
-         if ( ocost != NULL ) {
-            if ( A_less( &n_cost, ocost ) )
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
 
-         /* Create the node. */
-         const JumpPoint *jp_entry = jump_getTarget( cur->sys, sys );
-         neighbour                 = A_newNode( sys );
-         neighbour->parent         = cur;
+         /* Update the node. */
+         const JumpPoint *jp_entry = jump_getTarget( csys, sys );
+         neighbour->parent         = id;
          neighbour->g              = n_cost.g;
          neighbour->d              = n_cost.d;
          neighbour->pos = ( jp_entry != NULL ) ? &jp_entry->pos : NULL;
-         open           = A_add( open, neighbour );
+         A_push( &h, sys->id );
       }
-
-      /* Safety check in case not linked. */
-      if ( open == NULL )
-         break;
    }
 
    if ( o_distance != NULL ) {
@@ -3077,27 +3053,132 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
    }
 
    /* Build path backwards if not broken from loop. */
-   if ( cur != NULL && esys == cur->sys ) {
-      int njumps = A_g( cur ) + ojumps;
+   if ( found ) {
+      int njumps = cur->g + ojumps;
+      int id     = esys->id;
       assert( njumps > ojumps );
       if ( res == NULL )
          res = array_create_size( StarSystem *, njumps );
       array_resize( &res, njumps );
       /* Build path. */
       for ( int i = 0; i < njumps - ojumps; i++ ) {
-         res[njumps - i - 1] = cur->sys;
-         cur                 = cur->parent;
+         res[njumps - i - 1] = system_getIndex( id );
+         id                  = h.nodes[id].parent;
       }
    } else {
       res = NULL;
       array_free( old_data );
    }
 
-   /* free the linked lists */
-   A_freeList( A_gc );
+   /* free the nodes */
+   arena_release( &mark );
    return res;
 }
 
+/**
+ * @brief Computes the jump distances from a system to all the others.
+ */
+static void map_jumpDistRow( int *row, const StarSystem *start,
+                             int ignore_known, int show_hidden )
+{
+   int       nsys = map_jumpdistN;
+   int       qn;
+   ArenaMark mark  = arena_mark( arena_scratch() );
+   int      *queue = arena_alloc( mark.arena, sizeof( int ) * nsys );
+
+   for ( int i = 0; i < nsys; i++ )
+      row[i] = -1;
+
+   /* Every jump costs the same, so a breadth-first search is enough. */
+   row[start->id] = 0;
+   queue[0]       = start->id;
+   qn             = 1;
+   for ( int q = 0; q < qn; q++ ) {
+      const StarSystem *sys = system_getIndex( queue[q] );
+      for ( int i = 0; i < array_size( sys->jumps ); i++ ) {
+         const JumpPoint *jp = &sys->jumps[i];
+         if ( row[jp->target->id] >= 0 )
+            continue;
+         if ( !A_usable( jp, ignore_known, show_hidden ) )
+            continue;
+         row[jp->target->id] = row[sys->id] + 1;
+         queue[qn++]         = jp->target->id;
+      }
+   }
+
+   arena_release( &mark );
+}
+
+/**
+ * @brief Gets the number of jumps between two systems.
+ *
+ * Gives the same number of jumps as map_getJumpPath, but distances are cached
+ * so repeated queries are cheap.
+ *
+ *    @param sysstart System to start from.
+ *    @param sysend System to end at.
+ *    @param ignore_known Whether or not to ignore if systems and jump points
+ * are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Number of jumps between the systems or -1 if unreachable.
+ */
+int map_getJumpDist( const StarSystem *sysstart, const StarSystem *sysend,
+                     int ignore_known, int show_hidden )
+{
+   JumpDistCache *c;
+   int           *row;
+   int            nsys = array_size( system_getAll() );
+
+   if ( sysstart == sysend )
+      return 0;
+
+   /* The universe changed size, start over. */
+   if ( nsys != map_jumpdistN ) {
+      map_jumpDistFree();
+      map_jumpdistN = nsys;
+   }
+
+   c = &map_jumpdist[( !!ignore_known ) * 2 + ( !!show_hidden )];
+   if ( c->dist == NULL ) {
+      c->dist     = malloc( sizeof( int ) * nsys * nsys );
+      c->computed = calloc( nsys, sizeof( char ) );
+   }
+
+   row = &c->dist[(size_t)sysstart->id * nsys];
+   if ( !c->computed[sysstart->id] ) {
+      map_jumpDistRow( row, sysstart, ignore_known, show_hidden );
+      c->computed[sysstart->id] = 1;
+   }
+   return row[sysend->id];
+}
+
+/**
+ * @brief Invalidates the cached jump distances.
+ *
+ * Has to be called whenever jumps change or systems and jumps become known or
+ * unknown.
+ */
+void map_jumpDistInvalidate( void )
+{
+   for ( int i = 0; i < 4; i++ )
+      if ( map_jumpdist[i].computed != NULL )
+         memset( map_jumpdist[i].computed, 0, map_jumpdistN );
+}
+
+/**
+ * @brief Frees the cached jump distances.
+ */
+static void map_jumpDistFree( void )
+{
+   for ( int i = 0; i < 4; i++ ) {
+      free( map_jumpdist[i].dist );
+      free( map_jumpdist[i].computed );
+      map_jumpdist[i].dist     = NULL;
+      map_jumpdist[i].computed = NULL;
+   }
+   map_jumpdistN = 0;
+}
+
 /**
  * @brief Marks maps around a radius of currently system as known.
  *
@@ -3139,6 +3220,7 @@ int map_map( const Outfit *map )
    for ( int i = 0; i < array_size( map->u.map->jumps ); i++ )
       jp_setFlag( map->u.map->jumps[i], JP_KNOWN );
 
+   map_jumpDistInvalidate();
    ovr_refresh();
    return 1;
 }
@@ -3241,6 +3323,7 @@ static int localmap_docheck( const Outfit *lmap, StarSystem *sys, int range,
 int localmap_map( const Outfit *lmap )
 {
    int ret = localmap_docheck( lmap, cur_system, lmap->u.lmap.range, 1 );
+   map_jumpDistInvalidate();
    ovr_refresh();
    return ret;
 }
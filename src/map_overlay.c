@@ -973,7 +973,7 @@ void ovr_render( double dt )
       gl_uniformMat4( shaders.stealthoverlay.tex_mat, &I );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.stealthoverlay.vertex );
@@ -23,6 +23,7 @@
 #include "hook.h"
 #include "land.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_misn.h"
@@ -51,6 +52,41 @@ static char       **player_missions_failed =
  */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
 
+/**
+ * @brief Missions available at a location, to avoid checking all of them.
+ */
+typedef struct MissionIndex_ {
+   int *generic; /**< Array (array.h): Missions without spob, system or faction
+                    requirements. */
+   int *faction_any; /**< Array (array.h): Missions with only faction
+                        requirements. */
+   int **factions;   /**< Array (array.h): Per faction ID, the missions of
+                        faction_any that accept it. */
+   NameIndex spobs;   /**< Spob names to their list of missions. */
+   NameIndex systems; /**< System names to their list of missions without spob
+                         requirements. */
+   int **lists; /**< Array (array.h): Lists of missions by spob or system. */
+} MissionIndex;
+
+/**
+ * @brief Cached results of the mission conditionals.
+ */
+typedef struct MissionCache_ {
+   unsigned int chapter_gen; /**< Chapter generation of chapter_ret. */
+   int          chapter_ret; /**< Result of matching the chapter. */
+   unsigned int cond_gen;    /**< State generation of cond_ret. */
+   int          cond_ret;    /**< Result of the Lua conditional. */
+} MissionCache;
+
+static MissionIndex
+   mission_index[MIS_AVAIL_ENTER + 1]; /**< Missions by location. */
+static NameIndex     mission_nameidx;  /**< Mission indices by name. */
+static MissionCache *mission_cache =
+   NULL; /**< Array (array.h): Per mission, cached conditionals. */
+static char *mission_chapter = NULL; /**< Chapter the cache was made for. */
+static unsigned int mission_chapterGen = 1; /**< Changes with the chapter. */
+static unsigned int mission_stateGen   = 1; /**< Changes with tracked state. */
+
 /*
  * prototypes
  */
@@ -65,6 +101,11 @@ static int mission_meetConditionals( const MissionData *misn );
 static int mission_meetReq( const MissionData *misn, int faction,
                             const Spob *pnt, const StarSystem *sys );
 static int mission_matchFaction( const MissionData *misn, int faction );
+static int mission_matchChapter( const MissionData *misn );
+static int *mission_candidates( MissionAvailability loc, int faction,
+                                const Spob *pnt, const StarSystem *sys );
+static void missions_buildIndex( void );
+static void missions_freeIndex( void );
 static int mission_location( const char *loc );
 /* Loading. */
 static int missions_cmp( const void *a, const void *b );
@@ -98,12 +139,10 @@ static unsigned int mission_genID( void )
  */
 int mission_getID( const char *name )
 {
-   for ( int i = 0; i < array_size( mission_stack ); i++ )
-      if ( strcmp( name, mission_stack[i].name ) == 0 )
-         return i;
-
-   WARN( _( "Mission '%s' not found in stack" ), name );
-   return -1;
+   int id = nidx_get( &mission_nameidx, name );
+   if ( id < 0 )
+      WARN( _( "Mission '%s' not found in stack" ), name );
+   return id;
 }
 
 /**
@@ -168,9 +207,7 @@ static int mission_init( Mission *mission, const MissionData *misn, int genid,
    }
 
    /* init Lua */
-   mission->env = nlua_newEnv( misn->name );
-
-   misn_loadLibs( mission->env ); /* load our custom libraries */
+   mission->env = nlua_newEnvLibs( misn->name, misn_loadLibs );
 
    /* Create the "mem" table for persistence. */
    lua_newtable( naevL );
@@ -235,36 +272,82 @@ int mission_alreadyRunning( const MissionData *misn )
    return n;
 }
 
+/**
+ * @brief Marks the state conditionals can depend on as changed, invalidating
+ * the cached results of cacheable conditionals.
+ *
+ * Should be called when mission variables, completed missions or events,
+ * unidiffs or the chapter change.
+ */
+void missions_stateChanged( void )
+{
+   mission_stateGen++;
+}
+
+/**
+ * @brief Matches the chapter of the player against the one of a mission.
+ *
+ *    @return -1 if it doesn't match, 1 on failure, 0 if it matches.
+ */
+static int mission_matchChapter( const MissionData *misn )
+{
+   pcre2_match_data *match_data =
+      pcre2_match_data_create_from_pattern( misn->avail.chapter_re, NULL );
+   int rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)player.chapter,
+                         strlen( player.chapter ), 0, 0, match_data, NULL );
+   pcre2_match_data_free( match_data );
+   if ( rc < 0 ) {
+      switch ( rc ) {
+      case PCRE2_ERROR_NOMATCH:
+         return -1;
+      default:
+         WARN( _( "Matching error %d" ), rc );
+         break;
+      }
+   } else if ( rc == 0 )
+      return 1;
+   return 0;
+}
+
 static int mission_meetConditionals( const MissionData *misn )
 {
-   /* If chapter, must match chapter. */
+   int           id = misn - mission_stack;
+   MissionCache *mc = &mission_cache[id];
+
+   /* If chapter, must match chapter. The results are kept until the chapter
+    * changes. */
    if ( misn->avail.chapter_re != NULL ) {
-      pcre2_match_data *match_data =
-         pcre2_match_data_create_from_pattern( misn->avail.chapter_re, NULL );
-      int rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)player.chapter,
-                            strlen( player.chapter ), 0, 0, match_data, NULL );
-      pcre2_match_data_free( match_data );
-      if ( rc < 0 ) {
-         switch ( rc ) {
-         case PCRE2_ERROR_NOMATCH:
-            return -1;
-         default:
-            WARN( _( "Matching error %d" ), rc );
-            break;
-         }
-      } else if ( rc == 0 )
-         return 1;
+      if ( ( mission_chapter == NULL ) ||
+           ( strcmp( mission_chapter, player.chapter ) != 0 ) ) {
+         free( mission_chapter );
+         mission_chapter = strdup( player.chapter );
+         mission_chapterGen++;
+      }
+      if ( mc->chapter_gen != mission_chapterGen ) {
+         mc->chapter_ret = mission_matchChapter( misn );
+         mc->chapter_gen = mission_chapterGen;
+      }
+      if ( mc->chapter_ret != 0 )
+         return mc->chapter_ret;
    }
 
    /* Must not be already done or running if unique. */
    if ( mis_isFlag( misn, MISSION_UNIQUE ) &&
-        ( player_missionAlreadyDone( mission_getID( misn->name ) ) ||
-          mission_alreadyRunning( misn ) ) )
+        ( player_missionAlreadyDone( id ) || mission_alreadyRunning( misn ) ) )
       return 1;
 
    /* Must meet Lua condition. */
    if ( misn->avail.cond != NULL ) {
-      int c = cond_checkChunk( misn->avail.cond_chunk, misn->avail.cond );
+      int c;
+      if ( misn->avail.cond_cache && ( mc->cond_gen == mission_stateGen ) )
+         c = mc->cond_ret;
+      else {
+         c = cond_checkChunk( misn->avail.cond_chunk, misn->avail.cond );
+         if ( misn->avail.cond_cache && ( c >= 0 ) ) {
+            mc->cond_ret = c;
+            mc->cond_gen = mission_stateGen;
+         }
+      }
       if ( c < 0 ) {
          WARN( _( "Conditional for mission '%s' failed to run" ), misn->name );
          return 1;
@@ -274,8 +357,8 @@ static int mission_meetConditionals( const MissionData *misn )
 
    /* Must meet previous mission requirements. */
    if ( ( misn->avail.done != NULL ) &&
-        ( player_missionAlreadyDone( mission_getID( misn->avail.done ) ) ==
-          0 ) )
+        ( player_missionAlreadyDone(
+             nidx_get( &mission_nameidx, misn->avail.done ) ) == 0 ) )
       return 1;
 
    return 0;
@@ -326,16 +409,14 @@ static int mission_meetReq( const MissionData *misn, int faction,
 void missions_run( MissionAvailability loc, int faction, const Spob *pnt,
                    const StarSystem *sys )
 {
-   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+   int *candidates = mission_candidates( loc, faction, pnt, sys );
+   for ( int i = 0; i < array_size( candidates ); i++ ) {
       Mission      mission;
       double       chance;
-      MissionData *misn = &mission_stack[i];
+      MissionData *misn = &mission_stack[candidates[i]];
 
       if ( naev_isQuit() )
-         return;
-
-      if ( misn->avail.loc != loc )
-         continue;
+         break;
 
       if ( !mission_meetReq( misn, faction, pnt, sys ) )
          continue;
@@ -350,6 +431,7 @@ void missions_run( MissionAvailability loc, int faction, const Spob *pnt,
             &mission ); /* it better clean up for itself or we do it */
       }
    }
+   array_free( candidates );
 }
 
 /**
@@ -910,6 +992,173 @@ static int mission_matchFaction( const MissionData *misn, int faction )
    return 0;
 }
 
+/**
+ * @brief Appends a mission to a list of the index, creating it if necessary.
+ */
+static void missions_indexAdd( NameIndex *nidx, int ***lists,
+                               const char *name, int id )
+{
+   int l = nidx_get( nidx, name );
+   if ( l < 0 ) {
+      l = array_size( *lists );
+      array_push_back( lists, array_create( int ) );
+      nidx_set( nidx, name, l );
+   }
+   array_push_back( &( *lists )[l], id );
+}
+
+/**
+ * @brief Builds the indices used to look up missions by name and location.
+ *
+ * Must be called whenever the mission stack is modified.
+ */
+static void missions_buildIndex( void )
+{
+   missions_freeIndex();
+
+   nidx_create( &mission_nameidx );
+   for ( int i = 0; i < array_size( mission_stack ); i++ )
+      nidx_set( &mission_nameidx, mission_stack[i].name, i );
+
+   for ( int i = 0; i <= MIS_AVAIL_ENTER; i++ ) {
+      MissionIndex *mi = &mission_index[i];
+      mi->generic      = array_create( int );
+      mi->faction_any  = array_create( int );
+      mi->factions     = array_create( int * );
+      mi->lists        = array_create( int * );
+      nidx_create( &mi->spobs );
+      nidx_create( &mi->systems );
+   }
+
+   /* Missions are added in stack order, so each list stays sorted. */
+   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+      const MissionData *misn = &mission_stack[i];
+      MissionIndex      *mi;
+      if ( ( misn->avail.loc < 0 ) || ( misn->avail.loc > MIS_AVAIL_ENTER ) )
+         continue;
+      mi = &mission_index[misn->avail.loc];
+
+      if ( misn->avail.spob != NULL )
+         missions_indexAdd( &mi->spobs, &mi->lists, misn->avail.spob, i );
+      else if ( misn->avail.system != NULL )
+         missions_indexAdd( &mi->systems, &mi->lists, misn->avail.system, i );
+      else if ( array_size( misn->avail.factions ) > 0 ) {
+         array_push_back( &mi->faction_any, i );
+         for ( int j = 0; j < array_size( misn->avail.factions ); j++ ) {
+            int f = misn->avail.factions[j];
+            if ( f < 0 )
+               continue;
+            while ( array_size( mi->factions ) <= f )
+               array_push_back( &mi->factions, array_create( int ) );
+            /* Factions may be repeated. */
+            if ( ( array_size( mi->factions[f] ) == 0 ) ||
+                 ( array_back( mi->factions[f] ) != i ) )
+               array_push_back( &mi->factions[f], i );
+         }
+      } else
+         array_push_back( &mi->generic, i );
+   }
+
+   /* Cached results are no longer valid. */
+   mission_cache = array_create_size( MissionCache,
+                                      MAX( 1, array_size( mission_stack ) ) );
+   array_resize( &mission_cache, array_size( mission_stack ) );
+   memset( mission_cache, 0,
+           sizeof( MissionCache ) * array_size( mission_stack ) );
+}
+
+/**
+ * @brief Frees the indices of the missions.
+ */
+static void missions_freeIndex( void )
+{
+   nidx_free( &mission_nameidx );
+   for ( int i = 0; i <= MIS_AVAIL_ENTER; i++ ) {
+      MissionIndex *mi = &mission_index[i];
+      array_free( mi->generic );
+      array_free( mi->faction_any );
+      for ( int j = 0; j < array_size( mi->factions ); j++ )
+         array_free( mi->factions[j] );
+      array_free( mi->factions );
+      for ( int j = 0; j < array_size( mi->lists ); j++ )
+         array_free( mi->lists[j] );
+      array_free( mi->lists );
+      nidx_free( &mi->spobs );
+      nidx_free( &mi->systems );
+      memset( mi, 0, sizeof( MissionIndex ) );
+   }
+   array_free( mission_cache );
+   mission_cache = NULL;
+   free( mission_chapter );
+   mission_chapter = NULL;
+}
+
+/**
+ * @brief Compares two mission indices.
+ */
+static int missions_cmpID( const void *a, const void *b )
+{
+   return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * @brief Appends a list of mission indices to another.
+ */
+static void missions_append( int **out, const int *list )
+{
+   int n = array_size( *out );
+   if ( array_size( list ) == 0 )
+      return;
+   array_resize( out, n + array_size( list ) );
+   memcpy( &( *out )[n], list, sizeof( int ) * array_size( list ) );
+}
+
+/**
+ * @brief Gets the missions that can possibly meet the location requirements.
+ *
+ * Candidates still have to be checked with mission_meetReq.
+ *
+ *    @param loc Location to match.
+ *    @param faction Faction of the spob.
+ *    @param pnt Spob to run on.
+ *    @param sys System to run on.
+ *    @return Array (array.h) of mission indices in stack order, must be freed.
+ */
+static int *mission_candidates( MissionAvailability loc, int faction,
+                                const Spob *pnt, const StarSystem *sys )
+{
+   const MissionIndex *mi;
+   const int          *fac;
+   int                *out = array_create( int );
+
+   if ( ( loc < 0 ) || ( loc > MIS_AVAIL_ENTER ) )
+      return out;
+   mi = &mission_index[loc];
+
+   if ( pnt != NULL ) {
+      int l = nidx_get( &mi->spobs, pnt->name );
+      if ( l >= 0 )
+         missions_append( &out, mi->lists[l] );
+   }
+   if ( sys != NULL ) {
+      int l = nidx_get( &mi->systems, sys->name );
+      if ( l >= 0 )
+         missions_append( &out, mi->lists[l] );
+   }
+   missions_append( &out, mi->generic );
+   if ( faction < 0 )
+      fac = mi->faction_any;
+   else if ( faction < array_size( mi->factions ) )
+      fac = mi->factions[faction];
+   else
+      fac = NULL;
+   missions_append( &out, fac );
+
+   /* Keep the priority order of the stack. */
+   qsort( out, array_size( out ), sizeof( int ), missions_cmpID );
+   return out;
+}
+
 /**
  * @brief Activates mission claims.
  */
@@ -959,17 +1208,16 @@ int mission_compare( const void *arg1, const void *arg2 )
 Mission *missions_genList( int faction, const Spob *pnt, const StarSystem *sys,
                            MissionAvailability loc )
 {
-   int      rep;
+   int      rep, *candidates;
    Mission *tmp = array_create( Mission );
 
    NTracingZone( _ctx, 1 );
 
    /* Find available missions. */
-   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+   candidates = mission_candidates( loc, faction, pnt, sys );
+   for ( int i = 0; i < array_size( candidates ); i++ ) {
       double       chance;
-      MissionData *misn = &mission_stack[i];
-      if ( misn->avail.loc != loc )
-         continue;
+      MissionData *misn = &mission_stack[candidates[i]];
 
       /* Must hit chance. */
       chance = (double)( misn->avail.chance % 100 ) / 100.;
@@ -994,6 +1242,7 @@ Mission *missions_genList( int faction, const Spob *pnt, const StarSystem *sys,
          array_push_back( &tmp, newm );
       }
    }
+   array_free( candidates );
 
    /* Sort. */
    if ( array_size( tmp ) > 0 )
@@ -1081,6 +1330,8 @@ static int mission_parseXML( MissionData *temp, const xmlNodePtr parent )
                           faction_get( xml_get( node ) ) );
          continue;
       }
+      if ( xml_isNode( node, "cond" ) )
+         xmlr_attr_int( node, "cache", temp->avail.cond_cache );
       xmlr_strd( node, "cond", temp->avail.cond );
       xmlr_strd( node, "done", temp->avail.done );
       xmlr_int( node, "priority", temp->avail.priority );
@@ -1202,6 +1453,7 @@ int missions_load( void )
     * first. */
    qsort( mission_stack, array_size( mission_stack ), sizeof( MissionData ),
           missions_cmp );
+   missions_buildIndex();
 
 #if DEBUGGING
    if ( conf.devmode ) {
@@ -1291,7 +1543,7 @@ static int mission_parseFile( const char *file, MissionData *temp )
 
    /* Load the chunk. */
    int ret =
-      luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+      nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Mission Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
@@ -1313,6 +1565,7 @@ void missions_free( void )
    missions_cleanup();
 
    /* Free the mission data. */
+   missions_freeIndex();
    for ( int i = 0; i < array_size( mission_stack ); i++ )
       mission_freeData( &mission_stack[i] );
    array_free( mission_stack );
@@ -1728,5 +1981,8 @@ int mission_reload( const char *name )
       mission_freeData( &save );
    else
       *temp = save;
+
+   /* Requirements may have changed. */
+   missions_buildIndex();
    return res;
 }
@@ -50,6 +50,8 @@ typedef struct MissionAvail_s {
 
    char *cond;       /**< Condition that must be met (Lua). */
    int   cond_chunk; /**< Chunk representing the condition. */
+   int   cond_cache; /**< Whether the condition only depends on state tracked
+                        by missions_stateChanged(), so it can be cached. */
    char *done;       /**< Previous mission that must have been done. */
 
    int priority; /**< Mission priority: 0 = main plot, 5 = default, 10 =
@@ -137,6 +139,7 @@ void        missions_run( MissionAvailability loc, int faction, const Spob *pnt,
 int         mission_start( const char *name, unsigned int *id );
 int         mission_test( const char *name );
 const char *mission_availabilityStr( MissionAvailability loc );
+void        missions_stateChanged( void );
 
 /*
  * misc
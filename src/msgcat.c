@@ -171,6 +171,43 @@ uint32_t msgcat_nstringsFromHeader( const char buf[12] )
 }
 
 
+/**
+ * @brief Return the number of strings in a message catalog.
+ */
+uint32_t msgcat_nstrings( const msgcat_t *p )
+{
+   if (p->map_size < 12)
+      return 0;
+   return msgcat_nstringsFromHeader( p->map );
+}
+
+
+/**
+ * @brief Return a translation by its position in the message catalog.
+ *
+ * @param p The message catalog.
+ * @param i Position of the translation, less than msgcat_nstrings().
+ * @param[out] len Length of the translation, including all the plural forms separated by '\0'.
+ * @return The translation, or NULL if the catalog is invalid.
+ */
+const char *msgcat_translation( const msgcat_t *p, uint32_t i, size_t *len )
+{
+   const uint32_t *mo = p->map;
+   int sw = *mo - 0x950412de;
+   uint32_t n = swapc(mo[2], sw);
+   uint32_t t = swapc(mo[4], sw);
+   uint32_t tl, ts;
+   if (i>=n || n>=p->map_size/4 || t>=p->map_size-4*n || (t%4))
+      return NULL;
+   tl = swapc(mo[t/4+2*i], sw);
+   ts = swapc(mo[t/4+2*i+1], sw);
+   if (ts >= p->map_size || tl >= p->map_size-ts)
+      return NULL;
+   *len = tl;
+   return (const char *)p->map + ts;
+}
+
+
 /* ===================== https://git.musl-libc.org/cgit/musl/tree/src/locale/pleval.c ======================== */
 /*
 grammar:
@@ -27,6 +27,7 @@
 /** @endcond */
 
 #include "ai.h"
+#include "arena.h"
 #include "background.h"
 #include "camera.h"
 #include "cond.h"
@@ -58,6 +59,7 @@
 #include "nebula.h"
 #include "news.h"
 #include "nfile.h"
+#include "nlua.h"
 #include "nlua_colour.h"
 #include "nlua_data.h"
 #include "nlua_file.h"
@@ -122,6 +124,45 @@ static int          load_force_render = 0;
 static unsigned int load_last_render  = 0;
 static SDL_mutex   *load_mutex;
 
+/**
+ * @brief Stages of the data loading, see load_stages.
+ */
+enum {
+   LOAD_COMMODITY,
+   LOAD_SPFX,
+   LOAD_EFFECT,
+   LOAD_DTYPE,
+   LOAD_FACTION,
+   LOAD_OUTFIT,
+   LOAD_SHIP,
+   LOAD_OUTFITPOST,
+   LOAD_AI,
+   LOAD_TECH,
+   LOAD_SPACE,
+   LOAD_EVENT,
+   LOAD_MISSION,
+   LOAD_UNIDIFF,
+   LOAD_MAP,
+   LOAD_SAFELANE,
+   LOAD_FACTIONPOST,
+   LOAD_SENTINEL
+};
+#define LOAD_DEP( s ) ( 1u << ( s ) ) /**< Dependency mask of a stage. */
+#define LOADING_STAGES                                                         \
+   ( LOAD_SENTINEL + 1. ) /**< Amount of loading stages, including details. */
+
+/**
+ * @brief A stage of the data loading.
+ */
+typedef struct LoadStage_ {
+   const char *name; /**< Name used for tracing and timing. */
+   const char *msg;  /**< Loadscreen message. */
+   int ( *func )( void ); /**< Loading function. */
+   unsigned int deps;     /**< Stages that have to be done first. */
+   int threaded; /**< Whether it can run in the threadpool, i.e., it does not
+                    touch OpenGL nor Lua. */
+} LoadStage;
+
 /*
  * prototypes
  */
@@ -138,6 +179,62 @@ static void update_all( int dohooks );
 /* Misc. */
 static void loadscreen_update( double done, const char *msg );
 void        main_loop( int nested ); /* externed in dialogue.c */
+static int  load_safelanes( void );
+static int  load_factionsPost( void );
+static void load_stageRun( int s );
+static void load_stageThread( Job *job, void *data );
+static int  load_stageJoin( Job **job, const LoadStage *ls, int stage );
+static int  load_runStages( int stage );
+
+/**
+ * @brief Loading stages and their dependencies. The main thread stages are run
+ * in this order.
+ */
+static const LoadStage load_stages[LOAD_SENTINEL] = {
+   [LOAD_COMMODITY] = { "commodities", N_( "Loading Commodities…" ),
+                        commodity_load, 0, 0 },
+   [LOAD_SPFX] = { "spfx", N_( "Loading Special Effects…" ), spfx_load, 0, 0 },
+   [LOAD_EFFECT] = { "effects", N_( "Loading Effects…" ), effect_load, 0, 0 },
+   [LOAD_DTYPE]  = { "damage types", N_( "Loading Damage Types…" ), dtype_load,
+                     0, 1 },
+   [LOAD_FACTION] = { "factions", N_( "Loading Factions…" ), factions_load, 0,
+                      0 },
+   [LOAD_OUTFIT]  = { "outfits", N_( "Loading Outfits…" ), outfit_load,
+                      LOAD_DEP( LOAD_SPFX ) | LOAD_DEP( LOAD_DTYPE ) |
+                         LOAD_DEP( LOAD_FACTION ),
+                      0 },
+   [LOAD_SHIP]    = { "ships", N_( "Loading Ships…" ), ships_load,
+                      LOAD_DEP( LOAD_OUTFIT ), 0 },
+   [LOAD_OUTFITPOST] = { "outfits post", N_( "Post-processing Outfits…" ),
+                         outfit_loadPost, LOAD_DEP( LOAD_SHIP ), 0 },
+   [LOAD_AI]   = { "ai", N_( "Loading AI…" ), ai_load,
+                   LOAD_DEP( LOAD_OUTFITPOST ), 0 },
+   [LOAD_TECH] = { "techs", N_( "Loading Techs…" ), tech_load,
+                   LOAD_DEP( LOAD_COMMODITY ) | LOAD_DEP( LOAD_OUTFITPOST ),
+                   1 },
+   [LOAD_SPACE] = { "universe", N_( "Loading the Universe…" ), space_load,
+                    LOAD_DEP( LOAD_EFFECT ) | LOAD_DEP( LOAD_AI ) |
+                       LOAD_DEP( LOAD_TECH ),
+                    0 },
+   [LOAD_EVENT] = { "events", N_( "Loading Events…" ), events_load,
+                    LOAD_DEP( LOAD_SPACE ), 0 },
+   [LOAD_MISSION] = { "missions", N_( "Loading Missions…" ), missions_load,
+                      LOAD_DEP( LOAD_SPACE ), 0 },
+   [LOAD_UNIDIFF] = { "unidiffs", N_( "Loading the UniDiffs…" ), diff_init, 0,
+                      1 },
+   [LOAD_MAP]     = { "maps", N_( "Populating Maps…" ), outfit_mapParse,
+                      LOAD_DEP( LOAD_SPACE ), 0 },
+   [LOAD_SAFELANE] = { "safelanes", N_( "Calculating Patrols…" ),
+                       load_safelanes, LOAD_DEP( LOAD_SPACE ), 0 },
+   /* Handled at the end, deals with equip / standing scripts. */
+   [LOAD_FACTIONPOST] = { "factions post", N_( "Post-processing Factions…" ),
+                          load_factionsPost,
+                          LOAD_DEP( LOAD_EVENT ) | LOAD_DEP( LOAD_MISSION ) |
+                             LOAD_DEP( LOAD_UNIDIFF ) | LOAD_DEP( LOAD_MAP ) |
+                             LOAD_DEP( LOAD_SAFELANE ),
+                          0 },
+};
+static double load_stageTime[LOAD_SENTINEL]; /**< Time each stage took. */
 
 /**
  * @brief Flags naev to quit.
@@ -228,6 +325,7 @@ int main( int argc, char **argv )
 
    /* Initialize the threadpool */
    threadpool_init();
+   arena_init();
 
    /* Set up debug signal handlers. */
    debug_sigInit();
@@ -339,6 +437,9 @@ int main( int argc, char **argv )
                 FONT_PATH_PREFIX, 0 ); /* small font */
    gl_fontInit( &gl_defFontMono, _( FONT_MONOSPACE_PATH ), conf.font_size_def,
                 FONT_PATH_PREFIX, 0 );
+   gl_fontPrewarm( &gl_defFont );
+   gl_fontPrewarm( &gl_smallFont );
+   gl_fontPrewarm( &gl_defFontMono );
 
    /* Detect size changes that occurred after window creation. */
    naev_resize();
@@ -407,10 +508,11 @@ int main( int argc, char **argv )
    /* Start menu. */
    menu_main();
 
-   if ( conf.devmode )
+   if ( conf.devmode ) {
       LOG( _( "Reached main menu in %.3f s" ),
            (double)( SDL_GetTicks() - starttime ) / 1000. );
-   else
+      nlua_bytecodeReport();
+   } else
       LOG( _( "Reached main menu" ) );
    NTracingMessageL( _( "Reached main menu" ) );
 
@@ -526,6 +628,7 @@ int main( int argc, char **argv )
    lua_exit();        /* Closes Lua state, and invalidates all Lua. */
    sound_exit();      /* Kills the sound */
    gl_exit();         /* Kills video output */
+   threadpool_exit(); /* Stops the worker threads. */
 
    /* Has to be run last or it will mess up sound settings. */
    conf_cleanup(); /* Free some memory the configuration allocated. */
@@ -547,6 +650,7 @@ int main( int argc, char **argv )
    log_clean();
 
    /* Really turn the lights off. */
+   arena_exit();
    PHYSFS_deinit();
    gl_fontExit();
    gettext_exit();
@@ -678,69 +782,154 @@ static void loadscreen_unload( void )
 }
 
 /**
- * @brief Loads all the data, makes main() simpler.
+ * @brief Wrapper to use safelanes_init as a loading stage.
  */
-#define LOADING_STAGES 17. /**< Amount of loading stages. */
-void load_all( void )
+static int load_safelanes( void )
 {
-   NTracingFrameMarkStart( "load_all" );
-
-   int stage = 0;
-   /* We can do fast stuff here. */
-   sp_load();
+   safelanes_init();
+   return 0;
+}
 
-   /* order is very important as they're interdependent */
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Commodities…" ) );
-   commodity_load(); /* dep for space */
+/**
+ * @brief Wrapper to use factions_loadPost as a loading stage.
+ */
+static int load_factionsPost( void )
+{
+   factions_loadPost();
+   return 0;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES,
-                      _( "Loading Special Effects…" ) );
-   spfx_load(); /* no dep */
+/**
+ * @brief Runs a loading stage, timing it.
+ */
+static void load_stageRun( int s )
+{
+   const LoadStage *ls = &load_stages[s];
+   Uint64           t  = SDL_GetPerformanceCounter();
+   NTracingZone( _ctx, 1 );
+   NTracingZoneSetName( _ctx, ls->name, strlen( ls->name ) );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Effects…" ) );
-   effect_load(); /* no dep */
+   ls->func();
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Damage Types…" ) );
-   dtype_load(); /* dep for outfits */
+   load_stageTime[s] = (double)( SDL_GetPerformanceCounter() - t ) /
+                       (double)SDL_GetPerformanceFrequency();
+   NTracingZoneEnd( _ctx );
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Factions…" ) );
-   factions_load(); /* dep for fleet, space, missions, AI */
+/**
+ * @brief Runs a loading stage in the threadpool.
+ */
+static void load_stageThread( Job *job, void *data )
+{
+   (void)job;
+   load_stageRun( (int)( (const LoadStage *)data - load_stages ) );
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Outfits…" ) );
-   outfit_load(); /* dep for ships, factions */
+/**
+ * @brief Waits on a threaded loading stage and updates the loadscreen.
+ *
+ *    @param job Job of the stage, released and set to NULL.
+ *    @param ls Stage being waited on.
+ *    @param stage Number of stages done, used for the loadscreen.
+ *    @return Number of stages done.
+ */
+static int load_stageJoin( Job **job, const LoadStage *ls, int stage )
+{
+   job_wait( *job );
+   *job = NULL;
+   loadscreen_update( ++stage / LOADING_STAGES, _( ls->msg ) );
+   return stage;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Ships…" ) );
-   ships_load(); /* dep for fleet */
+/**
+ * @brief Runs all the loading stages, respecting their dependencies.
+ *
+ * Stages that are not threaded use OpenGL or Lua, so they are run on the main
+ * thread in the order they are defined, while the threaded ones run in the
+ * threadpool as soon as their dependencies are done.
+ *
+ *    @param stage Number of stages done, used for the loadscreen.
+ *    @return Number of stages done.
+ */
+static int load_runStages( int stage )
+{
+   Job         *jobs[LOAD_SENTINEL] = { NULL };
+   unsigned int done                = 0;
+   unsigned int started             = 0;
 
-   /* Handle dependent faction/outfit stuff. */
-   outfit_loadPost();
+   while ( done != LOAD_DEP( LOAD_SENTINEL ) - 1 ) {
+      int ran = 0;
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading AI…" ) );
-   ai_load(); /* dep for fleets */
+      /* Check for finished threaded stages. Waiting on them releases the
+       * handles. */
+      for ( int i = 0; i < LOAD_SENTINEL; i++ ) {
+         if ( ( jobs[i] == NULL ) || !job_finished( jobs[i] ) )
+            continue;
+         stage = load_stageJoin( &jobs[i], &load_stages[i], stage );
+         done |= LOAD_DEP( i );
+      }
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Techs…" ) );
-   tech_load(); /* dep for space */
+      /* Start the threaded stages that are ready. */
+      for ( int i = 0; i < LOAD_SENTINEL; i++ ) {
+         const LoadStage *ls = &load_stages[i];
+         if ( !ls->threaded || ( started & LOAD_DEP( i ) ) ||
+              ( ls->deps & ~done ) )
+            continue;
+         started |= LOAD_DEP( i );
+         jobs[i] = job_create( load_stageThread, (void *)ls, NULL );
+         job_run( jobs[i] );
+      }
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading the Universe…" ) );
-   space_load(); /* dep for events/missions */
+      /* Run the first main thread stage that is ready. */
+      for ( int i = 0; i < LOAD_SENTINEL; i++ ) {
+         const LoadStage *ls = &load_stages[i];
+         if ( ls->threaded || ( started & LOAD_DEP( i ) ) ||
+              ( ls->deps & ~done ) )
+            continue;
+         started |= LOAD_DEP( i );
+         loadscreen_update( ++stage / LOADING_STAGES, _( ls->msg ) );
+         load_stageRun( i );
+         done |= LOAD_DEP( i );
+         ran = 1;
+         break;
+      }
+      if ( ran )
+         continue;
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Events…" ) );
-   events_load();
+      /* Nothing to do on the main thread, so help out the threadpool until a
+       * threaded stage is done. */
+      for ( int i = 0; i < LOAD_SENTINEL; i++ ) {
+         if ( jobs[i] == NULL )
+            continue;
+         stage = load_stageJoin( &jobs[i], &load_stages[i], stage );
+         done |= LOAD_DEP( i );
+         break;
+      }
+   }
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Missions…" ) );
-   missions_load();
+   /* Timing information. */
+   if ( conf.devmode )
+      for ( int i = 0; i < LOAD_SENTINEL; i++ )
+         DEBUG( _( "Loading stage '%s' took %.3f s%s" ), load_stages[i].name,
+                load_stageTime[i],
+                load_stages[i].threaded ? _( " (threaded)" ) : "" );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading the UniDiffs…" ) );
-   diff_init();
+   return stage;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Populating Maps…" ) );
-   outfit_mapParse();
+/**
+ * @brief Loads all the data, makes main() simpler.
+ */
+void load_all( void )
+{
+   NTracingFrameMarkStart( "load_all" );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Calculating Patrols…" ) );
-   safelanes_init();
+   int stage = 0;
+   /* We can do fast stuff here. */
+   sp_load();
 
-   /* Handled at the end, deals with equip / standing scripts. */
-   factions_loadPost();
+   /* Loads all the data in the order given by their dependencies. */
+   stage = load_runStages( stage );
 
    loadscreen_update( ++stage / LOADING_STAGES, _( "Initializing Details…" ) );
 #if DEBUGGING
@@ -831,6 +1020,9 @@ void main_loop( int nested )
    /* Checks to see if we want to land. */
    space_checkLand();
 
+   /* Upload the textures that were streamed in. */
+   gl_texStreamUpdate();
+
    /*
     * Handle render.
     */
@@ -972,7 +1164,11 @@ void fps_display( double dt )
    if ( conf.fps_show ) {
       gl_print( &gl_defFontMono, x, y, &cFontWhite, "%3.2f", fps );
       y -= gl_defFontMono.h + 5.;
+      gl_print( &gl_defFontMono, x, y, &cFontWhite, _( "%u draws" ),
+                gl_drawCalls );
+      y -= gl_defFontMono.h + 5.;
    }
+   gl_drawCalls = 0;
 
    if ( ( player.p != NULL ) && !player_isFlag( PLAYER_DESTROYED ) &&
         !player_isFlag( PLAYER_CREATING ) ) {
@@ -1062,6 +1258,9 @@ void update_routine( double dt, int dohooks )
 
    double real_update = dt / dt_mod;
 
+   /* Nothing from the previous update can be using the frame arena. */
+   arena_frameReset();
+
    if ( dohooks ) {
       hook_exclusionStart();
 
@@ -1078,8 +1277,10 @@ void update_routine( double dt, int dohooks )
    spfx_update( dt, real_update );
 
    if ( dt > 0. ) {
-      /* First compute weapon collisions. */
-      weapons_updateCollide( dt );
+      /* First compute weapon collisions, skipped while warming up a system as
+       * nobody can see them. */
+      if ( !space_isWarmup() )
+         weapons_updateCollide( dt );
       pilots_update( dt );
       weapons_update( dt ); /* Has weapons think and update positions. */
 
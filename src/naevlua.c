@@ -300,5 +300,6 @@ int main( int argc, char **argv )
       return -1;
    }
    unload_all();
+   threadpool_exit();
    return 0;
 }
@@ -0,0 +1,215 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file nameindex.c
+ *
+ * @brief Hash index to look up things by name.
+ *
+ * Used by the getters of the different stacks (systems, spobs, outfits, ships,
+ * etc.) so that looking things up by name does not depend on the stacks being
+ * sorted.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "nameindex.h"
+
+#define NIDX_MIN_SIZE 64            /**< Minimum number of slots. */
+#define NIDX_ARENA_BLOCK ( 16 * 1024 ) /**< Block size of the name arena. */
+
+/*
+ * Prototypes.
+ */
+static int  nidx_find( const NameIndex *idx, const char *name, uint32_t hash );
+static void nidx_grow( NameIndex *idx );
+
+/**
+ * @brief Hashes a name (FNV-1a).
+ *
+ *    @param name Name to hash.
+ *    @return Hash of the name.
+ */
+uint32_t nidx_hash( const char *name )
+{
+   uint32_t h = 2166136261u;
+   for ( const unsigned char *c = (const unsigned char *)name; *c != '\0';
+         c++ ) {
+      h ^= *c;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+/**
+ * @brief Creates an empty name index.
+ */
+void nidx_create( NameIndex *idx )
+{
+   memset( idx, 0, sizeof( NameIndex ) );
+   arena_create( &idx->names, "name index", NIDX_ARENA_BLOCK );
+}
+
+/**
+ * @brief Frees a name index.
+ */
+void nidx_free( NameIndex *idx )
+{
+   free( idx->keys );
+   free( idx->hashes );
+   free( idx->values );
+   arena_destroy( &idx->names );
+   memset( idx, 0, sizeof( NameIndex ) );
+}
+
+/**
+ * @brief Removes all the names from an index, keeping the memory.
+ */
+void nidx_clear( NameIndex *idx )
+{
+   if ( idx->keys != NULL )
+      memset( idx->keys, 0, sizeof( const char * ) * idx->size );
+   idx->n = 0;
+   arena_reset( &idx->names );
+}
+
+/**
+ * @brief Finds the slot of a name.
+ *
+ *    @return The slot of the name if found, or the empty slot it would go in
+ *            otherwise.
+ */
+static int nidx_find( const NameIndex *idx, const char *name, uint32_t hash )
+{
+   int mask = idx->size - 1;
+   for ( int i = hash & mask;; i = ( i + 1 ) & mask ) {
+      if ( idx->keys[i] == NULL )
+         return i;
+      if ( ( idx->hashes[i] == hash ) && ( strcmp( idx->keys[i], name ) == 0 ) )
+         return i;
+   }
+}
+
+/**
+ * @brief Doubles the number of slots of an index.
+ */
+static void nidx_grow( NameIndex *idx )
+{
+   const char **keys   = idx->keys;
+   uint32_t    *hashes = idx->hashes;
+   int         *values = idx->values;
+   int          size   = idx->size;
+
+   idx->size   = ( size > 0 ) ? 2 * size : NIDX_MIN_SIZE;
+   idx->keys   = calloc( idx->size, sizeof( const char * ) );
+   idx->hashes = malloc( sizeof( uint32_t ) * idx->size );
+   idx->values = malloc( sizeof( int ) * idx->size );
+
+   /* Names are already interned, so just move them over. */
+   for ( int i = 0; i < size; i++ ) {
+      int j;
+      if ( keys[i] == NULL )
+         continue;
+      j              = nidx_find( idx, keys[i], hashes[i] );
+      idx->keys[j]   = keys[i];
+      idx->hashes[j] = hashes[i];
+      idx->values[j] = values[i];
+   }
+
+   free( keys );
+   free( hashes );
+   free( values );
+}
+
+/**
+ * @brief Sets the value of a name, adding it if necessary.
+ *
+ *    @param idx Index to modify.
+ *    @param name Name to set.
+ *    @param value Value to set, should not be negative.
+ */
+void nidx_set( NameIndex *idx, const char *name, int value )
+{
+   uint32_t hash = nidx_hash( name );
+   int      i;
+   size_t   len;
+   char    *key;
+
+   /* Keep the load factor under a half. */
+   if ( 2 * ( idx->n + 1 ) > idx->size )
+      nidx_grow( idx );
+
+   i = nidx_find( idx, name, hash );
+   if ( idx->keys[i] != NULL ) {
+      idx->values[i] = value;
+      return;
+   }
+
+   len = strlen( name ) + 1;
+   key = arena_alloc( &idx->names, len );
+   memcpy( key, name, len );
+   idx->keys[i]   = key;
+   idx->hashes[i] = hash;
+   idx->values[i] = value;
+   idx->n++;
+}
+
+/**
+ * @brief Gets the value of a name.
+ *
+ *    @param idx Index to look up in.
+ *    @param name Name to look up.
+ *    @return The value of the name, or -1 if not found.
+ */
+int nidx_get( const NameIndex *idx, const char *name )
+{
+   int i;
+   if ( ( idx->n == 0 ) || ( name == NULL ) )
+      return -1;
+   i = nidx_find( idx, name, nidx_hash( name ) );
+   if ( idx->keys[i] == NULL )
+      return -1;
+   return idx->values[i];
+}
+
+/**
+ * @brief Removes a name from an index.
+ *
+ *    @param idx Index to modify.
+ *    @param name Name to remove.
+ *    @return The value the name had, or -1 if not found.
+ */
+int nidx_remove( NameIndex *idx, const char *name )
+{
+   int mask, i, value;
+
+   if ( idx->n == 0 )
+      return -1;
+   mask = idx->size - 1;
+   i    = nidx_find( idx, name, nidx_hash( name ) );
+   if ( idx->keys[i] == NULL )
+      return -1;
+   value = idx->values[i];
+
+   /* Shift back the following names so probing doesn't stop early. The
+    * interned name stays in the arena until the index is cleared. */
+   for ( int j = ( i + 1 ) & mask; idx->keys[j] != NULL;
+         j = ( j + 1 ) & mask ) {
+      int home = idx->hashes[j] & mask;
+      /* Skip names whose home slot is cyclically in (i,j]. */
+      if ( ( i <= j ) ? ( ( i < home ) && ( home <= j ) )
+                      : ( ( i < home ) || ( home <= j ) ) )
+         continue;
+      idx->keys[i]   = idx->keys[j];
+      idx->hashes[i] = idx->hashes[j];
+      idx->values[i] = idx->values[j];
+      i              = j;
+   }
+   idx->keys[i] = NULL;
+   idx->n--;
+   return value;
+}
@@ -0,0 +1,33 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
+#include "arena.h"
+
+/**
+ * @brief Hash table mapping names to integer values, usually stack indices.
+ *
+ * Uses open addressing with linear probing. Names are copied into the index,
+ * so they do not have to outlive it.
+ */
+typedef struct NameIndex_ {
+   const char **keys;   /**< Interned names, NULL for empty slots. */
+   uint32_t    *hashes; /**< Precomputed hashes of the names. */
+   int         *values; /**< Values associated with the names. */
+   int          size;   /**< Number of slots, always a power of two. */
+   int          n;      /**< Number of names in the index. */
+   Arena        names;  /**< Memory of the interned names. */
+} NameIndex;
+
+uint32_t nidx_hash( const char *name );
+void     nidx_create( NameIndex *idx );
+void     nidx_free( NameIndex *idx );
+void     nidx_clear( NameIndex *idx );
+void     nidx_set( NameIndex *idx, const char *name, int value );
+int      nidx_get( const NameIndex *idx, const char *name );
+int      nidx_remove( NameIndex *idx, const char *name );
@@ -181,7 +181,7 @@ static void nebu_renderBackground( const double dt )
    glEnableVertexAttribArray( shaders.nebula_background.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_background.vertex,
                                0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    nebu_blitFBO();
 
    /* Clean up. */
@@ -287,7 +287,7 @@ void nebu_renderOverlay( const double dt )
    glEnableVertexAttribArray( shaders.nebula.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula.vertex, 0, 2,
                                GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    nebu_blitFBO();
 
    /* Clean up. */
@@ -347,7 +347,7 @@ static void nebu_renderPuffs( int below_player )
       glUniform1f( shaders.nebula_puff.time, nebu_time / 1.5 );
       glUniform2f( shaders.nebula_puff.r, puff->rx, puff->ry );
 
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       glDisableVertexAttribArray( shaders.nebula_puff.vertex );
       glUseProgram( 0 );
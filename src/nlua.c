@@ -9,6 +9,11 @@
 
 /** @cond */
 #include "physfs.h"
+#if HAVE_LUAJIT
+#include <luajit.h>
+#endif /* HAVE_LUAJIT */
+
+#include "SDL_timer.h"
 
 #include "naev.h"
 /** @endcond */
@@ -24,7 +29,9 @@
 #include "lua_enet.h"
 #include "lutf8lib.h"
 #include "lyaml.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "nlua_audio.h"
 #include "nlua_cli.h"
 #include "nlua_commodity.h"
@@ -39,6 +46,7 @@
 #include "nlua_outfit.h"
 #include "nlua_pilot.h"
 #include "nlua_player.h"
+#include "nlua_prof.h"
 #include "nlua_rnd.h"
 #include "nlua_safelanes.h"
 #include "nlua_shiplog.h"
@@ -50,6 +58,7 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "ntracing.h"
 
 lua_State *naevL         = NULL;      /**< Global Naev Lua state. */
 nlua_env   __NLUA_CURENV = LUA_NOREF; /**< Current environment. */
@@ -67,6 +76,49 @@ typedef struct LuaCache_ {
 } LuaCache_t;
 static LuaCache_t *lua_cache = NULL;
 
+/**
+ * @brief Prototype environment for a set of libraries.
+ */
+typedef struct LuaProto_ {
+   LuaLibsFunction loadlibs; /**< Function loading the libraries. */
+   nlua_env        env;      /**< Environment with the libraries loaded. */
+   int             naev; /**< Naev namespace the prototype was created with. */
+} LuaProto_t;
+static LuaProto_t *lua_protos = NULL; /**< Prototypes by set of libraries. */
+
+#define NLUA_BYTECODE_PATH "luac/" /**< Bytecode cache directory. */
+#define NLUA_BYTECODE_MAGIC                                                    \
+   "NLBC" /**< Magic number of the bytecode cache files. */
+#define NLUA_BYTECODE_VERSION 1 /**< Version of the bytecode cache files. */
+#define NLUA_BYTECODE_MIN                                                      \
+   256 /**< Smaller chunks are not worth caching. */
+
+/**
+ * @brief Header of the bytecode cache files, followed by the bytecode.
+ */
+typedef struct LuaBytecodeHeader_ {
+   char       magic[4];    /**< NLUA_BYTECODE_MAGIC. */
+   uint32_t   version;     /**< NLUA_BYTECODE_VERSION. */
+   char       flavour[32]; /**< Interpreter that generated the bytecode. */
+   md5_byte_t key[16];     /**< Hash of the flavour, chunk name and source. */
+   md5_byte_t sum[16];     /**< Hash of the bytecode. */
+   uint64_t   size;        /**< Size of the bytecode. */
+   double     parse_ms;    /**< Time it took to parse the source. */
+} LuaBytecodeHeader;
+
+/**
+ * @brief Statistics of the bytecode cache.
+ */
+typedef struct LuaBytecodeStats_ {
+   int    hits;     /**< Chunks loaded from the cache. */
+   int    misses;   /**< Chunks parsed and added to the cache. */
+   double parse_ms; /**< Time spent parsing sources. */
+   double load_ms;  /**< Time spent loading cached bytecode. */
+   double saved_ms; /**< Time it took to parse the cached chunks originally. */
+} LuaBytecodeStats;
+static LuaBytecodeStats lua_bcstats; /**< Bytecode cache statistics. */
+static int lua_bcstate = 0; /**< 0 unchecked, 1 usable, -1 unavailable. */
+
 /*
  * prototypes
  */
@@ -76,10 +128,19 @@ static int        nlua_package_loader_c( lua_State *L );
 static int        nlua_package_loader_croot( lua_State *L );
 static int        nlua_require( lua_State *L );
 static lua_State *nlua_newState( void ); /* creates a new state */
+static nlua_env   nlua_newEnvBase( const char *name );
+static void       nlua_runCommon( nlua_env ref );
 static int        nlua_loadBasic( lua_State *L );
 static int        luaB_loadstring( lua_State *L );
 static int        lua_cache_cmp( const void *p1, const void *p2 );
 static int        nlua_errTraceInternal( lua_State *L, int idx );
+static const char *nlua_bytecodeFlavour( void );
+static int         nlua_bytecodeLoad( lua_State *L, const char *path,
+                                      const md5_byte_t key[16], const char *name );
+static int nlua_bytecodeWriter( lua_State *L, const void *p, size_t sz,
+                                void *ud );
+static void nlua_bytecodeSave( lua_State *L, const char *path,
+                               const md5_byte_t key[16], double parse_ms );
 
 /* gettext */
 static int            nlua_gettext( lua_State *L );
@@ -213,7 +274,8 @@ void lua_init( void )
    lua_atpanic( naevL, nlua_panic );
 
    /* Initialize the caches. */
-   lua_cache = array_create( LuaCache_t );
+   lua_cache  = array_create( LuaCache_t );
+   lua_protos = array_create( LuaProto_t );
 }
 
 /**
@@ -239,9 +301,13 @@ static int luaB_loadstring( lua_State *L )
  */
 void lua_exit( void )
 {
+   nlua_profExit();
+   nlua_linoptExit();
    lua_clearCache();
    array_free( lua_cache );
    lua_cache = NULL;
+   array_free( lua_protos );
+   lua_protos = NULL;
 
    free( common_script );
    lua_close( naevL );
@@ -275,6 +341,231 @@ void lua_clearCache( void )
                   lc->idx ); /* lua_close should have taken care of this. */
    }
    array_erase( &lua_cache, array_begin( lua_cache ), array_end( lua_cache ) );
+
+   /* Prototypes get created again when needed. */
+   for ( int i = 0; i < array_size( lua_protos ); i++ ) {
+      nlua_freeEnv( lua_protos[i].env );
+      luaL_unref( naevL, LUA_REGISTRYINDEX, lua_protos[i].naev );
+   }
+   array_erase( &lua_protos, array_begin( lua_protos ),
+                array_end( lua_protos ) );
+}
+
+/**
+ * @brief Gets the name of the interpreter, as bytecode is only valid for the
+ * same one.
+ */
+static const char *nlua_bytecodeFlavour( void )
+{
+   static char flavour[32];
+   if ( flavour[0] == '\0' )
+#if HAVE_LUAJIT
+      snprintf( flavour, sizeof( flavour ), "%s/%d", LUAJIT_VERSION,
+                (int)( 8 * sizeof( void * ) ) );
+#else  /* HAVE_LUAJIT */
+      snprintf( flavour, sizeof( flavour ), "%s/%d/%d", LUA_RELEASE,
+                (int)( 8 * sizeof( void * ) ), (int)sizeof( lua_Number ) );
+#endif /* HAVE_LUAJIT */
+   return flavour;
+}
+
+/**
+ * @brief Tries to load a chunk from the bytecode cache.
+ *
+ *    @param L Lua state to load into.
+ *    @param path Path of the cache file.
+ *    @param key Hash the cache file should have.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, with the chunk on the stack.
+ */
+static int nlua_bytecodeLoad( lua_State *L, const char *path,
+                              const md5_byte_t key[16], const char *name )
+{
+   LuaBytecodeHeader hdr;
+   md5_state_t       md5;
+   md5_byte_t        sum[16];
+   size_t            size;
+   char             *data;
+   const char       *bc;
+   Uint64            t;
+
+   if ( !nfile_fileExists( path ) )
+      return -1;
+   t    = SDL_GetPerformanceCounter();
+   data = nfile_readFile( &size, path );
+   if ( data == NULL )
+      return -1;
+
+   /* Make sure the file is complete and from the same interpreter. */
+   if ( size < sizeof( LuaBytecodeHeader ) ) {
+      free( data );
+      return -1;
+   }
+   memcpy( &hdr, data, sizeof( LuaBytecodeHeader ) );
+   bc = &data[sizeof( LuaBytecodeHeader )];
+   if ( ( memcmp( hdr.magic, NLUA_BYTECODE_MAGIC, sizeof( hdr.magic ) ) !=
+          0 ) ||
+        ( hdr.version != NLUA_BYTECODE_VERSION ) ||
+        ( strncmp( hdr.flavour, nlua_bytecodeFlavour(),
+                   sizeof( hdr.flavour ) ) != 0 ) ||
+        ( memcmp( hdr.key, key, sizeof( hdr.key ) ) != 0 ) ||
+        ( hdr.size != size - sizeof( LuaBytecodeHeader ) ) ) {
+      free( data );
+      return -1;
+   }
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)bc, hdr.size );
+   md5_finish( &md5, sum );
+   if ( memcmp( sum, hdr.sum, sizeof( sum ) ) != 0 ) {
+      free( data );
+      return -1;
+   }
+
+   if ( luaL_loadbuffer( L, bc, hdr.size, name ) != 0 ) {
+      DEBUG( _( "Invalid Lua bytecode cache '%s': %s" ), path,
+             lua_tostring( L, -1 ) );
+      lua_pop( L, 1 );
+      free( data );
+      return -1;
+   }
+   free( data );
+
+   lua_bcstats.hits++;
+   lua_bcstats.saved_ms += hdr.parse_ms;
+   lua_bcstats.load_ms += 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+                          (double)SDL_GetPerformanceFrequency();
+   return 0;
+}
+
+/**
+ * @brief Appends dumped bytecode to an array.
+ */
+static int nlua_bytecodeWriter( lua_State *L, const void *p, size_t sz,
+                                void *ud )
+{
+   (void)L;
+   char **data = ud;
+   int    n    = array_size( *data );
+   array_resize( data, n + sz );
+   memcpy( &( *data )[n], p, sz );
+   return 0;
+}
+
+/**
+ * @brief Saves the chunk on the top of the stack to the bytecode cache.
+ *
+ *    @param L Lua state with the chunk.
+ *    @param path Path of the cache file.
+ *    @param key Hash of the flavour, chunk name and source.
+ *    @param parse_ms Time it took to parse the source.
+ */
+static void nlua_bytecodeSave( lua_State *L, const char *path,
+                               const md5_byte_t key[16], double parse_ms )
+{
+   LuaBytecodeHeader hdr;
+   md5_state_t       md5;
+   char             *data = array_create_size( char, 4096 );
+
+   /* Leave room for the header. */
+   array_resize( &data, sizeof( LuaBytecodeHeader ) );
+   if ( ( lua_dump( L, nlua_bytecodeWriter, &data ) != 0 ) ||
+        ( array_size( data ) == sizeof( LuaBytecodeHeader ) ) ) {
+      array_free( data );
+      return;
+   }
+
+   memset( &hdr, 0, sizeof( hdr ) );
+   memcpy( hdr.magic, NLUA_BYTECODE_MAGIC, sizeof( hdr.magic ) );
+   hdr.version = NLUA_BYTECODE_VERSION;
+   strncpy( hdr.flavour, nlua_bytecodeFlavour(), sizeof( hdr.flavour ) - 1 );
+   memcpy( hdr.key, key, sizeof( hdr.key ) );
+   hdr.size     = array_size( data ) - sizeof( LuaBytecodeHeader );
+   hdr.parse_ms = parse_ms;
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)&data[sizeof( LuaBytecodeHeader )],
+               hdr.size );
+   md5_finish( &md5, hdr.sum );
+   memcpy( data, &hdr, sizeof( hdr ) );
+
+   if ( nfile_writeFile( data, array_size( data ), path ) != 0 )
+      lua_bcstate = -1; /* Don't keep trying. */
+   array_free( data );
+}
+
+/**
+ * @brief Loads a chunk, using the bytecode cache when possible.
+ *
+ * Replacement of luaL_loadbuffer() for scripts from the data files. The cached
+ * bytecode is looked up by the hash of the source and chunk name, and is only
+ * used with the same interpreter that generated it.
+ *
+ *    @param L Lua state to load into.
+ *    @param buff Source of the chunk.
+ *    @param sz Size of the source.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, or the error of luaL_loadbuffer().
+ */
+int nlua_loadbuffer( lua_State *L, const char *buff, size_t sz,
+                     const char *name )
+{
+   md5_state_t md5;
+   md5_byte_t  key[16];
+   char        digest[33], path[PATH_MAX];
+   const char *flavour;
+   Uint64      t;
+   int         ret;
+   double      parse_ms;
+
+   /* Small or already compiled chunks are loaded directly. */
+   if ( ( sz < NLUA_BYTECODE_MIN ) || ( buff[0] == LUA_SIGNATURE[0] ) )
+      return luaL_loadbuffer( L, buff, sz, name );
+
+   if ( lua_bcstate == 0 ) {
+      char dirpath[PATH_MAX];
+      snprintf( dirpath, sizeof( dirpath ), "%s%s", nfile_cachePath(),
+                NLUA_BYTECODE_PATH );
+      lua_bcstate = ( nfile_dirMakeExist( dirpath ) == 0 ) ? 1 : -1;
+   }
+   if ( lua_bcstate < 0 )
+      return luaL_loadbuffer( L, buff, sz, name );
+
+   /* Chunk names end up in the bytecode, so they are part of the key. */
+   flavour = nlua_bytecodeFlavour();
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)flavour, strlen( flavour ) + 1 );
+   md5_append( &md5, (const md5_byte_t *)name, strlen( name ) + 1 );
+   md5_append( &md5, (const md5_byte_t *)buff, sz );
+   md5_finish( &md5, key );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &digest[i * 2], 3, "%02x", key[i] );
+   snprintf( path, sizeof( path ), "%s%s%s", nfile_cachePath(),
+             NLUA_BYTECODE_PATH, digest );
+
+   if ( nlua_bytecodeLoad( L, path, key, name ) == 0 )
+      return 0;
+
+   t        = SDL_GetPerformanceCounter();
+   ret      = luaL_loadbuffer( L, buff, sz, name );
+   parse_ms = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+              (double)SDL_GetPerformanceFrequency();
+   lua_bcstats.parse_ms += parse_ms;
+   if ( ret != 0 )
+      return ret;
+
+   lua_bcstats.misses++;
+   nlua_bytecodeSave( L, path, key, parse_ms );
+   return 0;
+}
+
+/**
+ * @brief Logs how much the bytecode cache saved so far.
+ */
+void nlua_bytecodeReport( void )
+{
+   LOG( _( "Lua bytecode cache: %d hits, %d misses, %.3f ms parsing, %.3f ms "
+           "loading bytecode, %.3f ms saved" ),
+        lua_bcstats.hits, lua_bcstats.misses, lua_bcstats.parse_ms,
+        lua_bcstats.load_ms, lua_bcstats.saved_ms - lua_bcstats.load_ms );
 }
 
 /*
@@ -296,7 +587,7 @@ int nlua_dobufenv( nlua_env env, const char *buff, size_t sz, const char *name )
    if ( conf.fpu_except )
       debug_disableFPUExcept();
 #endif /* DEBUGGING */
-   ret = luaL_loadbuffer( naevL, buff, sz, name );
+   ret = nlua_loadbuffer( naevL, buff, sz, name );
    if ( ret != 0 )
       return ret;
 #if DEBUGGING
@@ -360,6 +651,92 @@ void nlua_pushEnvTable( lua_State *L )
  * An "environment" is a table used with setfenv for sandboxing.
  */
 nlua_env nlua_newEnv( const char *name )
+{
+   nlua_env ref = nlua_newEnvBase( name );
+   nlua_runCommon( ref );
+   return ref;
+}
+
+/**
+ * @brief Creates an environment with a set of libraries, copying them from a
+ * prototype environment.
+ *
+ * The prototype is created the first time a set of libraries is used, and has
+ * the common script run and the libraries loaded. New environments get a
+ * shallow copy of it, so this is much cheaper than nlua_newEnv() followed by
+ * loading the libraries. Functions defined by the common script keep the
+ * prototype as their environment.
+ *
+ *    @param name Name of the environment.
+ *    @param loadlibs Function that loads the libraries into an environment.
+ *    @return The new environment.
+ */
+nlua_env nlua_newEnvLibs( const char *name, LuaLibsFunction loadlibs )
+{
+   const LuaProto_t *proto = NULL;
+   nlua_env          ref;
+
+   for ( int i = 0; i < array_size( lua_protos ); i++ ) {
+      if ( lua_protos[i].loadlibs == loadlibs ) {
+         proto = &lua_protos[i];
+         break;
+      }
+   }
+   if ( proto == NULL ) {
+      LuaProto_t *p = &array_grow( &lua_protos );
+      p->loadlibs   = loadlibs;
+      p->env        = nlua_newEnvBase( "prototype" );
+      nlua_getenv( naevL, p->env, "naev" );
+      p->naev = luaL_ref( naevL, LUA_REGISTRYINDEX );
+      nlua_runCommon( p->env );
+      loadlibs( p->env );
+      proto = p;
+   }
+
+   ref = nlua_newEnvBase( name );
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, ref );         /* t */
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, proto->env );  /* t, p */
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, proto->naev ); /* t, p, n */
+   lua_pushnil( naevL );                                 /* t, p, n, k */
+   while ( lua_next( naevL, -3 ) != 0 ) {                /* t, p, n, k, v */
+      /* Things referring to the environment itself stay. */
+      if ( lua_type( naevL, -2 ) == LUA_TSTRING ) {
+         const char *key = lua_tostring( naevL, -2 );
+         if ( ( strcmp( key, "_G" ) == 0 ) ||
+              ( strcmp( key, "require" ) == 0 ) ||
+              ( strcmp( key, "package" ) == 0 ) ||
+              ( strcmp( key, "__name" ) == 0 ) ||
+              ( strcmp( key, NLUA_LOAD_TABLE ) == 0 ) ) {
+            lua_pop( naevL, 1 ); /* t, p, n, k */
+            continue;
+         }
+      }
+      /* The naev namespace is per environment, unless a library replaced it.
+       */
+      if ( lua_rawequal( naevL, -1, -3 ) ) {
+         lua_pop( naevL, 1 );                   /* t, p, n, k */
+         lua_getfield( naevL, -4, "naev" );     /* t, p, n, k, tn */
+         lua_pushnil( naevL );                  /* t, p, n, k, tn, k */
+         while ( lua_next( naevL, -4 ) != 0 ) { /* t, p, n, k, tn, k, v */
+            lua_pushvalue( naevL, -2 );         /* t, p, n, k, tn, k, v, k */
+            lua_insert( naevL, -2 );            /* t, p, n, k, tn, k, k, v */
+            lua_rawset( naevL, -4 );            /* t, p, n, k, tn, k */
+         }
+         lua_pop( naevL, 1 ); /* t, p, n, k */
+         continue;
+      }
+      lua_pushvalue( naevL, -2 ); /* t, p, n, k, v, k */
+      lua_insert( naevL, -2 );    /* t, p, n, k, k, v */
+      lua_rawset( naevL, -6 );    /* t, p, n, k */
+   }
+   lua_pop( naevL, 3 ); /* */
+   return ref;
+}
+
+/**
+ * @brief Creates an environment without running the common script.
+ */
+static nlua_env nlua_newEnvBase( const char *name )
 {
    nlua_env ref;
 
@@ -425,6 +802,15 @@ nlua_env nlua_newEnv( const char *name )
    lua_newtable( naevL );             /* t, t, n */
    lua_setfield( naevL, -2, "naev" ); /* t, t */
 
+   lua_pop( naevL, 1 ); /* t */
+   return ref;
+}
+
+/**
+ * @brief Runs the common script in an environment.
+ */
+static void nlua_runCommon( nlua_env ref )
+{
    /* Run common script. */
    if ( conf.loaded && common_script == NULL ) {
       common_script = ndata_read( LUA_COMMON_PATH, &common_sz );
@@ -432,7 +818,7 @@ nlua_env nlua_newEnv( const char *name )
          WARN( _( "Unable to load common script '%s'!" ), LUA_COMMON_PATH );
    }
    if ( common_script != NULL ) {
-      if ( luaL_loadbuffer( naevL, common_script, common_sz,
+      if ( nlua_loadbuffer( naevL, common_script, common_sz,
                             LUA_COMMON_PATH ) == 0 ) {
          if ( nlua_pcall( ref, 0, 0 ) != 0 ) {
             WARN( _( "Failed to run '%s':\n%s" ), LUA_COMMON_PATH,
@@ -445,9 +831,6 @@ nlua_env nlua_newEnv( const char *name )
          lua_pop( naevL, 1 );
       }
    }
-
-   lua_pop( naevL, 1 ); /* t */
-   return ref;
 }
 
 /*
@@ -468,6 +851,10 @@ void nlua_freeEnv( nlua_env env )
    lua_rawseti( naevL, -2, env );                      /* t */
    lua_pop( naevL, 1 );                                /* */
 
+   /* The reference can get reused by another environment. */
+   if ( nlua_prof_active )
+      nlua_profFreeEnv( env );
+
    /* Unref. */
    luaL_unref( naevL, LUA_REGISTRYINDEX, env );
 }
@@ -742,7 +1129,7 @@ static int nlua_package_loader_lua( lua_State *L )
 
    /* Try to process the Lua. It will leave a function or message on the stack,
     * as required. */
-   luaL_loadbuffer( L, buf, bufsize, path_filename );
+   nlua_loadbuffer( L, buf, bufsize, path_filename );
    free( buf );
 
    /* Cache the result. */
@@ -984,7 +1371,19 @@ static int nlua_errTraceInternal( lua_State *L, int idx )
  */
 int nlua_pcall( nlua_env env, int nargs, int nresults )
 {
-   int errf, ret, prev_env;
+   int errf, ret, prev_env, prof;
+
+   NTracingZoneName( _ctx_pcall, "nlua_pcall", 1 );
+
+   /* Profile before anything gets pushed onto the stack. */
+   prof = 0;
+   if ( nlua_prof_active ) {
+      prof = nlua_profEnter( env, nargs );
+#if HAVE_TRACY
+      const char *name = nlua_profName();
+      NTracingZoneSetName( _ctx_pcall, name, strlen( name ) );
+#endif /* HAVE_TRACY */
+   }
 
 #if DEBUGGING
    errf = lua_gettop( naevL ) - nargs;
@@ -1016,6 +1415,10 @@ int nlua_pcall( nlua_env env, int nargs, int nresults )
       debug_enableFPUExcept();
 #endif /* DEBUGGING */
 
+   if ( prof )
+      nlua_profLeave( prof );
+
+   NTracingZoneEnd( _ctx_pcall );
    return ret;
 }
 
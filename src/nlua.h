@@ -29,6 +29,7 @@
    ( lua_isnoneornil( L, ind ) ? ( def ) : checkfunc( L, ind ) )
 
 typedef int       nlua_env;
+typedef int ( *LuaLibsFunction )( nlua_env env );
 extern lua_State *naevL;
 extern nlua_env   __NLUA_CURENV;
 
@@ -40,12 +41,16 @@ void     lua_exit( void );
 int      nlua_warn( lua_State *L, int idx );
 void     lua_clearCache( void );
 nlua_env nlua_newEnv( const char *name );
+nlua_env nlua_newEnvLibs( const char *name, LuaLibsFunction loadlibs );
 void     nlua_freeEnv( nlua_env env );
 void     nlua_pushenv( lua_State *L, nlua_env env );
 void     nlua_setenv( lua_State *L, nlua_env env, const char *name );
 void     nlua_getenv( lua_State *L, nlua_env env, const char *name );
 void     nlua_register( nlua_env env, const char *libname, const luaL_Reg *l,
                         int metatable );
+int      nlua_loadbuffer( lua_State *L, const char *buff, size_t sz,
+                          const char *name );
+void     nlua_bytecodeReport( void );
 int      nlua_dobufenv( nlua_env env, const char *buff, size_t sz,
                         const char *name );
 int      nlua_dofileenv( nlua_env env, const char *filename );
@@ -40,8 +40,25 @@ typedef struct LuaAudioEfx_s {
  */
 static LuaAudioEfx_t *lua_efx = NULL;
 
-static int stream_thread( void *la_data );
-static int stream_loadBuffer( LuaAudio_t *la, ALuint buffer );
+/*
+ * All the streams are fed by a single worker thread that only runs while
+ * there are streams playing. The list and the worker are protected by the
+ * sound lock.
+ */
+static LuaAudio_t **stream_list = NULL; /**< Streams being fed. */
+static LuaAudio_t  *stream_busy =
+   NULL; /**< Stream being decoded without the sound lock held. */
+static SDL_Thread *stream_worker  = NULL; /**< Stream worker thread. */
+static int         stream_running = 0;    /**< Whether the worker is running. */
+static int         stream_quit    = 0;    /**< Tells the worker to stop. */
+static SDL_cond   *stream_cond    = NULL; /**< Signals stream_busy changes. */
+
+static int  stream_thread( void *unused );
+static int  stream_update( LuaAudio_t *la );
+static void stream_start( LuaAudio_t *la );
+static void stream_stop( LuaAudio_t *la );
+static void stream_remove( LuaAudio_t *la );
+static int  stream_loadBuffer( LuaAudio_t *la, ALuint buffer );
 static int audio_genSource( ALuint *source );
 
 /* Audio methods. */
@@ -119,57 +136,172 @@ static const luaL_Reg audioL_methods[] = {
    { "soundPlay", audioL_soundPlay }, /* Old API */
    { 0, 0 } };                        /**< AudioLua methods. */
 
-static int stream_thread( void *la_data )
+/**
+ * @brief Feeds all the playing streams until there are none left.
+ */
+static int stream_thread( void *unused )
 {
-   LuaAudio_t *la = (LuaAudio_t *)la_data;
-
-   while ( 1 ) {
-      ALint  alstate;
-      ALuint removed;
-
-      soundLock();
-
-      /* Case finished. */
-      if ( la->active < 0 ) {
-         la->th = NULL;
-         SDL_CondBroadcast( la->cond );
-         alSourceStop( la->source );
-         soundUnlock();
-         return 0;
-      }
+   (void)unused;
 
-      alGetSourcei( la->source, AL_BUFFERS_PROCESSED, &alstate );
-      if ( alstate > 0 ) {
-         int ret;
-         /* Refill active buffer */
-         alSourceUnqueueBuffers( la->source, 1, &removed );
-         ret = stream_loadBuffer( la, la->stream_buffers[la->active] );
-         if ( ( la->active < 0 ) || ( ret < 0 ) ) {
-            /* stream_loadBuffer unlocks the sound lock internally, which can
-             * lead to the thread being gc'd and having active = -1. We have to
-             * add a check here to not mess around with stuff. */
-            la->th = NULL;
-            SDL_CondBroadcast( la->cond );
+   soundLock();
+   while ( ( array_size( stream_list ) > 0 ) && !stream_quit ) {
+      /* The list can change while a stream is being decoded, at worst a
+       * stream gets skipped until the next pass. */
+      for ( int i = 0; i < array_size( stream_list ); i++ ) {
+         LuaAudio_t *la = stream_list[i];
+         if ( stream_update( la ) ) {
             alSourceStop( la->source );
-            soundUnlock();
-            return 0;
-         } else {
-            alSourceQueueBuffers( la->source, 1,
-                                  &la->stream_buffers[la->active] );
-            la->active = 1 - la->active;
+            stream_remove( la );
          }
       }
       al_checkErr(); /* XXX - good or bad idea to log from the thread? */
       soundUnlock();
 
       SDL_Delay( 10 );
+
+      soundLock();
    }
+   stream_running = 0;
+   soundUnlock();
+   return 0;
 }
 
 /**
- * @brief Loads a buffer.
+ * @brief Refills the processed buffer of a stream if necessary.
  *
  * Assumes that soundLock() is set.
+ *
+ *    @return 1 if the stream is done and should no longer be fed.
+ */
+static int stream_update( LuaAudio_t *la )
+{
+   ALint  alstate;
+   ALuint removed;
+   int    ret;
+
+   /* Case finished. */
+   if ( la->active < 0 )
+      return 1;
+
+   alGetSourcei( la->source, AL_BUFFERS_PROCESSED, &alstate );
+   if ( alstate <= 0 )
+      return 0;
+
+   /* Refill active buffer. stream_loadBuffer unlocks the sound lock
+    * internally, so the stream may get stopped while it is decoding. */
+   alSourceUnqueueBuffers( la->source, 1, &removed );
+   stream_busy = la;
+   ret         = stream_loadBuffer( la, la->stream_buffers[la->active] );
+   stream_busy = NULL;
+   SDL_CondBroadcast( stream_cond );
+   if ( ( la->active < 0 ) || ( ret < 0 ) )
+      return 1;
+
+   alSourceQueueBuffers( la->source, 1, &la->stream_buffers[la->active] );
+   la->active = 1 - la->active;
+   return 0;
+}
+
+/**
+ * @brief Starts feeding a stream, starting the worker if needed.
+ *
+ * Assumes that soundLock() is set.
+ */
+static void stream_start( LuaAudio_t *la )
+{
+   if ( stream_list == NULL )
+      stream_list = array_create( LuaAudio_t * );
+   if ( stream_cond == NULL )
+      stream_cond = SDL_CreateCond();
+   array_push_back( &stream_list, la );
+   la->streaming = 1;
+
+   if ( stream_running || stream_quit )
+      return;
+
+   /* Clean up after the previous worker, it no longer needs the lock. */
+   if ( stream_worker != NULL )
+      SDL_WaitThread( stream_worker, NULL );
+   stream_worker = SDL_CreateThread( stream_thread, "stream_thread", NULL );
+   if ( stream_worker == NULL )
+      WARN( _( "Unable to create audio stream thread: %s" ), SDL_GetError() );
+   else
+      stream_running = 1;
+}
+
+/**
+ * @brief Stops the stream worker and frees the stream list.
+ *
+ * Has to be called before the sound lock and sources are destroyed.
+ */
+void audio_exit( void )
+{
+   SDL_Thread *worker;
+
+   soundLock();
+   stream_quit   = 1;
+   worker        = stream_worker;
+   stream_worker = NULL;
+   soundUnlock();
+
+   /* Can't hold the lock, as the worker needs it to stop. */
+   if ( worker != NULL )
+      SDL_WaitThread( worker, NULL );
+
+   soundLock();
+   for ( int i = 0; i < array_size( stream_list ); i++ )
+      stream_list[i]->streaming = 0;
+   array_free( stream_list );
+   stream_list    = NULL;
+   stream_running = 0;
+   stream_quit    = 0;
+   soundUnlock();
+   if ( stream_cond != NULL ) {
+      SDL_DestroyCond( stream_cond );
+      stream_cond = NULL;
+   }
+}
+
+/**
+ * @brief Stops feeding a stream, waiting for the worker to be done with it.
+ *
+ * Assumes that soundLock() is set.
+ */
+static void stream_stop( LuaAudio_t *la )
+{
+   la->active = -1;
+   while ( stream_busy == la ) {
+      if ( SDL_CondWaitTimeout( stream_cond, sound_lock, 3000 ) ==
+           SDL_MUTEX_TIMEDOUT ) {
+         WARN( _( "Timed out while waiting for audio thread of '%s' to "
+                  "finish!" ),
+               la->name );
+         break;
+      }
+   }
+   stream_remove( la );
+}
+
+/**
+ * @brief Removes a stream from the list of streams being fed.
+ *
+ * Assumes that soundLock() is set.
+ */
+static void stream_remove( LuaAudio_t *la )
+{
+   for ( int i = 0; i < array_size( stream_list ); i++ ) {
+      if ( stream_list[i] != la )
+         continue;
+      array_erase( &stream_list, &stream_list[i], &stream_list[i + 1] );
+      break;
+   }
+   la->streaming = 0;
+}
+
+/**
+ * @brief Loads a buffer.
+ *
+ * Assumes that soundLock() is set, and always returns with it set.
  */
 static int stream_loadBuffer( LuaAudio_t *la, ALuint buffer )
 {
@@ -201,26 +333,26 @@ static int stream_loadBuffer( LuaAudio_t *la, ALuint buffer )
 
       /* End of file. */
       if ( result == 0 ) {
-         if ( size == 0 ) {
-            return -2;
-         }
-         ret = 1;
+         ret = ( size == 0 ) ? -2 : 1;
          break;
       }
       /* Hole error. */
       else if ( result == OV_HOLE ) {
          WARN( _( "OGG: Vorbis hole detected in music!" ) );
-         return 0;
+         break;
       }
       /* Bad link error. */
       else if ( result == OV_EBADLINK ) {
          WARN( _( "OGG: Invalid stream section or corrupt link in music!" ) );
-         return -1;
+         ret = -1;
+         break;
       }
 
       size += result;
    }
    soundLock();
+   if ( ( ret < 0 ) || ( size == 0 ) )
+      return ( ret < 0 ) ? ret : -2;
 
    /* load the buffer up */
    alBufferData( buffer, la->format, buf, size, la->info->rate );
@@ -364,20 +496,12 @@ void audio_cleanup( LuaAudio_t *la )
 
    case LUA_AUDIO_STREAM:
       soundLock();
-      if ( la->th != NULL ) {
-         la->active = -1;
-         if ( SDL_CondWaitTimeout( la->cond, sound_lock, 3000 ) ==
-              SDL_MUTEX_TIMEDOUT )
-            WARN( _( "Timed out while waiting for audio thread of '%s' to "
-                     "finish!" ),
-                  la->name );
-      }
+      if ( la->streaming )
+         stream_stop( la );
       if ( alIsSource( la->source ) == AL_TRUE )
          alDeleteSources( 1, &la->source );
       if ( alIsBuffer( la->stream_buffers[0] ) == AL_TRUE )
          alDeleteBuffers( 2, la->stream_buffers );
-      if ( la->cond != NULL )
-         SDL_DestroyCond( la->cond );
       if ( la->lock != NULL )
          SDL_DestroyMutex( la->lock );
       ov_clear( &la->stream );
@@ -579,7 +703,6 @@ static int audioL_new( lua_State *L )
 
       la.active = 0;
       la.lock   = SDL_CreateMutex();
-      la.cond   = SDL_CreateCond();
       alGenBuffers( 2, la.stream_buffers );
       /* Buffers get queued later. */
    }
@@ -683,7 +806,7 @@ static int audioL_play( lua_State *L )
    if ( sound_disabled || la->ok )
       return 0;
 
-   if ( ( la->type == LUA_AUDIO_STREAM ) && ( la->th == NULL ) ) {
+   if ( ( la->type == LUA_AUDIO_STREAM ) && !la->streaming ) {
       int   ret = 0;
       ALint alstate;
       soundLock();
@@ -697,7 +820,7 @@ static int audioL_play( lua_State *L )
          alGetSourcei( la->source, AL_BUFFERS_QUEUED, &alstate );
       }
       if ( ret == 0 )
-         la->th = SDL_CreateThread( stream_thread, "stream_thread", la );
+         stream_start( la );
    } else
       soundLock();
    alSourcePlay( la->source );
@@ -762,16 +885,10 @@ static int audioL_stop( lua_State *L )
       break;
 
    case LUA_AUDIO_STREAM:
-      /* Kill the thread first. */
-      if ( la->th != NULL ) {
-         la->active = -1;
-         if ( SDL_CondWaitTimeout( la->cond, sound_lock, 3000 ) ==
-              SDL_MUTEX_TIMEDOUT )
-            WARN( _( "Timed out while waiting for audio thread of '%s' to "
-                     "finish!" ),
-                  la->name );
-      }
-      la->th = NULL;
+      /* Stop feeding it first. */
+      if ( la->streaming )
+         stream_stop( la );
+      la->active = 0;
 
       /* Stopping a source will make all buffers become processed. */
       alSourceStop( la->source );
@@ -46,8 +46,7 @@ typedef struct LuaAudio_s {
           rg_max_scale; /**< Replaygain maximum scale factor before clipping. */
    ALuint stream_buffers[2]; /**< Double buffering for streaming. */
    int    active;            /**< Active buffer. */
-   SDL_Thread *th;           /**< Buffering thread. */
-   SDL_cond   *cond;         /**< For message passing. */
+   int    streaming;         /**< Whether the stream worker feeds it. */
 } LuaAudio_t;
 
 /*
@@ -64,3 +63,4 @@ int         lua_isaudio( lua_State *L, int ind );
 /* Useful stuff. */
 void audio_clone( LuaAudio_t *la, const LuaAudio_t *source );
 void audio_cleanup( LuaAudio_t *la );
+void audio_exit( void );
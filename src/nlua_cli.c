@@ -12,8 +12,20 @@
 
 #include "nlua_cli.h"
 
+#include "console.h"
+#include "nlua_prof.h"
+
 /* CLI */
-static const luaL_Reg cli_methods[] = { { 0, 0 } }; /**< CLI Lua methods. */
+static int            cliL_profStart( lua_State *L );
+static int            cliL_profStop( lua_State *L );
+static int            cliL_profReport( lua_State *L );
+static int            cliL_profDump( lua_State *L );
+static const luaL_Reg cli_methods[] = {
+   { "profStart", cliL_profStart },
+   { "profStop", cliL_profStop },
+   { "profReport", cliL_profReport },
+   { "profDump", cliL_profDump },
+   { 0, 0 } }; /**< CLI Lua methods. */
 
 /**
  * @brief Loads the CLI Lua library.
@@ -26,3 +38,74 @@ int nlua_loadCLI( nlua_env env )
    nlua_register( env, "cli", cli_methods, 0 );
    return 0;
 }
+
+/**
+ * @brief Console only functionality.
+ *
+ * @luamod cli
+ */
+/**
+ * @brief Starts profiling the Lua calls, throwing away the previous profile.
+ *
+ * Time and memory allocated are attributed to each environment, function and
+ * hook stack.
+ *
+ * @luafunc profStart
+ */
+static int cliL_profStart( lua_State *L )
+{
+   (void)L;
+   nlua_profStart();
+   return 0;
+}
+
+/**
+ * @brief Stops profiling the Lua calls, keeping the profile.
+ *
+ * @luafunc profStop
+ */
+static int cliL_profStop( lua_State *L )
+{
+   (void)L;
+   nlua_profStop();
+   return 0;
+}
+
+/**
+ * @brief Prints a line of the profile report to the console.
+ */
+static void cli_profPrint( const char *line )
+{
+   cli_printCoreString( line, 1 );
+}
+
+/**
+ * @brief Prints what took the most time since the profiler was started.
+ *
+ * @usage cli.profReport() -- Top 10 of everything
+ * @usage cli.profReport( 30 ) -- Top 30 of everything
+ *
+ *    @luatparam[opt=10] number n Number of entries to print of each kind.
+ * @luafunc profReport
+ */
+static int cliL_profReport( lua_State *L )
+{
+   int n = luaL_optinteger( L, 1, 10 );
+   nlua_profReport( n, cli_profPrint );
+   return 0;
+}
+
+/**
+ * @brief Writes the whole profile as CSV.
+ *
+ *    @luatparam[opt="lua_profile.csv"] string filename File to write to,
+ * relative to the write directory.
+ *    @luatreturn boolean true on success.
+ * @luafunc profDump
+ */
+static int cliL_profDump( lua_State *L )
+{
+   const char *filename = luaL_optstring( L, 1, "lua_profile.csv" );
+   lua_pushboolean( L, nlua_profDump( filename ) == 0 );
+   return 1;
+}
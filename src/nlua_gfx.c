@@ -442,7 +442,7 @@ static int gfxL_renderTexH( lua_State *L )
    gl_uniformMat4( shader->ClipSpaceFromLocal, H );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
@@ -622,7 +622,7 @@ static int gfxL_renderLinesH( lua_State *L )
    gl_uniformColour( shaders.lines.colour, c );
    gl_uniformMat4( shaders.lines.projection, H );
 
-   glDrawArrays( GL_LINE_STRIP, 0, n );
+   gl_drawArrays( GL_LINE_STRIP, 0, n );
    glUseProgram( 0 );
 
    /* Check for errors. */
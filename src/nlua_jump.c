@@ -15,6 +15,7 @@
 #include "nlua_jump.h"
 
 #include "land_outfits.h"
+#include "map.h"
 #include "map_overlay.h"
 #include "nlua_pilot.h"
 #include "nlua_system.h"
@@ -500,6 +501,8 @@ static int jumpL_setKnown( lua_State *L )
    }
 
    if ( changed ) {
+      /* Update cached distances. */
+      map_jumpDistInvalidate();
       /* Update overlay. */
       ovr_refresh();
       /* Update outfits image array - in the case it changes map owned status.
@@ -19,12 +19,21 @@
 
 #include "nlua_linopt.h"
 
+#include "array.h"
+#include "conf.h"
 #include "log.h"
+#include "md5.h"
+#include "nfile.h"
 #include "nluadef.h"
+#include "ntracing.h"
 
 #define LINOPT_MAX_TM                                                          \
    1000 /**< Maximum time to optimize (in ms). Applied to linear relaxation    \
            and MIP independently. */
+#define LINOPT_CACHE_SIZE 256 /**< Maximum number of cached solutions. */
+#define LINOPT_CACHE_PATH "linopt.cache" /**< Solution cache file. */
+#define LINOPT_CACHE_MAGIC "NLOC" /**< Magic number of the cache file. */
+#define LINOPT_CACHE_VERSION 2    /**< Version of the cache file. */
 
 /**
  * @brief Our cute little linear program wrapper.
@@ -35,6 +44,80 @@ typedef struct LuaLinOpt_s {
    glp_prob *prob;  /**< Problem structure itself. */
 } LuaLinOpt_t;
 
+/**
+ * @brief How a cached solve ended.
+ */
+typedef enum LinOptResult_ {
+   LINOPT_RESULT_OK,     /**< Solved, values are valid. */
+   LINOPT_RESULT_ERROR,  /**< The solver failed, code is the return value. */
+   LINOPT_RESULT_STATUS, /**< No solution, code is the solution status. */
+} LinOptResult;
+
+/**
+ * @brief Cached solution of a linear program.
+ *
+ * Solutions are looked up by a hash of the full problem and the solver
+ * parameters, so identical problems only get solved once.
+ */
+typedef struct LinOptCache_ {
+   md5_byte_t key[16]; /**< Hash of the problem and parameters. */
+   uint64_t   used;    /**< Last time it was used, for eviction. */
+   int32_t    result;  /**< LinOptResult of the solve. */
+   int32_t    code;    /**< Solver error or status code if it failed. */
+   int32_t    ncols;   /**< Number of columns. */
+   int32_t    nrows;   /**< Number of rows. */
+   double     z;       /**< Value of the objective function. */
+   double    *vals;    /**< Values of the columns followed by the rows. */
+} LinOptCache;
+
+/**
+ * @brief Header of the solution cache file.
+ *
+ * It is followed by the entries, each with a LinOptCacheEntry followed by the
+ * values of the columns and rows.
+ */
+typedef struct LinOptCacheHeader_ {
+   char     magic[4]; /**< LINOPT_CACHE_MAGIC. */
+   uint32_t version;  /**< LINOPT_CACHE_VERSION. */
+   uint32_t n;        /**< Number of entries. */
+} LinOptCacheHeader;
+
+/**
+ * @brief Entry of the solution cache file.
+ */
+typedef struct LinOptCacheEntry_ {
+   md5_byte_t key[16]; /**< Hash of the problem and parameters. */
+   int32_t    result;  /**< LinOptResult of the solve. */
+   int32_t    code;    /**< Solver error or status code if it failed. */
+   int32_t    ncols;   /**< Number of columns. */
+   int32_t    nrows;   /**< Number of rows. */
+   double     z;       /**< Value of the objective function. */
+} LinOptCacheEntry;
+
+static LinOptCache *linopt_cache = NULL; /**< Array (array.h): Solutions. */
+
+static uint64_t     linopt_cacheTick   = 0; /**< Counter for LRU eviction. */
+static int          linopt_cacheLoaded = 0; /**< Whether the file was loaded. */
+static int          linopt_cacheDirty  = 0; /**< Has entries not in the file. */
+static unsigned int linopt_cacheHits   = 0; /**< Solves found in the cache. */
+static unsigned int linopt_cacheMisses = 0; /**< Solves not in the cache. */
+
+/* Solution cache. */
+static void         linopt_cacheKey( const LuaLinOpt_t *lp,
+                                     const glp_smcp *parm_smcp,
+                                     const glp_iocp *parm_iocp, int ismip,
+                                     md5_byte_t key[16] );
+static LinOptCache *linopt_cacheGet( const md5_byte_t key[16] );
+static LinOptCache *linopt_cacheAdd( const md5_byte_t key[16], int ncols,
+                                     int nrows );
+static void         linopt_cacheLoad( void );
+static void         linopt_cacheSave( void );
+static int          linopt_cachePush( lua_State *L, const LinOptCache *c );
+static int          linopt_solveProblem( const LuaLinOpt_t *lp, int ismip,
+                                         const glp_smcp *parm_smcp,
+                                         const glp_iocp *parm_iocp,
+                                         LinOptCache    *sol );
+
 /* Optim metatable methods. */
 static int linoptL_gc( lua_State *L );
 static int linoptL_eq( lua_State *L );
@@ -617,6 +700,385 @@ static int opt_onoff( const char *str, int def )
 }
 #undef STRCHK
 
+/**
+ * @brief Computes the key of a problem in the solution cache.
+ *
+ * Covers everything that can change the solution: the bounds, kinds and
+ * objective coefficients of the columns, the bounds and coefficients of the
+ * rows, the solver parameters including the time limits and MIP gap, and the
+ * GLPK version. Names are ignored.
+ */
+static void linopt_cacheKey( const LuaLinOpt_t *lp, const glp_smcp *parm_smcp,
+                             const glp_iocp *parm_iocp, int ismip,
+                             md5_byte_t key[16] )
+{
+   md5_state_t md5;
+   const char *version = glp_version();
+   int         ncols   = glp_get_num_cols( lp->prob );
+   int         nrows   = glp_get_num_rows( lp->prob );
+   int        *ind     = malloc( sizeof( int ) * ( ncols + 1 ) );
+   double     *val     = malloc( sizeof( double ) * ( ncols + 1 ) );
+   double      obj     = glp_get_obj_coef( lp->prob, 0 );
+   int32_t     parms[22];
+   double      gap = ismip ? parm_iocp->mip_gap : 0.;
+
+   memset( parms, 0, sizeof( parms ) );
+   parms[0] = LINOPT_CACHE_VERSION;
+   parms[1] = ismip;
+   parms[2] = glp_get_obj_dir( lp->prob );
+   parms[3] = ncols;
+   parms[4] = nrows;
+   parms[5] = parm_smcp->meth;
+   parms[6] = parm_smcp->pricing;
+   parms[7] = parm_smcp->r_test;
+   parms[8] = parm_smcp->presolve;
+   parms[9] = parm_smcp->tm_lim;
+   if ( ismip ) {
+      parms[10] = parm_iocp->br_tech;
+      parms[11] = parm_iocp->bt_tech;
+      parms[12] = parm_iocp->pp_tech;
+      parms[13] = parm_iocp->sr_heur;
+      parms[14] = parm_iocp->fp_heur;
+      parms[15] = parm_iocp->ps_heur;
+      parms[16] = parm_iocp->gmi_cuts;
+      parms[17] = parm_iocp->mir_cuts;
+      parms[18] = parm_iocp->cov_cuts;
+      parms[19] = parm_iocp->clq_cuts;
+      parms[20] = parm_iocp->presolve;
+      parms[21] = parm_iocp->tm_lim;
+   }
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)version, strlen( version ) );
+   md5_append( &md5, (const md5_byte_t *)parms, sizeof( parms ) );
+   md5_append( &md5, (const md5_byte_t *)&gap, sizeof( gap ) );
+   md5_append( &md5, (const md5_byte_t *)&obj, sizeof( obj ) );
+   for ( int i = 1; i <= ncols; i++ ) {
+      int32_t t[2] = { glp_get_col_kind( lp->prob, i ),
+                       glp_get_col_type( lp->prob, i ) };
+      double  d[3] = { glp_get_col_lb( lp->prob, i ),
+                       glp_get_col_ub( lp->prob, i ),
+                       glp_get_obj_coef( lp->prob, i ) };
+      md5_append( &md5, (const md5_byte_t *)t, sizeof( t ) );
+      md5_append( &md5, (const md5_byte_t *)d, sizeof( d ) );
+   }
+   for ( int i = 1; i <= nrows; i++ ) {
+      int32_t t[2] = { glp_get_row_type( lp->prob, i ),
+                       glp_get_mat_row( lp->prob, i, ind, val ) };
+      double  d[2] = { glp_get_row_lb( lp->prob, i ),
+                       glp_get_row_ub( lp->prob, i ) };
+      md5_append( &md5, (const md5_byte_t *)t, sizeof( t ) );
+      md5_append( &md5, (const md5_byte_t *)d, sizeof( d ) );
+      md5_append( &md5, (const md5_byte_t *)&ind[1], sizeof( int ) * t[1] );
+      md5_append( &md5, (const md5_byte_t *)&val[1], sizeof( double ) * t[1] );
+   }
+   md5_finish( &md5, key );
+
+   free( ind );
+   free( val );
+}
+
+/**
+ * @brief Looks up a solution in the cache.
+ *
+ *    @param key Key of the problem.
+ *    @return The cached solution or NULL if not found.
+ */
+static LinOptCache *linopt_cacheGet( const md5_byte_t key[16] )
+{
+   if ( !linopt_cacheLoaded )
+      linopt_cacheLoad();
+   for ( int i = 0; i < array_size( linopt_cache ); i++ ) {
+      LinOptCache *c = &linopt_cache[i];
+      if ( memcmp( c->key, key, sizeof( c->key ) ) == 0 ) {
+         c->used = ++linopt_cacheTick;
+         return c;
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Adds a solution to the cache, evicting the least recently used one if
+ * full.
+ *
+ *    @param key Key of the problem.
+ *    @param ncols Number of columns of the problem.
+ *    @param nrows Number of rows of the problem.
+ *    @return The new entry, with all the values set to zero.
+ */
+static LinOptCache *linopt_cacheAdd( const md5_byte_t key[16], int ncols,
+                                     int nrows )
+{
+   LinOptCache *c;
+
+   if ( linopt_cache == NULL )
+      linopt_cache = array_create_size( LinOptCache, LINOPT_CACHE_SIZE );
+   if ( array_size( linopt_cache ) < LINOPT_CACHE_SIZE )
+      c = &array_grow( &linopt_cache );
+   else {
+      c = &linopt_cache[0];
+      for ( int i = 1; i < array_size( linopt_cache ); i++ )
+         if ( linopt_cache[i].used < c->used )
+            c = &linopt_cache[i];
+      free( c->vals );
+   }
+
+   memset( c, 0, sizeof( LinOptCache ) );
+   memcpy( c->key, key, sizeof( c->key ) );
+   c->used           = ++linopt_cacheTick;
+   c->ncols          = ncols;
+   c->nrows          = nrows;
+   c->vals           = calloc( MAX( ncols + nrows, 1 ), sizeof( double ) );
+   linopt_cacheDirty = 1;
+   return c;
+}
+
+/**
+ * @brief Pushes a cached solution like linoptL_solve.
+ */
+static int linopt_cachePush( lua_State *L, const LinOptCache *c )
+{
+   if ( c->result != LINOPT_RESULT_OK ) {
+      lua_pushnil( L );
+      lua_pushstring( L, ( c->result == LINOPT_RESULT_ERROR )
+                            ? linopt_error( c->code )
+                            : linopt_status( c->code ) );
+      return 2;
+   }
+
+   /* Output function value. */
+   lua_pushnumber( L, c->z );
+
+   /* Column values. */
+   lua_newtable( L ); /* t */
+   for ( int i = 0; i < c->ncols; i++ ) {
+      lua_pushnumber( L, c->vals[i] ); /* t, z */
+      lua_rawseti( L, -2, i + 1 );     /* t */
+   }
+
+   /* Constraint values. */
+   lua_newtable( L ); /* t */
+   for ( int i = 0; i < c->nrows; i++ ) {
+      lua_pushnumber( L, c->vals[c->ncols + i] ); /* t, z */
+      lua_rawseti( L, -2, i + 1 );                /* t */
+   }
+   return 3;
+}
+
+/**
+ * @brief Loads the solutions saved by previous runs.
+ */
+static void linopt_cacheLoad( void )
+{
+   LinOptCacheHeader hdr;
+   char              path[PATH_MAX];
+   char             *buf;
+   size_t            size, pos;
+
+   linopt_cacheLoaded = 1;
+   if ( !conf.linopt_cache )
+      return;
+   snprintf( path, sizeof( path ), "%s%s", nfile_cachePath(),
+             LINOPT_CACHE_PATH );
+   if ( !nfile_fileExists( path ) )
+      return;
+   buf = nfile_readFile( &size, path );
+   if ( buf == NULL )
+      return;
+
+   /* Make sure it's a cache file we understand. */
+   if ( size < sizeof( LinOptCacheHeader ) ) {
+      free( buf );
+      return;
+   }
+   memcpy( &hdr, buf, sizeof( LinOptCacheHeader ) );
+   if ( ( memcmp( hdr.magic, LINOPT_CACHE_MAGIC, sizeof( hdr.magic ) ) != 0 ) ||
+        ( hdr.version != LINOPT_CACHE_VERSION ) ) {
+      free( buf );
+      return;
+   }
+
+   pos = sizeof( LinOptCacheHeader );
+   for ( uint32_t i = 0; i < MIN( hdr.n, LINOPT_CACHE_SIZE ); i++ ) {
+      LinOptCacheEntry e;
+      LinOptCache     *c;
+      size_t           nvals;
+      if ( pos + sizeof( LinOptCacheEntry ) > size ) {
+         WARN( _( "Linear optimization cache '%s' is corrupt!" ), path );
+         break;
+      }
+      memcpy( &e, &buf[pos], sizeof( LinOptCacheEntry ) );
+      pos += sizeof( LinOptCacheEntry );
+      nvals = (size_t)e.ncols + (size_t)e.nrows;
+      if ( ( e.ncols < 0 ) || ( e.nrows < 0 ) ||
+           ( pos + sizeof( double ) * nvals > size ) ) {
+         WARN( _( "Linear optimization cache '%s' is corrupt!" ), path );
+         break;
+      }
+      c         = linopt_cacheAdd( e.key, e.ncols, e.nrows );
+      c->result = e.result;
+      c->code   = e.code;
+      c->z      = e.z;
+      memcpy( c->vals, &buf[pos], sizeof( double ) * nvals );
+      pos += sizeof( double ) * nvals;
+   }
+   free( buf );
+   linopt_cacheDirty = 0;
+}
+
+/**
+ * @brief Compares cached solutions by last use for qsort.
+ */
+static int linopt_cacheCmp( const void *p1, const void *p2 )
+{
+   const LinOptCache *c1 = p1;
+   const LinOptCache *c2 = p2;
+   return ( c1->used > c2->used ) - ( c1->used < c2->used );
+}
+
+/**
+ * @brief Saves the cached solutions so later runs don't have to solve them.
+ */
+static void linopt_cacheSave( void )
+{
+   LinOptCacheHeader hdr;
+   char              path[PATH_MAX];
+   char             *buf;
+   size_t            size, pos;
+
+   if ( !conf.linopt_cache || !linopt_cacheDirty )
+      return;
+
+   /* Save from least to most recently used, so loading keeps the order. */
+   qsort( linopt_cache, array_size( linopt_cache ), sizeof( LinOptCache ),
+          linopt_cacheCmp );
+   size = sizeof( LinOptCacheHeader );
+   for ( int i = 0; i < array_size( linopt_cache ); i++ )
+      size += sizeof( LinOptCacheEntry ) +
+              sizeof( double ) *
+                 ( linopt_cache[i].ncols + linopt_cache[i].nrows );
+
+   buf = malloc( size );
+   memset( &hdr, 0, sizeof( hdr ) );
+   memcpy( hdr.magic, LINOPT_CACHE_MAGIC, sizeof( hdr.magic ) );
+   hdr.version = LINOPT_CACHE_VERSION;
+   hdr.n       = array_size( linopt_cache );
+   memcpy( buf, &hdr, sizeof( LinOptCacheHeader ) );
+   pos = sizeof( LinOptCacheHeader );
+   for ( int i = 0; i < array_size( linopt_cache ); i++ ) {
+      const LinOptCache *c = &linopt_cache[i];
+      LinOptCacheEntry   e;
+      size_t             nvals = c->ncols + c->nrows;
+      memset( &e, 0, sizeof( e ) );
+      memcpy( e.key, c->key, sizeof( e.key ) );
+      e.result = c->result;
+      e.code   = c->code;
+      e.ncols  = c->ncols;
+      e.nrows  = c->nrows;
+      e.z      = c->z;
+      memcpy( &buf[pos], &e, sizeof( LinOptCacheEntry ) );
+      pos += sizeof( LinOptCacheEntry );
+      memcpy( &buf[pos], c->vals, sizeof( double ) * nvals );
+      pos += sizeof( double ) * nvals;
+   }
+
+   snprintf( path, sizeof( path ), "%s%s", nfile_cachePath(),
+             LINOPT_CACHE_PATH );
+   if ( ( nfile_dirMakeExist( nfile_cachePath() ) != 0 ) ||
+        ( nfile_writeFile( buf, size, path ) != 0 ) )
+      WARN( _( "Unable to save linear optimization cache '%s'!" ), path );
+   free( buf );
+   linopt_cacheDirty = 0;
+}
+
+/**
+ * @brief Saves and frees the linear optimization solution cache.
+ */
+void nlua_linoptExit( void )
+{
+   if ( linopt_cacheHits + linopt_cacheMisses > 0 )
+      DEBUG( _( "Linear optimization cache: %u hits, %u misses" ),
+             linopt_cacheHits, linopt_cacheMisses );
+   linopt_cacheSave();
+   for ( int i = 0; i < array_size( linopt_cache ); i++ )
+      free( linopt_cache[i].vals );
+   array_free( linopt_cache );
+   linopt_cache       = NULL;
+   linopt_cacheLoaded = 0;
+}
+
+/**
+ * @brief Runs the solver on a problem.
+ *
+ *    @param lp Problem to solve.
+ *    @param ismip Whether the problem has integer columns.
+ *    @param parm_smcp Parameters of the simplex.
+ *    @param parm_iocp Parameters of the integer optimizer.
+ *    @param[out] sol Result of the solve, with the values already allocated.
+ *    @return 1 if the solution is optimal and can be cached, 0 otherwise.
+ */
+static int linopt_solveProblem( const LuaLinOpt_t *lp, int ismip,
+                                const glp_smcp *parm_smcp,
+                                const glp_iocp *parm_iocp, LinOptCache *sol )
+{
+   int ret;
+   int timeout = 0;
+
+   if ( !ismip || !parm_iocp->presolve ) {
+      ret = glp_simplex( lp->prob, parm_smcp );
+      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
+         sol->result = LINOPT_RESULT_ERROR;
+         sol->code   = ret;
+         return 0;
+      }
+      timeout = ( ret == GLP_ETMLIM );
+      /* Check for optimality of continuous problem. */
+      ret = glp_get_status( lp->prob );
+      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
+         sol->result = LINOPT_RESULT_STATUS;
+         sol->code   = ret;
+         return 0;
+      }
+   }
+   if ( ismip ) {
+      ret = glp_intopt( lp->prob, parm_iocp );
+      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
+         sol->result = LINOPT_RESULT_ERROR;
+         sol->code   = ret;
+         return 0;
+      }
+      timeout |= ( ret == GLP_ETMLIM );
+      /* Check for optimality of discrete problem. */
+      ret = glp_mip_status( lp->prob );
+      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
+         sol->result = LINOPT_RESULT_STATUS;
+         sol->code   = ret;
+         return 0;
+      }
+   }
+   sol->result = LINOPT_RESULT_OK;
+   sol->z      = glp_get_obj_val( lp->prob );
+
+   /* Go over variables and store them. */
+   for ( int i = 1; i <= lp->ncols; i++ ) {
+      if ( ismip )
+         sol->vals[i - 1] = glp_mip_col_val( lp->prob, i );
+      else
+         sol->vals[i - 1] = glp_get_col_prim( lp->prob, i );
+   }
+
+   /* Go over constraints and store them. */
+   for ( int i = 1; i <= lp->nrows; i++ ) {
+      if ( ismip )
+         sol->vals[lp->ncols + i - 1] = glp_mip_row_val( lp->prob, i );
+      else
+         sol->vals[lp->ncols + i - 1] = glp_get_row_prim( lp->prob, i );
+   }
+
+   return !timeout && ( ret == GLP_OPT );
+}
+
 #define GETOPT_IOCP( name, func, def )                                         \
    do {                                                                        \
       lua_getfield( L, 2, #name );                                             \
@@ -632,6 +1094,9 @@ static int opt_onoff( const char *str, int def )
 /**
  * @brief Solves the linear optimization problem.
  *
+ * Solutions are cached by the contents of the problem and the parameters, so
+ * solving an identical problem again does not run the solver.
+ *
  *    @luatparam LinOpt lp Linear program to modify.
  *    @luatreturn number The value of the primal funcation.
  *    @luatreturn table Table of column values.
@@ -640,10 +1105,12 @@ static int opt_onoff( const char *str, int def )
 static int linoptL_solve( lua_State *L )
 {
    LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
-   double       z;
-   int          ret, ismip;
+   int          ret, ismip, cacheable;
    glp_iocp     parm_iocp;
    glp_smcp     parm_smcp;
+   md5_byte_t   key[16];
+   LinOptCache *c;
+   LinOptCache  sol;
 #if DEBUGGING
    Uint64 starttime = SDL_GetTicks64();
 #endif /* DEBUGGING */
@@ -699,63 +1166,30 @@ static int linoptL_solve( lua_State *L )
    }
 #endif
 
-   /* Optimization. */
-   if ( !ismip || !parm_iocp.presolve ) {
-      ret = glp_simplex( lp->prob, &parm_smcp );
-      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_error( ret ) );
-         return 2;
-      }
-      /* Check for optimality of continuous problem. */
-      ret = glp_get_status( lp->prob );
-      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_status( ret ) );
-         return 2;
-      }
-   }
-   if ( ismip ) {
-      ret = glp_intopt( lp->prob, &parm_iocp );
-      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_error( ret ) );
-         return 2;
-      }
-      /* Check for optimality of discrete problem. */
-      ret = glp_mip_status( lp->prob );
-      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_status( ret ) );
-         return 2;
-      }
-   }
-   z = glp_get_obj_val( lp->prob );
-
-   /* Output function value. */
-   lua_pushnumber( L, z );
-
-   /* Go over variables and store them. */
-   lua_newtable( L ); /* t */
-   for ( int i = 1; i <= lp->ncols; i++ ) {
-      if ( ismip )
-         z = glp_mip_col_val( lp->prob, i );
-      else
-         z = glp_get_col_prim( lp->prob, i );
-      lua_pushnumber( L, z );  /* t, z */
-      lua_rawseti( L, -2, i ); /* t */
+   /* Identical problems are only solved once. */
+   linopt_cacheKey( lp, &parm_smcp, &parm_iocp, ismip, key );
+   c = linopt_cacheGet( key );
+   if ( c != NULL ) {
+      linopt_cacheHits++;
+      NTracingPlotI( "linopt: cache hits", linopt_cacheHits );
+      return linopt_cachePush( L, c );
    }
+   linopt_cacheMisses++;
+   NTracingPlotI( "linopt: cache misses", linopt_cacheMisses );
 
-   /* Go over constraints and store them. */
-   lua_newtable( L ); /* t */
-   for ( int i = 1; i <= lp->nrows; i++ ) {
-      if ( ismip )
-         z = glp_mip_row_val( lp->prob, i );
-      else
-         z = glp_get_row_prim( lp->prob, i );
-      lua_pushnumber( L, z );  /* t, z */
-      lua_rawseti( L, -2, i ); /* t */
+   /* Only proper solutions are cached, as time limits depend on the machine. */
+   memset( &sol, 0, sizeof( sol ) );
+   sol.ncols = lp->ncols;
+   sol.nrows = lp->nrows;
+   sol.vals  = calloc( MAX( lp->ncols + lp->nrows, 1 ), sizeof( double ) );
+   cacheable = linopt_solveProblem( lp, ismip, &parm_smcp, &parm_iocp, &sol );
+   ret       = linopt_cachePush( L, &sol );
+   if ( cacheable ) {
+      c    = linopt_cacheAdd( key, lp->ncols, lp->nrows );
+      c->z = sol.z;
+      memcpy( c->vals, sol.vals, sizeof( double ) * ( lp->ncols + lp->nrows ) );
    }
+   free( sol.vals );
 
    /* Complain about time. */
 #if DEBUGGING
@@ -763,7 +1197,7 @@ static int linoptL_solve( lua_State *L )
       NLUA_WARN( L, _( "glpk: too over 1 second to optimize!" ) );
 #endif /* DEBUGGING */
 
-   return 3;
+   return ret;
 }
 #undef GETOPT_IOCP
 
@@ -13,7 +13,8 @@ typedef struct LuaLinOpt_s LuaLinOpt_t;
 /*
  * Library loading
  */
-int nlua_loadLinOpt( nlua_env env );
+int  nlua_loadLinOpt( nlua_env env );
+void nlua_linoptExit( void );
 
 /* Basic operations. */
 LuaLinOpt_t *lua_tolinopt( lua_State *L, int ind );
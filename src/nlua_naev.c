@@ -18,10 +18,13 @@
 #include "nlua_naev.h"
 
 #include "array.h"
+#include "commodity.h"
+#include "conf.h"
 #include "console.h"
 #include "debug.h"
 #include "difficulty.h"
 #include "event.h"
+#include "faction.h"
 #include "hook.h"
 #include "info.h"
 #include "input.h"
@@ -30,10 +33,17 @@
 #include "nlua_misn.h"
 #include "nlua_system.h"
 #include "nluadef.h"
+#include "outfit.h"
 #include "pause.h"
 #include "player.h"
 #include "plugin.h"
+#include "safelanes.h"
 #include "semver.h"
+#include "ship.h"
+#include "sound.h"
+#include "space.h"
+#include "threadpool.h"
+#include "weapon.h"
 
 static int cache_table = LUA_NOREF; /* No reference. */
 
@@ -79,6 +89,14 @@ static int naevL_difficulty( lua_State *L );
 static int naevL_envs( lua_State *L );
 static int naevL_debugTrails( lua_State *L );
 static int naevL_debugCollisions( lua_State *L );
+static int naevL_debugJobs( lua_State *L );
+static int naevL_debugLookup( lua_State *L );
+static int naevL_debugPolygons( lua_State *L );
+static int naevL_debugQuadtree( lua_State *L );
+static int naevL_debugSafelanes( lua_State *L );
+static int naevL_debugNewEnv( lua_State *L );
+static int naevL_debugJump( lua_State *L );
+static int naevL_debugSound( lua_State *L );
 #endif /* DEBUGGING */
 
 static const luaL_Reg naev_methods[] = {
@@ -123,6 +141,14 @@ static const luaL_Reg naev_methods[] = {
    { "envs", naevL_envs },
    { "debugTrails", naevL_debugTrails },
    { "debugCollisions", naevL_debugCollisions },
+   { "debugJobs", naevL_debugJobs },
+   { "debugLookup", naevL_debugLookup },
+   { "debugPolygons", naevL_debugPolygons },
+   { "debugQuadtree", naevL_debugQuadtree },
+   { "debugSafelanes", naevL_debugSafelanes },
+   { "debugNewEnv", naevL_debugNewEnv },
+   { "debugJump", naevL_debugJump },
+   { "debugSound", naevL_debugSound },
 #endif         /* DEBUGGING */
    { 0, 0 } }; /**< Naev Lua methods. */
 
@@ -1081,4 +1107,345 @@ static int naevL_debugCollisions( lua_State *L )
       debug_rmFlag( DEBUG_MARK_COLLISION );
    return 0;
 }
+
+/**
+ * @brief Benchmarks the threadpool dispatch overhead, logging the results.
+ *
+ * @usage naev.debugJobs() -- Runs with the default number of jobs.
+ *
+ *    @luatparam[opt=100000] number n Number of jobs to run.
+ * @luafunc debugJobs
+ */
+static int naevL_debugJobs( lua_State *L )
+{
+   int n = luaL_optinteger( L, 1, 100000 );
+   threadpool_benchmark( n );
+   return 0;
+}
+
+/**
+ * @brief Times looking up names with a getter and logs the result.
+ */
+static void naevL_debugLookupLog( const char *name, const char **names, int n,
+                                  const void *( *get )( const char * ) )
+{
+   Uint64 t;
+   double ms;
+   int    nfound = 0;
+
+   if ( array_size( names ) == 0 )
+      return;
+   t = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ )
+      nfound += ( get( names[i % array_size( names )] ) != NULL );
+   t  = SDL_GetPerformanceCounter() - t;
+   ms = 1000. * (double)t / (double)SDL_GetPerformanceFrequency();
+   LOG( _( "   %s: %.3f ms (%.1f ns per lookup)" ), name, ms,
+        1e6 * ms / (double)n );
+   if ( nfound != n )
+      WARN( _( "Lookup benchmark '%s' found %d names instead of %d!" ), name,
+            nfound, n );
+}
+static const void *naevL_debugGetSystem( const char *name )
+{
+   return system_get( name );
+}
+static const void *naevL_debugGetSpob( const char *name )
+{
+   return spob_get( name );
+}
+static const void *naevL_debugGetOutfit( const char *name )
+{
+   return outfit_get( name );
+}
+static const void *naevL_debugGetShip( const char *name )
+{
+   return ship_get( name );
+}
+static const void *naevL_debugGetCommodity( const char *name )
+{
+   return commodity_get( name );
+}
+static const void *naevL_debugGetFaction( const char *name )
+{
+   /* Offset by one so the first faction is not NULL. */
+   return (const void *)(intptr_t)( faction_get( name ) + 1 );
+}
+
+/**
+ * @brief Benchmarks looking up systems, spobs, outfits, ships, commodities
+ * and factions by name, logging the results.
+ *
+ * @usage naev.debugLookup() -- Runs with the default number of lookups.
+ *
+ *    @luatparam[opt=100000] number n Number of lookups to do per type.
+ * @luafunc debugLookup
+ */
+static int naevL_debugLookup( lua_State *L )
+{
+   int          n     = MAX( luaL_optinteger( L, 1, 100000 ), 1 );
+   const char **names = array_create( const char * );
+   int         *factions;
+
+   LOG( _( "Name lookup benchmark with %d lookups:" ), n );
+
+   for ( int i = 0; i < array_size( system_getAll() ); i++ )
+      array_push_back( &names, system_getAll()[i].name );
+   naevL_debugLookupLog( "system_get", names, n, naevL_debugGetSystem );
+
+   array_resize( &names, 0 );
+   for ( int i = 0; i < array_size( spob_getAll() ); i++ )
+      array_push_back( &names, spob_getAll()[i].name );
+   naevL_debugLookupLog( "spob_get", names, n, naevL_debugGetSpob );
+
+   array_resize( &names, 0 );
+   for ( int i = 0; i < array_size( outfit_getAll() ); i++ )
+      array_push_back( &names, outfit_getAll()[i].name );
+   naevL_debugLookupLog( "outfit_get", names, n, naevL_debugGetOutfit );
+
+   array_resize( &names, 0 );
+   for ( int i = 0; i < array_size( ship_getAll() ); i++ )
+      array_push_back( &names, ship_getAll()[i].name );
+   naevL_debugLookupLog( "ship_get", names, n, naevL_debugGetShip );
+
+   array_resize( &names, 0 );
+   for ( int i = 0; i < array_size( commodity_getAll() ); i++ )
+      array_push_back( &names, commodity_getAll()[i].name );
+   naevL_debugLookupLog( "commodity_get", names, n, naevL_debugGetCommodity );
+
+   array_resize( &names, 0 );
+   factions = faction_getAll();
+   for ( int i = 0; i < array_size( factions ); i++ )
+      array_push_back( &names, faction_name( factions[i] ) );
+   array_free( factions );
+   naevL_debugLookupLog( "faction_get", names, n, naevL_debugGetFaction );
+
+   array_free( names );
+   return 0;
+}
+
+/**
+ * @brief Benchmarks the collision tests with the ship polygons, logging the
+ * results.
+ *
+ * @usage naev.debugPolygons() -- Runs with the default number of tests.
+ *
+ *    @luatparam[opt=100000] number n Number of tests to do of each kind.
+ * @luafunc debugPolygons
+ */
+static int naevL_debugPolygons( lua_State *L )
+{
+   int              n     = MAX( luaL_optinteger( L, 1, 100000 ), 1 );
+   const CollPoly **polys = array_create( const CollPoly * );
+   const Ship      *ships = ship_getAll();
+
+   for ( int i = 0; i < array_size( ships ); i++ ) {
+      const CollPoly *poly = &ships[i].polygon;
+      if ( ( array_size( poly->views ) > 0 ) && ( poly->views[0].npt >= 3 ) )
+         array_push_back( &polys, poly );
+   }
+   poly_benchmark( polys, array_size( polys ), n );
+
+   array_free( polys );
+   return 0;
+}
+
+/**
+ * @brief Benchmarks rebuilding the weapon quadtree every frame against
+ * updating it in place, logging the results.
+ *
+ * Replays the weapons currently in the system, padded with synthetic bolts
+ * fired between the pilots.
+ *
+ * @usage naev.debugQuadtree() -- Runs with the default number of weapons.
+ *
+ *    @luatparam[opt=5000] number n Number of weapons to simulate.
+ *    @luatparam[opt=600] number frames Number of frames to simulate.
+ * @luafunc debugQuadtree
+ */
+static int naevL_debugQuadtree( lua_State *L )
+{
+   int n      = MAX( luaL_optinteger( L, 1, 5000 ), 1 );
+   int frames = MAX( luaL_optinteger( L, 2, 600 ), 1 );
+   weapons_benchmarkQuadtree( n, frames );
+   return 0;
+}
+
+/**
+ * @brief Benchmarks a full computation of the safe lanes against incremental
+ * ones, logging the results.
+ *
+ * @usage naev.debugSafelanes()
+ *
+ * @luafunc debugSafelanes
+ */
+static int naevL_debugSafelanes( lua_State *L )
+{
+   (void)L;
+   safelanes_benchmark();
+   return 0;
+}
+
+/**
+ * @brief Benchmarks creating mission environments, as done when rolling the
+ * missions at landing, logging the results.
+ *
+ * Compares loading the libraries into a new environment with copying them
+ * from a prototype environment.
+ *
+ * @usage naev.debugNewEnv() -- Creates the default number of environments.
+ *
+ *    @luatparam[opt=1000] number n Number of environments to create each way.
+ * @luafunc debugNewEnv
+ */
+static int naevL_debugNewEnv( lua_State *L )
+{
+   int       n    = MAX( luaL_optinteger( L, 1, 1000 ), 1 );
+   nlua_env *envs = malloc( n * sizeof( nlua_env ) );
+   Uint64    t;
+   double    dt_new, dt_proto;
+
+   /* Make sure the prototype exists so both ways are timed the same. */
+   nlua_freeEnv( nlua_newEnvLibs( "benchmark", misn_loadLibs ) );
+
+   t = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ ) {
+      envs[i] = nlua_newEnv( "benchmark" );
+      misn_loadLibs( envs[i] );
+   }
+   dt_new = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+            (double)SDL_GetPerformanceFrequency();
+   for ( int i = 0; i < n; i++ )
+      nlua_freeEnv( envs[i] );
+
+   t = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < n; i++ )
+      envs[i] = nlua_newEnvLibs( "benchmark", misn_loadLibs );
+   dt_proto = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+              (double)SDL_GetPerformanceFrequency();
+   for ( int i = 0; i < n; i++ )
+      nlua_freeEnv( envs[i] );
+   free( envs );
+
+   LOG( _( "Mission environment creation (%d environments):" ), n );
+   LOG( _( "   loading libraries: %.3f ms (%.3f us each)" ), dt_new,
+        1000. * dt_new / n );
+   LOG( _( "   from prototype:    %.3f ms (%.3f us each)" ), dt_proto,
+        1000. * dt_proto / n );
+   return 0;
+}
+
+static const char *naevL_debugJumpSystems[] = {
+   "Alteris", "Churchill", "Delta Pavonis", "Doranthex", "Gamma Polaris",
+   "Qex",     "Raelid",    "Suna",          NULL,
+}; /**< Busy systems to benchmark entering by default. */
+
+/**
+ * @brief Times entering a system.
+ */
+static double naevL_debugJumpTime( const char *sysname, int fast )
+{
+   Uint64 t;
+   conf.fast_warmup = fast;
+   t                = SDL_GetPerformanceCounter();
+   space_init( sysname, 1 );
+   return 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+          (double)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Benchmarks entering busy systems with the full and the fast warm-up
+ * simulations, logging the results.
+ *
+ * The order of the full and fast entries alternates between systems so that
+ * neither always benefits from the caches warmed up by the other.
+ *
+ * The player ends up back in the starting system, but all the pilots that are
+ * not persistent are lost.
+ *
+ * @usage naev.debugJump() -- Uses the default systems.
+ * @usage naev.debugJump{ "Alteris", "Suna" } -- Uses two systems.
+ *
+ *    @luatparam[opt] {string,...} systems Names of the systems to enter.
+ * @luafunc debugJump
+ */
+static int naevL_debugJump( lua_State *L )
+{
+   const char **names;
+   const char  *orig;
+   int          fast = conf.fast_warmup;
+   double       total_full, total_fast;
+
+   if ( ( player.p == NULL ) || landed || ( cur_system == NULL ) )
+      return NLUA_ERROR( L, _( "The player has to be in space!" ) );
+   orig = cur_system->name;
+
+   /* Check the arguments before allocating, as errors don't return. */
+   if ( lua_istable( L, 1 ) ) {
+      for ( int i = 1; i <= (int)lua_objlen( L, 1 ); i++ ) {
+         lua_rawgeti( L, 1, i );
+         luaL_checkstring( L, -1 );
+         lua_pop( L, 1 );
+      }
+   }
+
+   names = array_create( const char * );
+   if ( lua_istable( L, 1 ) ) {
+      for ( int i = 1; i <= (int)lua_objlen( L, 1 ); i++ ) {
+         const char *name;
+         lua_rawgeti( L, 1, i );
+         name = lua_tostring( L, -1 );
+         lua_pop( L, 1 );
+         if ( system_get( name ) != NULL )
+            array_push_back( &names, system_get( name )->name );
+         else
+            WARN( _( "System '%s' not found!" ), name );
+      }
+   } else {
+      for ( int i = 0; naevL_debugJumpSystems[i] != NULL; i++ )
+         if ( system_get( naevL_debugJumpSystems[i] ) != NULL )
+            array_push_back( &names, naevL_debugJumpSystems[i] );
+   }
+
+   LOG( _( "System entry benchmark:" ) );
+   total_full = 0.;
+   total_fast = 0.;
+   for ( int i = 0; i < array_size( names ); i++ ) {
+      double dt_full, dt_fast;
+      if ( i % 2 == 0 ) {
+         dt_full = naevL_debugJumpTime( names[i], 0 );
+         dt_fast = naevL_debugJumpTime( names[i], 1 );
+      } else {
+         dt_fast = naevL_debugJumpTime( names[i], 1 );
+         dt_full = naevL_debugJumpTime( names[i], 0 );
+      }
+      LOG( _( "   %s: %.1f ms full, %.1f ms fast" ), names[i], dt_full,
+           dt_fast );
+      total_full += dt_full;
+      total_fast += dt_fast;
+   }
+   if ( array_size( names ) > 0 )
+      LOG( _( "   average: %.1f ms full, %.1f ms fast" ),
+           total_full / array_size( names ), total_fast / array_size( names ) );
+   array_free( names );
+
+   /* Go back home. */
+   conf.fast_warmup = fast;
+   space_init( orig, 1 );
+   return 0;
+}
+
+/**
+ * @brief Logs the statistics of the sound effect cache.
+ *
+ * @usage naev.debugSound()
+ *
+ * @luafunc debugSound
+ */
+static int naevL_debugSound( lua_State *L )
+{
+   (void)L;
+   sound_debugStats();
+   return 0;
+}
 #endif /* DEBUGGING */
@@ -15,6 +15,7 @@
 #include "nlua_pilot.h"
 
 #include "ai.h"
+#include "arena.h"
 #include "array.h"
 #include "camera.h"
 #include "damagetype.h"
@@ -1199,15 +1200,18 @@ static int pilotL_getFriendOrFoe( lua_State *L, int friend )
    pilot_stack = pilot_getAll();
    lua_newtable( L );
    k = 1;
-   if ( dist >= 0. && dist < INFINITY ) {
-      int            x, y, r;
-      const IntList *qt;
-      x  = round( v->x );
-      y  = round( v->y );
-      r  = ceil( dist );
-      qt = pilot_collideQuery( x - r, y - r, x + r, y + r );
-      for ( int i = 0; i < il_size( qt ); i++ ) {
-         const Pilot *plt = pilot_stack[il_get( qt, i, 0 )];
+   if ( ( dist >= 0. && dist < INFINITY ) || ( ( p != NULL ) && inrange ) ) {
+      IntList   qt;
+      ArenaMark mark = arena_mark( arena_scratch() );
+      il_createArena( &qt, 1, mark.arena );
+      /* Without a distance, only pilots that can be detected matter. */
+      if ( dist >= 0. && dist < INFINITY )
+         pilot_queryRadius( &qt, v->x, v->y, dist, NULL );
+      else
+         pilot_queryRadius( &qt, p->solid.pos.x, p->solid.pos.y,
+                            pilot_queryDetectRange( p ), p );
+      for ( int i = 0; i < il_size( &qt ); i++ ) {
+         const Pilot *plt = pilot_stack[il_get( &qt, i, 0 )];
 
          if ( getFriendOrFoeTest( p, plt, friend, dd, inrange, dis, fighters, v,
                                   lf ) ) {
@@ -1215,6 +1219,7 @@ static int pilotL_getFriendOrFoe( lua_State *L, int friend )
             lua_rawseti( L, -2, k++ );   /* table[key] = value */
          }
       }
+      arena_release( &mark );
    } else {
       for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
          const Pilot *plt = pilot_stack[i];
@@ -1340,43 +1345,31 @@ static int pilotL_getVisible( lua_State *L )
  */
 static int pilotL_getInrange( lua_State *L )
 {
-   int            k;
-   const vec2    *v   = luaL_checkvector( L, 1 );
-   double         d   = luaL_checknumber( L, 2 );
-   int            dis = lua_toboolean( L, 3 );
-   int            x, y, r;
-   const IntList *qt;
-   Pilot *const  *pilot_stack = pilot_getAll();
-
-   d = pow2( d ); /* Square it. */
+   int           k;
+   const vec2   *v   = luaL_checkvector( L, 1 );
+   double        d   = luaL_checknumber( L, 2 );
+   int           dis = lua_toboolean( L, 3 );
+   IntList       qt;
+   Pilot *const *pilot_stack = pilot_getAll();
+   ArenaMark     mark        = arena_mark( arena_scratch() );
 
-   /* Now put all the matching pilots in a table. */
-   x  = round( v->x );
-   y  = round( v->y );
-   r  = ceil( d );
-   qt = pilot_collideQuery( x - r, y - r, x + r, y + r );
+   /* Now put all the matching pilots in a table, the query already skips
+    * dead and hidden pilots. */
+   il_createArena( &qt, 1, mark.arena );
+   pilot_queryRadius( &qt, v->x, v->y, d, NULL );
    lua_newtable( L );
    k = 1;
-   for ( int i = 0; i < il_size( qt ); i++ ) {
-      Pilot *p = pilot_stack[il_get( qt, i, 0 )];
+   for ( int i = 0; i < il_size( &qt ); i++ ) {
+      const Pilot *p = pilot_stack[il_get( &qt, i, 0 )];
 
-      /* Check if dead. */
-      if ( pilot_isFlag( p, PILOT_DELETE ) )
-         continue;
-      /* Check if hidden. */
-      if ( pilot_isFlag( p, PILOT_HIDE ) )
-         continue;
       /* Check if disabled. */
       if ( dis && pilot_isDisabled( p ) )
          continue;
 
-      /* Must be in range. */
-      if ( vec2_dist2( v, &p->solid.pos ) > d )
-         continue;
-
       lua_pushpilot( L, p->id ); /* value */
       lua_rawseti( L, -2, k++ ); /* table[key] = value */
    }
+   arena_release( &mark );
 
    return 1;
 }
@@ -6462,11 +6455,11 @@ static int pilotL_collisionTest( lua_State *L )
    if ( lua_isasteroid( L, 2 ) ) {
       Asteroid    *a = luaL_validasteroid( L, 2 );
       CollPolyView rpoly;
-      poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang );
+      ArenaMark    mark = arena_mark( arena_scratch() );
+      poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang, mark.arena );
       int ret = CollidePolygon( getCollPoly( p ), &p->solid.pos, &rpoly,
                                 &a->sol.pos, &crash );
-      free( rpoly.x );
-      free( rpoly.y );
+      arena_release( &mark );
       if ( !ret )
          return 0;
       lua_pushvector( L, crash );
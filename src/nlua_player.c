@@ -2591,6 +2591,7 @@ static int playerL_chapterSet( lua_State *L )
    const char *str = luaL_checkstring( L, 1 );
    free( player.chapter );
    player.chapter = strdup( str );
+   missions_stateChanged();
    return 0;
 }
 
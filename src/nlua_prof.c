@@ -0,0 +1,458 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file nlua_prof.c
+ *
+ * @brief Opt-in profiler of the Lua calls.
+ *
+ * While running, every call through nlua_pcall() is timed and the memory Lua
+ * allocates during it is counted. Both are attributed to the environment and
+ * the function that were called, without counting nested calls. Hook stacks
+ * are tracked as well, and get everything run from them.
+ */
+/** @cond */
+#include "physfs.h"
+
+#include "SDL_timer.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "nlua_prof.h"
+
+#include "array.h"
+#include "log.h"
+#include "nameindex.h"
+#include "nstring.h"
+
+#define PROF_MAXDEPTH 128 /**< Maximum depth of nested calls tracked. */
+
+/**
+ * @brief What a profile entry corresponds to.
+ */
+typedef enum LuaProfKind_e {
+   LUA_PROF_ENV,   /**< Lua environment. */
+   LUA_PROF_FUNC,  /**< Lua function. */
+   LUA_PROF_STACK, /**< Hook stack. */
+   LUA_PROF_KINDS, /**< Number of kinds. */
+} LuaProfKind_t;
+
+/**
+ * @brief Accumulated profile of something.
+ */
+typedef struct LuaProfEntry_ {
+   char         *name;        /**< Name of the entry. */
+   LuaProfKind_t kind;        /**< What the entry is. */
+   unsigned int  calls;       /**< Number of times it was called. */
+   double        self;        /**< Seconds not counting nested calls. */
+   double        total;       /**< Seconds including nested calls. */
+   size_t        alloc_self;  /**< Bytes allocated not counting nested calls. */
+   size_t        alloc_total; /**< Bytes allocated including nested calls. */
+} LuaProfEntry;
+
+/**
+ * @brief Call being profiled.
+ */
+typedef struct LuaProfFrame_ {
+   int    entry[2];   /**< Entries to attribute the call to, -1 if unused. */
+   Uint64 start;      /**< Counter when the call started. */
+   Uint64 child;      /**< Counter ticks spent in nested calls. */
+   size_t alloc;      /**< Bytes allocated not counting nested calls. */
+   size_t childalloc; /**< Bytes allocated in nested calls. */
+} LuaProfFrame;
+
+int nlua_prof_active = 0; /**< Whether the Lua profiler is running. */
+
+static int           prof_session = 0;    /**< Changes on every toggle. */
+static LuaProfEntry *prof_entries = NULL; /**< Profile entries. */
+static NameIndex     prof_index[LUA_PROF_KINDS]; /**< Entries by name. */
+static int          *prof_envs = NULL; /**< Entry of each environment. */
+static LuaProfFrame  prof_frames[PROF_MAXDEPTH]; /**< Calls being profiled. */
+static int           prof_depth    = 0;    /**< Number of frames. */
+static int           prof_overflow = 0;    /**< Nested calls past the max. */
+static Uint64        prof_start    = 0;    /**< Counter when started. */
+static double        prof_freq     = 1.;   /**< Counter frequency. */
+static double        prof_elapsed  = 0.;   /**< Seconds the profiler ran. */
+static lua_Alloc     prof_allocf   = NULL; /**< Original Lua allocator. */
+static void         *prof_allocud  = NULL; /**< Original allocator data. */
+
+/*
+ * Prototypes.
+ */
+static void *nlua_profAlloc( void *ud, void *ptr, size_t osize, size_t nsize );
+static void  nlua_profClear( void );
+static int   nlua_profEntry( LuaProfKind_t kind, const char *name );
+static int   nlua_profPushFrame( int entry, int entry2 );
+static int   nlua_profCmp( const void *p1, const void *p2 );
+
+/**
+ * @brief Lua allocator that counts the memory allocated by the current call.
+ */
+static void *nlua_profAlloc( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+   if ( ( nsize > osize ) && ( prof_depth > 0 ) )
+      prof_frames[prof_depth - 1].alloc += nsize - osize;
+   return prof_allocf( ud, ptr, osize, nsize );
+}
+
+/**
+ * @brief Frees all the profile data.
+ */
+static void nlua_profClear( void )
+{
+   for ( int i = 0; i < array_size( prof_entries ); i++ )
+      free( prof_entries[i].name );
+   array_free( prof_entries );
+   prof_entries = NULL;
+   for ( int k = 0; k < LUA_PROF_KINDS; k++ )
+      nidx_free( &prof_index[k] );
+   array_free( prof_envs );
+   prof_envs     = NULL;
+   prof_depth    = 0;
+   prof_overflow = 0;
+}
+
+/**
+ * @brief Starts the profiler, throwing away the previous profile.
+ */
+void nlua_profStart( void )
+{
+   if ( nlua_prof_active )
+      return;
+
+   nlua_profClear();
+   prof_entries = array_create( LuaProfEntry );
+   prof_envs    = array_create( int );
+   for ( int k = 0; k < LUA_PROF_KINDS; k++ )
+      nidx_create( &prof_index[k] );
+
+   /* Wrap the allocator to count the memory. */
+   prof_allocf = lua_getallocf( naevL, &prof_allocud );
+   lua_setallocf( naevL, nlua_profAlloc, prof_allocud );
+
+   prof_freq        = (double)SDL_GetPerformanceFrequency();
+   prof_start       = SDL_GetPerformanceCounter();
+   prof_elapsed     = 0.;
+   nlua_prof_active = 1;
+   prof_session++;
+}
+
+/**
+ * @brief Stops the profiler, keeping the profile.
+ */
+void nlua_profStop( void )
+{
+   if ( !nlua_prof_active )
+      return;
+
+   lua_setallocf( naevL, prof_allocf, prof_allocud );
+   prof_elapsed =
+      (double)( SDL_GetPerformanceCounter() - prof_start ) / prof_freq;
+   prof_depth       = 0;
+   prof_overflow    = 0;
+   nlua_prof_active = 0;
+   prof_session++;
+}
+
+/**
+ * @brief Cleans up the profiler, must be run before the Lua state is closed.
+ */
+void nlua_profExit( void )
+{
+   nlua_profStop();
+   nlua_profClear();
+}
+
+/**
+ * @brief Gets the entry of a name, creating it if necessary.
+ */
+static int nlua_profEntry( LuaProfKind_t kind, const char *name )
+{
+   LuaProfEntry *e;
+   int           id = nidx_get( &prof_index[kind], name );
+   if ( id >= 0 )
+      return id;
+
+   e = &array_grow( &prof_entries );
+   memset( e, 0, sizeof( LuaProfEntry ) );
+   e->name = strdup( name );
+   e->kind = kind;
+   id      = e - prof_entries;
+   nidx_set( &prof_index[kind], name, id );
+   return id;
+}
+
+/**
+ * @brief Starts profiling a call.
+ *
+ *    @return Session to pass to nlua_profLeave().
+ */
+static int nlua_profPushFrame( int entry, int entry2 )
+{
+   LuaProfFrame *f;
+
+   if ( prof_depth >= PROF_MAXDEPTH ) {
+      prof_overflow++;
+      return prof_session;
+   }
+
+   f             = &prof_frames[prof_depth++];
+   f->entry[0]   = entry;
+   f->entry[1]   = entry2;
+   f->child      = 0;
+   f->alloc      = 0;
+   f->childalloc = 0;
+   f->start      = SDL_GetPerformanceCounter();
+   return prof_session;
+}
+
+/**
+ * @brief Starts profiling a call from nlua_pcall().
+ *
+ * The function to call and its arguments are expected on top of the stack.
+ *
+ *    @param env Environment the function is called in.
+ *    @param nargs Number of arguments of the function.
+ *    @return Session to pass to nlua_profLeave().
+ */
+int nlua_profEnter( nlua_env env, int nargs )
+{
+   lua_Debug ar;
+   char      buf[STRMAX_SHORT];
+   int       eenv, efunc;
+
+   /* Environments only get looked up the first time they are called. */
+   if ( env < 0 )
+      eenv = nlua_profEntry( LUA_PROF_ENV, "???" );
+   else {
+      int n = array_size( prof_envs );
+      if ( env >= n ) {
+         array_resize( &prof_envs, env + 1 );
+         for ( int i = n; i <= env; i++ )
+            prof_envs[i] = -1;
+      }
+      eenv = prof_envs[env];
+      if ( eenv < 0 ) {
+         const char *name;
+         nlua_getenv( naevL, env, "__name" );
+         name = lua_tostring( naevL, -1 );
+         eenv = nlua_profEntry( LUA_PROF_ENV, ( name != NULL ) ? name : "???" );
+         lua_pop( naevL, 1 );
+         prof_envs[env] = eenv;
+      }
+   }
+
+   /* Functions are identified by where they are defined. */
+   lua_pushvalue( naevL, -1 - nargs );
+   if ( lua_getinfo( naevL, ">S", &ar ) && ( strcmp( ar.what, "C" ) != 0 ) )
+      snprintf( buf, sizeof( buf ), "%s:%d", ar.short_src, ar.linedefined );
+   else
+      snprintf( buf, sizeof( buf ), "[C]" );
+   efunc = nlua_profEntry( LUA_PROF_FUNC, buf );
+
+   return nlua_profPushFrame( eenv, efunc );
+}
+
+/**
+ * @brief Starts profiling a hook stack.
+ *
+ *    @param stack Name of the stack being run.
+ *    @return Session to pass to nlua_profLeave().
+ */
+int nlua_profPush( const char *stack )
+{
+   return nlua_profPushFrame( nlua_profEntry( LUA_PROF_STACK, stack ), -1 );
+}
+
+/**
+ * @brief Stops profiling the last call.
+ *
+ *    @param session Session returned when the call started.
+ */
+void nlua_profLeave( int session )
+{
+   LuaProfFrame *f;
+   Uint64        dt;
+   size_t        alloc;
+
+   /* The profiler was toggled during the call. */
+   if ( !nlua_prof_active || ( session != prof_session ) )
+      return;
+   if ( prof_overflow > 0 ) {
+      prof_overflow--;
+      return;
+   }
+   if ( prof_depth <= 0 )
+      return;
+
+   f     = &prof_frames[--prof_depth];
+   dt    = SDL_GetPerformanceCounter() - f->start;
+   alloc = f->alloc + f->childalloc;
+   for ( int i = 0; i < 2; i++ ) {
+      LuaProfEntry *e;
+      if ( f->entry[i] < 0 )
+         continue;
+      e = &prof_entries[f->entry[i]];
+      e->calls++;
+      e->self += (double)( dt - MIN( f->child, dt ) ) / prof_freq;
+      e->total += (double)dt / prof_freq;
+      e->alloc_self += f->alloc;
+      e->alloc_total += alloc;
+   }
+
+   /* Don't count it again in the caller. */
+   if ( prof_depth > 0 ) {
+      LuaProfFrame *p = &prof_frames[prof_depth - 1];
+      p->child += dt;
+      p->childalloc += alloc;
+   }
+}
+
+/**
+ * @brief Gets the name of the environment of the current call for tracing.
+ */
+const char *nlua_profName( void )
+{
+   if ( prof_depth <= 0 )
+      return "nlua_pcall";
+   return prof_entries[prof_frames[prof_depth - 1].entry[0]].name;
+}
+
+/**
+ * @brief Forgets about an environment reference, since it can get reused.
+ */
+void nlua_profFreeEnv( nlua_env env )
+{
+   if ( ( env >= 0 ) && ( env < array_size( prof_envs ) ) )
+      prof_envs[env] = -1;
+}
+
+/**
+ * @brief Compares profile entries to sort them by decreasing time.
+ *
+ * Hook stacks use the total time, since they barely do anything themselves.
+ */
+static int nlua_profCmp( const void *p1, const void *p2 )
+{
+   const LuaProfEntry *e1 = *(const LuaProfEntry **)p1;
+   const LuaProfEntry *e2 = *(const LuaProfEntry **)p2;
+   double t1 = ( e1->kind == LUA_PROF_STACK ) ? e1->total : e1->self;
+   double t2 = ( e2->kind == LUA_PROF_STACK ) ? e2->total : e2->self;
+   if ( t1 > t2 )
+      return -1;
+   else if ( t1 < t2 )
+      return +1;
+   return strcmp( e1->name, e2->name );
+}
+
+/**
+ * @brief Reports the entries that took the most time.
+ *
+ *    @param n Number of entries to report of each kind.
+ *    @param print Function to output each line with.
+ */
+void nlua_profReport( int n, void ( *print )( const char *line ) )
+{
+   const char *titles[LUA_PROF_KINDS] = {
+      _( "Environments" ),
+      _( "Functions" ),
+      _( "Hook stacks" ),
+   };
+   char                 buf[STRMAX];
+   double               elapsed;
+   const LuaProfEntry **sorted;
+
+   if ( prof_entries == NULL ) {
+      print( _( "The Lua profiler has not been started." ) );
+      return;
+   }
+
+   elapsed = nlua_prof_active
+                ? (double)( SDL_GetPerformanceCounter() - prof_start ) /
+                     prof_freq
+                : prof_elapsed;
+   snprintf( buf, sizeof( buf ), _( "Lua profile of %.1f s (%s):" ), elapsed,
+             nlua_prof_active ? _( "running" ) : _( "stopped" ) );
+   print( buf );
+
+   sorted = malloc( sizeof( LuaProfEntry * ) *
+                    MAX( array_size( prof_entries ), 1 ) );
+   for ( int k = 0; k < LUA_PROF_KINDS; k++ ) {
+      int m = 0;
+      for ( int i = 0; i < array_size( prof_entries ); i++ )
+         if ( prof_entries[i].kind == (LuaProfKind_t)k )
+            sorted[m++] = &prof_entries[i];
+      if ( m == 0 )
+         continue;
+      qsort( sorted, m, sizeof( LuaProfEntry * ), nlua_profCmp );
+
+      snprintf( buf, sizeof( buf ), _( "%s (top %d of %d):" ), titles[k],
+                MIN( n, m ), m );
+      print( buf );
+      print( _( "    self ms   total ms     calls   self KiB  name" ) );
+      for ( int i = 0; i < MIN( n, m ); i++ ) {
+         const LuaProfEntry *e = sorted[i];
+         snprintf( buf, sizeof( buf ), "%11.2f %10.2f %9u %10.1f  %s",
+                   e->self * 1000., e->total * 1000., e->calls,
+                   (double)e->alloc_self / 1024., e->name );
+         print( buf );
+      }
+   }
+   free( sorted );
+}
+
+/**
+ * @brief Dumps the whole profile as CSV.
+ *
+ *    @param filename Name of the file to write to, relative to the write
+ *           directory.
+ *    @return 0 on success.
+ */
+int nlua_profDump( const char *filename )
+{
+   const char  *kinds[LUA_PROF_KINDS] = { "env", "function", "stack" };
+   PHYSFS_File *f;
+   char         buf[STRMAX];
+   int          l, ret;
+
+   if ( prof_entries == NULL ) {
+      WARN( _( "The Lua profiler has not been started." ) );
+      return -1;
+   }
+
+   f = PHYSFS_openWrite( filename );
+   if ( f == NULL ) {
+      WARN( _( "Unable to open '%s' for writing: %s" ), filename,
+            _( PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+      return -1;
+   }
+
+   ret = 0;
+   l   = scnprintf( buf, sizeof( buf ), "kind,name,calls,self_ms,total_ms,"
+                                        "self_bytes,total_bytes\n" );
+   if ( PHYSFS_writeBytes( f, buf, l ) != l )
+      ret = -1;
+   for ( int i = 0; ( ret == 0 ) && ( i < array_size( prof_entries ) ); i++ ) {
+      const LuaProfEntry *e = &prof_entries[i];
+
+      /* Names are quoted, with quotes doubled. */
+      l = scnprintf( buf, sizeof( buf ), "%s,\"", kinds[e->kind] );
+      for ( const char *c = e->name; ( *c != '\0' ) && ( l < STRMAX - 3 );
+            c++ ) {
+         if ( *c == '"' )
+            buf[l++] = '"';
+         buf[l++] = *c;
+      }
+      l += scnprintf( &buf[l], sizeof( buf ) - l, "\",%u,%.4f,%.4f,%zu,%zu\n",
+                      e->calls, e->self * 1000., e->total * 1000.,
+                      e->alloc_self, e->alloc_total );
+      if ( PHYSFS_writeBytes( f, buf, l ) != l )
+         ret = -1;
+   }
+   if ( ret != 0 )
+      WARN( _( "Failed to write '%s': %s" ), filename,
+            _( PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+   PHYSFS_close( f );
+   return ret;
+}
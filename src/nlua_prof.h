@@ -0,0 +1,24 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+#include "nlua.h"
+
+extern int nlua_prof_active; /**< Whether the Lua profiler is running. */
+
+/* Control. */
+void nlua_profStart( void );
+void nlua_profStop( void );
+void nlua_profExit( void );
+
+/* Hooks into the Lua calls. */
+int         nlua_profEnter( nlua_env env, int nargs );
+int         nlua_profPush( const char *stack );
+void        nlua_profLeave( int session );
+const char *nlua_profName( void );
+void        nlua_profFreeEnv( nlua_env env );
+
+/* Output. */
+void nlua_profReport( int n, void ( *print )( const char *line ) );
+int  nlua_profDump( const char *filename );
@@ -452,10 +452,9 @@ static int systemL_interference( lua_State *L )
  */
 static int systemL_jumpdistance( lua_State *L )
 {
-   StarSystem  *sys;
-   StarSystem **s;
-   StarSystem  *start, *goal;
-   int          h, k;
+   StarSystem *sys;
+   StarSystem *start, *goal;
+   int         h, k, d;
 
    sys = luaL_validsystem( L, 1 );
    h   = lua_toboolean( L, 3 );
@@ -475,14 +474,13 @@ static int systemL_jumpdistance( lua_State *L )
       return 1;
    }
 
-   s = map_getJumpPath( start, NULL, goal, k, h, NULL, NULL );
-   if ( s == NULL ) {
+   d = map_getJumpDist( start, goal, k, h );
+   if ( d < 0 ) {
       lua_pushnumber( L, HUGE_VAL );
       return 1;
    }
 
-   lua_pushnumber( L, array_size( s ) );
-   array_free( s );
+   lua_pushnumber( L, d );
    return 1;
 }
 
@@ -898,6 +896,7 @@ static int systemL_setknown( lua_State *L )
             jp_rmFlag( &sys->jumps[i], JP_KNOWN );
       }
    }
+   map_jumpDistInvalidate();
 
    /* Update outfits image array. */
    outfits_updateEquipmentOutfits();
@@ -18,6 +18,7 @@
 
 #include "array.h"
 #include "lvar.h"
+#include "mission.h"
 #include "nxml.h"
 
 /*
@@ -86,6 +87,7 @@ int var_load( xmlNodePtr parent )
          continue;
       var_stack = lvar_load( node );
    } while ( xml_nextNode( node ) );
+   missions_stateChanged();
    return 0;
 }
 
@@ -166,6 +168,7 @@ static int varL_pop( lua_State *L )
    if ( mv == NULL )
       return 0;
    lvar_rmArray( &var_stack, mv );
+   missions_stateChanged();
    return 0;
 }
 
@@ -185,6 +188,7 @@ static int varL_push( lua_State *L )
    const char *str = luaL_checkstring( L, 1 );
    lvar        var = lvar_tovar( L, str, 2 );
    var_add( &var, 1 );
+   missions_stateChanged();
    return 0;
 }
 
@@ -195,4 +199,5 @@ void var_cleanup( void )
 {
    lvar_freeArray( var_stack );
    var_stack = NULL;
+   missions_stateChanged();
 }
@@ -14,6 +14,7 @@
 #define NTracingZone( ctx, active ) TracyCZone( ctx, active )
 #define NTracingZoneName( ctx, name, active ) TracyCZoneN( ctx, name, active )
 #define NTracingZoneEnd( ctx ) TracyCZoneEnd( ctx )
+#define NTracingZoneSetName( ctx, name, size ) TracyCZoneName( ctx, name, size )
 #define NTracingAlloc( ptr, size )                                             \
    do {                                                                        \
       _uninitialized_var( ptr );                                               \
@@ -61,6 +62,7 @@ ALWAYS_INLINE static inline void *nrealloc( void *ptr, size_t size )
 #define NTracingZone( ctx, active )
 #define NTracingZoneName( ctx, name, active )
 #define NTracingZoneEnd( ctx )
+#define NTracingZoneSetName( ctx, name, size )
 #define NTracingAlloc( ptr, size )
 #define NTracingFree( ptr )
 #define nmalloc( size ) malloc( size )
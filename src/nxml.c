@@ -12,6 +12,17 @@
 #include <inttypes.h>
 
 #include "ndata.h"
+#include "threadpool.h"
+
+/**
+ * @brief Files being parsed by xml_parsePhysFSList.
+ */
+typedef struct XmlParseList_ {
+   char *const *filenames; /**< Files to parse. */
+   xmlDocPtr   *docs;      /**< Parsed documents. */
+} XmlParseList;
+
+static void xml_parsePhysFSRange( void *data, int start, int end );
 
 /**
  * @brief Parses a texture handling the sx and sy elements.
@@ -94,6 +105,41 @@ xmlDocPtr xml_parsePhysFS( const char *filename )
    return doc;
 }
 
+/**
+ * @brief Parses a range of the files of xml_parsePhysFSList.
+ */
+static void xml_parsePhysFSRange( void *data, int start, int end )
+{
+   const XmlParseList *pl = data;
+   for ( int i = start; i < end; i++ ) {
+      if ( ndata_matchExt( pl->filenames[i], "xml" ) )
+         pl->docs[i] = xml_parsePhysFS( pl->filenames[i] );
+      else
+         pl->docs[i] = NULL;
+   }
+}
+
+/**
+ * @brief Reads and parses many PhysFS files in parallel.
+ *
+ * Files without the xml extension are skipped. Reading and parsing is usually
+ * most of the loading time of the data files, so the documents can then be
+ * processed in order on the calling thread.
+ *
+ *    @param filenames PhysFS file names.
+ *    @param n Number of files.
+ *    @return Array of n documents (must free and xmlFreeDoc each), with NULL
+ *            for the files that were skipped or could not be parsed.
+ */
+xmlDocPtr *xml_parsePhysFSList( char *const *filenames, int n )
+{
+   XmlParseList pl;
+   pl.filenames = filenames;
+   pl.docs      = calloc( MAX( n, 1 ), sizeof( xmlDocPtr ) );
+   job_parallelFor( n, 4, xml_parsePhysFSRange, &pl );
+   return pl.docs;
+}
+
 int xmlw_saveTime( xmlTextWriterPtr writer, const char *name, time_t t )
 {
    xmlw_elem( writer, name, "%lld", (long long)t );
@@ -278,6 +278,7 @@ static inline char *nxml_trace_strdup( void *ptr )
  * Functions for generic complex reading.
  */
 xmlDocPtr             xml_parsePhysFS( const char *filename );
+xmlDocPtr            *xml_parsePhysFSList( char *const *filenames, int n );
 USE_RESULT glTexture *xml_parseTexture( xmlNodePtr node, const char *path,
                                         int defsx, int defsy,
                                         const unsigned int flags );
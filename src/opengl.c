@@ -661,6 +661,7 @@ int gl_init( unsigned int extra_flags )
    gl_initTextures();
    gl_initVBO();
    gl_initRender();
+   gl_initBatch();
 
    /* Get info about the OpenGL window */
    gl_getGLInfo();
@@ -951,6 +952,7 @@ void gl_exit( void )
 
    /* Exit the OpenGL subsystems. */
    gltf_exit();
+   gl_exitBatch();
    gl_exitRender();
    gl_exitVBO();
    gl_exitTextures();
@@ -11,6 +11,7 @@
 
 /* We put all the other opengl stuff here to only have to include one header. */
 #include "mat4.h"
+#include "opengl_batch.h"  // IWYU pragma: export
 #include "opengl_render.h" // IWYU pragma: export
 #include "opengl_shader.h" // IWYU pragma: export
 #include "opengl_tex.h"    // IWYU pragma: export
@@ -116,6 +117,40 @@ GLenum gl_stringToBlendFunc( const char *s );
 GLenum gl_stringToBlendFactor( const char *s );
 void   gl_screenshot( const char *filename );
 void   gl_saveFboDepth( GLuint fbo, const char *filename );
+
+/*
+ * Drawing, counts the draw calls for the frame statistics.
+ */
+extern unsigned int gl_drawCalls;
+
+/**
+ * @brief Wrapper of glDrawArrays that counts the draw call.
+ */
+static inline void gl_drawArrays( GLenum mode, GLint first, GLsizei count )
+{
+   gl_drawCalls++;
+   glDrawArrays( mode, first, count );
+}
+
+/**
+ * @brief Wrapper of glDrawArraysInstanced that counts the draw call.
+ */
+static inline void gl_drawArraysInstanced( GLenum mode, GLint first,
+                                           GLsizei count, GLsizei instances )
+{
+   gl_drawCalls++;
+   glDrawArraysInstanced( mode, first, count, instances );
+}
+
+/**
+ * @brief Wrapper of glDrawElements that counts the draw call.
+ */
+static inline void gl_drawElements( GLenum mode, GLsizei count, GLenum type,
+                                    const void *indices )
+{
+   gl_drawCalls++;
+   glDrawElements( mode, count, type, indices );
+}
 #ifdef DEBUGGING
 #define gl_debugGroupStart()                                                   \
    glPushDebugGroup( GL_DEBUG_SOURCE_APPLICATION, 0, strlen( __func__ ),       \
@@ -0,0 +1,283 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file opengl_batch.c
+ *
+ * @brief Batches sprites into instanced draws.
+ *
+ * While a batch is active, textures rendered with gl_renderTexture and
+ * gl_renderTextureInterpolate are queued instead of drawn. Consecutive sprites
+ * using the same textures are then drawn with a single instanced draw, with
+ * the transform, texture coordinates, colour and interpolation of each sprite
+ * streamed through a VBO.
+ *
+ * Anything else rendered while a batch is active has to call gl_batchFlush
+ * first, or it will end up below the queued sprites.
+ */
+/** @cond */
+#include <math.h>
+#include <stddef.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "opengl_batch.h"
+
+#include "array.h"
+#include "opengl.h"
+
+#define BATCH_MAX 4096 /**< Maximum number of sprites per draw. */
+#define BATCH_VBO_SIZE                                                         \
+   ( 4 * BATCH_MAX ) /**< Sprites that fit in the VBO before orphaning it. */
+
+/**
+ * @brief Per instance data of a sprite, matches texture_instanced.vert.
+ */
+typedef struct BatchSprite_ {
+   GLfloat mat0[3];   /**< First row of the affine transform. */
+   GLfloat mat1[3];   /**< Second row of the affine transform. */
+   GLfloat tex[4];    /**< Texture offset and size. */
+   GLfloat colour[4]; /**< Colour to modulate with. */
+   GLfloat inter;     /**< Interpolation between the textures. */
+   GLfloat pad;       /**< Pads to 64 bytes. */
+} BatchSprite;
+
+static int          batch_active = 0;    /**< Whether sprites are queued. */
+static GLuint       batch_ta     = 0;    /**< First texture of the queue. */
+static GLuint       batch_tb     = 0;    /**< Second texture of the queue. */
+static BatchSprite *batch_queue  = NULL; /**< Queued sprites. */
+static gl_vbo      *batch_vbo    = NULL; /**< Streamed instance data. */
+static GLsizei      batch_offset = 0; /**< Sprites written to the VBO. */
+
+/*
+ * Prototypes.
+ */
+static void gl_batchAttrib( GLuint index, GLuint offset, GLint size );
+static void gl_batchAttribClear( GLuint index );
+
+/**
+ * @brief Initializes the sprite batching.
+ *
+ *    @return 0 on success.
+ */
+int gl_initBatch( void )
+{
+   batch_queue  = array_create_size( BatchSprite, 256 );
+   batch_vbo    = gl_vboCreateStream( sizeof( BatchSprite ) * BATCH_VBO_SIZE,
+                                      NULL );
+   batch_offset = 0;
+   return 0;
+}
+
+/**
+ * @brief Cleans up the sprite batching.
+ */
+void gl_exitBatch( void )
+{
+   array_free( batch_queue );
+   batch_queue = NULL;
+   gl_vboDestroy( batch_vbo );
+   batch_vbo    = NULL;
+   batch_active = 0;
+}
+
+/**
+ * @brief Starts queueing sprites.
+ */
+void gl_batchBegin( void )
+{
+   batch_active = 1;
+}
+
+/**
+ * @brief Draws the queued sprites and stops queueing.
+ */
+void gl_batchEnd( void )
+{
+   gl_batchFlush();
+   batch_active = 0;
+}
+
+/**
+ * @brief Checks to see if sprites are being queued.
+ */
+int gl_batchActive( void )
+{
+   return batch_active;
+}
+
+/**
+ * @brief Sets up a per instance attribute.
+ */
+static void gl_batchAttrib( GLuint index, GLuint offset, GLint size )
+{
+   glEnableVertexAttribArray( index );
+   gl_vboActivateAttribOffset( batch_vbo, index, offset, size, GL_FLOAT,
+                               sizeof( BatchSprite ) );
+   glVertexAttribDivisor( index, 1 );
+}
+
+/**
+ * @brief Clears a per instance attribute.
+ *
+ * The divisor belongs to the attribute index and not the program, so it has
+ * to be reset or it would affect the other shaders.
+ */
+static void gl_batchAttribClear( GLuint index )
+{
+   glVertexAttribDivisor( index, 0 );
+   glDisableVertexAttribArray( index );
+}
+
+/**
+ * @brief Draws all the queued sprites.
+ */
+void gl_batchFlush( void )
+{
+   GLsizei n = array_size( batch_queue );
+   GLuint  offset;
+
+   if ( n <= 0 )
+      return;
+
+   /* Orphan the buffer when full so we don't have to wait on the draws still
+    * using it. */
+   if ( batch_offset + n > BATCH_VBO_SIZE ) {
+      gl_vboData( batch_vbo, sizeof( BatchSprite ) * BATCH_VBO_SIZE, NULL );
+      batch_offset = 0;
+   }
+   offset = sizeof( BatchSprite ) * batch_offset;
+   gl_vboSubData( batch_vbo, offset, sizeof( BatchSprite ) * n, batch_queue );
+   batch_offset += n;
+
+   glUseProgram( shaders.texture_instanced.program );
+
+   /* Bind the textures. */
+   glActiveTexture( GL_TEXTURE1 );
+   glBindTexture( GL_TEXTURE_2D, batch_tb );
+   glActiveTexture( GL_TEXTURE0 );
+   glBindTexture( GL_TEXTURE_2D, batch_ta );
+   /* Always end with TEXTURE0 active. */
+
+   /* Set the vertex and instance data. */
+   glEnableVertexAttribArray( shaders.texture_instanced.vertex );
+   gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture_instanced.vertex,
+                               0, 2, GL_FLOAT, 0 );
+   gl_batchAttrib( shaders.texture_instanced.inst_mat0,
+                   offset + offsetof( BatchSprite, mat0 ), 3 );
+   gl_batchAttrib( shaders.texture_instanced.inst_mat1,
+                   offset + offsetof( BatchSprite, mat1 ), 3 );
+   gl_batchAttrib( shaders.texture_instanced.inst_tex,
+                   offset + offsetof( BatchSprite, tex ), 4 );
+   gl_batchAttrib( shaders.texture_instanced.inst_colour,
+                   offset + offsetof( BatchSprite, colour ), 4 );
+   gl_batchAttrib( shaders.texture_instanced.inst_inter,
+                   offset + offsetof( BatchSprite, inter ), 1 );
+
+   /* Set shader uniforms. */
+   glUniform1i( shaders.texture_instanced.sampler1, 0 );
+   glUniform1i( shaders.texture_instanced.sampler2, 1 );
+   gl_uniformMat4( shaders.texture_instanced.projection, &gl_view_matrix );
+
+   /* Draw. */
+   gl_drawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, n );
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.texture_instanced.vertex );
+   gl_batchAttribClear( shaders.texture_instanced.inst_mat0 );
+   gl_batchAttribClear( shaders.texture_instanced.inst_mat1 );
+   gl_batchAttribClear( shaders.texture_instanced.inst_tex );
+   gl_batchAttribClear( shaders.texture_instanced.inst_colour );
+   gl_batchAttribClear( shaders.texture_instanced.inst_inter );
+
+   /* anything failed? */
+   gl_checkErr();
+
+   glUseProgram( 0 );
+
+   array_resize( &batch_queue, 0 );
+}
+
+/**
+ * @brief Queues a texture to be drawn with the batch.
+ *
+ * Uses the same parameters as gl_renderTextureRaw, with ta*inter +
+ * tb*(1.-inter) as in gl_renderTextureInterpolateRawH. Pass the same texture
+ * twice with an interpolation of 1 when not interpolating.
+ *
+ *    @param ta Texture A to blit.
+ *    @param tb Texture B to blit.
+ *    @param inter Amount of interpolation to do.
+ *    @param flags Texture flags of texture A.
+ *    @param x X position of the texture on the screen. (units pixels)
+ *    @param y Y position of the texture on the screen. (units pixels)
+ *    @param w Width on the screen. (units pixels)
+ *    @param h Height on the screen. (units pixels)
+ *    @param tx X position within the texture. [0:1]
+ *    @param ty Y position within the texture. [0:1]
+ *    @param tw Texture width. [0:1]
+ *    @param th Texture height. [0:1]
+ *    @param c Colour to use (modifies texture colour).
+ *    @param angle Rotation to apply (radians ccw around the center).
+ */
+void gl_batchTexture( GLuint ta, GLuint tb, double inter, uint8_t flags,
+                      double x, double y, double w, double h, double tx,
+                      double ty, double tw, double th, const glColour *c,
+                      double angle )
+{
+   BatchSprite *s;
+
+   /* Different textures can't go in the same draw. */
+   if ( ( ta != batch_ta ) || ( tb != batch_tb ) ||
+        ( array_size( batch_queue ) >= BATCH_MAX ) ) {
+      gl_batchFlush();
+      batch_ta = ta;
+      batch_tb = tb;
+   }
+
+   /* Must have colour for now. */
+   if ( c == NULL )
+      c = &cWhite;
+
+   s = &array_grow( &batch_queue );
+
+   /* Same transform as gl_renderTextureRaw, but only the affine part. */
+   if ( angle == 0. ) {
+      s->mat0[0] = w;
+      s->mat0[1] = 0.;
+      s->mat0[2] = x;
+      s->mat1[0] = 0.;
+      s->mat1[1] = h;
+      s->mat1[2] = y;
+   } else {
+      double hw = w * 0.5;
+      double hh = h * 0.5;
+      double ca = cos( angle );
+      double sa = sin( angle );
+      s->mat0[0] = ca * w;
+      s->mat0[1] = -sa * h;
+      s->mat0[2] = x + hw - ca * hw + sa * hh;
+      s->mat1[0] = sa * w;
+      s->mat1[1] = ca * h;
+      s->mat1[2] = y + hh - sa * hw - ca * hh;
+   }
+
+   /* Flipping is the same as mat4_ortho( -1., 1., 2., 0., 1., -1. ). */
+   s->tex[0] = tx;
+   s->tex[2] = tw;
+   if ( flags & OPENGL_TEX_VFLIP ) {
+      s->tex[1] = 1. - ty;
+      s->tex[3] = -th;
+   } else {
+      s->tex[1] = ty;
+      s->tex[3] = th;
+   }
+
+   s->colour[0] = c->r;
+   s->colour[1] = c->g;
+   s->colour[2] = c->b;
+   s->colour[3] = c->a;
+   s->inter     = CLAMP( 0., 1., inter );
+   s->pad       = 0.;
+}
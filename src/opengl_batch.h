@@ -0,0 +1,29 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
+#include "colour.h"
+#include "glad.h"
+
+/*
+ * Init/cleanup.
+ */
+int  gl_initBatch( void );
+void gl_exitBatch( void );
+
+/*
+ * Batching.
+ */
+void gl_batchBegin( void );
+void gl_batchEnd( void );
+void gl_batchFlush( void );
+int  gl_batchActive( void );
+void gl_batchTexture( GLuint ta, GLuint tb, double inter, uint8_t flags,
+                      double x, double y, double w, double h, double tx,
+                      double ty, double tw, double th, const glColour *c,
+                      double angle );
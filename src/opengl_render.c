@@ -43,6 +43,7 @@ static gl_vbo *gl_lineVBO            = 0;
 static gl_vbo *gl_triangleVBO        = 0;
 static int     gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int     gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
+unsigned int   gl_drawCalls          = 0; /**< Draw calls this frame. */
 
 void gl_beginSolidProgram( mat4 projection, const glColour *c )
 {
@@ -124,11 +125,11 @@ void gl_renderRectH( const mat4 *H, const glColour *c, int filled )
    if ( filled ) {
       gl_vboActivateAttribOffset( gl_squareVBO, shaders.solid.vertex, 0, 2,
                                   GL_FLOAT, 0 );
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    } else {
       gl_vboActivateAttribOffset( gl_squareEmptyVBO, shaders.solid.vertex, 0, 2,
                                   GL_FLOAT, 0 );
-      glDrawArrays( GL_LINE_STRIP, 0, 5 );
+      gl_drawArrays( GL_LINE_STRIP, 0, 5 );
    }
    gl_endSolidProgram();
 }
@@ -171,7 +172,7 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s,
    gl_beginSolidProgram( projection, c );
    gl_vboActivateAttribOffset( gl_triangleVBO, shaders.solid.vertex, 0, 2,
                                GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_STRIP, 0, 4 );
+   gl_drawArrays( GL_LINE_STRIP, 0, 4 );
    gl_endSolidProgram();
 }
 
@@ -199,7 +200,7 @@ void gl_renderDepthRawH( GLuint depth, const mat4 *projection,
    gl_uniformMat4( shaders.texture_depth_only.tex_mat, tex_mat );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_depth_only.vertex );
@@ -272,7 +273,7 @@ void gl_renderTextureDepthRawH( GLuint texture, GLuint depth,
    glUniform1i( shaders.texture_depth.depth, 1 );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_depth.vertex );
@@ -344,7 +345,7 @@ void gl_renderTextureRawH( GLuint texture, const mat4 *projection,
    gl_uniformMat4( shaders.texture.tex_mat, tex_mat );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture.vertex );
@@ -418,6 +419,11 @@ void gl_renderTexture( const glTexture *texture, double x, double y, double w,
                        double h, double tx, double ty, double tw, double th,
                        const glColour *c, double angle )
 {
+   if ( gl_batchActive() ) {
+      gl_batchTexture( texture->texture, texture->texture, 1., texture->flags,
+                       x, y, w, h, tx, ty, tw, th, c, angle );
+      return;
+   }
    gl_renderTextureRaw( texture->texture, texture->flags, x, y, w, h, tx, ty,
                         tw, th, c, angle );
 }
@@ -486,7 +492,7 @@ void gl_renderSDF( const glTexture *texture, double x, double y, double w,
                 ( 2.0 * texture->vmax * ( w + 2. ) / texture->w ) );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texturesdf.vertex );
@@ -544,7 +550,7 @@ void gl_renderTextureInterpolateRawH( GLuint ta, GLuint tb, double inter,
    gl_uniformMat4( shaders.texture_interpolate.tex_mat, tex_mat );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_interpolate.vertex );
@@ -586,6 +592,12 @@ void gl_renderTextureInterpolate( const glTexture *ta, const glTexture *tb,
    else if ( ta == NULL )
       return gl_renderTexture( tb, x, y, w, h, tx, ty, tw, th, c, 0. );
 
+   if ( gl_batchActive() ) {
+      gl_batchTexture( ta->texture, tb->texture, inter, ta->flags, x, y, w, h,
+                       tx, ty, tw, th, c, 0. );
+      return;
+   }
+
    projection = gl_view_matrix;
    mat4_translate_scale_xy( &projection, x, y, w, h );
    tex_mat = ( ta->flags & OPENGL_TEX_VFLIP )
@@ -1152,7 +1164,7 @@ void gl_renderShaderH( const SimpleShader *shd, const mat4 *H,
 
    gl_uniformMat4( shd->projection, H );
 
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    glDisableVertexAttribArray( shd->vertex );
    glUseProgram( 0 );
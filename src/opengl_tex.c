@@ -21,6 +21,24 @@
 #include "md5.h"
 #include "nfile.h"
 #include "opengl.h"
+#include "threadpool.h"
+
+#define TRANS_MAGIC                                                            \
+   0x314d544eu /**< Identifies transparency maps in the cache ("NTM1"). */
+
+/**
+ * @brief Header of a transparency map, stored as is in the cache.
+ *
+ * Followed by the bounding boxes of the sprites and then their rows.
+ */
+typedef struct glTransHeader_ {
+   uint32_t magic; /**< Should be TRANS_MAGIC. */
+   uint32_t sx;    /**< Number of sprites on the x axis. */
+   uint32_t sy;    /**< Number of sprites on the y axis. */
+   uint32_t sw;    /**< Width of a sprite. */
+   uint32_t sh;    /**< Height of a sprite. */
+   uint32_t words; /**< Number of words per row. */
+} glTransHeader;
 
 /*
  * graphic list
@@ -45,14 +63,39 @@ static SDL_threadID tex_mainthread;
 static SDL_mutex   *gl_lock  = NULL; /**< Lock for OpenGL functions. */
 static SDL_mutex   *tex_lock = NULL; /**< Lock for texture list manipulation. */
 
+#define TEX_STREAM_BUDGET                                                      \
+   0.002 /**< Seconds to spend uploading streamed images each frame. */
+
+/**
+ * @brief Image being decoded in the background before it is needed.
+ */
+typedef struct glTexStream_ {
+   char        *path;    /**< Path of the image. */
+   int          sx;      /**< X sprites. */
+   int          sy;      /**< Y sprites. */
+   unsigned int flags;   /**< Flags the image will be loaded with. */
+   SDL_Surface *surface; /**< Decoded image, NULL if it failed to load. */
+   glTransMap  *trans;   /**< Transparency map if requested. */
+   SDL_atomic_t done;    /**< Whether or not the decoding is done. */
+   Job         *job;     /**< Parent job of the decoding. */
+} glTexStream;
+static glTexStream **tex_stream = NULL; /**< Images being streamed in. */
+static glTexture **tex_streamed = NULL; /**< Streamed textures not yet used. */
+static SDL_mutex  *stream_lock  = NULL; /**< Lock for tex_stream. */
+
 /*
  * prototypes
  */
 /* misc */
 static uint8_t             SDL_GetAlpha( SDL_Surface *s, int x, int y );
 static int                 SDL_IsTrans( SDL_Surface *s, int x, int y );
-static USE_RESULT uint8_t *SDL_MapAlpha( SDL_Surface *s, int tight );
-static size_t              gl_transSize( const int w, const int h );
+static USE_RESULT uint8_t *SDL_MapAlpha( SDL_Surface *s );
+static size_t gl_transSize( int sx, int sy, int sw, int sh );
+static USE_RESULT void *gl_transCreate( SDL_Surface *s, int sx, int sy,
+                                        size_t *size );
+static glTransMap      *gl_transLoad( void *data, size_t size, int sx, int sy,
+                                      int sw, int sh );
+static void             gl_transFree( glTransMap *map );
 /* glTexture */
 static USE_RESULT GLuint gl_texParameters( unsigned int flags );
 static USE_RESULT GLuint gl_loadSurface( SDL_Surface *surface,
@@ -63,9 +106,23 @@ static int gl_loadNewImage( glTexture *tex, const char *path, int sx, int sy,
 static int gl_loadNewImageRWops( glTexture *tex, const char *path,
                                  SDL_RWops *rw, int sx, int sy,
                                  unsigned int flags );
+static int  gl_decodeImage( const char *path, SDL_RWops *rw, int sx, int sy,
+                            unsigned int flags, SDL_Surface **surface,
+                            glTransMap **trans );
+static void gl_uploadImage( glTexture *tex, SDL_Surface *surface,
+                            glTransMap *trans, int sx, int sy,
+                            unsigned int flags );
+/* Streaming. */
+static void         gl_texStreamJob( Job *job, void *data );
+static glTexStream *gl_texStreamTake( const char *path, int sx, int sy,
+                                      unsigned int flags );
+static void         gl_texStreamFree( glTexStream *ts );
 /* List. */
 static glTexture *gl_texCreate( const char *path, int sx, int sy,
                                 unsigned int flags );
+static void gl_texRealPath( char *buf, size_t len, const char *path );
+static int  gl_texExists( const char *path, unsigned int flags, int sx,
+                          int sy );
 static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags );
 static int tex_cmp( const void *p1, const void *p2 );
 
@@ -159,59 +216,148 @@ static int SDL_IsTrans( SDL_Surface *s, int x, int y )
 /**
  * @brief Maps the surface transparency.
  *
- * Basically generates a map of what pixels are transparent.  Good for pixel
- *  perfect collision routines.
+ * Basically generates a map of the alpha of every pixel, used to create
+ * distance fields.
  *
  *    @param s Surface to map its transparency.
- *    @param tight Whether or not to store transparency per bit or
- *    @return 0 on success.
+ *    @return The alpha of each pixel.
  */
-static uint8_t *SDL_MapAlpha( SDL_Surface *s, int tight )
+static uint8_t *SDL_MapAlpha( SDL_Surface *s )
 {
-   uint8_t *t;
    int      w = s->w;
    int      h = s->h;
-
-   if ( tight ) {
-      /* alloc memory for just enough bits to hold all the data we need */
-      size_t size = gl_transSize( w, h );
-      t           = malloc( size );
-      if ( t == NULL ) {
-         WARN( _( "Out of Memory" ) );
-         return NULL;
-      }
-      memset( t, 0, size ); /* important, must be set to zero */
-
-      /* Check each pixel individually. */
-      for ( int i = 0; i < h; i++ )
-         for ( int j = 0; j < w;
-               j++ ) /* sets each bit to be 1 if not transparent or 0 if is */
-            t[( i * w + j ) / 8] |=
-               ( SDL_IsTrans( s, j, i ) ) ? 0 : ( 1 << ( ( i * w + j ) % 8 ) );
-   } else {
-      t = malloc( w * h );
-      /* Check each pixel individually. */
-      for ( int i = 0; i < h; i++ )
-         for ( int j = 0; j < w;
-               j++ ) /* sets each bit to be 1 if not transparent or 0 if is */
-            t[i * w + j] = SDL_GetAlpha(
-               s, j, i ); /* Flipped with tight version, this is not good :/ */
-   }
-
+   uint8_t *t = malloc( w * h );
+   /* Check each pixel individually. */
+   for ( int i = 0; i < h; i++ )
+      for ( int j = 0; j < w; j++ )
+         t[i * w + j] = SDL_GetAlpha( s, j, i );
    return t;
 }
 
 /*
  * @brief Gets the size needed for a transparency map.
  *
- *    @param w Width of the image.
- *    @param h Height of the image.
+ *    @param sx Number of sprites on the x axis.
+ *    @param sy Number of sprites on the y axis.
+ *    @param sw Width of a sprite.
+ *    @param sh Height of a sprite.
  *    @return The size in bytes.
  */
-static size_t gl_transSize( const int w, const int h )
+static size_t gl_transSize( int sx, int sy, int sw, int sh )
+{
+   size_t n     = (size_t)sx * sy;
+   size_t words = ( sw + 63 ) / 64;
+   /* The header and boxes keep the rows aligned to 8 bytes. */
+   return sizeof( glTransHeader ) + n * 4 * sizeof( int16_t ) +
+          n * sh * words * sizeof( uint64_t );
+}
+
+/**
+ * @brief Creates the transparency map of a sprite sheet.
+ *
+ * Pixels are mapped the same way as with SDL_IsTrans, and stored per sprite in
+ * the layout described by glTransMap.
+ *
+ *    @param s Surface to map its transparency.
+ *    @param sx Number of sprites on the x axis.
+ *    @param sy Number of sprites on the y axis.
+ *    @param[out] size Size of the map in bytes.
+ *    @return The map data, to be loaded with gl_transLoad.
+ */
+static void *gl_transCreate( SDL_Surface *s, int sx, int sy, size_t *size )
+{
+   glTransHeader *hdr;
+   int16_t       *box;
+   uint64_t      *bits;
+   int            sw    = s->w / sx;
+   int            sh    = s->h / sy;
+   int            words = ( sw + 63 ) / 64;
+
+   *size = gl_transSize( sx, sy, sw, sh );
+   hdr   = calloc( 1, *size ); /* important, must be set to zero */
+   if ( hdr == NULL ) {
+      WARN( _( "Out of Memory" ) );
+      return NULL;
+   }
+   hdr->magic = TRANS_MAGIC;
+   hdr->sx    = sx;
+   hdr->sy    = sy;
+   hdr->sw    = sw;
+   hdr->sh    = sh;
+   hdr->words = words;
+   box        = (int16_t *)&hdr[1];
+   bits       = (uint64_t *)&box[4 * sx * sy];
+
+   for ( int fy = 0; fy < sy; fy++ ) {
+      for ( int fx = 0; fx < sx; fx++ ) {
+         int16_t  *b = &box[4 * ( fy * sx + fx )];
+         uint64_t *f = &bits[(size_t)( fy * sx + fx ) * sh * words];
+         b[0]        = sw;
+         b[1]        = sh;
+         b[2]        = -1;
+         b[3]        = -1;
+         for ( int y = 0; y < sh; y++ ) {
+            for ( int x = 0; x < sw; x++ ) {
+               /* sets each bit to be 1 if not transparent or 0 if is */
+               if ( SDL_IsTrans( s, fx * sw + x, fy * sh + y ) )
+                  continue;
+               f[y * words + x / 64] |= UINT64_C( 1 ) << ( x % 64 );
+               b[0] = MIN( b[0], x );
+               b[1] = MIN( b[1], y );
+               b[2] = MAX( b[2], x );
+               b[3] = MAX( b[3], y );
+            }
+         }
+      }
+   }
+   return hdr;
+}
+
+/**
+ * @brief Loads a transparency map from its data.
+ *
+ *    @param data Data created by gl_transCreate or read from the cache. The map
+ *           takes ownership on success.
+ *    @param size Size of the data.
+ *    @param sx Expected number of sprites on the x axis.
+ *    @param sy Expected number of sprites on the y axis.
+ *    @param sw Expected width of a sprite.
+ *    @param sh Expected height of a sprite.
+ *    @return The map or NULL if the data does not match.
+ */
+static glTransMap *gl_transLoad( void *data, size_t size, int sx, int sy,
+                                 int sw, int sh )
+{
+   const glTransHeader *hdr = data;
+   glTransMap          *map;
+
+   if ( ( data == NULL ) || ( size != gl_transSize( sx, sy, sw, sh ) ) ||
+        ( hdr->magic != TRANS_MAGIC ) || ( (int)hdr->sx != sx ) ||
+        ( (int)hdr->sy != sy ) || ( (int)hdr->sw != sw ) ||
+        ( (int)hdr->sh != sh ) || ( (int)hdr->words != ( sw + 63 ) / 64 ) )
+      return NULL;
+
+   map        = malloc( sizeof( glTransMap ) );
+   map->sx    = sx;
+   map->sy    = sy;
+   map->sw    = sw;
+   map->sh    = sh;
+   map->words = hdr->words;
+   map->box   = (const int16_t *)&hdr[1];
+   map->bits  = (const uint64_t *)&map->box[4 * sx * sy];
+   map->data  = data;
+   return map;
+}
+
+/**
+ * @brief Frees a transparency map.
+ */
+static void gl_transFree( glTransMap *map )
 {
-   /* One bit per pixel, plus remainder. */
-   return w * h / 8 + ( ( w * h % 8 ) ? 1 : 0 );
+   if ( map == NULL )
+      return;
+   free( map->data );
+   free( map );
 }
 
 /**
@@ -422,7 +568,7 @@ static GLuint gl_loadSurface( SDL_Surface *surface, unsigned int flags,
    SDL_LockSurface( rgba );
    if ( flags & OPENGL_TEX_SDF ) {
       const float border[] = { 0., 0., 0., 0. };
-      uint8_t    *trans    = SDL_MapAlpha( rgba, 0 );
+      uint8_t    *trans    = SDL_MapAlpha( rgba );
       GLfloat    *dataf = make_distance_mapbf( trans, rgba->w, rgba->h, vmax );
       free( trans );
       glTexParameterfv( GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border );
@@ -492,6 +638,46 @@ static glTexture *gl_texCreate( const char *path, int sx, int sy,
    return tex;
 }
 
+/**
+ * @brief Gets the path textures are looked up by in the list.
+ *
+ *    @param[out] buf Buffer to write the path to.
+ *    @param len Size of the buffer.
+ *    @param path Path of the texture in ndata.
+ */
+static void gl_texRealPath( char *buf, size_t len, const char *path )
+{
+   const char *realdir = PHYSFS_getRealDir( path );
+   snprintf( buf, len, "%s/%s", realdir ? realdir : "[NULL]", path );
+}
+
+/**
+ * @brief Checks to see if a texture matching a path is already loaded.
+ *
+ * Unlike gl_texExistsOrCreate, does not increment the used counter.
+ *
+ *    @param path Path to the texture.
+ *    @param flags Flags used by the texture.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @return 1 if the texture exists, 0 otherwise.
+ */
+static int gl_texExists( const char *path, unsigned int flags, int sx, int sy )
+{
+   char       buf[STRMAX];
+   glTexList *t;
+
+   gl_texRealPath( buf, sizeof( buf ), path );
+   SDL_mutexP( tex_lock );
+   const glTexList q = { .path = buf, .sx = sx, .sy = sy, .flags = flags };
+   t = ( texture_list == NULL )
+          ? NULL
+          : bsearch( &q, texture_list, array_size( texture_list ),
+                     sizeof( glTexList ), tex_cmp );
+   SDL_mutexV( tex_lock );
+   return ( t != NULL );
+}
+
 /**
  * @brief Check to see if a texture matching a path already exists.
  *
@@ -509,8 +695,7 @@ USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
                                             unsigned int flags, int sx, int sy,
                                             int *created )
 {
-   char        buf[STRMAX];
-   const char *realdir;
+   char buf[STRMAX];
 
    /* Null does never exist. */
    if ( ( path == NULL ) || ( flags & OPENGL_TEX_SKIPCACHE ) ) {
@@ -519,8 +704,7 @@ USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
    }
 
    /* Get the real path name. */
-   realdir = PHYSFS_getRealDir( path );
-   snprintf( buf, sizeof( buf ), "%s/%s", realdir ? realdir : "[NULL]", path );
+   gl_texRealPath( buf, sizeof( buf ), path );
    SDL_mutexP( tex_lock );
 
    /* Check to see if it already exists */
@@ -634,13 +818,29 @@ glTexture *gl_newImageRWops( const char *path, SDL_RWops *rw,
 static int gl_loadNewImage( glTexture *tex, const char *path, int sx, int sy,
                             unsigned int flags )
 {
-   SDL_RWops *rw;
+   SDL_RWops   *rw;
+   glTexStream *ts;
 
    if ( path == NULL ) {
       WARN( _( "Trying to load image from NULL path." ) );
       return -1;
    }
 
+   /* Use the decoded image if it was being streamed in. */
+   ts = gl_texStreamTake( path, sx, sy, flags );
+   if ( ts != NULL ) {
+      int ret = -1;
+      if ( ts->surface != NULL ) {
+         gl_uploadImage( tex, ts->surface, ts->trans, sx, sy, flags );
+         ts->surface = NULL;
+         ts->trans   = NULL;
+         ret         = 0;
+      }
+      gl_texStreamFree( ts );
+      if ( ret == 0 )
+         return 0;
+   }
+
    /* Load from packfile */
    rw = PHYSFSRWOPS_openRead( path );
    if ( rw == NULL ) {
@@ -670,6 +870,7 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
                                  unsigned int flags )
 {
    SDL_Surface *surface;
+   glTransMap  *trans;
 
    /* Placeholder for warnings. */
    if ( path == NULL ) {
@@ -677,9 +878,34 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
       flags |= OPENGL_TEX_SKIPCACHE; /* Don't want caching here. */
    }
 
-   surface = IMG_Load_RW( rw, 0 );
+   if ( gl_decodeImage( path, rw, sx, sy, flags, &surface, &trans ) )
+      return -1;
+   gl_uploadImage( tex, surface, trans, sx, sy, flags );
+   return 0;
+}
 
-   flags |= OPENGL_TEX_VFLIP;
+/**
+ * @brief Decodes an image and creates its transparency map if necessary.
+ *
+ * Does not use OpenGL so it can be run from any thread.
+ *
+ *    @param path Image to load, used for warnings.
+ *    @param rw SDL_Rwops structure to use to load.
+ *    @param sx X sprites to load.
+ *    @param sy Y sprites to load.
+ *    @param flags Flags to control image parameters.
+ *    @param[out] psurface Decoded image.
+ *    @param[out] ptrans Transparency map or NULL if not requested.
+ *    @return 0 on success.
+ */
+static int gl_decodeImage( const char *path, SDL_RWops *rw, int sx, int sy,
+                           unsigned int flags, SDL_Surface **psurface,
+                           glTransMap **ptrans )
+{
+   SDL_Surface *surface = IMG_Load_RW( rw, 0 );
+
+   *psurface = surface;
+   *ptrans   = NULL;
    if ( surface == NULL ) {
       WARN( _( "'%s' could not be opened" ), path );
       return -1;
@@ -691,14 +917,13 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
       md5_state_t md5;
       char       *data;
       char       *cachefile = NULL;
-      uint8_t    *trans     = NULL;
+      glTransMap *trans     = NULL;
+      int         sw        = surface->w / sx;
+      int         sh        = surface->h / sy;
       md5_byte_t *md5val    = malloc( 16 );
       md5_init( &md5 );
       char digest[33];
 
-      /* Appropriate size for the transparency map, see SDL_MapAlpha */
-      cachesize = gl_transSize( surface->w, surface->h );
-
       /* Go to the start of the file. */
       pngsize = SDL_RWseek( rw, 0, SEEK_END );
       SDL_RWseek( rw, 0, SEEK_SET );
@@ -721,13 +946,12 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
 
       /* Attempt to find a cached transparency map. */
       if ( nfile_fileExists( cachefile ) ) {
-         trans = (uint8_t *)nfile_readFile( &filesize, cachefile );
+         char *cached = nfile_readFile( &filesize, cachefile );
 
-         /* Consider cached data invalid if the length doesn't match. */
-         if ( trans != NULL && cachesize != (unsigned int)filesize ) {
-            free( trans );
-            trans = NULL;
-         }
+         /* Consider cached data invalid if the layout doesn't match. */
+         trans = gl_transLoad( cached, filesize, sx, sy, sw, sh );
+         if ( trans == NULL )
+            free( cached );
          /* Cached data matches, no need to overwrite. */
          else {
             free( cachefile );
@@ -736,29 +960,53 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
       }
 
       if ( trans == NULL ) {
+         void *map;
          SDL_LockSurface( surface );
-         trans = SDL_MapAlpha( surface, 1 );
+         map = gl_transCreate( surface, sx, sy, &cachesize );
          SDL_UnlockSurface( surface );
+         trans = gl_transLoad( map, cachesize, sx, sy, sw, sh );
+         if ( trans == NULL )
+            free( map );
 
-         if ( cachefile != NULL ) {
+         if ( ( trans != NULL ) && ( cachefile != NULL ) ) {
             /* Cache newly-generated transparency map. */
             char dirpath[PATH_MAX];
             snprintf( dirpath, sizeof( dirpath ), "%s/%s", nfile_cachePath(),
                       "collisions/" );
             nfile_dirMakeExist( dirpath );
-            nfile_writeFile( (char *)trans, cachesize, cachefile );
-            free( cachefile );
+            nfile_writeFile( map, cachesize, cachefile );
          }
+         free( cachefile );
       }
 
-      tex->trans = trans;
+      *ptrans = trans;
    }
 
+   return 0;
+}
+
+/**
+ * @brief Uploads a decoded image to a texture.
+ *
+ *    @param tex Texture to load to.
+ *    @param surface Decoded image, freed by the function.
+ *    @param trans Transparency map of the image, owned by the texture after.
+ *    @param sx X sprites to load.
+ *    @param sy Y sprites to load.
+ *    @param flags Flags to control image parameters.
+ */
+static void gl_uploadImage( glTexture *tex, SDL_Surface *surface,
+                            glTransMap *trans, int sx, int sy,
+                            unsigned int flags )
+{
+   flags |= OPENGL_TEX_VFLIP;
+
    /* Load image if necessary. */
-   tex->w  = (double)surface->w;
-   tex->h  = (double)surface->h;
-   tex->sx = (double)sx;
-   tex->sy = (double)sy;
+   tex->trans = trans;
+   tex->w     = (double)surface->w;
+   tex->h     = (double)surface->h;
+   tex->sx    = (double)sx;
+   tex->sy    = (double)sy;
 
    tex->texture = gl_loadSurface( surface, flags, 0, &tex->vmax );
 
@@ -770,7 +1018,6 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
 
    /* Clean up. */
    SDL_FreeSurface( surface );
-   return 0;
 }
 
 /**
@@ -851,7 +1098,7 @@ void gl_freeTexture( glTexture *texture )
       if ( cur->used <= 0 ) { /* not used anymore */
          /* free the texture */
          glDeleteTextures( 1, &texture->texture );
-         free( texture->trans );
+         gl_transFree( texture->trans );
          free( texture->name );
          free( texture );
 
@@ -872,7 +1119,7 @@ void gl_freeTexture( glTexture *texture )
 
    /* Free anyways */
    glDeleteTextures( 1, &texture->texture );
-   free( texture->trans );
+   gl_transFree( texture->trans );
    free( texture->name );
    free( texture );
 
@@ -956,10 +1203,17 @@ USE_RESULT glTexture *gl_rawTexture( const char *name, GLuint texid, double w,
  */
 int gl_isTrans( const glTexture *t, const int x, const int y )
 {
-   /* Get the position in the sheet. */
-   int i = y * (int)( t->w ) + x;
+   const glTransMap *map = t->trans;
+   /* Get the sprite and position in it. */
+   int fx = x / map->sw;
+   int fy = y / map->sh;
+   int lx = x % map->sw;
+   /* Pixels left over on the borders of the sheet aren't part of any sprite. */
+   if ( fx >= map->sx || fy >= map->sy )
+      return 1;
    /* Now we have to pull out the individual bit. */
-   return !( t->trans[i / 8] & ( 1 << ( i % 8 ) ) );
+   return !( gl_transRow( map, fx, fy, y % map->sh )[lx / 64] &
+             ( UINT64_C( 1 ) << ( lx % 64 ) ) );
 }
 
 /**
@@ -1004,6 +1258,179 @@ void gl_getSpriteFromDir( int *x, int *y, int sx, int sy, double dir )
    ( *y ) = s / sx;
 }
 
+/**
+ * @brief Starts decoding an image in the background so that loading it later
+ * only has to upload it.
+ *
+ * Does nothing if the texture is already loaded or being streamed in. Decoded
+ * images are uploaded a few at a time by gl_texStreamUpdate, or right away if
+ * they are loaded with gl_newImage or gl_newSprite before that.
+ *
+ *    @param path Image to load.
+ *    @param sx Number of X sprites in image.
+ *    @param sy Number of Y sprites in image.
+ *    @param flags Flags the image will be loaded with.
+ */
+void gl_texPrefetch( const char *path, int sx, int sy, unsigned int flags )
+{
+   glTexStream *ts;
+
+   if ( ( path == NULL ) || ( flags & OPENGL_TEX_SKIPCACHE ) )
+      return;
+   if ( gl_texExists( path, flags, sx, sy ) )
+      return;
+
+   SDL_mutexP( stream_lock );
+   for ( int i = 0; i < array_size( tex_stream ); i++ ) {
+      const glTexStream *s = tex_stream[i];
+      if ( ( s->sx == sx ) && ( s->sy == sy ) && ( s->flags == flags ) &&
+           ( strcmp( s->path, path ) == 0 ) ) {
+         SDL_mutexV( stream_lock );
+         return;
+      }
+   }
+   ts        = calloc( 1, sizeof( glTexStream ) );
+   ts->path  = strdup( path );
+   ts->sx    = sx;
+   ts->sy    = sy;
+   ts->flags = flags;
+   ts->job   = job_create( NULL, NULL, NULL );
+   if ( tex_stream == NULL )
+      tex_stream = array_create( glTexStream * );
+   array_push_back( &tex_stream, ts );
+   SDL_mutexV( stream_lock );
+
+   job_run( job_create( gl_texStreamJob, ts, ts->job ) );
+}
+
+/**
+ * @brief Decodes a streamed image.
+ */
+static void gl_texStreamJob( Job *job, void *data )
+{
+   (void)job;
+   glTexStream *ts = data;
+   SDL_RWops   *rw = PHYSFSRWOPS_openRead( ts->path );
+   if ( rw == NULL )
+      WARN( _( "Failed to load surface '%s' from ndata." ), ts->path );
+   else {
+      gl_decodeImage( ts->path, rw, ts->sx, ts->sy, ts->flags, &ts->surface,
+                      &ts->trans );
+      SDL_RWclose( rw );
+   }
+   SDL_AtomicSet( &ts->done, 1 );
+}
+
+/**
+ * @brief Takes an image out of the stream, waiting for it to be decoded.
+ *
+ *    @return The streamed image or NULL if it is not being streamed in.
+ */
+static glTexStream *gl_texStreamTake( const char *path, int sx, int sy,
+                                      unsigned int flags )
+{
+   glTexStream *ts = NULL;
+
+   if ( stream_lock == NULL )
+      return NULL;
+
+   SDL_mutexP( stream_lock );
+   for ( int i = 0; i < array_size( tex_stream ); i++ ) {
+      glTexStream *s = tex_stream[i];
+      if ( ( s->sx == sx ) && ( s->sy == sy ) && ( s->flags == flags ) &&
+           ( strcmp( s->path, path ) == 0 ) ) {
+         ts = s;
+         array_erase( &tex_stream, &tex_stream[i], &tex_stream[i + 1] );
+         break;
+      }
+   }
+   SDL_mutexV( stream_lock );
+
+   if ( ts != NULL ) {
+      job_run( ts->job );
+      job_wait( ts->job );
+   }
+   return ts;
+}
+
+/**
+ * @brief Frees a streamed image.
+ */
+static void gl_texStreamFree( glTexStream *ts )
+{
+   SDL_FreeSurface( ts->surface );
+   gl_transFree( ts->trans );
+   free( ts->path );
+   free( ts );
+}
+
+/**
+ * @brief Uploads the images that finished decoding.
+ *
+ * Only spends TEX_STREAM_BUDGET seconds a frame so that streaming doesn't
+ * cause stutters. Should be called every frame from the main thread.
+ */
+void gl_texStreamUpdate( void )
+{
+   Uint64 t0 = SDL_GetPerformanceCounter();
+
+   if ( stream_lock == NULL )
+      return;
+
+   for ( ;; ) {
+      glTexStream *ts = NULL;
+
+      SDL_mutexP( stream_lock );
+      for ( int i = 0; i < array_size( tex_stream ); i++ ) {
+         if ( !SDL_AtomicGet( &tex_stream[i]->done ) )
+            continue;
+         ts = tex_stream[i];
+         array_erase( &tex_stream, &tex_stream[i], &tex_stream[i + 1] );
+         break;
+      }
+      SDL_mutexV( stream_lock );
+      if ( ts == NULL )
+         return;
+
+      job_run( ts->job );
+      job_wait( ts->job );
+      if ( ts->surface != NULL ) {
+         int        created;
+         glTexture *t = gl_texExistsOrCreate( ts->path, ts->flags, ts->sx,
+                                              ts->sy, &created );
+         if ( created ) {
+            gl_uploadImage( t, ts->surface, ts->trans, ts->sx, ts->sy,
+                            ts->flags );
+            ts->surface = NULL;
+            ts->trans   = NULL;
+         }
+         /* Keep a reference until gl_texStreamRelease. */
+         if ( tex_streamed == NULL )
+            tex_streamed = array_create( glTexture * );
+         array_push_back( &tex_streamed, t );
+      }
+      gl_texStreamFree( ts );
+
+      if ( (double)( SDL_GetPerformanceCounter() - t0 ) /
+              (double)SDL_GetPerformanceFrequency() >
+           TEX_STREAM_BUDGET )
+         return;
+   }
+}
+
+/**
+ * @brief Releases the references held to streamed textures.
+ *
+ * Textures that got used in the meantime stay loaded, the rest are freed.
+ */
+void gl_texStreamRelease( void )
+{
+   for ( int i = 0; i < array_size( tex_streamed ); i++ )
+      gl_freeTexture( tex_streamed[i] );
+   array_free( tex_streamed );
+   tex_streamed = NULL;
+}
+
 /**
  * @brief Initializes the opengl texture subsystem.
  *
@@ -1013,6 +1440,7 @@ int gl_initTextures( void )
 {
    gl_lock        = SDL_CreateMutex();
    tex_lock       = SDL_CreateMutex();
+   stream_lock    = SDL_CreateMutex();
    tex_mainthread = SDL_ThreadID();
    return 0;
 }
@@ -1022,6 +1450,18 @@ int gl_initTextures( void )
  */
 void gl_exitTextures( void )
 {
+   /* Finish streaming. */
+   for ( int i = 0; i < array_size( tex_stream ); i++ ) {
+      job_run( tex_stream[i]->job );
+      job_wait( tex_stream[i]->job );
+      gl_texStreamFree( tex_stream[i] );
+   }
+   array_free( tex_stream );
+   tex_stream = NULL;
+   gl_texStreamRelease();
+   SDL_DestroyMutex( stream_lock );
+   stream_lock = NULL;
+
    SDL_DestroyMutex( tex_lock );
    SDL_DestroyMutex( gl_lock );
 
@@ -35,6 +35,55 @@
    ( 1 << 5 ) /**< Clamp image border to transparency. */
 #define OPENGL_TEX_NOTSRGB ( 1 << 6 ) /**< Texture is not in SRGB format. */
 
+/**
+ * @brief Transparency map of a sprite sheet for pixel perfect collisions.
+ *
+ * Each sprite is stored separately with its rows padded to 64-bit words, so
+ * that rows of different sprites can be compared a word at a time. Bit x%64 of
+ * word x/64 of a row is set if pixel x can collide.
+ */
+typedef struct glTransMap_ {
+   int             sx;    /**< Number of sprites on the x axis. */
+   int             sy;    /**< Number of sprites on the y axis. */
+   int             sw;    /**< Width of a sprite in pixels. */
+   int             sh;    /**< Height of a sprite in pixels. */
+   int             words; /**< Number of words per row. */
+   const int16_t  *box;   /**< Bounding box of the set bits of each sprite as
+                             x0, y0, x1, y1 (x0>x1 if empty). */
+   const uint64_t *bits;  /**< Rows of all the sprites. */
+   void           *data;  /**< Memory of the map, as stored in the cache. */
+} glTransMap;
+
+/**
+ * @brief Gets a row of a sprite of a transparency map.
+ *
+ *    @param map Map to get row of.
+ *    @param sx X position of the sprite in the sheet.
+ *    @param sy Y position of the sprite in the sheet (in image rows).
+ *    @param y Row of the sprite.
+ *    @return The words of the row.
+ */
+static inline const uint64_t *gl_transRow( const glTransMap *map, int sx,
+                                           int sy, int y )
+{
+   return &map->bits[( (size_t)( sy * map->sx + sx ) * map->sh + y ) *
+                     map->words];
+}
+
+/**
+ * @brief Gets the bounding box of the set bits of a sprite.
+ *
+ *    @param map Map to get bounding box of.
+ *    @param sx X position of the sprite in the sheet.
+ *    @param sy Y position of the sprite in the sheet (in image rows).
+ *    @return The bounding box as x0, y0, x1, y1.
+ */
+static inline const int16_t *gl_transBox( const glTransMap *map, int sx,
+                                          int sy )
+{
+   return &map->box[4 * ( sy * map->sx + sx )];
+}
+
 /**
  * @brief Abstraction for rendering sprite sheets.
  *
@@ -56,9 +105,9 @@ typedef struct glTexture_ {
    double srh; /**< Sprite render height - equivalent to sh/h. */
 
    /* data */
-   GLuint   texture; /**< the opengl texture itself */
-   uint8_t *trans;   /**< maps the transparency */
-   double   vmax;    /**< Maximum value for SDF textures. */
+   GLuint      texture; /**< the opengl texture itself */
+   glTransMap *trans;   /**< maps the transparency */
+   double      vmax;    /**< Maximum value for SDF textures. */
 
    /* properties */
    uint8_t flags; /**< flags used for texture properties */
@@ -96,6 +145,13 @@ USE_RESULT glTexture *gl_rawTexture( const char *name, GLuint tex, double w,
  */
 void gl_freeTexture( glTexture *texture );
 
+/*
+ * Streaming.
+ */
+void gl_texPrefetch( const char *path, int sx, int sy, unsigned int flags );
+void gl_texStreamUpdate( void );
+void gl_texStreamRelease( void );
+
 /*
  * FBO stuff.
  */
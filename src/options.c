@@ -466,6 +466,9 @@ static int opt_gameplaySave( unsigned int wid, const char *str )
                    FONT_PATH_PREFIX, 0 ); /* small font */
       gl_fontInit( &gl_defFontMono, _( FONT_MONOSPACE_PATH ),
                    conf.font_size_def, FONT_PATH_PREFIX, 0 );
+      gl_fontPrewarm( &gl_defFont );
+      gl_fontPrewarm( &gl_smallFont );
+      gl_fontPrewarm( &gl_defFontMono );
    }
 
    /* Save the difficulty mode. */
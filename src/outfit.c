@@ -26,6 +26,7 @@
 #include "damagetype.h"
 #include "log.h"
 #include "mapData.h" // IWYU pragma: keep
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_camera.h"
@@ -62,8 +63,9 @@ typedef struct OutfitThreadData_ {
 /*
  * the stack
  */
-static Outfit *outfit_stack  = NULL; /**< Stack of outfits. */
-static char  **license_stack = NULL; /**< Stack of available licenses. */
+static Outfit   *outfit_stack  = NULL; /**< Stack of outfits. */
+static char    **license_stack = NULL; /**< Stack of available licenses. */
+static NameIndex outfit_nameidx;        /**< Outfit indices by name. */
 
 /*
  * Helper stuff for setting up short descriptions for outfits.
@@ -79,6 +81,7 @@ static char  **license_stack = NULL; /**< Stack of available licenses. */
 static OutfitType outfit_strToOutfitType( char *buf );
 /* parsing */
 static int  outfit_loadDir( const char *dir );
+static int  outfit_loadLibs( nlua_env env );
 static int  outfit_parseDamage( Damage *dmg, xmlNodePtr node );
 static int  outfit_parseThread( void *ptr );
 static int  outfit_parse( Outfit *temp, const char *file );
@@ -234,9 +237,10 @@ const Outfit *outfit_get( const char *name )
  */
 const Outfit *outfit_getW( const char *name )
 {
-   const Outfit s = { .name = (char *)name };
-   return bsearch( &s, outfit_stack, array_size( outfit_stack ),
-                   sizeof( Outfit ), outfit_cmp );
+   int id = nidx_get( &outfit_nameidx, name );
+   if ( id < 0 )
+      return NULL;
+   return &outfit_stack[id];
 }
 
 /**
@@ -2954,6 +2958,23 @@ static int outfit_loadDir( const char *dir )
    return 0;
 }
 
+/**
+ * @brief Loads the libraries of the outfit environments.
+ *
+ *    @param env Environment to load into.
+ *    @return 0 on success.
+ */
+static int outfit_loadLibs( nlua_env env )
+{
+   /* TODO limit libraries here. */
+   nlua_loadStandard( env );
+   nlua_loadGFX( env );
+   nlua_loadPilotOutfit( env );
+   nlua_loadCamera( env );
+   nlua_loadMunition( env );
+   return 0;
+}
+
 /**
  * @brief Loads all the outfits.
  *
@@ -2974,6 +2995,9 @@ int outfit_load( void )
    noutfits = array_size( outfit_stack );
    /* Sort up licenses. */
    qsort( outfit_stack, noutfits, sizeof( Outfit ), outfit_cmp );
+   nidx_create( &outfit_nameidx );
+   for ( int i = 0; i < noutfits; i++ )
+      nidx_set( &outfit_nameidx, outfit_stack[i].name, i );
    if ( license_stack != NULL )
       qsort( license_stack, array_size( license_stack ), sizeof( char * ),
              strsort );
@@ -3000,14 +3024,8 @@ int outfit_load( void )
          continue;
       }
 
-      env        = nlua_newEnv( o->lua_file );
+      env        = nlua_newEnvLibs( o->lua_file, outfit_loadLibs );
       o->lua_env = env;
-      /* TODO limit libraries here. */
-      nlua_loadStandard( env );
-      nlua_loadGFX( env );
-      nlua_loadPilotOutfit( env );
-      nlua_loadCamera( env );
-      nlua_loadMunition( env );
 
       /* Run code. */
       if ( nlua_dobufenv( env, dat, sz, o->lua_file ) != 0 ) {
@@ -3341,6 +3359,7 @@ void outfit_free( void )
 
    array_free( outfit_stack );
    array_free( license_stack );
+   nidx_free( &outfit_nameidx );
 }
 
 /**
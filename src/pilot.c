@@ -10,6 +10,8 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include "SDL_cpuinfo.h"
+
 #include "naev.h"
 /** @endcond */
 
@@ -19,6 +21,7 @@
 #include "array.h"
 #include "board.h"
 #include "camera.h"
+#include "conf.h"
 #include "damagetype.h"
 #include "debris.h"
 #include "debug.h"
@@ -40,8 +43,13 @@
 #include "quadtree.h"
 #include "rng.h"
 #include "sound.h"
+#include "threadpool.h"
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
+#define PILOT_QUERY_RADIUS                                                     \
+   2048. /**< Initial radius of the nearest pilot queries. */
+#define PILOT_QUERY_MAX                                                        \
+   1e9 /**< Radius at which queries just go over the whole stack. */
 
 /* ID Generators. */
 static unsigned int pilot_id =
@@ -54,11 +62,50 @@ static Pilot **pilot_stack =
 static Quadtree pilot_quadtree; /**< Quadtree for the pilots. */
 static IntList  pilot_qtquery;  /**< Quadtree query. */
 static int      qt_init = 0;
+static int     *pilot_qtVisible =
+   NULL; /**< Pilots in the quadtree that can be seen from any distance. */
+static double pilot_qtSignature = 0.; /**< Largest ew_signature in quadtree. */
+static double pilot_qtDetection = 0.; /**< Largest ew_detection in quadtree. */
+static double pilot_qtDetect    = 0.; /**< Largest ew_detect in quadtree. */
 /* A simple grid search procedure was used to determine the following
  * parameters. */
 static int qt_max_elem = 2;
 static int qt_depth    = 5;
 
+/**
+ * @brief How a pilot continues after the serial pre-update stage.
+ */
+typedef enum PilotUpdateStage_ {
+   PILOT_UPDATE_DONE,     /**< Nothing left to do this frame. */
+   PILOT_UPDATE_DISABLED, /**< Disabled or cooling down, only slows down. */
+   PILOT_UPDATE_NORMAL,   /**< Normal flight. */
+} PilotUpdateStage;
+
+/**
+ * @brief Pending pilot update for the parallel integration stage.
+ */
+typedef struct PilotUpdate_ {
+   Pilot           *p;     /**< Pilot being updated. */
+   double           dt;    /**< Delta tick modified by time speedup. */
+   PilotUpdateStage stage; /**< Stage to integrate with. */
+} PilotUpdate;
+
+/**
+ * @brief Chunk of pending updates handled by a single worker.
+ */
+typedef struct PilotUpdateChunk_ {
+   PilotUpdate *upd; /**< First update in the chunk. */
+   int          n;   /**< Number of updates in the chunk. */
+} PilotUpdateChunk;
+
+static PilotUpdate      *pilot_updates      = NULL; /**< Pending updates. */
+static PilotUpdateChunk *pilot_updateChunks = NULL; /**< Worker chunks. */
+static ThreadQueue      *pilot_vpool = NULL; /**< Integration stage queue. */
+static int pilot_stackGeneration = 0; /**< Increases when stack is cleaned. */
+#define PILOT_UPDATE_PARALLEL_MIN                                              \
+   32 /**< Minimum pilots to bother integrating in parallel. */
+#define PILOT_UPDATE_CHUNK_MIN 8 /**< Minimum pilots per worker. */
+
 /* misc */
 static const double pilot_commTimeout =
    15.; /**< Time for text above pilot to time out. */
@@ -76,7 +123,13 @@ static void pilot_init( Pilot *dest, const Ship *ship, const char *name,
 /* Update. */
 static void pilot_hyperspace( Pilot *pilot, double dt );
 static void pilot_refuel( Pilot *p, double dt );
-static void pilot_updateSolid( Pilot *p, double dt );
+static void             pilot_updateSolid( Pilot *p, double dt );
+static PilotUpdateStage pilot_updatePre( Pilot *pilot, double dt );
+static void pilot_updateIntegrate( Pilot *pilot, PilotUpdateStage stage,
+                                   double dt );
+static void pilot_updatePost( Pilot *pilot, double dt );
+static int  pilot_updateIntegrateChunk( void *data );
+static void pilots_updateParallel( double dt );
 /* Clean up. */
 static void pilot_erase( Pilot *p );
 /* Misc. */
@@ -86,6 +139,16 @@ static int  pilot_getStackPos( unsigned int id );
 static void pilot_init_trails( Pilot *p );
 static int  pilot_trail_generated( Pilot *p, int generator );
 static void pilot_addQuadtree( const Pilot *p, int i );
+static void pilot_queryBox( IntList *il, double x, double y, double r );
+static int  pilot_queryInsert( Pilot **out, double *scores, int n, int k,
+                               Pilot *p, double s );
+static int  pilot_queryCmp( const void *p1, const void *p2 );
+static int  pilot_queryEnemy( const Pilot *t, double d2, const void *data,
+                              double *score );
+static int  pilot_queryEnemySize( const Pilot *t, double d2, const void *data,
+                                  double *score );
+static int  pilot_queryEnemyHeuristic( const Pilot *t, double d2,
+                                       const void *data, double *score );
 
 /**
  * @brief Gets the pilot stack.
@@ -322,6 +385,19 @@ int pilot_validEnemy( const Pilot *p, const Pilot *target )
    return 1;
 }
 
+/**
+ * @brief Scores valid enemies by distance.
+ */
+static int pilot_queryEnemy( const Pilot *t, double d2, const void *data,
+                             double *score )
+{
+   const Pilot *p = data;
+   if ( !pilot_validEnemy( p, t ) )
+      return 0;
+   *score = d2;
+   return 1;
+}
+
 /**
  * @brief Gets the nearest enemy to the pilot.
  *
@@ -330,23 +406,36 @@ int pilot_validEnemy( const Pilot *p, const Pilot *target )
  */
 unsigned int pilot_getNearestEnemy( const Pilot *p )
 {
-   unsigned int tp = 0;
-   double       d  = 0.;
-
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double td;
+   Pilot *t;
+   if ( pilot_queryNearest( &t, 1, p->solid.pos.x, p->solid.pos.y,
+                            pilot_queryDetectRange( p ), 1., pilot_queryEnemy,
+                            p ) <= 0 )
+      return 0;
+   return t->id;
+}
 
-      if ( !pilot_validEnemy( p, pilot_stack[i] ) )
-         continue;
+/**
+ * @brief Data for pilot_queryEnemySize.
+ */
+typedef struct PilotQueryEnemySize_ {
+   const Pilot *p;       /**< Pilot looking for enemies. */
+   double       mass_LB; /**< Lower bound of the mass. */
+   double       mass_UB; /**< Upper bound of the mass. */
+} PilotQueryEnemySize;
 
-      /* Check distance. */
-      td = vec2_dist2( &pilot_stack[i]->solid.pos, &p->solid.pos );
-      if ( !tp || ( td < d ) ) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
-   return tp;
+/**
+ * @brief Scores valid enemies within a mass range by distance.
+ */
+static int pilot_queryEnemySize( const Pilot *t, double d2, const void *data,
+                                 double *score )
+{
+   const PilotQueryEnemySize *q = data;
+   if ( !pilot_validEnemy( q->p, t ) )
+      return 0;
+   if ( ( t->solid.mass < q->mass_LB ) || ( t->solid.mass > q->mass_UB ) )
+      return 0;
+   *score = d2;
+   return 1;
 }
 
 /**
@@ -361,28 +450,41 @@ unsigned int pilot_getNearestEnemy( const Pilot *p )
 unsigned int pilot_getNearestEnemy_size( const Pilot *p, double target_mass_LB,
                                          double target_mass_UB )
 {
-   unsigned int tp = 0;
-   double       d  = 0.;
-
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double td;
-
-      if ( !pilot_validEnemy( p, pilot_stack[i] ) )
-         continue;
-
-      if ( pilot_stack[i]->solid.mass < target_mass_LB ||
-           pilot_stack[i]->solid.mass > target_mass_UB )
-         continue;
+   Pilot              *t;
+   PilotQueryEnemySize q = {
+      .p = p, .mass_LB = target_mass_LB, .mass_UB = target_mass_UB };
+   if ( pilot_queryNearest( &t, 1, p->solid.pos.x, p->solid.pos.y,
+                            pilot_queryDetectRange( p ), 1.,
+                            pilot_queryEnemySize, &q ) <= 0 )
+      return 0;
+   return t->id;
+}
 
-      /* Check distance. */
-      td = vec2_dist2( &pilot_stack[i]->solid.pos, &p->solid.pos );
-      if ( !tp || ( td < d ) ) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
+/**
+ * @brief Data for pilot_queryEnemyHeuristic.
+ */
+typedef struct PilotQueryEnemyHeuristic_ {
+   const Pilot *p;             /**< Pilot looking for enemies. */
+   double       mass_factor;   /**< Target mass parameter. */
+   double       health_factor; /**< Target health parameter. */
+   double       damage_factor; /**< Target dps parameter. */
+   double       range_factor;  /**< Weighting for range. */
+} PilotQueryEnemyHeuristic;
 
-   return tp;
+/**
+ * @brief Scores valid enemies with the heuristic.
+ */
+static int pilot_queryEnemyHeuristic( const Pilot *t, double d2,
+                                      const void *data, double *score )
+{
+   const PilotQueryEnemyHeuristic *q = data;
+   if ( !pilot_validEnemy( q->p, t ) )
+      return 0;
+   *score = q->range_factor * d2 +
+            FABS( pilot_relsize( q->p, t ) - q->mass_factor ) +
+            FABS( pilot_relhp( q->p, t ) - q->health_factor ) +
+            FABS( pilot_reldps( q->p, t ) - q->damage_factor );
+   return 1;
 }
 
 /**
@@ -403,29 +505,19 @@ unsigned int pilot_getNearestEnemy_heuristic( const Pilot *p,
                                               double       damage_factor,
                                               double       range_factor )
 {
-   unsigned int tp                      = 0;
-   double       current_heuristic_value = 10e3;
-
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double temp;
-      Pilot *target = pilot_stack[i];
-
-      if ( !pilot_validEnemy( p, target ) )
-         continue;
-
-      /* Check distance. */
-      temp = range_factor * vec2_dist2( &target->solid.pos, &p->solid.pos ) +
-             FABS( pilot_relsize( p, target ) - mass_factor ) +
-             FABS( pilot_relhp( p, target ) - health_factor ) +
-             FABS( pilot_reldps( p, target ) - damage_factor );
-
-      if ( ( tp == 0 ) || ( temp < current_heuristic_value ) ) {
-         current_heuristic_value = temp;
-         tp                      = target->id;
-      }
-   }
-
-   return tp;
+   Pilot                   *t;
+   PilotQueryEnemyHeuristic q = { .p             = p,
+                                  .mass_factor   = mass_factor,
+                                  .health_factor = health_factor,
+                                  .damage_factor = damage_factor,
+                                  .range_factor  = range_factor };
+   /* The other terms are never negative, so the range term bounds the score
+    * and lets the search stop early. */
+   if ( pilot_queryNearest(
+           &t, 1, p->solid.pos.x, p->solid.pos.y, pilot_queryDetectRange( p ),
+           MAX( range_factor, 0. ), pilot_queryEnemyHeuristic, &q ) <= 0 )
+      return 0;
+   return t->id;
 }
 
 /**
@@ -813,6 +905,278 @@ void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 )
    qt_query( &pilot_quadtree, il, x1, y1, x2, y2 );
 }
 
+void pilot_collideQueryTemp( QuadtreeTemp *tmp, IntList *il, int x1, int y1,
+                             int x2, int y2 )
+{
+   qt_query_temp( &pilot_quadtree, tmp, il, x1, y1, x2, y2 );
+}
+
+/**
+ * @brief Queries the pilot quadtree for the box containing a circle.
+ */
+static void pilot_queryBox( IntList *il, double x, double y, double r )
+{
+   int x1 = floor( CLAMP( -PILOT_QUERY_MAX, PILOT_QUERY_MAX, x - r ) );
+   int y1 = floor( CLAMP( -PILOT_QUERY_MAX, PILOT_QUERY_MAX, y - r ) );
+   int x2 = ceil( CLAMP( -PILOT_QUERY_MAX, PILOT_QUERY_MAX, x + r ) );
+   int y2 = ceil( CLAMP( -PILOT_QUERY_MAX, PILOT_QUERY_MAX, y + r ) );
+   qt_query( &pilot_quadtree, il, x1, y1, x2, y2 );
+}
+
+/**
+ * @brief Gets a pilot returned by the quadtree if it can be queried.
+ *
+ * The stack may have changed since the quadtree was built, so the position
+ * has to be checked.
+ */
+static Pilot *pilot_queryGet( int i )
+{
+   Pilot *p;
+   if ( i >= array_size( pilot_stack ) )
+      return NULL;
+   p = pilot_stack[i];
+   if ( pilot_isFlag( p, PILOT_DELETE ) || pilot_isFlag( p, PILOT_HIDE ) )
+      return NULL;
+   return p;
+}
+
+/**
+ * @brief Compares stack positions for qsort.
+ */
+static int pilot_queryCmp( const void *p1, const void *p2 )
+{
+   return *(const int *)p1 - *(const int *)p2;
+}
+
+/**
+ * @brief Gets the pilots within a radius of a point.
+ *
+ * Uses the pilot quadtree, so only pilots that are not hidden nor being
+ * deleted are returned. The results are appended to the list in stack order,
+ * so they match what a linear scan over the stack would give.
+ *
+ *    @param il List to append the stack positions of the pilots to.
+ *    @param x X position of the center.
+ *    @param y Y position of the center.
+ *    @param r Radius to look in. Use a non-finite radius to get all pilots.
+ *    @param viewer If not NULL, also add the pilots the viewer can see from any
+ *           distance, such as those with PILOT_VISIBLE and its escorts.
+ *    @return Number of pilots appended.
+ */
+int pilot_queryRadius( IntList *il, double x, double y, double r,
+                       const Pilot *viewer )
+{
+   IntList   qt;
+   int      *idx;
+   int       n, m;
+   double    r2;
+   ArenaMark mark = arena_mark( arena_scratch() );
+
+   /* Radius so large it's not worth using the quadtree. */
+   if ( !isfinite( r ) || ( r >= PILOT_QUERY_MAX ) ) {
+      n = 0;
+      for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+         if ( pilot_queryGet( i ) == NULL )
+            continue;
+         il_set( il, il_push_back( il ), 0, i );
+         n++;
+      }
+      arena_release( &mark );
+      return n;
+   }
+
+   r  = MAX( r, 0. );
+   r2 = pow2( r );
+   il_createArena( &qt, 1, mark.arena );
+   pilot_queryBox( &qt, x, y, r );
+   idx = arena_alloc( mark.arena,
+                      sizeof( int ) * ( il_size( &qt ) +
+                                        array_size( pilot_qtVisible ) +
+                                        ( ( viewer != NULL )
+                                             ? array_size( viewer->escorts )
+                                             : 0 ) ) );
+   n   = 0;
+   for ( int i = 0; i < il_size( &qt ); i++ ) {
+      int          j = il_get( &qt, i, 0 );
+      const Pilot *p = pilot_queryGet( j );
+      if ( p == NULL )
+         continue;
+      if ( pow2( p->solid.pos.x - x ) + pow2( p->solid.pos.y - y ) > r2 )
+         continue;
+      idx[n++] = j;
+   }
+
+   /* Pilots outside the radius that can be seen from anywhere. */
+   if ( viewer != NULL ) {
+      for ( int i = 0; i < array_size( pilot_qtVisible ); i++ ) {
+         int          j = pilot_qtVisible[i];
+         const Pilot *p = pilot_queryGet( j );
+         if ( p == NULL )
+            continue;
+         if ( pow2( p->solid.pos.x - x ) + pow2( p->solid.pos.y - y ) <= r2 )
+            continue;
+         idx[n++] = j;
+      }
+
+      /* Escorts are always seen by their parent, duplicates are removed
+       * below. */
+      for ( int i = 0; i < array_size( viewer->escorts ); i++ ) {
+         int          j = pilot_getStackPos( viewer->escorts[i].id );
+         const Pilot *p = ( j >= 0 ) ? pilot_queryGet( j ) : NULL;
+         if ( ( p == NULL ) || ( p->parent != viewer->id ) )
+            continue;
+         idx[n++] = j;
+      }
+   }
+
+   qsort( idx, n, sizeof( int ), pilot_queryCmp );
+   m = 0;
+   for ( int i = 0; i < n; i++ ) {
+      if ( ( i > 0 ) && ( idx[i] == idx[i - 1] ) )
+         continue;
+      il_set( il, il_push_back( il ), 0, idx[i] );
+      m++;
+   }
+   arena_release( &mark );
+   return m;
+}
+
+/**
+ * @brief Inserts a candidate into the sorted list of best pilots.
+ *
+ *    @return New number of pilots in the list.
+ */
+static int pilot_queryInsert( Pilot **out, double *scores, int n, int k,
+                              Pilot *p, double s )
+{
+   int i;
+   if ( ( n >= k ) && ( s >= scores[n - 1] ) )
+      return n;
+   i = MIN( n, k - 1 );
+   while ( ( i > 0 ) && ( scores[i - 1] > s ) ) {
+      out[i]    = out[i - 1];
+      scores[i] = scores[i - 1];
+      i--;
+   }
+   out[i]    = p;
+   scores[i] = s;
+   return MIN( n + 1, k );
+}
+
+/**
+ * @brief Gets the best scoring pilots around a point.
+ *
+ * Looks in rings of increasing radius around the point, and stops as soon as
+ * no pilot further away can beat the ones already found. For this to work,
+ * the score of a pilot at a squared distance d2 must be at least weight*d2.
+ * Only pilots that are not hidden nor being deleted are considered, and those
+ * that are visible from any distance are always considered.
+ *
+ *    @param[out] out Array of at least k pilots to fill, sorted by score.
+ *    @param k Maximum number of pilots to get.
+ *    @param x X position of the center.
+ *    @param y Y position of the center.
+ *    @param rmax Maximum radius to look in.
+ *    @param weight Lower bound on the score per squared distance.
+ *    @param func Function that filters and scores the candidates. Lower scores
+ *           are better.
+ *    @param data User data to pass to func.
+ *    @return Number of pilots found.
+ */
+int pilot_queryNearest( Pilot **out, int k, double x, double y, double rmax,
+                        double weight, PilotQueryFunc func, const void *data )
+{
+   IntList   qt;
+   double   *scores;
+   double    r, r2, r2in;
+   int       n, full;
+   ArenaMark mark;
+
+   if ( k <= 0 )
+      return 0;
+
+   mark   = arena_mark( arena_scratch() );
+   scores = arena_alloc( mark.arena, sizeof( double ) * k );
+   il_createArena( &qt, 1, mark.arena );
+   rmax = MAX( rmax, 0. );
+   n    = 0;
+   r2in = -1.;
+   r    = MIN( PILOT_QUERY_RADIUS, rmax );
+   full = 0;
+   while ( 1 ) {
+      full = !isfinite( r ) || ( r >= PILOT_QUERY_MAX );
+      r2   = pow2( r );
+      if ( full ) {
+         il_clear( &qt );
+         for ( int i = 0; i < array_size( pilot_stack ); i++ )
+            il_set( &qt, il_push_back( &qt ), 0, i );
+      } else
+         pilot_queryBox( &qt, x, y, r );
+
+      /* Only look at the pilots in the new ring. */
+      for ( int i = 0; i < il_size( &qt ); i++ ) {
+         double s, d2;
+         Pilot *p = pilot_queryGet( il_get( &qt, i, 0 ) );
+         if ( p == NULL )
+            continue;
+         d2 = pow2( p->solid.pos.x - x ) + pow2( p->solid.pos.y - y );
+         if ( ( d2 <= r2in ) || ( !full && ( d2 > r2 ) ) )
+            continue;
+         if ( func( p, d2, data, &s ) )
+            n = pilot_queryInsert( out, scores, n, k, p, s );
+      }
+
+      /* Nothing further away can do better. */
+      if ( full || ( r >= rmax ) ||
+           ( ( n >= k ) && ( scores[n - 1] <= weight * r2 ) ) )
+         break;
+      r2in = r2;
+      r    = MIN( 2. * r, rmax );
+   }
+
+   /* Pilots outside the radius that can be seen from anywhere. */
+   if ( !full ) {
+      for ( int i = 0; i < array_size( pilot_qtVisible ); i++ ) {
+         double s, d2;
+         Pilot *p = pilot_queryGet( pilot_qtVisible[i] );
+         if ( p == NULL )
+            continue;
+         d2 = pow2( p->solid.pos.x - x ) + pow2( p->solid.pos.y - y );
+         if ( d2 <= r2 )
+            continue;
+         if ( func( p, d2, data, &s ) )
+            n = pilot_queryInsert( out, scores, n, k, p, s );
+      }
+   }
+
+   arena_release( &mark );
+   return n;
+}
+
+/**
+ * @brief Gets an upper bound on the distance a pilot can detect others at.
+ *
+ * Based on the largest signature and detection of the pilots in the system
+ * this frame.
+ *
+ *    @param p Pilot to get the detection range of.
+ *    @return The maximum distance the pilot can detect another pilot at.
+ */
+double pilot_queryDetectRange( const Pilot *p )
+{
+   return MAX( 0., p->stats.ew_detect * MAX( p->stats.ew_track *
+                                                pilot_qtSignature,
+                                             pilot_qtDetection ) );
+}
+
+/**
+ * @brief Gets the largest detection modifier of the pilots in the system.
+ */
+double pilot_queryDetectMax( void )
+{
+   return pilot_qtDetect;
+}
+
 /**
  * @brief Tries to turn the pilot to face dir.
  *
@@ -1158,8 +1522,11 @@ void pilot_broadcast( Pilot *p, const char *msg, int ignore_int )
  */
 void pilot_distress( Pilot *p, Pilot *attacker, const char *msg )
 {
-   int    r;
-   double d;
+   int           r, n;
+   double        d;
+   IntList       il;
+   unsigned int *ids;
+   ArenaMark     mark;
 
    /* Broadcast the message. */
    if ( ( msg != NULL ) && ( msg[0] != '\0' ) )
@@ -1189,12 +1556,24 @@ void pilot_distress( Pilot *p, Pilot *attacker, const char *msg )
       }
    }
 
+   /* Only pilots that can be detected or are within sensor range can get the
+    * signal. The AI may modify the stack, so work with IDs. */
+   mark = arena_mark( arena_scratch() );
+   il_createArena( &il, 1, mark.arena );
+   n   = pilot_queryRadius( &il, p->solid.pos.x, p->solid.pos.y,
+                            MAX( pilot_queryDetectRange( p ),
+                                 sqrt( pilot_sensorRange() ) ),
+                            p );
+   ids = arena_alloc( mark.arena, sizeof( unsigned int ) * MAX( n, 1 ) );
+   for ( int i = 0; i < n; i++ )
+      ids[i] = pilot_stack[il_get( &il, i, 0 )]->id;
+
    /* Now we must check to see if a pilot is in range. */
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      Pilot *pi = pilot_stack[i];
+   for ( int i = 0; i < n; i++ ) {
+      Pilot *pi = pilot_get( ids[i] );
 
       /* Skip if unsuitable. */
-      if ( ( pi->ai == NULL ) || ( pi->id == p->id ) ||
+      if ( ( pi == NULL ) || ( pi->ai == NULL ) || ( pi->id == p->id ) ||
            ( pilot_isFlag( pi, PILOT_DEAD ) ) ||
            ( pilot_isFlag( pi, PILOT_DELETE ) ) )
          continue;
@@ -1217,6 +1596,7 @@ void pilot_distress( Pilot *p, Pilot *attacker, const char *msg )
            !areEnemies( p->faction, pi->faction ) )
          r = 1;
    }
+   arena_release( &mark );
 
    /* Player only gets one faction hit per pilot. */
    if ( !pilot_isFlag( p, PILOT_DISTRESSED ) ) {
@@ -1913,7 +2293,7 @@ void pilot_renderFramebuffer( Pilot *p, GLuint fbo, double fw, double fh,
       glUniform1f( ed->u_dir, p->solid.dir );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clean up texture. */
       if ( ed->img != NULL ) {
@@ -1992,6 +2372,7 @@ void pilot_render( Pilot *p )
       if ( e == NULL ) {
          if ( p->ship->gfx_3d != NULL ) {
             /* Render to framebuffer first. */
+            gl_batchFlush();
             pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw,
                                          gl_screen.nh, NULL );
 
@@ -2014,6 +2395,8 @@ void pilot_render( Pilot *p )
          mat4              projection, tex_mat;
          const EffectData *ed = e->data;
 
+         gl_batchFlush();
+
          /* Have to scissors a bit more in case of custom vertex effects. */
          if ( ed->flags & EFFECT_VERTEX ) {
             double s = ceil( 2.0 * p->ship->size / gl_screen.scale );
@@ -2071,7 +2454,7 @@ void pilot_render( Pilot *p )
          glUniform1f( ed->u_dir, p->solid.dir );
 
          /* Draw. */
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up texture. */
          if ( ed->img != NULL ) {
@@ -2092,8 +2475,10 @@ void pilot_render( Pilot *p )
    }
    for ( int i = 0, g = 0; g < array_size( p->ship->trail_emitters ); g++ ) {
       if ( pilot_trail_generated( p, g ) ) {
-         if ( p->trail[i]->ontop )
+         if ( p->trail[i]->ontop ) {
+            gl_batchFlush();
             spfx_trail_draw( p->trail[i] );
+         }
          i++;
       }
    }
@@ -2113,6 +2498,9 @@ void pilot_render( Pilot *p )
 
    /* Useful debug stuff below. */
 #ifdef DEBUGGING
+   if ( inbounds && ( debug_isFlag( DEBUG_MARK_COLLISION ) ||
+                      debug_isFlag( DEBUG_MARK_EMITTER ) ) )
+      gl_batchFlush();
    if ( inbounds && debug_isFlag( DEBUG_MARK_COLLISION ) ) {
       static gl_vbo      *poly_vbo = NULL;
       GLfloat             data[1024];
@@ -2149,7 +2537,7 @@ void pilot_render( Pilot *p )
       gl_uniformColour( shaders.lines.colour, &cWhite );
 
       /* Draw. */
-      glDrawArrays( GL_LINE_LOOP, 0, n );
+      gl_drawArrays( GL_LINE_LOOP, 0, n );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.lines.vertex );
@@ -2301,19 +2689,43 @@ void pilot_renderOverlay( Pilot *p )
 /**
  * @brief Updates the pilot.
  *
+ * This is the serial version, it runs all the update stages back to back. See
+ * pilots_update() for the parallel version.
+ *
  *    @param pilot Pilot to update.
  *    @param dt Current delta tick.
  */
 void pilot_update( Pilot *pilot, double dt )
+{
+   PilotUpdateStage stage;
+
+   /* Modify the dt with speedup. */
+   dt *= pilot->stats.time_speedup;
+
+   stage = pilot_updatePre( pilot, dt );
+   if ( stage == PILOT_UPDATE_DONE )
+      return;
+   pilot_updateIntegrate( pilot, stage, dt );
+   pilot_updatePost( pilot, dt );
+}
+
+/**
+ * @brief Serial part of the pilot update before integrating.
+ *
+ * Handles timers, outfits, damage, death and everything else that may touch
+ * other pilots, run hooks or run Lua.
+ *
+ *    @param pilot Pilot to update.
+ *    @param dt Current delta tick (already modified by time speedup).
+ *    @return How the pilot should be integrated afterwards.
+ */
+static PilotUpdateStage pilot_updatePre( Pilot *pilot, double dt )
 {
    int    cooling, nchg;
    Pilot *target;
    double a, px, py, vx, vy;
    Target wt;
 
-   /* Modify the dt with speedup. */
-   dt *= pilot->stats.time_speedup;
-
    /* Check target validity. */
    target  = pilot_weaponTarget( pilot, &wt );
    cooling = pilot_isFlag( pilot, PILOT_COOLDOWN );
@@ -2479,7 +2891,7 @@ void pilot_update( Pilot *pilot, double dt )
             pilot_setFlag( pilot, PILOT_NONTARGETABLE );
             pilot->itimer = PILOT_PLAYER_NONTARGETABLE_TAKEOFF_DELAY;
          }
-         return;
+         return PILOT_UPDATE_DONE;
       }
    } else if ( pilot_isFlag( pilot, PILOT_LANDING ) ) {
       if ( pilot->ptimer < 0. ) {
@@ -2488,7 +2900,7 @@ void pilot_update( Pilot *pilot, double dt )
             pilot->ptimer = 0.;
          } else
             pilot_delete( pilot );
-         return;
+         return PILOT_UPDATE_DONE;
       }
    }
    /* he's dead jim */
@@ -2571,7 +2983,7 @@ void pilot_update( Pilot *pilot, double dt )
             if ( pilot->id == PLAYER_ID ) /* player.p handled differently */
                player_destroyed();
             pilot_delete( pilot );
-            return;
+            return PILOT_UPDATE_DONE;
          }
       }
    } else if ( pilot_isFlag( pilot, PILOT_NONTARGETABLE ) ) {
@@ -2647,47 +3059,16 @@ void pilot_update( Pilot *pilot, double dt )
    /* Update effects. */
    nchg += effect_update( &pilot->effects, dt );
    if ( pilot_isFlag( pilot, PILOT_DELETE ) )
-      return; /* It's possible for effects to remove the pilot causing future
-                 Lua to be unhappy. */
+      return PILOT_UPDATE_DONE; /* It's possible for effects to remove the
+                                   pilot causing future Lua to be unhappy. */
 
    /* Must recalculate stats because something changed state. */
    if ( ( nchg > 0 ) || pilotoutfit_modified )
       pilot_calcStats( pilot );
 
    /* purpose fallthrough to get the movement like disabled */
-   if ( pilot_isDisabled( pilot ) || cooling ) {
-      /* Do the slow brake thing */
-      pilot->solid.speed_max = 0.;
-      pilot_setAccel( pilot, 0. );
-      pilot_setTurn( pilot, 0. );
-
-      /* Update the solid */
-      pilot_updateSolid( pilot, dt );
-
-      /* Engine glow decay. */
-      if ( pilot->engine_glow > 0. ) {
-         pilot->engine_glow -= MAX( 0.5, pilot->accel / pilot->speed ) * dt;
-         if ( pilot->engine_glow < 0. )
-            pilot->engine_glow = 0.;
-      }
-
-      /* Update the trail. */
-      pilot_sample_trails( pilot, 0 );
-
-      /* Cooldown still updates outfits. */
-      pilot_shipLUpdate( pilot, dt );
-
-      /* Update outfits if necessary. */
-      pilot->otimer += dt;
-      while ( pilot->otimer >= PILOT_OUTFIT_LUA_UPDATE_DT ) {
-         pilot_outfitLUpdate( pilot, PILOT_OUTFIT_LUA_UPDATE_DT );
-         if ( pilot_isFlag( pilot, PILOT_DELETE ) )
-            return; /* Same as with the effects, it is theoretically possible
-                       for the outfit to remove the pilot. */
-         pilot->otimer -= PILOT_OUTFIT_LUA_UPDATE_DT;
-      }
-      return;
-   }
+   if ( pilot_isDisabled( pilot ) || cooling )
+      return PILOT_UPDATE_DISABLED;
 
    /* Player damage decay. */
    if ( pilot->player_damage > 0. )
@@ -2739,6 +3120,43 @@ void pilot_update( Pilot *pilot, double dt )
    } else
       pilot->solid.speed_max = -1.; /* Disables max speed. */
 
+   return PILOT_UPDATE_NORMAL;
+}
+
+/**
+ * @brief Integrates the pilot's movement.
+ *
+ * Only touches the pilot's own state so it can be run in parallel for all the
+ * pilots.
+ *
+ *    @param pilot Pilot to integrate.
+ *    @param stage Stage returned by pilot_updatePre().
+ *    @param dt Current delta tick (already modified by time speedup).
+ */
+static void pilot_updateIntegrate( Pilot *pilot, PilotUpdateStage stage,
+                                   double dt )
+{
+   if ( stage == PILOT_UPDATE_DISABLED ) {
+      /* Do the slow brake thing */
+      pilot->solid.speed_max = 0.;
+      pilot_setAccel( pilot, 0. );
+      pilot_setTurn( pilot, 0. );
+
+      /* Update the solid */
+      pilot_updateSolid( pilot, dt );
+
+      /* Engine glow decay. */
+      if ( pilot->engine_glow > 0. ) {
+         pilot->engine_glow -= MAX( 0.5, pilot->accel / pilot->speed ) * dt;
+         if ( pilot->engine_glow < 0. )
+            pilot->engine_glow = 0.;
+      }
+
+      /* Update the trail. */
+      pilot_sample_trails( pilot, 0 );
+      return;
+   }
+
    /* Set engine glow. */
    if ( pilot->solid.accel > 0. ) {
       /*pilot->engine_glow += pilot->accel / pilot->speed * dt;*/
@@ -2775,8 +3193,17 @@ void pilot_update( Pilot *pilot, double dt )
 
    /* Update the trail. */
    pilot_sample_trails( pilot, 0 );
+}
 
-   /* Update pilot Lua. */
+/**
+ * @brief Serial part of the pilot update after integrating.
+ *
+ *    @param pilot Pilot to update.
+ *    @param dt Current delta tick (already modified by time speedup).
+ */
+static void pilot_updatePost( Pilot *pilot, double dt )
+{
+   /* Update pilot Lua (cooldown and disabled pilots still update outfits). */
    pilot_shipLUpdate( pilot, dt );
 
    /* Update outfits if necessary. */
@@ -3957,7 +4384,11 @@ void pilot_stackRemove( Pilot *p )
  */
 void pilots_init( void )
 {
-   pilot_stack = array_create_size( Pilot *, PILOT_SIZE_MIN );
+   pilot_stack        = array_create_size( Pilot *, PILOT_SIZE_MIN );
+   pilot_updates      = array_create_size( PilotUpdate, PILOT_SIZE_MIN );
+   pilot_updateChunks = array_create( PilotUpdateChunk );
+   pilot_vpool        = vpool_create();
+   pilot_qtVisible    = array_create( int );
    il_create( &pilot_qtquery, 1 );
 }
 
@@ -3987,9 +4418,20 @@ void pilots_free( void )
    free( player.ps.acquired );
    memset( &player.ps, 0, sizeof( PlayerShip_t ) );
 
+   /* Clean up parallel update. */
+   array_free( pilot_updates );
+   pilot_updates = NULL;
+   array_free( pilot_updateChunks );
+   pilot_updateChunks = NULL;
+   if ( pilot_vpool != NULL )
+      vpool_cleanup( pilot_vpool );
+   pilot_vpool = NULL;
+
    /* Clean up quadtree. */
    qt_destroy( &pilot_quadtree );
    il_destroy( &pilot_qtquery );
+   array_free( pilot_qtVisible );
+   pilot_qtVisible = NULL;
 }
 
 /**
@@ -4002,6 +4444,9 @@ void pilots_clean( int persist )
    int persist_count = 0;
    NTracingZone( _ctx, 1 );
 
+   /* Invalidates any pilot update in progress. */
+   pilot_stackGeneration++;
+
    /* First pass to stop outfits without clearing stuff - this can call all
     * sorts of Lua stuff. */
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
@@ -4075,6 +4520,7 @@ void pilots_newSystem( void )
       qt_destroy( &pilot_quadtree );
    qt_create( &pilot_quadtree, -r, -r, r, r, qt_max_elem, qt_depth );
    qt_init = 1;
+   array_resize( &pilot_qtVisible, 0 );
 
    NTracingZoneEnd( _ctx );
 }
@@ -4116,6 +4562,13 @@ static void pilot_addQuadtree( const Pilot *p, int i )
    h2 = ceil( p->ship->size * 0.5 );
    qt_insert( &pilot_quadtree, i, MIN( x, px ) - w2, MIN( y, py ) - h2,
               MAX( x, px ) + w2, MAX( y, py ) + h2 );
+
+   /* Bounds for the neighbour queries. */
+   pilot_qtSignature = MAX( pilot_qtSignature, p->ew_signature );
+   pilot_qtDetection = MAX( pilot_qtDetection, p->ew_detection );
+   pilot_qtDetect    = MAX( pilot_qtDetect, p->stats.ew_detect );
+   if ( pilot_isFlag( p, PILOT_VISIBLE ) || pilot_isFlag( p, PILOT_VISPLAYER ) )
+      array_push_back( &pilot_qtVisible, i );
 }
 
 /**
@@ -4139,6 +4592,10 @@ void pilots_updatePurge( void )
 
    /* Second loop sets up quadtrees. */
    qt_clear( &pilot_quadtree ); /* Empty it. */
+   array_resize( &pilot_qtVisible, 0 );
+   pilot_qtSignature = 0.;
+   pilot_qtDetection = 0.;
+   pilot_qtDetect    = 0.;
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       const Pilot *p = pilot_stack[i];
 
@@ -4209,13 +4666,71 @@ void pilots_update( double dt )
          if ( pilot_isFlag( p, PILOT_PLAYER ) )
             player_think( p, dt );
          else
-            ai_think( p, dt, 1 );
+            ai_thinkLOD( p, dt );
       }
    }
+   ai_lodUpdate();
 
    /* Now update all the pilots. */
+   if ( !conf.deterministic )
+      pilots_updateParallel( dt );
+   else {
+      for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+         Pilot *p = pilot_stack[i];
+
+         /* Ignore. */
+         if ( pilot_isFlag( p, PILOT_DELETE ) )
+            continue;
+
+         /* Invisible, not doing anything. */
+         if ( pilot_isFlag( p, PILOT_HIDE ) )
+            continue;
+
+         /* Just update the pilot. */
+         if ( pilot_isFlag( p, PILOT_PLAYER ) )
+            player_update( p, dt );
+         else
+            pilot_update( p, dt );
+      }
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Integrates a chunk of pilots, run from the threadpool.
+ */
+static int pilot_updateIntegrateChunk( void *data )
+{
+   const PilotUpdateChunk *chunk = data;
+   for ( int i = 0; i < chunk->n; i++ ) {
+      const PilotUpdate *pu = &chunk->upd[i];
+      pilot_updateIntegrate( pu->p, pu->stage, pu->dt );
+   }
+   return 0;
+}
+
+/**
+ * @brief Updates all the pilots with the integration stage in parallel.
+ *
+ * The serial stages are run in pilot stack order, so the results only differ
+ * from the serial update in that all the pre-update side effects (damage,
+ * hooks, deaths) of the frame happen before any of the Lua updates.
+ *
+ *    @param dt Delta tick for the update.
+ */
+static void pilots_updateParallel( double dt )
+{
+   int n, nchunks, chunksize, generation;
+   NTracingZone( _ctx, 1 );
+
+   /* Serial pre-update, this can do anything including adding pilots. */
+   generation = pilot_stackGeneration;
+   array_erase( &pilot_updates, array_begin( pilot_updates ),
+                array_end( pilot_updates ) );
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      Pilot *p = pilot_stack[i];
+      PilotUpdate pu;
+      Pilot      *p = pilot_stack[i];
 
       /* Ignore. */
       if ( pilot_isFlag( p, PILOT_DELETE ) )
@@ -4225,11 +4740,57 @@ void pilots_update( double dt )
       if ( pilot_isFlag( p, PILOT_HIDE ) )
          continue;
 
-      /* Just update the pilot. */
-      if ( pilot_isFlag( p, PILOT_PLAYER ) )
-         player_update( p, dt );
-      else
-         pilot_update( p, dt );
+      pu.p     = p;
+      pu.dt    = dt * p->stats.time_speedup;
+      pu.stage = pilot_updatePre( p, pu.dt );
+      if ( pu.stage != PILOT_UPDATE_DONE )
+         array_push_back( &pilot_updates, pu );
+      else if ( pilot_isFlag( p, PILOT_PLAYER ) &&
+                !player_isFlag( PLAYER_DESTROYED ) )
+         player_updateSpecific( p, dt );
+
+      /* Something like a hook teleporting the player cleared the stack. */
+      if ( generation != pilot_stackGeneration ) {
+         NTracingZoneEnd( _ctx );
+         return;
+      }
+   }
+
+   /* Parallel integration, only touches the pilot itself. */
+   n = array_size( pilot_updates );
+   if ( n < PILOT_UPDATE_PARALLEL_MIN ) {
+      for ( int i = 0; i < n; i++ )
+         pilot_updateIntegrate( pilot_updates[i].p, pilot_updates[i].stage,
+                                pilot_updates[i].dt );
+   } else {
+      nchunks   = MIN( SDL_GetCPUCount(), n / PILOT_UPDATE_CHUNK_MIN );
+      nchunks   = MAX( nchunks, 1 );
+      chunksize = ( n + nchunks - 1 ) / nchunks;
+      array_resize( &pilot_updateChunks, nchunks );
+      for ( int i = 0; i < nchunks; i++ ) {
+         PilotUpdateChunk *chunk = &pilot_updateChunks[i];
+         chunk->upd              = &pilot_updates[i * chunksize];
+         chunk->n = MIN( chunksize, n - i * chunksize );
+         if ( chunk->n > 0 )
+            vpool_enqueue( pilot_vpool, pilot_updateIntegrateChunk, chunk );
+      }
+      vpool_wait( pilot_vpool );
+   }
+
+   /* Serial post-update, mainly Lua. */
+   for ( int i = 0; i < n; i++ ) {
+      Pilot *p = pilot_updates[i].p;
+
+      /* Pre-updates of other pilots may have removed it. */
+      if ( !pilot_isFlag( p, PILOT_DELETE ) )
+         pilot_updatePost( p, pilot_updates[i].dt );
+
+      if ( pilot_isFlag( p, PILOT_PLAYER ) &&
+           !player_isFlag( PLAYER_DESTROYED ) )
+         player_updateSpecific( p, dt );
+
+      if ( generation != pilot_stackGeneration )
+         break;
    }
 
    NTracingZoneEnd( _ctx );
@@ -4243,6 +4804,8 @@ void pilots_render( void )
    NTracingZone( _ctx, 1 );
    gl_debugGroupStart();
 
+   /* Sprite ships get batched, pilot_render flushes for everything else. */
+   gl_batchBegin();
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       Pilot *p = pilot_stack[i];
 
@@ -4253,6 +4816,7 @@ void pilots_render( void )
       if ( !pilot_isFlag( p, PILOT_PLAYER ) )
          pilot_render( p );
    }
+   gl_batchEnd();
 
    gl_debugGroupEnd();
    NTracingZoneEnd( _ctx );
@@ -14,6 +14,7 @@
 #include "ntime.h"
 #include "outfit.h"
 #include "physics.h"
+#include "quadtree.h"
 #include "ship.h"
 #include "space.h"
 #include "spfx.h"
@@ -574,5 +575,18 @@ void    pilot_untargetAsteroid( int anchor, int asteroid );
 PilotOutfitSlot *pilot_getDockSlot( Pilot *p );
 const IntList   *pilot_collideQuery( int x1, int y1, int x2, int y2 );
 void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 );
+void pilot_collideQueryTemp( QuadtreeTemp *tmp, IntList *il, int x1, int y1,
+                             int x2, int y2 );
 void pilot_quadtreeParams( int max_elem, int depth );
+
+/* Neighbour queries. */
+typedef int ( *PilotQueryFunc )( const Pilot *t, double d2, const void *data,
+                                 double *score );
+int    pilot_queryRadius( IntList *il, double x, double y, double r,
+                          const Pilot *viewer );
+int    pilot_queryNearest( Pilot **out, int k, double x, double y, double rmax,
+                           double weight, PilotQueryFunc func,
+                           const void *data );
+double pilot_queryDetectRange( const Pilot *p );
+double pilot_queryDetectMax( void );
 int  pilot_invincible( const Pilot *p );
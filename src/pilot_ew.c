@@ -432,7 +432,9 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
                                      int *isplayer )
 {
    Pilot *const *ps;
-   int           n;
+   IntList       il;
+   int           n, nq;
+   ArenaMark     mark;
 
    /* Check nearby non-allies. */
    if ( mod != NULL )
@@ -443,9 +445,16 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
       *isplayer = 0;
    n  = 0;
    ps = pilot_getAll();
-   for ( int i = 0; i < array_size( ps ); i++ ) {
-      double dist;
-      Pilot *t = ps[i];
+
+   /* Only pilots within the largest close distance matter. */
+   mark = arena_mark( arena_scratch() );
+   il_createArena( &il, 1, mark.arena );
+   nq = pilot_queryRadius(
+      &il, p->solid.pos.x, p->solid.pos.y,
+      MAX( 0., p->ew_stealth * pilot_queryDetectMax() * 1.5 ), NULL );
+   for ( int i = 0; i < nq; i++ ) {
+      double       dist;
+      const Pilot *t = ps[il_get( &il, i, 0 )];
 
       /* Quick checks first. */
       if ( pilot_isDisabled( t ) )
@@ -484,6 +493,7 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
       if ( ( isplayer != NULL ) && pilot_isPlayer( t ) )
          *isplayer = 1;
    }
+   arena_release( &mark );
 
    return n;
 }
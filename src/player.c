@@ -858,6 +858,7 @@ void player_cleanup( void )
 
    array_free( events_done );
    events_done = NULL;
+   missions_stateChanged();
 
    /* Clean up licenses. */
    for ( int i = 0; i < array_size( player_licenses ); i++ )
@@ -2096,6 +2097,9 @@ int player_jump( void )
 
       /* Order escorts to jump; just for aesthetics (for now) */
       escorts_jump( player.p, &cur_system->jumps[player.p->nav_hyperspace] );
+
+      /* Start loading the target system while the jump charges. */
+      space_gfxPrefetch( cur_system->jumps[player.p->nav_hyperspace].target );
       return 1;
    }
 
@@ -2136,8 +2140,11 @@ void player_brokeHyperspace( void )
    space_init( jp->target->name, 1 );
 
    /* Set jumps as known. */
-   if ( !pilot_isFlag( player.p, PILOT_MANUAL_CONTROL ) )
+   if ( !pilot_isFlag( player.p, PILOT_MANUAL_CONTROL ) &&
+        !jp_isKnown( jp->returnJump ) ) {
       jp_setFlag( jp->returnJump, JP_KNOWN );
+      map_jumpDistInvalidate();
+   }
 
    /* Set up the overlay. */
    ovr_initAlpha();
@@ -3108,6 +3115,7 @@ void player_missionFinished( int id )
    array_push_back( &missions_done, id );
 
    qsort( missions_done, array_size( missions_done ), sizeof( int ), cmp_int );
+   missions_stateChanged();
 
    /* Run the completion hook. */
    m = mission_get( id );
@@ -3164,6 +3172,7 @@ void player_eventFinished( int id )
    array_push_back( &events_done, id );
 
    qsort( events_done, array_size( events_done ), sizeof( int ), cmp_int );
+   missions_stateChanged();
 
    /* Run the completion hook. */
    event_toLuaTable( naevL, id ); /* Push to stack. */
@@ -3769,6 +3778,7 @@ Spob *player_load( xmlNodePtr parent )
       else if ( xml_isNode( node, "escorts" ) )
          player_parseEscorts( node );
    } while ( xml_nextNode( node ) );
+   missions_stateChanged();
 
    /* Set up meta-data. */
    player.time_since_save = time( NULL );
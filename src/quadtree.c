@@ -20,7 +20,7 @@ enum {
    // ----------------------------------------------------------------------------------------
    // Element node fields:
    // ----------------------------------------------------------------------------------------
-   enode_num = 2,
+   enode_num = 5,
 
    // Points to the next element in the leaf node. A value of -1
    // indicates the end of the list.
@@ -29,10 +29,20 @@ enum {
    // Stores the element index.
    enode_idx_elt = 1,
 
+   // Points to the previous element in the leaf node, or -1 if first.
+   enode_idx_prev = 2,
+
+   // Stores the index of the leaf node.
+   enode_idx_leaf = 3,
+
+   // Points to the next element node of the same element, so that elements
+   // can be removed without looking for their leaves.
+   enode_idx_enext = 4,
+
    // ----------------------------------------------------------------------------------------
    // Element fields:
    // ----------------------------------------------------------------------------------------
-   elt_num = 5,
+   elt_num = 10,
 
    // Stores the rectangle encompassing the element.
    elt_idx_lft = 0,
@@ -43,6 +53,16 @@ enum {
    // Stores the ID of the element.
    elt_idx_id = 4,
 
+   // Stores the rectangle the element was inserted with, including the margin.
+   // The element is in all the leaves this rectangle intersects.
+   elt_idx_flft = 5,
+   elt_idx_ftop = 6,
+   elt_idx_frgt = 7,
+   elt_idx_fbtm = 8,
+
+   // Points to the first element node of the element.
+   elt_idx_enode = 9,
+
    // ----------------------------------------------------------------------------------------
    // Node fields:
    // ----------------------------------------------------------------------------------------
@@ -73,8 +93,13 @@ enum {
    nd_idx_depth = 5,
 };
 
+// Number of updates the rectangles of moving elements are extended for.
+static const int qt_lookahead = 4;
+
 static void node_insert( Quadtree *qt, int index, int depth, int mx, int my,
                          int sx, int sy, int element );
+static int  elt_insert( Quadtree *qt, int id, int x1, int y1, int x2, int y2,
+                        int dx, int dy );
 
 static int intersect( int l1, int t1, int r1, int b1, int l2, int t2, int r2,
                       int b2 )
@@ -82,16 +107,43 @@ static int intersect( int l1, int t1, int r1, int b1, int l2, int t2, int r2,
    return l2 <= r1 && r2 >= l1 && t2 <= b1 && b2 >= t1;
 }
 
+static void elt_unlink( Quadtree *qt, int element, int enode )
+{
+   // Remove the element node from the list of the element.
+   int index = il_get( &qt->elts, element, elt_idx_enode );
+   int prev  = -1;
+   while ( index != -1 && index != enode ) {
+      prev  = index;
+      index = il_get( &qt->enodes, index, enode_idx_enext );
+   }
+   if ( index == -1 )
+      return;
+   if ( prev == -1 )
+      il_set( &qt->elts, element, elt_idx_enode,
+              il_get( &qt->enodes, enode, enode_idx_enext ) );
+   else
+      il_set( &qt->enodes, prev, enode_idx_enext,
+              il_get( &qt->enodes, enode, enode_idx_enext ) );
+}
+
 static void leaf_insert( Quadtree *qt, int node, int depth, int mx, int my,
                          int sx, int sy, int element )
 {
    // Insert the element node to the leaf.
    const int nd_fc = il_get( &qt->nodes, node, node_idx_fc );
-   il_set( &qt->nodes, node, node_idx_fc, il_insert( &qt->enodes ) );
-   il_set( &qt->enodes, il_get( &qt->nodes, node, node_idx_fc ), enode_idx_next,
-           nd_fc );
-   il_set( &qt->enodes, il_get( &qt->nodes, node, node_idx_fc ), enode_idx_elt,
-           element );
+   const int enode = il_insert( &qt->enodes );
+   il_set( &qt->nodes, node, node_idx_fc, enode );
+   il_set( &qt->enodes, enode, enode_idx_next, nd_fc );
+   il_set( &qt->enodes, enode, enode_idx_elt, element );
+   il_set( &qt->enodes, enode, enode_idx_prev, -1 );
+   il_set( &qt->enodes, enode, enode_idx_leaf, node );
+   if ( nd_fc != -1 )
+      il_set( &qt->enodes, nd_fc, enode_idx_prev, enode );
+
+   // Add it to the element nodes of the element.
+   il_set( &qt->enodes, enode, enode_idx_enext,
+           il_get( &qt->elts, element, elt_idx_enode ) );
+   il_set( &qt->elts, element, elt_idx_enode, enode );
 
    // If the leaf is full, split it.
    if ( il_get( &qt->nodes, node, node_idx_num ) == qt->max_elements &&
@@ -108,6 +160,7 @@ static void leaf_insert( Quadtree *qt, int node, int depth, int mx, int my,
 
          // Pop off the element node from the leaf and remove it from the qt.
          il_set( &qt->nodes, node, node_idx_fc, next_index );
+         elt_unlink( qt, elt, index );
          il_erase( &qt->enodes, index );
 
          // Insert element to the list.
@@ -200,14 +253,15 @@ static void node_insert( Quadtree *qt, int index, int depth, int mx, int my,
                          int sx, int sy, int element )
 {
    // Find the leaves and insert the element to all the leaves found.
-   IntList leaves = { 0 };
+   IntList   leaves = { 0 };
+   ArenaMark mark   = arena_mark( arena_scratch() );
 
-   const int lft = il_get( &qt->elts, element, elt_idx_lft );
-   const int top = il_get( &qt->elts, element, elt_idx_top );
-   const int rgt = il_get( &qt->elts, element, elt_idx_rgt );
-   const int btm = il_get( &qt->elts, element, elt_idx_btm );
+   const int lft = il_get( &qt->elts, element, elt_idx_flft );
+   const int top = il_get( &qt->elts, element, elt_idx_ftop );
+   const int rgt = il_get( &qt->elts, element, elt_idx_frgt );
+   const int btm = il_get( &qt->elts, element, elt_idx_fbtm );
 
-   il_create( &leaves, nd_num );
+   il_createArena( &leaves, nd_num, mark.arena );
    find_leaves( &leaves, qt, index, depth, mx, my, sx, sy, lft, top, rgt, btm );
    for ( int j = 0; j < il_size( &leaves ); ++j ) {
       const int nd_mx    = il_get( &leaves, j, nd_idx_mx );
@@ -219,7 +273,7 @@ static void node_insert( Quadtree *qt, int index, int depth, int mx, int my,
       leaf_insert( qt, nd_index, nd_depth, nd_mx, nd_my, nd_sx, nd_sy,
                    element );
    }
-   il_destroy( &leaves );
+   arena_release( &mark );
 }
 
 void qt_create( Quadtree *qt, int x1, int y1, int x2, int y2, int max_elements,
@@ -227,6 +281,8 @@ void qt_create( Quadtree *qt, int x1, int y1, int x2, int y2, int max_elements,
 {
    qt->max_elements = max_elements;
    qt->max_depth    = max_depth;
+   qt->margin       = 0;
+   qt->removed      = 0;
    qt->temp         = NULL;
    qt->temp_size    = 0;
    il_create( &qt->nodes, node_num );
@@ -248,8 +304,14 @@ void qt_create( Quadtree *qt, int x1, int y1, int x2, int y2, int max_elements,
    qt->root_my = y1 + half_height;
 }
 
+void qt_set_margin( Quadtree *qt, int margin )
+{
+   qt->margin = margin;
+}
+
 void qt_clear( Quadtree *qt )
 {
+   qt->removed = 0;
    il_clear( &qt->nodes );
    il_clear( &qt->elts );
    il_clear( &qt->enodes );
@@ -269,16 +331,36 @@ void qt_destroy( Quadtree *qt )
 }
 
 int qt_insert( Quadtree *qt, int id, int x1, int y1, int x2, int y2 )
+{
+   return elt_insert( qt, id, x1, y1, x2, y2, 0, 0 );
+}
+
+static int elt_insert( Quadtree *qt, int id, int x1, int y1, int x2, int y2,
+                       int dx, int dy )
 {
    // Insert a new element.
    const int new_element = il_insert( &qt->elts );
 
+   // Extend the rectangle in the direction the element is moving in, so that
+   // it can keep moving in place for a few frames.
+   dx *= qt_lookahead;
+   dy *= qt_lookahead;
+
    // Set the fields of the new element.
    il_set( &qt->elts, new_element, elt_idx_lft, x1 );
    il_set( &qt->elts, new_element, elt_idx_top, y1 );
    il_set( &qt->elts, new_element, elt_idx_rgt, x2 );
    il_set( &qt->elts, new_element, elt_idx_btm, y2 );
    il_set( &qt->elts, new_element, elt_idx_id, id );
+   il_set( &qt->elts, new_element, elt_idx_enode, -1 );
+   il_set( &qt->elts, new_element, elt_idx_flft,
+           x1 - qt->margin + ( dx < 0 ? dx : 0 ) );
+   il_set( &qt->elts, new_element, elt_idx_ftop,
+           y1 - qt->margin + ( dy < 0 ? dy : 0 ) );
+   il_set( &qt->elts, new_element, elt_idx_frgt,
+           x2 + qt->margin + ( dx > 0 ? dx : 0 ) );
+   il_set( &qt->elts, new_element, elt_idx_fbtm,
+           y2 + qt->margin + ( dy > 0 ? dy : 0 ) );
 
    // Insert the element to the appropriate leaf node(s).
    node_insert( qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy,
@@ -288,67 +370,85 @@ int qt_insert( Quadtree *qt, int id, int x1, int y1, int x2, int y2 )
 
 void qt_remove( Quadtree *qt, int element )
 {
-   // Find the leaves.
-   IntList leaves = { 0 };
-
-   const int lft = il_get( &qt->elts, element, elt_idx_lft );
-   const int top = il_get( &qt->elts, element, elt_idx_top );
-   const int rgt = il_get( &qt->elts, element, elt_idx_rgt );
-   const int btm = il_get( &qt->elts, element, elt_idx_btm );
-
-   il_create( &leaves, nd_num );
-   find_leaves( &leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx,
-                qt->root_sy, lft, top, rgt, btm );
-
-   // For each leaf node, remove the element node.
-   for ( int j = 0; j < il_size( &leaves ); ++j ) {
-      const int nd_index = il_get( &leaves, j, nd_idx_index );
-
-      // Walk the list until we find the element node.
-      int node_index = il_get( &qt->nodes, nd_index, node_idx_fc );
-      int prev_index = -1;
-      while ( node_index != -1 &&
-              il_get( &qt->enodes, node_index, enode_idx_elt ) != element ) {
-         prev_index = node_index;
-         node_index = il_get( &qt->enodes, node_index, enode_idx_next );
-      }
-
-      if ( node_index != -1 ) {
-         // Remove the element node.
-         const int next_index =
-            il_get( &qt->enodes, node_index, enode_idx_next );
-         if ( prev_index == -1 )
-            il_set( &qt->nodes, nd_index, node_idx_fc, next_index );
-         else
-            il_set( &qt->enodes, prev_index, enode_idx_next, next_index );
-         il_erase( &qt->enodes, node_index );
-
-         // Decrement the leaf element count.
-         il_set( &qt->nodes, nd_index, node_idx_num,
-                 il_get( &qt->nodes, nd_index, node_idx_num ) - 1 );
-      }
+   // For each element node, remove it from its leaf.
+   int enode = il_get( &qt->elts, element, elt_idx_enode );
+   while ( enode != -1 ) {
+      const int leaf = il_get( &qt->enodes, enode, enode_idx_leaf );
+      const int next = il_get( &qt->enodes, enode, enode_idx_next );
+      const int prev = il_get( &qt->enodes, enode, enode_idx_prev );
+      const int enext = il_get( &qt->enodes, enode, enode_idx_enext );
+
+      if ( prev == -1 )
+         il_set( &qt->nodes, leaf, node_idx_fc, next );
+      else
+         il_set( &qt->enodes, prev, enode_idx_next, next );
+      if ( next != -1 )
+         il_set( &qt->enodes, next, enode_idx_prev, prev );
+      il_erase( &qt->enodes, enode );
+
+      // Decrement the leaf element count.
+      il_set( &qt->nodes, leaf, node_idx_num,
+              il_get( &qt->nodes, leaf, node_idx_num ) - 1 );
+      enode = enext;
    }
-   il_destroy( &leaves );
 
    // Remove the element.
    il_erase( &qt->elts, element );
+   qt->removed++;
+}
+
+int qt_move( Quadtree *qt, int element, int id, int x1, int y1, int x2, int y2 )
+{
+   // If it's still within the rectangle it was inserted with, it's in all the
+   // leaves it has to be, so only the element has to be updated.
+   if ( x1 >= il_get( &qt->elts, element, elt_idx_flft ) &&
+        y1 >= il_get( &qt->elts, element, elt_idx_ftop ) &&
+        x2 <= il_get( &qt->elts, element, elt_idx_frgt ) &&
+        y2 <= il_get( &qt->elts, element, elt_idx_fbtm ) ) {
+      il_set( &qt->elts, element, elt_idx_lft, x1 );
+      il_set( &qt->elts, element, elt_idx_top, y1 );
+      il_set( &qt->elts, element, elt_idx_rgt, x2 );
+      il_set( &qt->elts, element, elt_idx_btm, y2 );
+      il_set( &qt->elts, element, elt_idx_id, id );
+      return element;
+   }
+
+   // Otherwise it has to be reinserted, using how much it moved since the last
+   // update as a guess of where it's going.
+   const int dx = x1 - il_get( &qt->elts, element, elt_idx_lft );
+   const int dy = y1 - il_get( &qt->elts, element, elt_idx_top );
+   qt_remove( qt, element );
+   if ( qt->margin <= 0 )
+      return qt_insert( qt, id, x1, y1, x2, y2 );
+   return elt_insert( qt, id, x1, y1, x2, y2, dx, dy );
 }
 
 void qt_query( Quadtree *qt, IntList *out, int qlft, int qtop, int qrgt,
                int qbtm )
+{
+   QuadtreeTemp tmp = { .temp = qt->temp, .temp_size = qt->temp_size };
+   qt_query_temp( qt, &tmp, out, qlft, qtop, qrgt, qbtm );
+   qt->temp      = tmp.temp;
+   qt->temp_size = tmp.temp_size;
+}
+
+void qt_query_temp( const Quadtree *qt, QuadtreeTemp *tmp, IntList *out,
+                    int qlft, int qtop, int qrgt, int qbtm )
 {
    // Find the leaves that intersect the specified query rectangle.
    IntList   leaves  = { 0 };
+   ArenaMark mark    = arena_mark( arena_scratch() );
    const int elt_cap = il_size( &qt->elts );
 
-   if ( qt->temp_size < elt_cap ) {
-      qt->temp_size = elt_cap;
-      qt->temp      = realloc( qt->temp, qt->temp_size * sizeof( *qt->temp ) );
-      memset( qt->temp, 0, qt->temp_size * sizeof( *qt->temp ) );
+   if ( tmp->temp_size < elt_cap ) {
+      tmp->temp = realloc( tmp->temp, elt_cap * sizeof( *tmp->temp ) );
+      memset( &tmp->temp[tmp->temp_size], 0,
+              ( elt_cap - tmp->temp_size ) * sizeof( *tmp->temp ) );
+      tmp->temp_size = elt_cap;
    }
 
    // For each leaf node, look for elements that intersect.
-   il_create( &leaves, nd_num );
+   il_createArena( &leaves, nd_num, mark.arena );
    find_leaves( &leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx,
                 qt->root_sy, qlft, qtop, qrgt, qbtm );
 
@@ -365,28 +465,44 @@ void qt_query( Quadtree *qt, IntList *out, int qlft, int qtop, int qrgt,
          const int top = il_get( &qt->elts, element, elt_idx_top );
          const int rgt = il_get( &qt->elts, element, elt_idx_rgt );
          const int btm = il_get( &qt->elts, element, elt_idx_btm );
-         if ( !qt->temp[element] &&
+         if ( !tmp->temp[element] &&
               intersect( qlft, qtop, qrgt, qbtm, lft, top, rgt, btm ) ) {
             il_set( out, il_push_back( out ), 0, element );
-            qt->temp[element] = 1;
+            tmp->temp[element] = 1;
          }
          elt_node_index = il_get( &qt->enodes, elt_node_index, enode_idx_next );
       }
    }
-   il_destroy( &leaves );
+   arena_release( &mark );
 
    /* Unmark the elements that were inserted, and convert to IDs. */
    for ( int j = 0; j < il_size( out ); ++j ) {
       const int element = il_get( out, j, 0 );
-      const int id      = il_get( &qt->elts, element, elt_idx_id );
-      qt->temp[element] = 0;
+      const int id       = il_get( &qt->elts, element, elt_idx_id );
+      tmp->temp[element] = 0;
       il_set( out, j, 0, id );
    }
 }
 
+void qt_temp_free( QuadtreeTemp *tmp )
+{
+   free( tmp->temp );
+   tmp->temp      = NULL;
+   tmp->temp_size = 0;
+}
+
+void qt_cleanup_lazy( Quadtree *qt )
+{
+   // Empty leaves only slow down queries a bit, so wait until a good part of
+   // the elements were removed.
+   if ( qt->removed > 64 && 4 * qt->removed > il_size( &qt->elts ) )
+      qt_cleanup( qt );
+}
+
 void qt_cleanup( Quadtree *qt )
 {
    IntList to_process = { 0 };
+   qt->removed        = 0;
    il_create( &to_process, 1 );
 
    // Only process the root if it's not a leaf.
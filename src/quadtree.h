@@ -16,7 +16,8 @@
 
 #include "intlist.h"
 
-typedef struct Quadtree Quadtree;
+typedef struct Quadtree     Quadtree;
+typedef struct QuadtreeTemp QuadtreeTemp;
 
 struct Quadtree {
    // Stores all the nodes in the quadtree. The first node in this
@@ -39,6 +40,13 @@ struct Quadtree {
    // Stores the maximum depth allowed for the quadtree.
    int max_depth;
 
+   // Extra size elements are inserted with on each side, so that they can
+   // move that much without having to be reinserted.
+   int margin;
+
+   // Number of elements removed since the last cleanup.
+   int removed;
+
    // Temporary buffer used for queries.
 
    char *temp;
@@ -47,6 +55,16 @@ struct Quadtree {
    int temp_size;
 };
 
+// Temporary buffer used for querying trees concurrently. Each thread should
+// use its own, and the same one can be reused for different trees.
+struct QuadtreeTemp {
+   // Marks elements already found, always cleared after a query.
+   char *temp;
+
+   // Stores the size of the temporary buffer.
+   int temp_size;
+};
+
 // Function signature used for traversing a tree node.
 typedef void QtNodeFunc( Quadtree *qt, void *user_data, int node, int depth,
                          int mx, int my, int sx, int sy );
@@ -66,15 +84,37 @@ void qt_clear( Quadtree *qt );
 // Returns an index to the new element.
 int qt_insert( Quadtree *qt, int id, int x1, int y1, int x2, int y2 );
 
+// Sets the margin of the tree, which makes it loose. Should be set before
+// inserting elements.
+void qt_set_margin( Quadtree *qt, int margin );
+
 // Removes the specified element from the tree.
 void qt_remove( Quadtree *qt, int element );
 
+// Moves an element and changes its ID. Elements that stay within the margin
+// are updated in place, otherwise they get reinserted.
+// Returns the index of the element, which may change.
+int qt_move( Quadtree *qt, int element, int id, int x1, int y1, int x2,
+             int y2 );
+
 // Cleans up the tree, removing empty leaves.
 void qt_cleanup( Quadtree *qt );
 
+// Cleans up the tree only if enough elements were removed since the last
+// cleanup.
+void qt_cleanup_lazy( Quadtree *qt );
+
 // Outputs a list of elements found in the specified rectangle.
 void qt_query( Quadtree *qt, IntList *out, int x1, int y1, int x2, int y2 );
 
+// Same as qt_query, but uses an external temporary buffer so the tree is not
+// modified and can be queried from multiple threads at once.
+void qt_query_temp( const Quadtree *qt, QuadtreeTemp *tmp, IntList *out, int x1,
+                    int y1, int x2, int y2 );
+
+// Frees an external temporary buffer.
+void qt_temp_free( QuadtreeTemp *tmp );
+
 // Traverses all the nodes in the tree, calling 'branch' for branch nodes and
 // 'leaf' for leaf nodes.
 void qt_traverse( Quadtree *qt, void *user_data, QtNodeFunc *branch,
@@ -99,7 +99,7 @@ static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
    gl_uniformMat4( shader->ClipSpaceFromLocal, &ortho );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
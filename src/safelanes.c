@@ -56,6 +56,9 @@ static const double JUMP_CONDUCTIVITY =
    0.001; /**< Conductivity value for inter-system jump-point connections. */
 static const double MIN_ANGLE =
    M_PI / 18.; /**< Path triangles can't be more acute. */
+static const uint64_t HASH_INIT =
+   14695981039346656037u; /**< FNV-1a offset basis for the change hashes. */
+static const uint64_t HASH_PRIME = 1099511628211u; /**< FNV-1a prime. */
 enum {
    STORAGE_MODE_LOWER_TRIANGULAR_PART =
       -1, /**< A CHOLMOD "stype" value: matrix is interpreted as symmetric. */
@@ -100,6 +103,17 @@ typedef struct Faction_ {
 typedef uint32_t         FactionMask;
 static const FactionMask MASK_0 = 0, MASK_1 = 1;
 
+/** @brief Results of the previous computation, to reuse what didn't change. */
+typedef struct SafeLanesPrev_ {
+   int         *sys_to_first_vertex; /**< Old sys_to_first_vertex. */
+   int         *sys_to_first_edge;   /**< Old sys_to_first_edge. */
+   FactionMask *vertex_fmask;        /**< Old vertex_fmask. */
+   int         *lane_faction;        /**< Old lane_faction. */
+   uint64_t    *sys_hash;            /**< Old sys_hash. */
+   int         *sys_comp;            /**< Old sys_comp. */
+   uint64_t     faction_hash;        /**< Old faction_hash. */
+} SafeLanesPrev;
+
 /*
  * Global state.
  */
@@ -147,6 +161,18 @@ static cholmod_dense
    *utilde; /**< Potentials (bunch of U columns in the KU=F problem). */
 static cholmod_dense **PPl; /**< Array: (array.h): For each builder faction, The
                                (P*)P in: grad_u(phi)=(Q*)Q U~ (P*)P. */
+static uint64_t *sys_hash; /**< Array (array.h): Per system, hash of everything
+                               its lanes depend on. */
+static uint64_t faction_hash; /**< Hash of the lane-building factions. */
+static int     *sys_comp; /**< Array (array.h): Per system, the representative
+                             system of its connected component. */
+static int *sys_active; /**< Array (array.h): Per system, whether its lanes are
+                           still being optimized. */
+static int *comp_turns; /**< Array (array.h): Per component representative,
+                           builds (upper bound) to happen next turn. */
+static cholmod_factor *stiff_f; /**< Factorization of "stiff", reused while its
+                                   sparsity pattern doesn't change. */
+static uint64_t stiff_pattern;  /**< Hash of the pattern stiff_f is for. */
 static double *cmp_key_ref; /**< To qsort() a list of indices by table value,
                                point this at your table and use cmp_key. */
 static int safelanes_calculated_once =
@@ -155,6 +181,7 @@ static int safelanes_calculated_once =
 /*
  * Prototypes.
  */
+static int    safelanes_compute( int full, int dirty );
 static int    safelanes_buildOneTurn( int iters_done );
 static int    safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
                                             int                  iters_done );
@@ -163,11 +190,18 @@ static void   safelanes_initStacks_edge( void );
 static void   safelanes_initStacks_faction( void );
 static void   safelanes_initStacks_vertex( void );
 static void   safelanes_initStacks_anchor( void );
+static void   safelanes_initStacks_hash( void );
+static int    safelanes_initActive( const SafeLanesPrev *prev, int full,
+                                    int dirty );
+static void   safelanes_freezeIdle( void );
+static void   safelanes_prevTake( SafeLanesPrev *prev );
+static void   safelanes_prevFree( SafeLanesPrev *prev );
 static void   safelanes_initOptimizer( void );
 static void   safelanes_destroyOptimizer( void );
 static void   safelanes_destroyStacks( void );
 static void   safelanes_destroyTmp( void );
 static void   safelanes_initStiff( void );
+static void   safelanes_initFactor( void );
 static double safelanes_initialConductivity( int ei );
 static void   safelanes_updateConductivity( int ei_activated );
 static void   safelanes_initQtQ( void );
@@ -182,6 +216,7 @@ static inline FactionMask MASK_ANY_FACTION();
 static inline FactionMask MASK_ONE_FACTION( int id );
 static inline FactionMask MASK_COMPROMISE( int id1, int id2 );
 static int                cmp_key( const void *p1, const void *p2 );
+static uint64_t hash_data( uint64_t h, const void *data, size_t size );
 static inline void triplet_entry( cholmod_triplet *m, int i, int j, double v );
 static cholmod_dense *safelanes_sliceByPresence( const cholmod_dense *m,
                                                  const double *sysPresence );
@@ -219,6 +254,7 @@ void safelanes_destroy( void )
 {
    safelanes_destroyOptimizer();
    safelanes_destroyStacks();
+   cholmod_free_factor( &stiff_f, &C );
    cholmod_finish( &C );
 }
 
@@ -292,33 +328,142 @@ SafeLane *safelanes_get( int faction, int standing, const StarSystem *system )
 /**
  * @brief Update the safe lane locations in response to the universe changing
  * (e.g., diff applied).
+ *
+ * Only the connected components with changes are optimized again, the lanes
+ * of the others are kept from the previous computation.
  */
 void safelanes_recalculate( void )
 {
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
+   int    nactive;
 #endif /* DEBUGGING */
 
    /* Don't recompute on exit. */
    if ( naev_isQuit() )
       return;
 
-   safelanes_initStacks();
-   safelanes_initOptimizer();
-   for ( int iters_done = 0; safelanes_buildOneTurn( iters_done ) > 0;
-         iters_done++ )
-      ;
-   safelanes_destroyOptimizer();
-   /* Stacks remain available for queries. */
 #if DEBUGGING
-   if ( conf.devmode )
+   nactive = safelanes_compute( 0, -1 );
+   if ( conf.devmode ) {
       DEBUG( n_( "Charted safe lanes for %d object in %.3f s",
                  "Charted safe lanes for %d objects in %.3f s",
                  array_size( vertex_stack ) ),
              array_size( vertex_stack ), ( SDL_GetTicks() - time ) / 1000. );
+      DEBUG( _( "Re-optimized safe lanes of %d of %d systems" ), nactive,
+             array_size( sys_active ) );
+   }
+#else  /* DEBUGGING */
+   safelanes_compute( 0, -1 );
 #endif /* DEBUGGING */
+}
+
+/**
+ * @brief Computes the safe lanes, reusing the previous results of the
+ * connected components that didn't change.
+ *
+ * Every connected component is optimized on its own until it has nothing left
+ * to build, so the lanes of a component don't depend on the others, and
+ * skipping unchanged components gives the same result as a full computation.
+ *
+ *    @param full Whether to recompute everything.
+ *    @param dirty Index of a system whose component should be considered
+ * changed, or -1.
+ *    @return Number of systems whose lanes were optimized.
+ */
+static int safelanes_compute( int full, int dirty )
+{
+   SafeLanesPrev prev;
+   int           nactive;
+
+   safelanes_prevTake( &prev );
+   safelanes_initStacks();
+   nactive = safelanes_initActive( &prev, full, dirty );
+   safelanes_prevFree( &prev );
+
+   if ( nactive > 0 ) {
+      safelanes_initOptimizer();
+      for ( int iters_done = 0; safelanes_buildOneTurn( iters_done ) > 0;
+            iters_done++ )
+         safelanes_freezeIdle();
+      safelanes_destroyOptimizer();
+   } else
+      safelanes_destroyTmp();
+   /* Stacks remain available for queries. */
 
    safelanes_calculated_once = 1;
+   return nactive;
+}
+
+/**
+ * @brief Benchmarks a full computation of the safe lanes against incremental
+ * ones, logging the results.
+ *
+ * The incremental computations are done as if the smallest and largest
+ * connected components had changed, and their lanes are checked against the
+ * full computation.
+ */
+void safelanes_benchmark( void )
+{
+   Uint64 t;
+   double dt;
+   int   *ref, *size, nactive, ncomp, nsys;
+   int    dirty[2] = { -1, -1 };
+
+   if ( naev_isQuit() )
+      return;
+
+   t  = SDL_GetPerformanceCounter();
+   safelanes_compute( 1, -1 );
+   dt = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+        (double)SDL_GetPerformanceFrequency();
+   ref = array_copy( int, lane_faction );
+
+   /* Find the smallest and largest components with vertices. */
+   nsys  = array_size( sys_comp );
+   size  = calloc( nsys, sizeof( int ) );
+   ncomp = 0;
+   for ( int s = 0; s < nsys; s++ )
+      size[sys_comp[s]] += sys_to_first_vertex[s + 1] - sys_to_first_vertex[s];
+   for ( int s = 0; s < nsys; s++ ) {
+      if ( ( sys_comp[s] != s ) || ( size[s] == 0 ) )
+         continue;
+      ncomp++;
+      if ( ( dirty[0] < 0 ) || ( size[s] < size[dirty[0]] ) )
+         dirty[0] = s;
+      if ( ( dirty[1] < 0 ) || ( size[s] > size[dirty[1]] ) )
+         dirty[1] = s;
+   }
+   LOG( _( "Safe lanes: full computation of %d objects in %d components: "
+           "%.3f ms" ),
+        array_size( vertex_stack ), ncomp, dt );
+
+   t       = SDL_GetPerformanceCounter();
+   nactive = safelanes_compute( 0, -1 );
+   dt      = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+        (double)SDL_GetPerformanceFrequency();
+   LOG( _( "Safe lanes: incremental computation without changes (%d "
+           "systems): %.3f ms" ),
+        nactive, dt );
+
+   for ( int i = 0; i < 2; i++ ) {
+      int nmismatch = 0;
+      if ( dirty[i] < 0 )
+         continue;
+      t       = SDL_GetPerformanceCounter();
+      nactive = safelanes_compute( 0, dirty[i] );
+      dt      = 1000. * (double)( SDL_GetPerformanceCounter() - t ) /
+           (double)SDL_GetPerformanceFrequency();
+      for ( int e = 0; e < array_size( ref ); e++ )
+         if ( lane_faction[e] != ref[e] )
+            nmismatch++;
+      LOG( _( "Safe lanes: incremental computation of a component with %d "
+              "objects (%d systems): %.3f ms, %d lanes differ" ),
+           size[dirty[i]], nactive, dt, nmismatch );
+   }
+
+   free( size );
+   array_free( ref );
 }
 
 /**
@@ -335,6 +480,7 @@ int safelanes_calculated( void )
 static void safelanes_initOptimizer( void )
 {
    safelanes_initStiff();
+   safelanes_initFactor();
    safelanes_initQtQ();
    safelanes_initFTilde();
    safelanes_initPPl();
@@ -365,14 +511,13 @@ static void safelanes_destroyOptimizer( void )
 static int safelanes_buildOneTurn( int iters_done )
 {
    cholmod_sparse *stiff_s;
-   cholmod_factor *stiff_f;
    cholmod_dense  *_QtQutilde, *Lambda_tilde, *Y_workspace, *E_workspace;
    int             turns_next_time;
    double          zero[] = { 0, 0 }, neg_1[] = { -1, 0 };
 
    Y_workspace = E_workspace = Lambda_tilde = NULL;
+   /* Only the values change between turns, so just refactorize. */
    stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
-   stiff_f = cholmod_analyze( stiff_s, &C );
    cholmod_factorize( stiff_s, stiff_f, &C );
    cholmod_solve2( CHOLMOD_A, stiff_f, ftilde, NULL, &utilde, NULL,
                    &Y_workspace, &E_workspace, &C );
@@ -383,7 +528,6 @@ static int safelanes_buildOneTurn( int iters_done )
    cholmod_free_dense( &_QtQutilde, &C );
    cholmod_free_dense( &Y_workspace, &C );
    cholmod_free_dense( &E_workspace, &C );
-   cholmod_free_factor( &stiff_f, &C );
    cholmod_free_sparse( &stiff_s, &C );
    turns_next_time = safelanes_activateByGradient( Lambda_tilde, iters_done );
    cholmod_free_dense( &Lambda_tilde, &C );
@@ -401,6 +545,7 @@ static void safelanes_initStacks( void )
    safelanes_initStacks_vertex();  /* Dependency for edge. */
    safelanes_initStacks_edge();
    safelanes_initStacks_anchor();
+   safelanes_initStacks_hash();
 }
 
 /**
@@ -562,6 +707,9 @@ static void safelanes_initStacks_anchor( void )
       unionfind_union( &tmp_sys_uf, vertex_stack[tmp_jump_edges[i][0]].system,
                        vertex_stack[tmp_jump_edges[i][1]].system );
    anchor_systems      = unionfind_findall( &tmp_sys_uf );
+   sys_comp            = array_create_size( int, nsys );
+   for ( int i = 0; i < nsys; i++ )
+      array_push_back( &sys_comp, unionfind_find( &tmp_sys_uf, i ) );
    tmp_anchor_vertices = array_create_size( int, array_size( anchor_systems ) );
 
    /* Add an anchor vertex per system, but only if there actually is a vertex in
@@ -574,6 +722,199 @@ static void safelanes_initStacks_anchor( void )
    array_free( anchor_systems );
 }
 
+/**
+ * @brief Hashes everything the lanes of each system depend on, to find what
+ * changed since the previous computation.
+ */
+static void safelanes_initStacks_hash( void )
+{
+   const StarSystem *systems_stack = system_getAll();
+
+   faction_hash = HASH_INIT;
+   for ( int fi = 0; fi < array_size( faction_stack ); fi++ ) {
+      const Faction *f = &faction_stack[fi];
+      faction_hash     = hash_data( faction_hash, &f->id, sizeof( f->id ) );
+      faction_hash     = hash_data( faction_hash, &f->lane_length_per_presence,
+                                    sizeof( f->lane_length_per_presence ) );
+      faction_hash     = hash_data( faction_hash, &f->lane_base_cost,
+                                    sizeof( f->lane_base_cost ) );
+   }
+
+   sys_hash = array_create_size( uint64_t, array_size( systems_stack ) );
+   for ( int s = 0; s < array_size( systems_stack ); s++ ) {
+      const StarSystem *sys     = &systems_stack[s];
+      uint64_t          h       = HASH_INIT;
+      int               nolanes = sys_isFlag( sys, SYSTEM_NOLANES ) != 0;
+      h = hash_data( h, &nolanes, sizeof( nolanes ) );
+      for ( int i = 0; i < array_size( sys->spobs ); i++ ) {
+         const Spob *p = sys->spobs[i];
+         nolanes       = spob_isFlag( p, SPOB_NOLANES ) != 0;
+         h             = hash_data( h, &p->id, sizeof( p->id ) );
+         h             = hash_data( h, &nolanes, sizeof( nolanes ) );
+         h = hash_data( h, &p->presence.faction, sizeof( p->presence.faction ) );
+         h = hash_data( h, &p->presence.base, sizeof( p->presence.base ) );
+         h = hash_data( h, &p->presence.bonus, sizeof( p->presence.bonus ) );
+         h = hash_data( h, &p->pos.x, sizeof( p->pos.x ) );
+         h = hash_data( h, &p->pos.y, sizeof( p->pos.y ) );
+      }
+      for ( int i = 0; i < array_size( sys->jumps ); i++ ) {
+         const JumpPoint *jp = &sys->jumps[i];
+         int              usable =
+            !jp_isFlag( jp, JP_HIDDEN | JP_EXITONLY | JP_NOLANES );
+         int twoway = jp->returnJump != NULL;
+         h          = hash_data( h, &jp->targetid, sizeof( jp->targetid ) );
+         h          = hash_data( h, &usable, sizeof( usable ) );
+         h          = hash_data( h, &twoway, sizeof( twoway ) );
+         h          = hash_data( h, &jp->pos.x, sizeof( jp->pos.x ) );
+         h          = hash_data( h, &jp->pos.y, sizeof( jp->pos.y ) );
+      }
+      for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
+         h = hash_data( h, &presence_budget[fi][s], sizeof( double ) );
+      array_push_back( &sys_hash, h );
+   }
+}
+
+/**
+ * @brief Chooses the systems to optimize, copying the previous lanes of the
+ * connected components that didn't change.
+ *
+ * A component is unchanged if it has the same systems as before, and none of
+ * them changed. Presence budgets are cleared outside of the optimized systems.
+ *
+ *    @param prev Results of the previous computation.
+ *    @param full Whether to optimize everything.
+ *    @param dirty Index of a system whose component should be considered
+ * changed, or -1.
+ *    @return Number of systems to optimize.
+ */
+static int safelanes_initActive( const SafeLanesPrev *prev, int full,
+                                 int dirty )
+{
+   int *clean, *old_comp, *old_size, *new_size;
+   int  nactive;
+   int  nsys = array_size( sys_comp );
+
+   sys_active = array_create_size( int, nsys );
+   array_resize( &sys_active, nsys );
+   comp_turns = array_create_size( int, nsys );
+   array_resize( &comp_turns, nsys );
+   for ( int s = 0; s < nsys; s++ )
+      sys_active[s] = 1;
+
+   /* Fall back to a full computation when the universe changed too much. */
+   if ( full || ( prev->sys_hash == NULL ) ||
+        ( array_size( prev->sys_hash ) != nsys ) ||
+        ( prev->faction_hash != faction_hash ) )
+      return nsys;
+
+   clean    = malloc( nsys * sizeof( int ) );
+   old_comp = malloc( nsys * sizeof( int ) );
+   old_size = calloc( nsys, sizeof( int ) );
+   new_size = calloc( nsys, sizeof( int ) );
+   for ( int s = 0; s < nsys; s++ ) {
+      clean[s]    = 1;
+      old_comp[s] = -1;
+   }
+   for ( int s = 0; s < nsys; s++ ) {
+      int c = sys_comp[s];
+      old_size[prev->sys_comp[s]]++;
+      new_size[c]++;
+      if ( old_comp[c] < 0 )
+         old_comp[c] = prev->sys_comp[s];
+      else if ( old_comp[c] != prev->sys_comp[s] )
+         clean[c] = 0;
+      if ( ( prev->sys_hash[s] != sys_hash[s] ) ||
+           ( prev->sys_to_first_vertex[s + 1] - prev->sys_to_first_vertex[s] !=
+             sys_to_first_vertex[s + 1] - sys_to_first_vertex[s] ) ||
+           ( prev->sys_to_first_edge[s + 1] - prev->sys_to_first_edge[s] !=
+             sys_to_first_edge[s + 1] - sys_to_first_edge[s] ) )
+         clean[c] = 0;
+   }
+   if ( dirty >= 0 )
+      clean[sys_comp[dirty]] = 0;
+
+   nactive = 0;
+   for ( int s = 0; s < nsys; s++ ) {
+      int c = sys_comp[s];
+      if ( !clean[c] || ( old_size[old_comp[c]] != new_size[c] ) ) {
+         nactive++;
+         continue;
+      }
+      sys_active[s] = 0;
+      for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
+         presence_budget[fi][s] = 0.;
+      memcpy( &vertex_fmask[sys_to_first_vertex[s]],
+              &prev->vertex_fmask[prev->sys_to_first_vertex[s]],
+              ( sys_to_first_vertex[s + 1] - sys_to_first_vertex[s] ) *
+                 sizeof( FactionMask ) );
+      memcpy( &lane_faction[sys_to_first_edge[s]],
+              &prev->lane_faction[prev->sys_to_first_edge[s]],
+              ( sys_to_first_edge[s + 1] - sys_to_first_edge[s] ) *
+                 sizeof( int ) );
+   }
+   free( clean );
+   free( old_comp );
+   free( old_size );
+   free( new_size );
+
+   /* Only the spobs being optimized need fluxes. */
+   for ( int i = array_size( tmp_spob_indices ) - 1; i >= 0; i-- )
+      if ( !sys_active[vertex_stack[tmp_spob_indices[i]].system] )
+         array_erase( &tmp_spob_indices, &tmp_spob_indices[i],
+                      &tmp_spob_indices[i + 1] );
+
+   return nactive;
+}
+
+/**
+ * @brief Stops optimizing the connected components that have nothing left to
+ * build.
+ */
+static void safelanes_freezeIdle( void )
+{
+   for ( int s = 0; s < array_size( sys_active ); s++ ) {
+      if ( !sys_active[s] || ( comp_turns[sys_comp[s]] > 0 ) )
+         continue;
+      sys_active[s] = 0;
+      for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
+         presence_budget[fi][s] = 0.;
+   }
+}
+
+/**
+ * @brief Takes over the results of the previous computation.
+ */
+static void safelanes_prevTake( SafeLanesPrev *prev )
+{
+   prev->sys_to_first_vertex = sys_to_first_vertex;
+   prev->sys_to_first_edge   = sys_to_first_edge;
+   prev->vertex_fmask        = vertex_fmask;
+   prev->lane_faction        = lane_faction;
+   prev->sys_hash            = sys_hash;
+   prev->sys_comp            = sys_comp;
+   prev->faction_hash        = faction_hash;
+   sys_to_first_vertex       = NULL;
+   sys_to_first_edge         = NULL;
+   vertex_fmask              = NULL;
+   lane_faction              = NULL;
+   sys_hash                  = NULL;
+   sys_comp                  = NULL;
+}
+
+/**
+ * @brief Frees the results of the previous computation.
+ */
+static void safelanes_prevFree( SafeLanesPrev *prev )
+{
+   array_free( prev->sys_to_first_vertex );
+   array_free( prev->sys_to_first_edge );
+   free( prev->vertex_fmask );
+   array_free( prev->lane_faction );
+   array_free( prev->sys_hash );
+   array_free( prev->sys_comp );
+   memset( prev, 0, sizeof( SafeLanesPrev ) );
+}
+
 /**
  * @brief Tears down the local faction/object stacks.
  */
@@ -600,6 +941,14 @@ static void safelanes_destroyStacks( void )
    lane_faction = NULL;
    array_free( lane_fmask );
    lane_fmask = NULL;
+   array_free( sys_hash );
+   sys_hash = NULL;
+   array_free( sys_comp );
+   sys_comp = NULL;
+   array_free( sys_active );
+   sys_active = NULL;
+   array_free( comp_turns );
+   comp_turns = NULL;
 }
 
 /**
@@ -668,6 +1017,31 @@ static void safelanes_initStiff( void )
 #endif /* DEBUGGING */
 }
 
+/**
+ * @brief Analyzes the stiffness matrix, unless its sparsity pattern is the
+ * same as the previous one.
+ *
+ * Only the values of the matrix change during the optimization, so the
+ * factorization can be redone numerically every turn.
+ */
+static void safelanes_initFactor( void )
+{
+   cholmod_sparse *stiff_s;
+   uint64_t        pattern = HASH_INIT;
+
+   pattern = hash_data( pattern, &stiff->nrow, sizeof( stiff->nrow ) );
+   pattern = hash_data( pattern, stiff->i, stiff->nnz * sizeof( int ) );
+   pattern = hash_data( pattern, stiff->j, stiff->nnz * sizeof( int ) );
+   if ( ( stiff_f != NULL ) && ( pattern == stiff_pattern ) )
+      return;
+
+   cholmod_free_factor( &stiff_f, &C );
+   stiff_s       = cholmod_triplet_to_sparse( stiff, 0, &C );
+   stiff_f       = cholmod_analyze( stiff_s, &C );
+   stiff_pattern = pattern;
+   cholmod_free_sparse( &stiff_s, &C );
+}
+
 /**
  * @brief Returns the initial conductivity value (1/length) for edge ei.
  * The live value is stored in the stiffness matrix; \see safelanes_initStiff
@@ -822,6 +1196,7 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
       array_push_back( &facind_vals, 0 );
    }
    turns_next_time = 0;
+   memset( comp_turns, 0, array_size( comp_turns ) * sizeof( int ) );
 
    for ( int si = 0; si < array_size( sys_to_first_vertex ) - 1; si++ ) {
       /* Factions with most presence here choose first. */
@@ -938,9 +1313,10 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
 
          /* Add the lane. */
          presence_budget[fi][si] -= cost_best;
-         if ( presence_budget[fi][si] >= cost_cheapest_other )
+         if ( presence_budget[fi][si] >= cost_cheapest_other ) {
             turns_next_time++;
-         else {
+            comp_turns[sys_comp[si]]++;
+         } else {
             presence_budget[fi][si] =
                0.; /* Nothing more to do here; tell ourselves. */
             if ( lal[fi] == NULL )
@@ -981,6 +1357,19 @@ static int cmp_key( const void *p1, const void *p2 )
    return SIGN( d );
 }
 
+/**
+ * @brief Hashes data into a running hash (FNV-1a).
+ */
+static uint64_t hash_data( uint64_t h, const void *data, size_t size )
+{
+   const unsigned char *c = data;
+   for ( size_t i = 0; i < size; i++ ) {
+      h ^= c[i];
+      h *= HASH_PRIME;
+   }
+   return h;
+}
+
 /**
  * @brief Return true if this triangle is so flat that lanes from point m to
  * point n aren't allowed.
@@ -38,3 +38,4 @@ void      safelanes_destroy( void );
 SafeLane *safelanes_get( int faction, int standing, const StarSystem *system );
 void      safelanes_recalculate( void );
 int       safelanes_calculated( void );
+void      safelanes_benchmark( void );
@@ -113,6 +113,13 @@ SHADERS = [
       attributes = ["vertex"],
       uniforms = ["projection", "colour", "tex_mat", "sampler1", "sampler2", "inter"],
    ),
+   Shader(
+      name = "texture_instanced",
+      vs_path = "texture_instanced.vert",
+      fs_path = "texture_instanced.frag",
+      attributes = ["vertex", "inst_mat0", "inst_mat1", "inst_tex", "inst_colour", "inst_inter"],
+      uniforms = ["projection", "sampler1", "sampler2"],
+   ),
    Shader(
       name = "texturesdf",
       vs_path = "texturesdf.vert",
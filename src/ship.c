@@ -20,6 +20,7 @@
 #include "conf.h"
 #include "faction.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_camera.h"
@@ -58,6 +59,8 @@ typedef struct ShipThreadData_ {
 
 static Ship *ship_stack = NULL; /**< Stack of ships available in the game. */
 
+static NameIndex ship_nameidx; /**< Ship indices by name. */
+
 #define SHIP_FBO 3
 static double       max_size            = 512.; /* Use at least 512 x 512. */
 static double       ship_fbos           = 0.;
@@ -71,9 +74,12 @@ static double       ship_aa_scale       = -1.;
  * Prototypes
  */
 static int  ship_loadPLG( Ship *temp, const char *buf );
+static void ship_gfxPaths( const Ship *s, char *space, char *engine,
+                           char *comm, size_t len );
 static int  ship_parse( Ship *temp, const char *filename, int firstpass );
 static int  ship_parseThread( void *ptr );
 static void ship_freeSlot( ShipOutfitSlot *s );
+static void ship_reindex( void );
 static void ship_renderFramebuffer3D( const Ship *s, GLuint fbo, double size,
                                       double fw, double fh, double engine_glow,
                                       double t, const glColour *c,
@@ -90,6 +96,16 @@ static int ship_cmp( const void *p1, const void *p2 )
    return strcmp( s1->name, s2->name );
 }
 
+/**
+ * @brief Rebuilds the name index of the ships.
+ */
+static void ship_reindex( void )
+{
+   nidx_clear( &ship_nameidx );
+   for ( int i = 0; i < array_size( ship_stack ); i++ )
+      nidx_set( &ship_nameidx, ship_stack[i].name, i );
+}
+
 /**
  * @brief Gets a ship based on its name.
  *
@@ -112,9 +128,10 @@ const Ship *ship_get( const char *name )
  */
 const Ship *ship_getW( const char *name )
 {
-   const Ship s = { .name = (char *)name };
-   return bsearch( &s, ship_stack, array_size( ship_stack ), sizeof( Ship ),
-                   ship_cmp );
+   int id = nidx_get( &ship_nameidx, name );
+   if ( id < 0 )
+      return NULL;
+   return &ship_stack[id];
 }
 
 /**
@@ -620,6 +637,80 @@ int ship_gfxLoadNeeded( void )
    return 0;
 }
 
+/**
+ * @brief Gets the paths of the 2D graphics of a ship.
+ *
+ *    @param s Ship to get paths of.
+ *    @param[out] space Path of the space sprite.
+ *    @param[out] engine Path of the engine sprite.
+ *    @param[out] comm Path of the comm graphic.
+ *    @param len Size of the path buffers.
+ */
+static void ship_gfxPaths( const Ship *s, char *space, char *engine,
+                           char *comm, size_t len )
+{
+   char       *base;
+   const char *delim;
+   const char *ext = ".webp";
+   const char *buf = s->gfx_path;
+
+   /* Get base path. */
+   delim = strchr( buf, '_' );
+   base  = delim == NULL ? strdup( buf ) : strndup( buf, delim - buf );
+
+   /* Determine extension path. */
+   if ( buf[0] == '/' ) /* absolute path. */
+      snprintf( space, len, "%s", buf );
+   else {
+      snprintf( space, len, SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
+      if ( !PHYSFS_exists( space ) ) {
+         ext = ".png";
+         snprintf( space, len, SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
+      }
+   }
+
+   snprintf( engine, len, SHIP_GFX_PATH "%s/%s" SHIP_ENGINE "%s", base, buf,
+             ext );
+   snprintf( comm, len, SHIP_GFX_PATH "%s/%s" SHIP_COMM "%s", base, buf,
+             ext );
+   free( base );
+}
+
+/**
+ * @brief Starts decoding the graphics of a ship in the background.
+ *
+ * Ships with 3D graphics are skipped, as glTF models need the OpenGL context
+ * to load and are loaded when needed.
+ *
+ *    @param s Ship to prefetch the graphics of.
+ */
+void ship_gfxPrefetch( const Ship *s )
+{
+   char         str[PATH_MAX], engine[PATH_MAX], comm[PATH_MAX];
+   const char  *base_path;
+   unsigned int flags = OPENGL_TEX_MIPMAPS | OPENGL_TEX_VFLIP;
+
+   if ( ship_gfxLoaded( s ) )
+      return;
+
+   base_path = ( s->base_path != NULL ) ? s->base_path : s->base_type;
+   snprintf( str, sizeof( str ), SHIP_3DGFX_PATH "%s/%s.gltf", base_path,
+             s->gfx_path );
+   if ( PHYSFS_exists( str ) )
+      return;
+
+   /* Flags have to match ship_loadSpaceImage. */
+   snprintf( str, sizeof( str ), "%s%s.xml", SHIP_POLYGON_PATH,
+             ( s->polygon_path != NULL ) ? s->polygon_path : s->gfx_path );
+   if ( !PHYSFS_exists( str ) )
+      flags |= OPENGL_TEX_MAPTRANS;
+
+   ship_gfxPaths( s, str, engine, comm, sizeof( str ) );
+   gl_texPrefetch( str, s->sx, s->sy, flags );
+   if ( !s->noengine )
+      gl_texPrefetch( engine, s->sx, s->sy, OPENGL_TEX_MIPMAPS );
+}
+
 /**
  * @brief Loads the graphics for a ship if necessary.
  *
@@ -627,9 +718,8 @@ int ship_gfxLoadNeeded( void )
  */
 int ship_gfxLoad( Ship *s )
 {
-   char        str[PATH_MAX], *base;
-   const char *delim, *base_path;
-   const char *ext    = ".webp";
+   char        str[PATH_MAX], engine_path[PATH_MAX], comm[PATH_MAX];
+   const char *base_path;
    const char *buf    = s->gfx_path;
    int         sx     = s->sx;
    int         sy     = s->sy;
@@ -640,8 +730,6 @@ int ship_gfxLoad( Ship *s )
       return 0;
 
    /* Get base path. */
-   delim     = strchr( buf, '_' );
-   base      = delim == NULL ? strdup( buf ) : strndup( buf, delim - buf );
    base_path = ( s->base_path != NULL ) ? s->base_path : s->base_type;
 
    /* Load the 3d model */
@@ -691,46 +779,31 @@ int ship_gfxLoad( Ship *s )
       }
    }
 
-   /* Determine extension path. */
-   if ( buf[0] == '/' ) /* absolute path. */
-      snprintf( str, sizeof( str ), "%s", buf );
-   else {
-      snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
-      if ( !PHYSFS_exists( str ) ) {
-         ext = ".png";
-         snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s%s", base, buf,
-                   ext );
-      }
-   }
+   /* Determine the 2D graphics paths. */
+   ship_gfxPaths( s, str, engine_path, comm, sizeof( str ) );
 
    /* Load the polygon. */
    ship_loadPLG( s,
                  ( s->polygon_path != NULL ) ? s->polygon_path : s->gfx_path );
 
    /* If we have 3D and polygons, we'll ignore the 2D stuff. */
-   if ( ( s->gfx_3d != NULL ) && ( array_size( s->polygon.views ) > 0 ) ) {
-      free( base );
+   if ( ( s->gfx_3d != NULL ) && ( array_size( s->polygon.views ) > 0 ) )
       return 0;
-   }
 
    /* Get the comm graphic for future loading. */
    if ( s->gfx_comm == NULL )
-      SDL_asprintf( &s->gfx_comm, SHIP_GFX_PATH "%s/%s" SHIP_COMM "%s", base,
-                    buf, ext );
+      s->gfx_comm = strdup( comm );
 
    /* Load the space sprite. */
    ship_loadSpaceImage( s, str, sx, sy );
 
    /* Load the engine sprite .*/
    if ( engine ) {
-      snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s" SHIP_ENGINE "%s",
-                base, buf, ext );
-      ship_loadEngineImage( s, str, sx, sy );
+      ship_loadEngineImage( s, engine_path, sx, sy );
       if ( s->gfx_engine == NULL )
          WARN( _( "Ship '%s' does not have an engine sprite (%s)." ), s->name,
-               str );
+               engine_path );
    }
-   free( base );
 
 #if 0
 #if DEBUGGING
@@ -1471,7 +1544,7 @@ static void ship_renderFramebuffer3D( const Ship *s, GLuint fbo, double size,
    gl_uniformMat4( shaders.texture_sharpen.tex_mat, &tex_mat );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_sharpen.vertex );
@@ -1647,15 +1720,19 @@ int ships_load( void )
    }
    array_free( shipdata );
 
-   /* Sort so we can use ship_get. */
+   /* Sort and index so we can use ship_get. */
    qsort( ship_stack, array_size( ship_stack ), sizeof( Ship ), ship_cmp );
+   nidx_create( &ship_nameidx );
+   ship_reindex();
 
    /* Now we do the second pass to resolve inheritance. */
    for ( int i = array_size( ship_stack ) - 1; i >= 0; i-- ) {
       Ship *s   = &ship_stack[i];
       int   ret = ship_parse( s, NULL, 0 );
-      if ( ret )
+      if ( ret ) {
          array_erase( &ship_stack, &s[0], &s[1] );
+         ship_reindex();
+      }
    }
 
 #if DEBUGGING
@@ -1852,6 +1929,7 @@ void ships_free( void )
 
    array_free( ship_stack );
    ship_stack = NULL;
+   nidx_free( &ship_nameidx );
 }
 
 static void ship_freeSlot( ShipOutfitSlot *s )
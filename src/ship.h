@@ -241,5 +241,6 @@ void   ships_resize( void );
 int    ship_gfxLoaded( const Ship *s );
 int    ship_gfxLoadNeeded( void );
 int    ship_gfxLoad( Ship *temp );
+void   ship_gfxPrefetch( const Ship *s );
 int    ship_compareTech( const void *arg1, const void *arg2 );
 double ship_maxSize( void );
@@ -48,6 +48,7 @@
 #include "log.h"
 #include "music.h"
 #include "ndata.h"
+#include "nlua_audio.h"
 #include "nlua_spfx.h"
 #include "nopenal.h"
 #include "pilot.h"
@@ -59,6 +60,8 @@
 
 #define SOUND_SUFFIX_WAV ".wav" /**< Suffix of sounds. */
 #define SOUND_SUFFIX_OGG ".ogg" /**< Suffix of sounds. */
+#define SOUND_CACHE_BUDGET                                                     \
+   ( 32 * 1024 * 1024 ) /**< Bytes of decoded PCM to keep around. */
 
 #define voiceLock() SDL_LockMutex( voice_mutex )
 #define voiceUnlock() SDL_UnlockMutex( voice_mutex )
@@ -67,15 +70,34 @@
  * @struct alSound
  *
  * @brief Contains a sound buffer.
+ *
+ * Sounds with a filename are only decoded the first time they are played, and
+ * may be evicted again when the decoded data goes over the cache budget. The
+ * length and channels are kept once known.
  */
 typedef struct alSound_ {
-   char  *filename; /**< Name of the file loaded from. */
-   char  *name;     /**< Buffer's name. */
-   double length;   /**< Length of the buffer. */
-   int    channels; /**< Number of channels of the buffer. */
-   ALuint buf;      /**< Buffer data. */
+   char        *filename; /**< Name of the file loaded from, NULL if unknown. */
+   char        *name;     /**< Buffer's name. */
+   double       length;   /**< Length of the buffer. */
+   int          channels; /**< Number of channels of the buffer. */
+   ALuint       buf;      /**< Buffer data, only valid when loaded. */
+   int          loaded;   /**< 1 if decoded, 0 if not yet, -1 if failed. */
+   size_t       bytes;    /**< Size of the decoded data. */
+   unsigned int lastused; /**< Cache tick of the last use. */
 } alSound;
 
+/**
+ * @brief Statistics of the sound cache.
+ */
+typedef struct SoundCacheStats_ {
+   unsigned int hits;      /**< Plays of already decoded sounds. */
+   unsigned int misses;    /**< Plays that had to decode the sound. */
+   unsigned int evictions; /**< Sounds evicted to stay within budget. */
+   double       decode;    /**< Total time spent decoding in seconds. */
+   double       decodemax; /**< Longest decode in seconds. */
+   size_t       bytesmax;  /**< Peak size of the decoded data. */
+} SoundCacheStats;
+
 /**
  * @typedef voice_state_t
  * @brief The state of a voice.
@@ -133,7 +155,10 @@ static int sound_initialized = 0; /**< Whether or not sound is initialized. */
 /*
  * Sound list.
  */
-static alSound *sound_list = NULL; /**< List of available sounds. */
+static alSound        *sound_list  = NULL; /**< List of available sounds. */
+static size_t          sound_bytes = 0;    /**< Bytes of decoded sounds. */
+static unsigned int    sound_tick  = 0;    /**< Cache tick for the LRU. */
+static SoundCacheStats sound_stats;        /**< Cache statistics. */
 
 /*
  * Voices.
@@ -156,6 +181,12 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
 /* General. */
 static int  sound_makeList( void );
 static void sound_free( alSound *snd );
+static int  sound_addFile( const char *filename, const char *name );
+/* Cache. */
+static int  sound_load( alSound *snd );
+static int  sound_use( alSound *snd );
+static void sound_unload( alSound *snd );
+static void sound_cacheTrim( const alSound *keep );
 /* Voices. */
 
 /*
@@ -673,6 +704,9 @@ void sound_exit( void )
    if ( sound_disabled || !sound_initialized )
       return;
 
+   /* The stream worker uses the lock and sources, so it has to go first. */
+   audio_exit();
+
    if ( voice_mutex != NULL ) {
       voiceLock();
       /* free the voices. */
@@ -723,9 +757,14 @@ void sound_exit( void )
    source_mstack = 0;
 
    /* free the sounds */
+#if DEBUGGING
+   sound_debugStats();
+#endif /* DEBUGGING */
    for ( int i = 0; i < array_size( sound_list ); i++ )
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list  = NULL;
+   sound_bytes = 0;
 
    /* Clean up EFX stuff. */
    if ( al_info.efx == AL_TRUE ) {
@@ -779,10 +818,16 @@ int sound_get( const char *name )
  */
 double sound_getLength( int sound )
 {
+   alSound *s;
+
    if ( sound_disabled )
       return 0.;
 
-   return sound_list[sound].length;
+   /* The length is only known after the first decode. */
+   s = &sound_list[sound];
+   if ( s->loaded == 0 )
+      sound_load( s );
+   return s->length;
 }
 
 /**
@@ -802,11 +847,13 @@ int sound_play( int sound )
    if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
       return -1;
 
-   /* Gets a new voice. */
-   v = voice_new();
-
    /* Get the sound. */
    s = &sound_list[sound];
+   if ( sound_use( s ) )
+      return -1;
+
+   /* Gets a new voice. */
+   v = voice_new();
 
    /* Try to play the sound. */
    if ( al_playVoice( v, s, 0., 0., 0., 0., AL_TRUE ) )
@@ -860,11 +907,13 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
-   /* Gets a new voice. */
-   v = voice_new();
-
    /* Get the sound. */
    s = &sound_list[sound];
+   if ( sound_use( s ) )
+      return -1;
+
+   /* Gets a new voice. */
+   v = voice_new();
 
    /* Try to play the sound. */
    if ( al_playVoice( v, s, px, py, vx, vy, AL_FALSE ) )
@@ -1222,10 +1271,9 @@ static int sound_makeList( void )
    /* load the profiles */
    suflen = strlen( SOUND_SUFFIX_WAV );
    for ( size_t i = 0; files[i] != NULL; i++ ) {
-      int        len;
-      char       path[PATH_MAX];
-      SDL_RWops *rw;
-      int        flen = strlen( files[i] );
+      int  len;
+      char path[PATH_MAX];
+      int  flen = strlen( files[i] );
 
       /* Must be longer than suffix. */
       if ( flen < suflen )
@@ -1238,16 +1286,14 @@ static int sound_makeList( void )
              0 ) )
          continue;
 
-      /* Load the sound. */
+      /* Only remember the sound, it gets decoded when first played. */
       snprintf( path, sizeof( path ), SOUND_PATH "%s", files[i] );
-      rw = PHYSFSRWOPS_openRead( path );
 
       /* remove the suffix */
       len           = flen - suflen;
       files[i][len] = '\0';
 
-      source_newRW( rw, files[i], 0 );
-      SDL_RWclose( rw );
+      sound_addFile( path, files[i] );
    }
 
    DEBUG( n_( "Loaded %d Sound", "Loaded %d Sounds", array_size( sound_list ) ),
@@ -1321,12 +1367,189 @@ static void sound_free( alSound *snd )
    free( snd->filename );
 
    /* Free internals. */
-   soundLock();
+   if ( snd->loaded > 0 ) {
+      soundLock();
+      alDeleteBuffers( 1, &snd->buf );
+      al_checkErr();
+      soundUnlock();
+   }
+}
+
+/**
+ * @brief Adds a sound to the list without decoding it.
+ *
+ *    @param filename Path to the sound file.
+ *    @param name Name of the sound.
+ *    @return ID of the new sound.
+ */
+static int sound_addFile( const char *filename, const char *name )
+{
+   alSound *snd = &array_grow( &sound_list );
+   memset( snd, 0, sizeof( alSound ) );
+   snd->filename = strdup( filename );
+   snd->name     = strdup( name );
+   return snd - sound_list;
+}
+
+/**
+ * @brief Decodes a sound into its buffer if it is not already.
+ *
+ *    @param snd Sound to decode.
+ *    @return 0 on success.
+ */
+static int sound_load( alSound *snd )
+{
+   SDL_RWops *rw;
+   Uint64     t;
+   double     dt;
+   int        ret;
 
+   if ( snd->loaded > 0 )
+      return 0;
+   else if ( snd->loaded < 0 )
+      return -1;
+
+   rw = PHYSFSRWOPS_openRead( snd->filename );
+   if ( rw == NULL ) {
+      WARN( _( "Unable to open sound file '%s'." ), snd->filename );
+      snd->loaded = -1;
+      return -1;
+   }
+   t   = SDL_GetPerformanceCounter();
+   ret = al_load( snd, rw, snd->name );
+   dt  = (double)( SDL_GetPerformanceCounter() - t ) /
+        (double)SDL_GetPerformanceFrequency();
+   SDL_RWclose( rw );
+   if ( ret != 0 ) {
+      snd->loaded = -1;
+      return -1;
+   }
+   snd->loaded = 1;
+
+   /* Statistics. */
+   sound_stats.misses++;
+   sound_stats.decode += dt;
+   sound_stats.decodemax = MAX( sound_stats.decodemax, dt );
+   sound_bytes += snd->bytes;
+   sound_stats.bytesmax = MAX( sound_stats.bytesmax, sound_bytes );
+
+   /* Make room for it. */
+   sound_cacheTrim( snd );
+   return 0;
+}
+
+/**
+ * @brief Marks a sound as used, decoding it if necessary.
+ *
+ *    @param snd Sound that is about to be played.
+ *    @return 0 on success.
+ */
+static int sound_use( alSound *snd )
+{
+   snd->lastused = ++sound_tick;
+   if ( snd->loaded > 0 ) {
+      sound_stats.hits++;
+      return 0;
+   }
+   return sound_load( snd );
+}
+
+/**
+ * @brief Frees the decoded data of a sound, keeping it in the list.
+ *
+ *    @param snd Sound to unload.
+ */
+static void sound_unload( alSound *snd )
+{
+   soundLock();
    alDeleteBuffers( 1, &snd->buf );
    al_checkErr();
+   soundUnlock();
+   snd->buf    = 0;
+   snd->loaded = 0;
+   sound_bytes -= snd->bytes;
+   sound_stats.evictions++;
+}
 
+/**
+ * @brief Evicts the least recently used sounds until within budget.
+ *
+ * Sounds that are still attached to a source can not be freed and are
+ * skipped, so the budget may be temporarily exceeded.
+ *
+ *    @param keep Sound not to evict.
+ */
+static void sound_cacheTrim( const alSound *keep )
+{
+   ALint *inuse;
+
+   if ( sound_bytes <= SOUND_CACHE_BUDGET )
+      return;
+
+   /* Buffers still attached to sources can not be deleted. */
+   inuse = malloc( sizeof( ALint ) * MAX( source_nall, 1 ) );
+   soundLock();
+   for ( int i = 0; i < source_nall; i++ )
+      alGetSourcei( source_all[i], AL_BUFFER, &inuse[i] );
+   al_checkErr();
    soundUnlock();
+
+   while ( sound_bytes > SOUND_CACHE_BUDGET ) {
+      alSound *lru = NULL;
+      for ( int i = 0; i < array_size( sound_list ); i++ ) {
+         alSound *s    = &sound_list[i];
+         int      used = 0;
+         /* Sounds without a file can't be decoded again. */
+         if ( ( s == keep ) || ( s->loaded <= 0 ) || ( s->filename == NULL ) )
+            continue;
+         if ( ( lru != NULL ) && ( s->lastused >= lru->lastused ) )
+            continue;
+         for ( int j = 0; j < source_nall; j++ ) {
+            if ( (ALuint)inuse[j] == s->buf ) {
+               used = 1;
+               break;
+            }
+         }
+         if ( !used )
+            lru = s;
+      }
+      if ( lru == NULL )
+         break;
+      sound_unload( lru );
+   }
+
+   free( inuse );
+}
+
+/**
+ * @brief Logs the statistics of the sound cache.
+ */
+void sound_debugStats( void )
+{
+   unsigned int plays = sound_stats.hits + sound_stats.misses;
+   int          n     = 0;
+
+   if ( sound_disabled )
+      return;
+
+   for ( int i = 0; i < array_size( sound_list ); i++ )
+      if ( sound_list[i].loaded > 0 )
+         n++;
+   LOG( _( "Sound cache: %d of %d sounds decoded using %.1f MiB (peak %.1f "
+           "MiB, budget %.1f MiB)" ),
+        n, array_size( sound_list ), (double)sound_bytes / ( 1024. * 1024. ),
+        (double)sound_stats.bytesmax / ( 1024. * 1024. ),
+        (double)SOUND_CACHE_BUDGET / ( 1024. * 1024. ) );
+   LOG( _( "Sound cache: %u plays, %.1f%% hit rate, %u evictions" ), plays,
+        ( plays > 0 ) ? 100. * (double)sound_stats.hits / (double)plays : 0.,
+        sound_stats.evictions );
+   LOG( _( "Sound cache: %u decodes taking %.1f ms (%.2f ms average, %.2f ms "
+           "max)" ),
+        sound_stats.misses, sound_stats.decode * 1000.,
+        ( sound_stats.misses > 0 )
+           ? sound_stats.decode * 1000. / (double)sound_stats.misses
+           : 0.,
+        sound_stats.decodemax * 1000. );
 }
 
 /**
@@ -1418,6 +1641,8 @@ int sound_playGroup( int group, int sound, int once )
       return -1;
 
    s = &sound_list[sound];
+   if ( sound_use( s ) )
+      return -1;
    for ( int i = 0; i < al_ngroups; i++ ) {
       alGroup_t *g;
 
@@ -1806,6 +2031,10 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
    if ( ret )
       return -1;
 
+   /* Can't be decoded again, so it stays around until the end. */
+   snd.loaded = 1;
+   sound_bytes += snd.bytes;
+
    sndl = &array_grow( &sound_list );
    memcpy( sndl, &snd, sizeof( alSound ) );
    sndl->name = strdup( name );
@@ -1814,14 +2043,23 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
 }
 
 /**
- * @brief Loads a new source from a file.
+ * @brief Adds a new source from a file, it gets decoded when first played.
  */
 int source_new( const char *filename, unsigned int flags )
 {
-   SDL_RWops *rw = PHYSFSRWOPS_openRead( filename );
-   int        id = source_newRW( rw, filename, flags );
+   SDL_RWops *rw;
+   (void)flags;
+   if ( sound_disabled )
+      return -1;
+
+   /* Report missing files now rather than when first played. */
+   rw = PHYSFSRWOPS_openRead( filename );
+   if ( rw == NULL ) {
+      WARN( _( "Unable to open sound file '%s'." ), filename );
+      return -1;
+   }
    SDL_RWclose( rw );
-   return id;
+   return sound_addFile( filename, filename );
 }
 
 /**
@@ -2143,6 +2381,7 @@ int al_load( alSound *snd, SDL_RWops *rw, const char *name )
    } else
       snd->length = (double)size / (double)( freq * ( bits / 8 ) * channels );
    snd->channels = channels;
+   snd->bytes    = size;
 
    /* Check for errors. */
    al_checkErr();
@@ -85,6 +85,7 @@ int source_new( const char *filename, unsigned int flags );
  */
 int    sound_get( const char *name );
 double sound_getLength( int sound );
+void   sound_debugStats( void );
 
 /*
  * voice management
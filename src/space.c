@@ -16,6 +16,7 @@
 
 #include "space.h"
 
+#include "arena.h"
 #include "array.h"
 #include "background.h"
 #include "camera.h"
@@ -33,6 +34,7 @@
 #include "menu.h"
 #include "mission.h"
 #include "music.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nebula.h"
 #include "nlua.h"
@@ -72,6 +74,8 @@
 
 #define DEBRIS_BUFFER 1000 /**< Buffer to smooth appearance of debris */
 
+#define PREFETCH_SHIPS 16 /**< Ship graphics to prefetch when jumping. */
+
 static const double spob_aa_scale = 2.;
 
 typedef struct spob_lua_file_s {
@@ -100,9 +104,13 @@ static VirtualSpob *vspob_stack   = NULL; /**< Virtual spob stack. */
  * stuff. Main issue will be redoing the Lua system/spob modules to handle such
  * a case, but can be done with  the weapon module as a referenc. */
 static int systemstack_changed =
-   0; /**< Whether or not the systems_stack was changed after loading. */
+   0; /**< Whether or not the systems_stack was changed after loading, and
+         system_nameidx has to be rebuilt. */
 static int spobstack_changed =
-   0; /**< Whether or not the spob_stack was changed after loading. */
+   0; /**< Whether or not the spob_stack was changed after loading, and
+         spob_nameidx has to be rebuilt. */
+static NameIndex system_nameidx; /**< System indices by name. */
+static NameIndex spob_nameidx;   /**< Spob indices by name. */
 static MapShader **mapshaders = NULL; /**< Map shaders. */
 
 /*
@@ -128,13 +136,15 @@ int space_spawn = 1; /**< Spawn enabled by default. */
  */
 /* spob load */
 static void spob_initDefaults( Spob *spob );
-static int  spob_parse( Spob *spob, const char *filename, Commodity **stdList );
+static int  spob_parse( Spob *spob, xmlDocPtr doc, const char *filename,
+                        Commodity **stdList );
 static int  space_parseSaveNodes( xmlNodePtr parent, StarSystem *sys );
 static int  spob_parsePresence( xmlNodePtr node, SpobPresence *ap );
 /* system load */
 static void system_init( StarSystem *sys );
 static int  systems_load( void );
-static int  system_parse( StarSystem *system, const char *filename );
+static int  system_parse( StarSystem *system, xmlDocPtr doc,
+                          const char *filename );
 static int  system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys );
 static int  system_parseJumps( StarSystem *sys );
 static int  system_parseAsteroidField( const xmlNodePtr node, StarSystem *sys );
@@ -142,9 +152,12 @@ static int  system_parseAsteroidExclusion( const xmlNodePtr node,
                                            StarSystem      *sys );
 /* misc */
 static int             spob_cmp( const void *p1, const void *p2 );
+static void            spob_reindex( void );
+static void            system_reindex( void );
 static void            system_scheduler( double dt, int init );
 static SystemPresence *system_getFactionPresenceGrow( StarSystem *sys,
                                                       int         faction );
+static int             presence_cmpValue( const void *p1, const void *p2 );
 /* Markers. */
 static int space_addMarkerSystem( int sysid, MissionMarkerType type );
 static int space_addMarkerSpob( int pntid, MissionMarkerType type );
@@ -890,19 +903,14 @@ int space_sysReachable( const StarSystem *sys )
  */
 int space_sysReallyReachable( const char *sysname )
 {
-   StarSystem **path, *goal;
+   const StarSystem *goal;
 
    if ( strcmp( sysname, cur_system->name ) == 0 )
       return 1;
    goal = system_get( sysname );
    if ( goal == NULL )
       return 0;
-   path = map_getJumpPath( cur_system, NULL, goal, 1, 1, NULL, NULL );
-   if ( path != NULL ) {
-      array_free( path );
-      return 1;
-   }
-   return 0;
+   return ( map_getJumpDist( cur_system, goal, 1, 1 ) >= 0 );
 }
 
 /**
@@ -1008,29 +1016,36 @@ static int system_cmp( const void *p1, const void *p2 )
  */
 StarSystem *system_get( const char *sysname )
 {
+   int id;
+
    if ( sysname == NULL )
       return NULL;
 
    /* Somethig was added, and since we store IDs too, everything can't be sorted
-    * anymore by name... */
-   if ( systemstack_changed ) {
-      for ( int i = 0; i < array_size( systems_stack ); i++ )
-         if ( strcmp( systems_stack[i].name, sysname ) == 0 )
-            return &systems_stack[i];
-      WARN( _( "System '%s' not found in stack" ), sysname );
-      return NULL;
-   }
+    * anymore by name, so the index has to be rebuilt... */
+   if ( systemstack_changed )
+      system_reindex();
 
-   const StarSystem s = { .name = (char *)sysname };
-   StarSystem *found  = bsearch( &s, systems_stack, array_size( systems_stack ),
-                                 sizeof( StarSystem ), system_cmp );
-   if ( found != NULL )
-      return found;
+   id = nidx_get( &system_nameidx, sysname );
+   if ( id >= 0 )
+      return &systems_stack[id];
 
    WARN( _( "System '%s' not found in stack" ), sysname );
    return NULL;
 }
 
+/**
+ * @brief Rebuilds the name index of the systems.
+ */
+static void system_reindex( void )
+{
+   nidx_clear( &system_nameidx );
+   /* Go backwards so the first system with a name wins. */
+   for ( int i = array_size( systems_stack ) - 1; i >= 0; i-- )
+      nidx_set( &system_nameidx, systems_stack[i].name, i );
+   systemstack_changed = 0;
+}
+
 /**
  * @brief Get the system by its index.
  *
@@ -1108,31 +1123,38 @@ static int spob_cmp( const void *p1, const void *p2 )
  */
 Spob *spob_get( const char *spobname )
 {
+   int id;
+
    if ( spobname == NULL ) {
       WARN( _( "Trying to find NULL spob…" ) );
       return NULL;
    }
 
    /* Somethig was added, and since we store IDs too, everything can't be sorted
-    * anymore by name... */
-   if ( spobstack_changed ) {
-      for ( int i = 0; i < array_size( spob_stack ); i++ )
-         if ( strcmp( spob_stack[i].name, spobname ) == 0 )
-            return &spob_stack[i];
-      WARN( _( "Spob '%s' not found in the universe" ), spobname );
-      return NULL;
-   }
+    * anymore by name, so the index has to be rebuilt... */
+   if ( spobstack_changed )
+      spob_reindex();
 
-   const Spob p     = { .name = (char *)spobname };
-   Spob      *found = bsearch( &p, spob_stack, array_size( spob_stack ),
-                               sizeof( Spob ), spob_cmp );
-   if ( found != NULL )
-      return found;
+   id = nidx_get( &spob_nameidx, spobname );
+   if ( id >= 0 )
+      return &spob_stack[id];
 
    WARN( _( "Spob '%s' not found in the universe" ), spobname );
    return NULL;
 }
 
+/**
+ * @brief Rebuilds the name index of the spobs.
+ */
+static void spob_reindex( void )
+{
+   nidx_clear( &spob_nameidx );
+   /* Go backwards so the first spob with a name wins. */
+   for ( int i = array_size( spob_stack ) - 1; i >= 0; i-- )
+      nidx_set( &spob_nameidx, spob_stack[i].name, i );
+   spobstack_changed = 0;
+}
+
 /**
  * @brief Gets spob by index.
  *
@@ -1572,6 +1594,7 @@ void space_update( double dt, double real_dt )
             continue;
 
          jp_setFlag( jp, JP_KNOWN );
+         map_jumpDistInvalidate();
          player_message( _( "You discovered a Jump Point." ) );
          hparam[0].type        = HOOK_PARAM_STRING;
          hparam[0].u.str       = "jump";
@@ -1605,6 +1628,15 @@ int space_isSimulation( void )
    return space_simulating;
 }
 
+/**
+ * @brief returns whether we're in the fast part of the simulation, where
+ * weapon collisions are skipped and the AI thinks less often.
+ */
+int space_isWarmup( void )
+{
+   return conf.fast_warmup && space_simulating && !space_simulating_effects;
+}
+
 /**
  * @brief returns whether or not we're simulating with effects.
  */
@@ -1724,7 +1756,10 @@ void space_init( const char *sysname, int do_simulate )
    system_scheduler( 0., 1 );
 
    /* we now know this system */
-   sys_setFlag( cur_system, SYSTEM_KNOWN );
+   if ( !sys_isKnown( cur_system ) ) {
+      sys_setFlag( cur_system, SYSTEM_KNOWN );
+      map_jumpDistInvalidate();
+   }
 
    NTracingZoneName( _ctx_simulating, "space_init[simulation]", 1 );
    /* Simulate system. */
@@ -1742,14 +1777,17 @@ void space_init( const char *sysname, int do_simulate )
    }
    player_messageToggle( 0 );
    if ( do_simulate ) {
-      int n, s;
+      int    n, s;
+      double dt_pre;
       /* Uint32 time = SDL_GetTicks(); */
       s              = sound_disabled;
       sound_disabled = 1;
       ntime_allowUpdate( 0 );
-      n = SYSTEM_SIMULATE_TIME_PRE / fps_min_simulation;
+      /* Nothing is visible yet, so coarser steps are good enough. */
+      dt_pre = conf.fast_warmup ? SYSTEM_SIMULATE_DT_PRE : fps_min_simulation;
+      n      = SYSTEM_SIMULATE_TIME_PRE / dt_pre;
       for ( int i = 0; i < n; i++ )
-         update_routine( fps_min_simulation, 0 );
+         update_routine( dt_pre, 0 );
       space_simulating_effects = 1;
       n                        = SYSTEM_SIMULATE_TIME_POST / fps_min_simulation;
       for ( int i = 0; i < n; i++ )
@@ -1852,6 +1890,7 @@ const char *spob_name( const Spob *p )
 static int spobs_load( void )
 {
    char      **spob_files;
+   xmlDocPtr  *docs;
    Commodity **stdList;
 
    /* Initialize stack if needed. */
@@ -1861,12 +1900,13 @@ static int spobs_load( void )
    /* Extract the list of standard commodities. */
    stdList = standard_commodities();
 
-   /* Load XML stuff. */
+   /* Load XML stuff, the files are read and parsed in parallel. */
    spob_files = ndata_listRecursive( SPOB_DATA_PATH );
+   docs       = xml_parsePhysFSList( spob_files, array_size( spob_files ) );
    for ( int i = 0; i < array_size( spob_files ); i++ ) {
-      if ( ndata_matchExt( spob_files[i], "xml" ) ) {
+      if ( docs[i] != NULL ) {
          Spob s;
-         int  ret = spob_parse( &s, spob_files[i], stdList );
+         int  ret = spob_parse( &s, docs[i], spob_files[i], stdList );
          if ( ret == 0 ) {
             s.id = array_size( spob_stack );
             array_push_back( &spob_stack, s );
@@ -1882,10 +1922,13 @@ static int spobs_load( void )
    qsort( spob_stack, array_size( spob_stack ), sizeof( Spob ), spob_cmp );
    for ( int j = 0; j < array_size( spob_stack ); j++ )
       spob_stack[j].id = j;
+   nidx_create( &spob_nameidx );
+   spob_reindex();
 
    /* Clean up. */
    array_free( spob_files );
    array_free( stdList );
+   free( docs );
 
    return 0;
 }
@@ -2279,6 +2322,69 @@ void space_gfxLoad( StarSystem *sys )
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Compares presences by decreasing value.
+ */
+static int presence_cmpValue( const void *p1, const void *p2 )
+{
+   const SystemPresence *a = p1;
+   const SystemPresence *b = p2;
+   return ( a->value < b->value ) - ( a->value > b->value );
+}
+
+/**
+ * @brief Starts decoding the graphics of a star system in the background.
+ *
+ * Used when a jump is engaged so that the spob graphics and the ships of the
+ * factions with the most presence in the target system are ready by the time
+ * the player arrives.
+ *
+ *    @param sys System to prefetch graphics for.
+ */
+void space_gfxPrefetch( const StarSystem *sys )
+{
+   const Ship     *ships = ship_getAll();
+   int             npres = array_size( sys->presence );
+   int             n     = 0;
+   SystemPresence *pres;
+   ArenaMark       mark;
+
+   NTracingZone( _ctx, 1 );
+
+   /* Whatever wasn't used from the last prefetch can go. */
+   gl_texStreamRelease();
+
+   /* Spobs with Lua load their graphics themselves. */
+   for ( int i = 0; i < array_size( sys->spobs ); i++ ) {
+      const Spob *spob = sys->spobs[i];
+      if ( ( spob->lua_load != LUA_NOREF ) || ( spob->gfx_space != NULL ) ||
+           ( spob->gfx_space3dName != NULL ) )
+         continue;
+      gl_texPrefetch( spob->gfx_spaceName, 1, 1, OPENGL_TEX_MIPMAPS );
+   }
+
+   /* Guess the ships from the presence, most present factions first. */
+   mark = arena_mark( arena_scratch() );
+   pres = arena_alloc( mark.arena, sizeof( SystemPresence ) * MAX( npres, 1 ) );
+   memcpy( pres, sys->presence, sizeof( SystemPresence ) * npres );
+   qsort( pres, npres, sizeof( SystemPresence ), presence_cmpValue );
+   for ( int i = 0; ( i < npres ) && ( n < PREFETCH_SHIPS ); i++ ) {
+      if ( pres[i].value <= 0. )
+         break;
+      for ( int j = 0; ( j < array_size( ships ) ) && ( n < PREFETCH_SHIPS );
+            j++ ) {
+         if ( ( ships[j].faction != pres[i].faction ) ||
+              ship_gfxLoaded( &ships[j] ) )
+            continue;
+         ship_gfxPrefetch( &ships[j] );
+         n++;
+      }
+   }
+   arena_release( &mark );
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief Unloads all the graphics for a star system.
  *
@@ -2364,21 +2470,18 @@ static void spob_initDefaults( Spob *spob )
  * @brief Parses a spob from an xml node.
  *
  *    @param spob Spob to fill up.
- *    @param filename Name of the file to parse.
+ *    @param doc Parsed file, gets freed.
+ *    @param filename Name of the file that was parsed.
  *    @param[in] stdList The array of standard commodities.
  *    @return 0 on success.
  */
-static int spob_parse( Spob *spob, const char *filename, Commodity **stdList )
+static int spob_parse( Spob *spob, xmlDocPtr doc, const char *filename,
+                       Commodity **stdList )
 {
-   xmlDocPtr    doc;
    xmlNodePtr   node, parent;
    unsigned int flags;
    Commodity  **comms;
 
-   doc = xml_parsePhysFS( filename );
-   if ( doc == NULL )
-      return -1;
-
    parent = doc->xmlChildrenNode; /* first spob node */
    if ( parent == NULL ) {
       WARN( _( "Malformed %s file: does not contain elements" ), filename );
@@ -3005,6 +3108,7 @@ void systems_reconstructJumps( void )
       for ( int j = 0; j < array_size( sys->jumps ); j++ )
          sys->jumps[j].targetid = sys->jumps[j].target->id;
    }
+   map_jumpDistInvalidate();
 
    NTracingZoneEnd( _ctx );
 }
@@ -3163,20 +3267,15 @@ static int system_parseAsteroidExclusion( const xmlNodePtr node,
  * @brief Creates a system from an XML node.
  *
  *    @param sys System to set up.
- *    @param filename Name of the file to parse.
+ *    @param doc Parsed file, gets freed.
+ *    @param filename Name of the file that was parsed.
  *    @return 0 on success.
  */
-static int system_parse( StarSystem *sys, const char *filename )
+static int system_parse( StarSystem *sys, xmlDocPtr doc, const char *filename )
 {
    xmlNodePtr node, parent;
-   xmlDocPtr  doc;
    uint32_t   flags;
 
-   /* Load the file. */
-   doc = xml_parsePhysFS( filename );
-   if ( doc == NULL )
-      return -1;
-
    parent = doc->xmlChildrenNode; /* first spob node */
    if ( parent == NULL ) {
       WARN( _( "Malformed %s file: does not contain elements" ), filename );
@@ -3623,13 +3722,16 @@ static int systems_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **system_files;
+   char     **system_files;
+   xmlDocPtr *docs;
 
    /* Allocate if needed. */
    if ( systems_stack == NULL )
       systems_stack = array_create( StarSystem );
 
+   /* The files are read and parsed in parallel. */
    system_files = ndata_listRecursive( SYSTEM_DATA_PATH );
+   docs = xml_parsePhysFSList( system_files, array_size( system_files ) );
 
    /*
     * First pass - loads all the star systems_stack.
@@ -3637,10 +3739,10 @@ static int systems_load( void )
    for ( int i = 0; i < array_size( system_files ); i++ ) {
       StarSystem sys;
 
-      if ( !ndata_matchExt( system_files[i], "xml" ) )
+      if ( docs[i] == NULL )
          continue;
 
-      int ret = system_parse( &sys, system_files[i] );
+      int ret = system_parse( &sys, docs[i], system_files[i] );
       if ( ret == 0 ) {
          sys.filename = system_files[i];
          sys.id       = array_size( systems_stack );
@@ -3660,6 +3762,8 @@ static int systems_load( void )
       systems_stack[j].id   = j;
       systems_stack[j].note = NULL; /* just to be sure */
    }
+   nidx_create( &system_nameidx );
+   system_reindex();
 
    /*
     * Second pass - loads all the jump routes.
@@ -3669,6 +3773,7 @@ static int systems_load( void )
 
    /* Clean up. */
    array_free( system_files );
+   free( docs );
 
 #if DEBUGGING
    if ( conf.devmode ) {
@@ -3917,6 +4022,7 @@ void space_exit( void )
       nlua_freeEnv( spb->lua_env );
    }
    array_free( spob_stack );
+   nidx_free( &spob_nameidx );
 
    for ( int i = 0; i < array_size( spob_lua_stack ); i++ )
       spob_lua_free( &spob_lua_stack[i] );
@@ -3966,6 +4072,7 @@ void space_exit( void )
    }
    array_free( systems_stack );
    systems_stack = NULL;
+   nidx_free( &system_nameidx );
 
    /* Free asteroids stuff. */
    asteroids_free();
@@ -4000,6 +4107,7 @@ void space_clearKnown( void )
    }
    for ( int j = 0; j < array_size( spob_stack ); j++ )
       spob_rmFlag( &spob_stack[j], SPOB_KNOWN );
+   map_jumpDistInvalidate();
 }
 
 /**
@@ -4326,6 +4434,9 @@ int space_playerLoad( xmlNodePtr parent, const char *version )
       } while ( xml_nextNode( cur ) );
    } while ( xml_nextNode( node ) );
 
+   /* Known systems and jumps changed. */
+   map_jumpDistInvalidate();
+
    /* Update global standing. */
    faction_updateGlobal();
 
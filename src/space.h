@@ -20,6 +20,9 @@
 #define SYSTEM_SIMULATE_TIME_POST                                              \
    5. /**< Time to simulate the system before the player is added, however,    \
          effects are added. */
+#define SYSTEM_SIMULATE_DT_PRE                                                 \
+   0.25 /**< Time step of the fast warm-up simulation before effects are       \
+           enabled. */
 #define MAX_HYPERSPACE_VEL 25. /**< Speed to brake to before jumping. */
 
 /*
@@ -485,12 +488,14 @@ void   system_rmCurrentPresence( StarSystem *sys, int faction, double amount );
  */
 void space_update( double dt, double real_dt );
 int  space_isSimulation( void );
+int  space_isWarmup( void );
 int  space_needsEffects( void );
 
 /*
  * Graphics.
  */
 void space_gfxLoad( StarSystem *sys );
+void space_gfxPrefetch( const StarSystem *sys );
 void space_gfxUnload( StarSystem *sys );
 
 /*
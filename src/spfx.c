@@ -946,7 +946,7 @@ void spfx_trail_draw( const Trail_spfx *trail )
       glUniform2f( spec->shader.pos1, len, spp->thick );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    }
 
    /* Clear state. */
@@ -1137,7 +1137,7 @@ static void spfx_renderStack( SPFX *spfx_stack )
          glUniform1f( effect->u_size, effect->size );
 
          /* Draw. */
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clear state. */
          glDisableVertexAttribArray( shaders.texture.vertex );
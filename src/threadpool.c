@@ -2,33 +2,43 @@
  * See Licensing and Copyright notice in threadpool.h
  */
 /*
- * @brief A simple threadpool implementation using a single queue.
+ * @brief A work-stealing job system.
  *
- * The queue is inspired by this paper (look for the queue with two locks):
+ * Every worker thread (and the thread that initialized the threadpool) owns a
+ * deque of jobs. The owner pushes and pops jobs at the bottom, while idle
+ * threads steal jobs from the top of other deques. The deque is inspired by
+ * this paper:
  *
- * Maged M. Michael and Michael L. Scott. 1998. Nonblocking algorithms and
- * preemption-safe locking on multiprogrammed shared memory multiprocessors. J.
- * Parallel Distrib. Comput. 51, 1 (May 1998), 1-26. DOI=10.1006/jpdc.1998.1446
- * http://dx.doi.org/10.1006/jpdc.1998.1446
+ * David Chase and Yossi Lev. 2005. Dynamic circular work-stealing deque. In
+ * Proceedings of the seventeenth annual ACM symposium on Parallelism in
+ * algorithms and architectures (SPAA '05), 21-28.
+ * DOI=10.1145/1073970.1073974 http://dx.doi.org/10.1145/1073970.1073974
  *
- * @ARTICLE{Michael98non-blockingalgorithms,
- *    author = {Maged M. Michael and Michael L. Scott},
- *    title = {Non-Blocking Algorithms and Preemption-Safe Locking on
- * Multiprogrammed Shared Memory Multiprocessors}, journal = {Journal of
- * Parallel and Distributed Computing}, year = {1998}, volume = {51}, pages =
- * {1--26},
- * }
+ * Jobs can be created from inside other jobs and threads waiting for a job
+ * run other jobs in the meantime, so waiting from a job does not deadlock.
+ * Threads that are not part of the pool share a single deque protected by a
+ * mutex.
  *
- * @note The algorithm/strategy for killing idle workers should be moved into
- *       the threadhandler and it should also be improved (the current strategy
- *       is probably not very good).
+ * Jobs are allocated from a per-thread ring buffer. Children are recycled once
+ * finished, while jobs without a parent are only recycled once they have been
+ * waited on, so that the slot can not be reused by another job while someone
+ * still holds the handle.
+ *
+ * The old vpool interface is kept as a thin wrapper on top of the jobs.
  */
 
 /** @cond */
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "SDL_atomic.h"
 #include "SDL_cpuinfo.h"
+#include "SDL_mutex.h"
 #include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include "naev.h"
 /** @endcond */
 
 #include "threadpool.h"
@@ -36,44 +46,50 @@
 #include "array.h"
 #include "log.h"
 
-#define THREADPOOL_TIMEOUT                                                     \
-   ( 5 * 100 )               /* The time a worker thread waits in ms. */
-#define THREADSIG_STOP ( 1 ) /* The signal to stop a worker thread */
-#define THREADSIG_RUN                                                          \
-   ( 0 ) /* The signal to indicate the worker thread is running */
+#define JOB_DEQUE_SIZE 4096 /**< Size of the deques, must be a power of 2. */
+#define JOB_POOL_SIZE                                                          \
+   4096 /**< Jobs allocated per thread, must be a power of 2. */
+#define JOB_MAX_CONTINUATIONS 16 /**< Maximum jobs depending on a job. */
+#define JOB_MAX_WORKERS 8        /**< Maximum number of worker threads. */
+#define JOB_WAIT_SPINS                                                         \
+   64 /**< Times a waiting thread yields before sleeping between checks. */
 
 /**
- * Threads to use.
+ * @brief A job to run on the threadpool.
  */
-static int MAXTHREADS = 8; /* Bit overkill, but oh well. */
+struct Job_ {
+   JobFunction      function; /**< Function to run. */
+   JobRangeFunction range;    /**< Function to run for parallel fors. */
+   void            *data;     /**< Data to pass to the function. */
+   Job             *parent;   /**< Parent that waits on this job. */
+   int              start;    /**< Start of the range for parallel fors. */
+   int              end;      /**< End of the range for parallel fors. */
+   int              grain;    /**< Smallest range to split for parallel fors. */
+   SDL_atomic_t     unfinished; /**< The job itself plus unfinished children. */
+   SDL_atomic_t pending; /**< Unfinished dependencies, plus one until run. */
+   SDL_atomic_t busy; /**< References to the job, recycled when 0. */
+   int          ncontinuations; /**< Number of jobs depending on this one. */
+   Job *continuations[JOB_MAX_CONTINUATIONS]; /**< Jobs depending on this. */
+};
 
 /**
- * @brief Node in the thread queue.
+ * @brief Per-thread data of the job system.
  */
-typedef struct Node_ {
-   void         *data; /**< The element in the list */
-   struct Node_ *next; /**< The next node in the list */
-} Node;
-
-struct vpoolThreadData_;
+typedef struct JobWorker_ {
+   SDL_atomic_t top;    /**< Where other threads steal from. */
+   SDL_atomic_t bottom; /**< Where the owner pushes and pops. */
+   Job         *deque[JOB_DEQUE_SIZE]; /**< Circular buffer of jobs. */
+   Job         *pool;    /**< Jobs allocated by the thread. */
+   unsigned int poolidx; /**< Next job to try to allocate. */
+   unsigned int victim;  /**< Next worker to try to steal from. */
+   SDL_Thread  *thread;  /**< Thread of the worker, NULL for the main one. */
+} JobWorker;
 
 /**
- * @brief Threadqueue itself.
+ * @brief Threadqueue itself, now only a list of jobs to run.
  */
 struct ThreadQueue_ {
-   Node *first;   /**< The first node */
-   Node *last;    /**< The second node */
-   Node *reserve; /**< Reserve buffer. */
-   /* A semaphore to ensure reads only happen when the queue is not empty */
-   SDL_sem   *semaphore;
-   SDL_mutex *t_lock; /**< Tail lock. Lock when reading/updating tail */
-   SDL_mutex *h_lock; /**< Same as tail lock, except it's head lock */
-   SDL_mutex *r_lock; /**< For reserve buffer. */
-   /* For vpools. */
-   SDL_cond                *cond;
-   SDL_mutex               *mutex;
-   struct vpoolThreadData_ *arg;
-   int                      cnt;
+   struct ThreadQueueData_ *jobs; /**< Queued jobs (array.h). */
 };
 
 /**
@@ -84,500 +100,604 @@ typedef struct ThreadQueueData_ {
    void *data;                  /* And its arguments */
 } ThreadQueueData;
 
-/**
- * @brief Thread data.
- */
-typedef struct ThreadData_ {
-   int ( *function )( void * ); /* The function to be called */
-   void    *data;               /* Arguments to the above function */
-   int      signal;             /* Signals to the thread */
-   SDL_sem *semaphore; /* The semaphore to signal new jobs or new signal in the
-                          'signal' variable */
-   ThreadQueue *idle;  /* The queue with idle threads */
-   ThreadQueue *stopped; /* The queue with stopped threads */
-} ThreadData;
-
-/**
- * @brief Virtual thread pool data.
- */
-struct vpoolThreadData_ {
-   SDL_cond *cond; /**< Condition variable for signalling all jobs in the vpool
-                      are done */
-   SDL_mutex *mutex; /**< The mutex to use with the above condition variable */
-   int *count; /**< Variable to count number of finished jobs in the vpool */
-   ThreadQueueData node;    /**< The job to be done */
-   ThreadQueueData wrapper; /**< Wrapper to avoid malloc. */
-};
-typedef struct vpoolThreadData_ vpoolThreadData;
-
-/* The global threadpool queue */
-static ThreadQueue *global_queue = NULL;
+static JobWorker *job_workers  = NULL; /**< Threads in the job system. */
+static int        job_nworkers = 0;    /**< Number of threads in job_workers. */
+static JobWorker  job_shared;          /**< Used by threads not in the pool. */
+static SDL_mutex *job_sharedLock = NULL; /**< Lock for job_shared. */
+static SDL_sem   *job_sem        = NULL; /**< To wake up idle workers. */
+static SDL_atomic_t job_sleeping;        /**< Number of sleeping workers. */
+static SDL_atomic_t job_quit;            /**< Tells the workers to stop. */
+static SDL_TLSID    job_tls = 0; /**< Index of the worker of the thread. */
 
 /*
  * Prototypes.
  */
-static ThreadQueue *tq_create( void );
-static void         tq_enqueue( ThreadQueue *q, void *data );
-static void        *tq_dequeue( ThreadQueue *q );
-static void         tq_destroy( ThreadQueue *q );
-static int          threadpool_worker( void *data );
-static int          threadpool_handler( void *data );
-static int          vpool_worker( void *data );
+static JobWorker *job_worker( void );
+static int        job_dist( int a, int b );
+static int        job_push( JobWorker *wk, Job *job );
+static Job       *job_pop( JobWorker *wk );
+static Job       *job_steal( JobWorker *wk );
+static Job       *job_get( JobWorker *wk );
+static Job       *job_alloc( void );
+static void       job_submit( Job *job );
+static void       job_release( Job *job );
+static void       job_execute( Job *job );
+static void       job_executeRange( Job *job );
+static void       job_finish( Job *job );
+static int        job_workerThread( void *data );
+static void       vpool_worker( Job *job, void *data );
 
 /**
- * @brief Creates a concurrent queue.
- *
- * The basic concept is that we have a separate lock for both head and tail, so
- *  we can operate separately on either head or tail. This lets us enqueue at
- *  tail and dequeue at the head in true FIFO fashion.
+ * @brief Gets the worker of the current thread.
  *
- *    @return The ThreadQueue.
+ *    @return The worker or NULL if the thread is not part of the pool.
+ */
+static JobWorker *job_worker( void )
+{
+   intptr_t idx = (intptr_t)SDL_TLSGet( job_tls );
+   if ( idx <= 0 )
+      return NULL;
+   return &job_workers[idx - 1];
+}
+
+/**
+ * @brief Gets the distance between two deque positions, handles overflow.
  */
-static ThreadQueue *tq_create( void )
+static int job_dist( int a, int b )
 {
-   ThreadQueue *q;
-   Node        *n;
+   return (int)( (unsigned int)b - (unsigned int)a );
+}
 
-   /* Queue memory allocation. */
-   q = calloc( 1, sizeof( ThreadQueue ) );
+/**
+ * @brief Pushes a job at the bottom of a deque, only called by the owner.
+ *
+ *    @return 0 on success, -1 if the deque is full.
+ */
+static int job_push( JobWorker *wk, Job *job )
+{
+   int b = SDL_AtomicGet( &wk->bottom );
+   int t = SDL_AtomicGet( &wk->top );
+   if ( job_dist( t, b ) >= JOB_DEQUE_SIZE )
+      return -1;
+   wk->deque[(unsigned int)b & ( JOB_DEQUE_SIZE - 1 )] = job;
+   SDL_MemoryBarrierRelease();
+   SDL_AtomicSet( &wk->bottom, (int)( (unsigned int)b + 1 ) );
+   return 0;
+}
 
-   /* Allocate and insert the dummy node */
-   n        = calloc( 1, sizeof( Node ) );
-   n->next  = NULL;
-   q->first = n;
-   q->last  = n;
+/**
+ * @brief Pops a job from the bottom of a deque, only called by the owner.
+ */
+static Job *job_pop( JobWorker *wk )
+{
+   Job *job;
+   int  b = (int)( (unsigned int)SDL_AtomicGet( &wk->bottom ) - 1 );
+   int  t;
+   SDL_AtomicSet( &wk->bottom, b );
+   /* The store to bottom has to be seen before top is loaded, or a thief
+    * can take the last job at the same time. SDL_AtomicSet only has acquire
+    * semantics on some platforms, so an explicit full fence is needed. */
+   __atomic_thread_fence( __ATOMIC_SEQ_CST );
+   t = SDL_AtomicGet( &wk->top );
+
+   /* Empty. */
+   if ( job_dist( t, b ) < 0 ) {
+      SDL_AtomicSet( &wk->bottom, t );
+      return NULL;
+   }
 
-   /* Create locks. */
-   q->t_lock    = SDL_CreateMutex();
-   q->h_lock    = SDL_CreateMutex();
-   q->r_lock    = SDL_CreateMutex();
-   q->semaphore = SDL_CreateSemaphore( 0 );
+   job = wk->deque[(unsigned int)b & ( JOB_DEQUE_SIZE - 1 )];
+   if ( job_dist( t, b ) > 0 )
+      return job;
 
-   return q;
+   /* Last job, race against thieves. */
+   if ( !SDL_AtomicCAS( &wk->top, t, (int)( (unsigned int)t + 1 ) ) )
+      job = NULL;
+   SDL_AtomicSet( &wk->bottom, (int)( (unsigned int)t + 1 ) );
+   return job;
 }
 
 /**
- * @brief Enqueue data to the ThreadQueue q.
- *
- *    @param q The queue to be inserted into.
- *    @param data The element to be stored in the queue.
+ * @brief Steals a job from the top of a deque, can be called by any thread.
  */
-static void tq_enqueue( ThreadQueue *q, void *data )
+static Job *job_steal( JobWorker *wk )
 {
-   Node *n;
-
-   /* Try to grab reserved struct if possible. */
-   SDL_mutexP( q->r_lock );
-   if ( q->reserve != NULL ) {
-      n          = q->reserve;
-      q->reserve = n->next;
-   } else
-      n = malloc( sizeof( Node ) );
-   n->data = data;
-   n->next = NULL;
-   SDL_mutexV( q->r_lock );
-
-   /* Lock */
-   SDL_mutexP( q->t_lock );
-
-   /* Enqueue. */
-   q->last->next = n;
-   q->last       = n;
-
-   /* Signal and unlock. This wil break if someone tries to enqueue 2^32+1
-    * elements or something. */
-   SDL_SemPost( q->semaphore );
-   SDL_mutexV( q->t_lock );
+   Job *job;
+   int  t, b;
+   t = SDL_AtomicGet( &wk->top );
+   /* Pairs with the fence in job_pop, top has to be loaded before bottom. */
+   __atomic_thread_fence( __ATOMIC_SEQ_CST );
+   b = SDL_AtomicGet( &wk->bottom );
+   if ( job_dist( t, b ) <= 0 )
+      return NULL;
+   job = wk->deque[(unsigned int)t & ( JOB_DEQUE_SIZE - 1 )];
+   if ( !SDL_AtomicCAS( &wk->top, t, (int)( (unsigned int)t + 1 ) ) )
+      return NULL; /* Lost the race. */
+   return job;
 }
 
 /**
- * @brief Dequeue from the ThreadQueue q.
+ * @brief Gets a job to run, first from the thread's own deque, then from the
+ * other deques.
  *
- * @attention The callee should ALWAYS have called SDL_SemWait() on the
- * semaphore.
- *
- *    @param q The queue to dequeue from.
- *    @return A void pointer to the element from the queue.
+ *    @param wk Worker of the thread or NULL if not part of the pool.
+ *    @return Job to run or NULL if there is nothing to do.
  */
-static void *tq_dequeue( ThreadQueue *q )
+static Job *job_get( JobWorker *wk )
 {
-   void *d;
-   Node *newhead, *node;
-
-   /* Lock the head. */
-   SDL_mutexP( q->h_lock );
-
-   /* Start running. */
-   node    = q->first;
-   newhead = node->next;
-
-   /* Head not consistent. */
-   if ( newhead == NULL ) {
-      WARN( _( "Tried to dequeue while the queue was empty!" ) );
-      /* Ugly fix :/ */
-      /*
-      SDL_mutexV(q->h_lock);
-      return NULL;
-      */
-      /* We prefer to wait until the cache updates :/ */
-      do {
-         node    = q->first;
-         newhead = node->next;
-      } while ( newhead == NULL );
+   Job         *job;
+   unsigned int victim;
+
+   if ( wk != NULL ) {
+      job = job_pop( wk );
+      if ( job != NULL )
+         return job;
    }
 
-   /* Remember the value and assign newhead as the new dummy element. */
-   d        = newhead->data;
-   q->first = newhead;
+   /* Jobs pushed by threads outside of the pool. */
+   job = job_steal( &job_shared );
+   if ( job != NULL )
+      return job;
+
+   /* Try to steal from the rest. */
+   victim = ( wk != NULL ) ? wk->victim++ : 0;
+   for ( int i = 0; i < job_nworkers; i++ ) {
+      JobWorker *other = &job_workers[( victim + i ) % job_nworkers];
+      if ( other == wk )
+         continue;
+      job = job_steal( other );
+      if ( job != NULL )
+         return job;
+   }
+   return NULL;
+}
+
+/**
+ * @brief Allocates a job from the thread's pool.
+ */
+static Job *job_alloc( void )
+{
+   JobWorker *wk = job_worker();
+   int        shared;
+   Job       *job;
+
+   shared = ( wk == NULL );
+   if ( shared ) {
+      SDL_mutexP( job_sharedLock );
+      wk = &job_shared;
+   }
 
-   /* Unlock */
-   SDL_mutexV( q->h_lock );
+   for ( int i = 0;; i++ ) {
+      job = &wk->pool[wk->poolidx++ & ( JOB_POOL_SIZE - 1 )];
+      if ( SDL_AtomicGet( &job->busy ) == 0 )
+         break;
 
-   /* Save memory in reserve. */
-   SDL_mutexP( q->r_lock );
-   node->next = q->reserve;
-   q->reserve = node;
-   SDL_mutexV( q->r_lock );
+      /* Pool exhausted, help out until jobs are recycled. */
+      if ( i >= JOB_POOL_SIZE ) {
+         Job *other;
+         if ( shared )
+            SDL_mutexV( job_sharedLock );
+         other = job_get( shared ? NULL : wk );
+         if ( other != NULL )
+            job_execute( other );
+         else
+            SDL_Delay( 0 );
+         if ( shared )
+            SDL_mutexP( job_sharedLock );
+         i = 0;
+      }
+   }
 
-   return d;
+   job->function       = NULL;
+   job->range          = NULL;
+   job->data           = NULL;
+   job->parent         = NULL;
+   job->start          = 0;
+   job->end            = 0;
+   job->grain          = 1;
+   job->ncontinuations = 0;
+   SDL_AtomicSet( &job->unfinished, 1 );
+   SDL_AtomicSet( &job->pending, 1 );
+   SDL_AtomicSet( &job->busy, 1 );
+
+   if ( shared )
+      SDL_mutexV( job_sharedLock );
+   return job;
 }
 
 /**
- * @brief Destroys and frees a ThreadQueue.
- *
- * Frees all elements too.
- *
- *    @param q The ThreadQueue to free.
+ * @brief Makes a job available to the workers.
  */
-static void tq_destroy( ThreadQueue *q )
+static void job_submit( Job *job )
 {
-   /* Iterate through the list and free the nodes */
-   while ( q->first != NULL ) {
-      Node *n  = q->first;
-      q->first = n->next;
-      free( n );
+   JobWorker *wk = job_worker();
+   int        ret;
+
+   if ( wk != NULL )
+      ret = job_push( wk, job );
+   else {
+      SDL_mutexP( job_sharedLock );
+      ret = job_push( &job_shared, job );
+      SDL_mutexV( job_sharedLock );
+   }
+
+   /* Deque is full, just run it here. */
+   if ( ret ) {
+      job_execute( job );
+      return;
    }
 
-   /* Free reserve. */
-   while ( q->reserve != NULL ) {
-      Node *n    = q->reserve;
-      q->reserve = n->next;
-      free( n );
+   if ( SDL_AtomicGet( &job_sleeping ) > 0 )
+      SDL_SemPost( job_sem );
+}
+
+/**
+ * @brief Removes a pending dependency of a job, submitting it when there are
+ * none left.
+ */
+static void job_release( Job *job )
+{
+   if ( SDL_AtomicAdd( &job->pending, -1 ) == 1 )
+      job_submit( job );
+}
+
+/**
+ * @brief Runs a job.
+ */
+static void job_execute( Job *job )
+{
+   if ( job->range != NULL )
+      job_executeRange( job );
+   else if ( job->function != NULL )
+      job->function( job, job->data );
+   job_finish( job );
+}
+
+/**
+ * @brief Runs a parallel for job, splitting off halves of the range as
+ * children until it is below the grain size.
+ */
+static void job_executeRange( Job *job )
+{
+   int start = job->start;
+   int end   = job->end;
+
+   while ( end - start > job->grain ) {
+      int  mid   = start + ( end - start ) / 2;
+      Job *child = job_create( NULL, job->data, job );
+      child->range = job->range;
+      child->grain = job->grain;
+      child->start = mid;
+      child->end   = end;
+      job_run( child );
+      end = mid;
    }
+   job->range( job->data, start, end );
+}
+
+/**
+ * @brief Marks part of a job as finished, handling continuations and the
+ * parent when it is completely done.
+ */
+static void job_finish( Job *job )
+{
+   Job *parent;
+
+   if ( SDL_AtomicAdd( &job->unfinished, -1 ) != 1 )
+      return;
 
-   /* Clean up threading structures. */
-   SDL_DestroySemaphore( q->semaphore );
-   SDL_DestroyMutex( q->h_lock );
-   SDL_DestroyMutex( q->t_lock );
-   SDL_DestroyMutex( q->r_lock );
-
-   /* Clean up vpool structures. */
-   if ( q->mutex != NULL )
-      SDL_DestroyMutex( q->mutex );
-   if ( q->cond != NULL )
-      SDL_DestroyCond( q->cond );
-   array_free( q->arg );
-
-   free( q->first );
-   free( q );
+   /* Can only be recycled after this, so we have to be careful. */
+   parent = job->parent;
+   for ( int i = 0; i < job->ncontinuations; i++ )
+      job_release( job->continuations[i] );
+   SDL_AtomicAdd( &job->busy, -1 );
+
+   if ( parent != NULL )
+      job_finish( parent );
 }
 
 /**
  * @brief The worker function for the threadpool.
  *
- * It waits for a signal from the handler. If it receives THREADSIG_STOP it
- *  means the worker thread should stop. Else it dequeues a job from the
- *  global_queue and executes it.
+ * It runs jobs while there are any, and sleeps until a job is submitted
+ * otherwise. Stops once there is nothing left to do after threadpool_exit.
  *
- *    @param data A pointer to the ThreadData struct used for a lot of stuff.
+ *    @param data A pointer to the JobWorker of the thread.
  */
-static int threadpool_worker( void *data )
+static int job_workerThread( void *data )
 {
-   ThreadData *work = (ThreadData *)data;
+   JobWorker *wk = (JobWorker *)data;
+   SDL_TLSSet( job_tls, (void *)(intptr_t)( wk - job_workers + 1 ), NULL );
 
    /* Work loop */
    while ( 1 ) {
-      /* Wait for new signal */
-      while ( SDL_SemWait( work->semaphore ) == -1 ) {
-         /* Putting this in a while-loop is probably a really bad idea, but I
-          * don't have any better ideas. */
-         WARN( _( "SDL_SemWait failed! Error: %s" ), SDL_GetError() );
+      Job *job = job_get( wk );
+      if ( job == NULL ) {
+         if ( SDL_AtomicGet( &job_quit ) )
+            break;
+         SDL_AtomicAdd( &job_sleeping, 1 );
+         /* Check again in case a job was submitted while we weren't marked as
+          * sleeping. */
+         job = job_get( wk );
+         if ( ( job == NULL ) && !SDL_AtomicGet( &job_quit ) )
+            SDL_SemWait( job_sem );
+         SDL_AtomicAdd( &job_sleeping, -1 );
       }
-      /* Break if received signal to stop */
-      if ( work->signal == THREADSIG_STOP )
-         break;
+      if ( job != NULL )
+         job_execute( job );
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Initialize the global threadpool.
+ *
+ * The calling thread becomes part of the pool and runs jobs while waiting.
+ *
+ *    @return Returns 0 on success and -1 if there's already a threadpool.
+ */
+int threadpool_init( void )
+{
+   int nthreads;
 
-      /* Do work :-) */
-      work->function( work->data );
+   /* There's already a threadpool */
+   if ( job_workers != NULL ) {
+      WARN( _( "Threadpool has already been initialized!" ) );
+      return -1;
+   }
 
-      /* Enqueue itself in the idle worker threads queue */
-      tq_enqueue( work->idle, work );
+   /* The initializing thread also runs jobs when waiting. */
+   nthreads     = CLAMP( 1, JOB_MAX_WORKERS, SDL_GetCPUCount() - 1 );
+   job_nworkers = nthreads + 1;
+   job_workers  = calloc( job_nworkers, sizeof( JobWorker ) );
+   for ( int i = 0; i < job_nworkers; i++ )
+      job_workers[i].pool = calloc( JOB_POOL_SIZE, sizeof( Job ) );
+   job_shared.pool = calloc( JOB_POOL_SIZE, sizeof( Job ) );
+   job_sharedLock  = SDL_CreateMutex();
+   job_sem         = SDL_CreateSemaphore( 0 );
+   job_tls         = SDL_TLSCreate();
+   SDL_AtomicSet( &job_sleeping, 0 );
+   SDL_AtomicSet( &job_quit, 0 );
+   SDL_TLSSet( job_tls, (void *)(intptr_t)1, NULL );
+
+   /* Start the workers. */
+   for ( int i = 1; i < job_nworkers; i++ ) {
+      job_workers[i].thread =
+         SDL_CreateThread( job_workerThread, "job_worker", &job_workers[i] );
+      if ( job_workers[i].thread == NULL ) {
+         ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
+         return -1;
+      }
    }
-   /* Enqueue itself in the stopped worker threads queue when stopped */
-   tq_enqueue( work->stopped, work );
 
    return 0;
 }
 
 /**
- * @brief Handles assigning jobs to the workers and killing them if necessary.
+ * @brief Gets the number of threads running jobs.
  *
- * @note Stopping the threeadpool_handler is not yet implemented.
+ *    @return Number of threads including the main one, 0 if not initialized.
+ */
+int threadpool_threads( void )
+{
+   return job_nworkers;
+}
+
+/**
+ * @brief Stops the worker threads and frees the threadpool.
  *
- * Process is:
+ * All the jobs have to be waited on before calling this.
+ */
+void threadpool_exit( void )
+{
+   if ( job_workers == NULL )
+      return;
+
+   /* Wake up everyone so they notice they have to stop. */
+   SDL_AtomicSet( &job_quit, 1 );
+   for ( int i = 1; i < job_nworkers; i++ )
+      SDL_SemPost( job_sem );
+   for ( int i = 1; i < job_nworkers; i++ )
+      SDL_WaitThread( job_workers[i].thread, NULL );
+
+   for ( int i = 0; i < job_nworkers; i++ )
+      free( job_workers[i].pool );
+   free( job_workers );
+   job_workers  = NULL;
+   job_nworkers = 0;
+   free( job_shared.pool );
+   memset( &job_shared, 0, sizeof( JobWorker ) );
+   SDL_DestroyMutex( job_sharedLock );
+   job_sharedLock = NULL;
+   SDL_DestroySemaphore( job_sem );
+   job_sem = NULL;
+   SDL_TLSSet( job_tls, NULL, NULL );
+}
+
+/**
+ * @brief Creates a new job.
  *
- * 1) Wait for job
- * 2) if Timed out -> kill idle, putting on stopped, go to 1)
- * 3) Have thread run job
- * 3.1) Grab a job from the queue
- * 3.2) If idle thread, grab idle thread
- *      else if stopped threads, reactivate stopped thread
- *      else wait for running thread
- * 4) Go to 1)
+ * The job does nothing until job_run is called. If a parent is given, it will
+ * not be finished until the new job is finished, which is useful to create
+ * jobs from inside other jobs.
  *
- *    @param data Not used. SDL threading requires functions to take a void
- *                pointer as argument.
- *    @return Not really implemented yet.
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
+ *    @param parent Job that has to wait for this job or NULL.
+ *    @return The newly created job.
  */
-static int threadpool_handler( void *data )
+Job *job_create( JobFunction function, void *data, Job *parent )
 {
-   (void)data;
-   int         nrunning, newthread;
-   ThreadData *threadargs, *threadarg;
-   /* Queues for idle workers and stopped workers */
-   ThreadQueue     *idle, *stopped;
-   ThreadQueueData *node;
-
-   /* Initialize the idle and stopped queues. */
-   idle    = tq_create();
-   stopped = tq_create();
-
-   /* Allocate threadargs to communicate with workers */
-   threadargs = calloc( MAXTHREADS, sizeof( ThreadData ) );
-
-   /* Initialize threadargs */
-   for ( int i = 0; i < MAXTHREADS; i++ ) {
-      threadargs[i].function = NULL;
-      threadargs[i].data     = NULL;
-      threadargs[i].semaphore =
-         SDL_CreateSemaphore( 0 ); /* Used to give orders. */
-      threadargs[i].idle    = idle;
-      threadargs[i].stopped = stopped;
-      threadargs[i].signal  = THREADSIG_RUN;
-      /* 'Workers' that do not have a thread are considered stopped */
-      tq_enqueue( stopped, &threadargs[i] );
-   }
+   Job *job      = job_alloc();
+   job->function = function;
+   job->data     = data;
+   job->parent   = parent;
+   if ( parent != NULL )
+      SDL_AtomicAdd( &parent->unfinished, 1 );
+   else
+      SDL_AtomicAdd( &job->busy, 1 ); /* Held by the owner until job_wait. */
+   return job;
+}
 
-   /* Set the number of running threads to 0 */
-   nrunning = 0;
+/**
+ * @brief Creates a job that runs a function over a range of indices in
+ * parallel.
+ *
+ *    @param n Number of indices to process, starting at 0.
+ *    @param grain Smallest number of indices to process in a single call.
+ *    @param function Function to run over the [start,end) ranges.
+ *    @param data Data to pass to the function.
+ *    @param parent Job that has to wait for this job or NULL.
+ *    @return The newly created job.
+ */
+Job *job_createFor( int n, int grain, JobRangeFunction function, void *data,
+                    Job *parent )
+{
+   Job *job   = job_create( NULL, data, parent );
+   job->range = function;
+   job->end   = MAX( n, 0 );
+   job->grain = MAX( grain, 1 );
+   return job;
+}
 
-   /*
-    * Thread handler main loop.
-    */
-   while ( 1 ) {
-      /*
-       * We must now wait, this shall be done on each active thread. However
-       * they will be put to sleep as time passes. When we receive a command
-       * we'll proceed to process it.
-       */
-      if ( nrunning > 0 ) {
-         /*
-          * Here we'll wait until thread gets work to do. If it doesn't it will
-          * just stop a worker thread and wait until it gets something to do.
-          */
-         if ( SDL_SemWaitTimeout( global_queue->semaphore,
-                                  THREADPOOL_TIMEOUT ) != 0 ) {
-            /* There weren't any new jobs so we'll start killing threads ;) */
-            if ( SDL_SemTryWait( idle->semaphore ) == 0 ) {
-               threadarg = tq_dequeue( idle );
-               /* Set signal to stop worker thread */
-               threadarg->signal = THREADSIG_STOP;
-               /* Signal thread and decrement running threads counter */
-               SDL_SemPost( threadarg->semaphore );
-               nrunning -= 1;
-            }
-
-            /* We just go back to waiting on a thread. */
-            continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      } else {
-         /*
-          * Here we wait for a new job. No threads are alive at this point and
-          * the threadpool is just patiently waiting for work to arrive.
-          */
-         if ( SDL_SemWait( global_queue->semaphore ) == -1 ) {
-            WARN( _( "SDL_SemWait failed! Error: %s" ), SDL_GetError() );
-            continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
+/**
+ * @brief Makes a job wait for another job to finish before running.
+ *
+ * @warning Has to be called before either job is run.
+ *
+ *    @param job Job that has to wait.
+ *    @param dependency Job to wait for.
+ */
+void job_depend( Job *job, Job *dependency )
+{
+   if ( dependency->ncontinuations >= JOB_MAX_CONTINUATIONS ) {
+      WARN( _( "Job has too many dependent jobs!" ) );
+      return;
+   }
+   SDL_AtomicAdd( &job->pending, 1 );
+   dependency->continuations[dependency->ncontinuations++] = job;
+}
 
-      /*
-       * Get a new job from the queue. This should be safe as we have received
-       * a permission from the global_queue->semaphore.
-       */
-      node      = tq_dequeue( global_queue );
-      newthread = 0;
-
-      /*
-       * Choose where to get the thread. Either idle, revive stopped or block
-       * until another thread becomes idle.
-       */
-      /* Idle thread available */
-      if ( SDL_SemTryWait( idle->semaphore ) == 0 )
-         threadarg = tq_dequeue( idle );
-      /* Make a new thread */
-      else if ( SDL_SemTryWait( stopped->semaphore ) == 0 ) {
-         threadarg         = tq_dequeue( stopped );
-         threadarg->signal = THREADSIG_RUN;
-         newthread         = 1;
-      }
-      /* Wait for idle thread */
-      else {
-         while ( SDL_SemWait( idle->semaphore ) == -1 ) {
-            /* Bad idea */
-            WARN( _( "SDL_SemWait failed! Error: %s" ), SDL_GetError() );
-         }
-         threadarg = tq_dequeue( idle );
-      }
+/**
+ * @brief Runs a job, or lets it run once its dependencies are done.
+ */
+void job_run( Job *job )
+{
+   job_release( job );
+}
 
-      /* Assign arguments for the thread */
-      threadarg->function = node->function;
-      threadarg->data     = node->data;
-      /* Signal the thread that there's a new job */
-      SDL_SemPost( threadarg->semaphore );
+/**
+ * @brief Checks to see if a job and its children are finished.
+ */
+int job_finished( const Job *job )
+{
+   return ( SDL_AtomicGet( (SDL_atomic_t *)&job->unfinished ) <= 0 );
+}
 
-      /* Start a new thread and increment the thread counter */
-      if ( newthread ) {
-         SDL_CreateThread( threadpool_worker, "threadpool_worker", threadarg );
-         nrunning += 1;
+/**
+ * @brief Blocks until a job and its children are finished, running other jobs
+ * in the meantime.
+ *
+ * Releases the handle of the job, which may be recycled afterwards.
+ *
+ *    @param job Job without a parent to wait for.
+ */
+void job_wait( Job *job )
+{
+   JobWorker *wk   = job_worker();
+   int        idle = 0;
+   while ( !job_finished( job ) ) {
+      Job *other = job_get( wk );
+      if ( other != NULL ) {
+         job_execute( other );
+         idle = 0;
       }
+      /* Nothing to steal, so it is only waiting on jobs already running. Back
+       * off to stop hogging the CPU from them. */
+      else if ( idle++ < JOB_WAIT_SPINS )
+         SDL_Delay( 0 );
+      else
+         SDL_Delay( 1 );
    }
-   /** @TODO A way to stop the threadpool. */
-
-   /* Clean up. */
-   tq_destroy( idle );
-   tq_destroy( stopped );
-   free( threadargs );
-
-   return 0;
+   SDL_AtomicAdd( &job->busy, -1 );
 }
 
 /**
- * @brief Initialize the global threadpool.
+ * @brief Runs a function over a range of indices in parallel and waits for it
+ * to finish.
  *
- *    @return Returns 0 on success and -1 if there's already a threadpool.
+ *    @param n Number of indices to process, starting at 0.
+ *    @param grain Smallest number of indices to process in a single call.
+ *    @param function Function to run over the [start,end) ranges.
+ *    @param data Data to pass to the function.
  */
-int threadpool_init( void )
+void job_parallelFor( int n, int grain, JobRangeFunction function, void *data )
 {
-   MAXTHREADS = SDL_GetCPUCount() + 1; /* SDL 1.3 is pretty cool. */
-
-   /* There's already a queue */
-   if ( global_queue != NULL ) {
-      WARN( _( "Threadpool has already been initialized!" ) );
-      return -1;
-   }
+   Job *job;
 
-   /* Create the global queue queue */
-   global_queue = tq_create();
+   if ( n <= 0 )
+      return;
 
-   /* Initialize the threadpool handler. */
-   if ( SDL_CreateThread( threadpool_handler, "threadpool_handler", NULL ) ==
-        NULL ) {
-      ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
-      return -1;
+   /* Not worth splitting. */
+   if ( ( n <= grain ) || ( job_workers == NULL ) ) {
+      function( data, 0, n );
+      return;
    }
 
-   return 0;
+   job = job_createFor( n, grain, function, data, NULL );
+   job_run( job );
+   job_wait( job );
 }
 
 /**
  * @brief Creates a new vpool queue.
  *
  * This is just an interface to make running a number of jobs and then wait for
- *  them to finish more pleasant. You should not nest vpools as of now as there
- *  are only a limit number of worker threads and we can't have them wait for a
- *  thread to finish that doesn't exist.
- *
- * If you really want to sort of nest vpools, you should start a new thread
- *  instead of using the threadpool. I might add a vpool_waitInANewThread
- *  function some day.
+ *  them to finish more pleasant. Jobs of a vpool may create and wait on other
+ *  vpools.
  *
  *    @return Returns a ThreadQueue to be used.
  */
 ThreadQueue *vpool_create( void )
 {
-   ThreadQueue *tq = tq_create();
-   /* Create vpool-specific threading structures. */
-   tq->cond  = SDL_CreateCond();
-   tq->mutex = SDL_CreateMutex();
-   tq->arg   = array_create( vpoolThreadData );
+   ThreadQueue *tq = calloc( 1, sizeof( ThreadQueue ) );
+   tq->jobs        = array_create( ThreadQueueData );
    return tq;
 }
 
 /**
  * @brief Enqueue a job in the vpool queue.
- *
- * @warning Do NOT enqueue jobs that wait for another job to be done, as this
- *          could lead to a deadlock.
  */
 void vpool_enqueue( ThreadQueue *queue, int ( *function )( void * ),
                     void        *data )
 {
-   vpoolThreadData *arg = &array_grow( &queue->arg );
-   memset( arg, 0, sizeof( vpoolThreadData ) );
-   /* Common field.s */
-   arg->cond  = queue->cond;
-   arg->mutex = queue->mutex;
-   arg->count = &queue->cnt;
-   /* Task-specific stuff. */
-   arg->node.data     = data;
-   arg->node.function = function;
-   SDL_SemPost( queue->semaphore );
-   arg->wrapper.function = vpool_worker;
+   ThreadQueueData *qd = &array_grow( &queue->jobs );
+   qd->function        = function;
+   qd->data            = data;
 }
 
 /**
- * @brief A special vpool worker that signals the waiting thread when all jobs
- *        are done.
- *
- * It uses a mutex+condition variable+counter.
+ * @brief Runs a vpool job.
  */
-static int vpool_worker( void *data )
+static void vpool_worker( Job *job, void *data )
 {
-   int              cnt;
-   vpoolThreadData *work = (vpoolThreadData *)data;
-
-   /* Do work */
-   work->node.function( work->node.data );
-
-   /* Decrement the counter and signal vpool_wait if all threads are done */
-   SDL_mutexP( work->mutex );
-   cnt = *( work->count ) - 1;
-   if ( cnt <= 0 )                  /* All jobs done. */
-      SDL_CondSignal( work->cond ); /* Signal waiting thread */
-   *( work->count ) = cnt;
-   SDL_mutexV( work->mutex );
-
-   return 0;
+   (void)job;
+   ThreadQueueData *qd = (ThreadQueueData *)data;
+   qd->function( qd->data );
 }
 
 /* @brief Run every job in the vpool queue and block until every job in the
  *        queue is done.
  *
- * @note It destroys the queue when it's done.
+ * @note It empties the queue when it's done so it can be reused.
  */
 void vpool_wait( ThreadQueue *queue )
 {
-   /* Number of tasks we have. */
-   int cnt;
-   queue->cnt = array_size( queue->arg );
-   cnt        = queue->cnt;
+   Job *root;
+   int  cnt = array_size( queue->jobs );
 
-   if ( global_queue == NULL ) {
+   if ( job_workers == NULL ) {
       WARN( _( "Threadpool has not been initialized yet!" ) );
       return;
    }
@@ -586,29 +706,16 @@ void vpool_wait( ThreadQueue *queue )
    if ( cnt <= 0 )
       return;
 
-   /* Allocate all vpoolThreadData objects */
-   SDL_mutexP( queue->mutex );
-   /* Initialize the vpoolThreadData */
-   for ( int i = 0; i < cnt; i++ ) {
-      vpoolThreadData *arg;
-      /* This is needed to keep the invariants of the queue */
-      while ( SDL_SemWait( queue->semaphore ) == -1 ) {
-         /* Again, a really bad idea */
-         WARN( _( "SDL_SemWait failed! Error: %s" ), SDL_GetError() );
-      }
-      /* Launch new job. */
-      arg               = &queue->arg[i];
-      arg->wrapper.data = arg;
-      tq_enqueue( global_queue, &queue->arg[i].wrapper );
-   }
-
-   /* Wait for the threads to finish */
-   SDL_CondWait( queue->cond, queue->mutex );
-   SDL_mutexV( queue->mutex );
+   /* All the jobs are children of an empty job we can wait on. */
+   root = job_create( NULL, NULL, NULL );
+   for ( int i = 0; i < cnt; i++ )
+      job_run( job_create( vpool_worker, &queue->jobs[i], root ) );
+   job_run( root );
+   job_wait( root );
 
    /* Can toss away all the queue stuff. */
-   array_erase( &queue->arg, array_begin( queue->arg ),
-                array_end( queue->arg ) );
+   array_erase( &queue->jobs, array_begin( queue->jobs ),
+                array_end( queue->jobs ) );
 }
 
 /**
@@ -616,6 +723,6 @@ void vpool_wait( ThreadQueue *queue )
  */
 void vpool_cleanup( ThreadQueue *queue )
 {
-   /* Clean up */
-   tq_destroy( queue );
+   array_free( queue->jobs );
+   free( queue );
 }
@@ -17,20 +17,66 @@
 struct ThreadQueue_;
 typedef struct ThreadQueue_ ThreadQueue;
 
+struct Job_;
+typedef struct Job_ Job;
+
+/* Function run by a job. */
+typedef void ( *JobFunction )( Job *job, void *data );
+
+/* Function run by a parallel for over the [start,end) range. */
+typedef void ( *JobRangeFunction )( void *data, int start, int end );
+
 /* Initializes the threadpool */
 int threadpool_init( void );
 
-/* Creates a new vpool queue. Destroy with vpool_wait. */
+/* Stops the worker threads, all jobs have to be done. */
+void threadpool_exit( void );
+
+/* Gets the number of threads running jobs, including the main one. */
+int threadpool_threads( void );
+
+/* Logs the dispatch overhead of the threadpool, only in debug builds. */
+void threadpool_benchmark( int njobs );
+
+/* Creates a new job, which does nothing until run. Jobs may be created and
+ * waited on from other jobs. If a parent is given, the parent is not finished
+ * until the job is and the handle is recycled once finished. Jobs without a
+ * parent are only recycled once waited on, so they have to be waited on
+ * exactly once. */
+Job *job_create( JobFunction function, void *data, Job *parent );
+
+/* Creates a job that splits [0,n) into ranges of at least grain indices and
+ * runs them in parallel. */
+Job *job_createFor( int n, int grain, JobRangeFunction function, void *data,
+                    Job *parent );
+
+/* Makes a job only run once the dependency is finished. Has to be called
+ * before either job is run. */
+void job_depend( Job *job, Job *dependency );
+
+/* Runs a job once its dependencies are done. */
+void job_run( Job *job );
+
+/* Checks to see if a job and its children are finished. */
+int job_finished( const Job *job );
+
+/* Blocks until a job and its children are finished, running other jobs in the
+ * meantime. Releases the handle, so only jobs without a parent may be waited on
+ * and only once. */
+void job_wait( Job *job );
+
+/* Runs a parallel for and waits for it to finish. */
+void job_parallelFor( int n, int grain, JobRangeFunction function, void *data );
+
+/* Creates a new vpool queue. Destroy with vpool_cleanup. */
 ThreadQueue *vpool_create( void );
 
-/* Enqueue a job in the vpool queue. Do NOT enqueue a job that has to wait for
- * another job to be done as this could lead to a deadlock. Also do not enqueue
- * jobs from enqueued threads. */
+/* Enqueue a job in the vpool queue. */
 void vpool_enqueue( ThreadQueue *queue, int ( *function )( void * ),
                     void        *data );
 
 /* Run every job in the vpool queue and block until every job in the queue is
- * done. */
+ * done. The queue can be reused afterwards. */
 void vpool_wait( ThreadQueue *queue );
 
 /* Clean up. */
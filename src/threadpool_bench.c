@@ -0,0 +1,415 @@
+/*
+ * See Licensing and Copyright notice in threadpool.h
+ */
+/*
+ * @brief Benchmark of the threadpool dispatch overhead.
+ *
+ * Only built into debug builds, as it carries a copy of the old threadpool to
+ * compare against.
+ */
+#if DEBUGGING
+/** @cond */
+#include <stdlib.h>
+
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "threadpool.h"
+
+#include "log.h"
+
+/**
+ * @brief Data of the threadpool benchmark.
+ */
+typedef struct ThreadBenchmark_ {
+   SDL_atomic_t count; /**< Number of items processed. */
+} ThreadBenchmark;
+
+/**
+ * @brief Job in the old thread queue.
+ */
+typedef struct LegacyData_ {
+   int ( *function )( void * ); /**< The function to be called. */
+   void *data;                  /**< And its arguments. */
+} LegacyData;
+
+/*
+ * Copy of the old threadpool: a single queue with a head and a tail lock, a
+ * handler thread that hands the jobs to the workers one by one, and vpools that
+ * wait on a condition variable. Only kept as a baseline for
+ * threadpool_benchmark, without the killing of idle workers.
+ */
+/**
+ * @brief Node in the old thread queue.
+ */
+typedef struct LegacyNode_ {
+   void               *data; /**< The element in the list. */
+   struct LegacyNode_ *next; /**< The next node in the list. */
+} LegacyNode;
+
+/**
+ * @brief Old thread queue.
+ */
+typedef struct LegacyQueue_ {
+   LegacyNode *first;     /**< The first node, a dummy one. */
+   LegacyNode *last;      /**< The last node. */
+   LegacyNode *reserve;   /**< Reserve buffer. */
+   SDL_sem    *semaphore; /**< Counts the elements in the queue. */
+   SDL_mutex  *t_lock;    /**< Tail lock. */
+   SDL_mutex  *h_lock;    /**< Head lock. */
+   SDL_mutex  *r_lock;    /**< Reserve buffer lock. */
+} LegacyQueue;
+
+/**
+ * @brief Worker of the old threadpool.
+ */
+typedef struct LegacyWorker_ {
+   LegacyData   job;       /**< Job to run. */
+   int          stop;      /**< Whether the worker should stop. */
+   SDL_sem     *semaphore; /**< Signals a new job or to stop. */
+   SDL_Thread  *thread;    /**< Thread of the worker. */
+   LegacyQueue *idle;      /**< Queue of the idle workers. */
+} LegacyWorker;
+
+/**
+ * @brief Job of an old vpool.
+ */
+typedef struct LegacyVpoolJob_ {
+   SDL_cond  *cond;    /**< Signalled when all the jobs are done. */
+   SDL_mutex *mutex;   /**< Mutex of cond. */
+   int       *count;   /**< Number of jobs left. */
+   LegacyData node;    /**< The job to be done. */
+   LegacyData wrapper; /**< Runs node and signals when done. */
+} LegacyVpoolJob;
+
+/**
+ * @brief Creates an old thread queue.
+ */
+static LegacyQueue *legacy_create( void )
+{
+   LegacyQueue *q = calloc( 1, sizeof( LegacyQueue ) );
+   q->first       = calloc( 1, sizeof( LegacyNode ) );
+   q->last        = q->first;
+   q->t_lock      = SDL_CreateMutex();
+   q->h_lock      = SDL_CreateMutex();
+   q->r_lock      = SDL_CreateMutex();
+   q->semaphore   = SDL_CreateSemaphore( 0 );
+   return q;
+}
+
+/**
+ * @brief Enqueues data in an old thread queue.
+ */
+static void legacy_enqueue( LegacyQueue *q, void *data )
+{
+   LegacyNode *n;
+
+   SDL_mutexP( q->r_lock );
+   if ( q->reserve != NULL ) {
+      n          = q->reserve;
+      q->reserve = n->next;
+   } else
+      n = malloc( sizeof( LegacyNode ) );
+   n->data = data;
+   n->next = NULL;
+   SDL_mutexV( q->r_lock );
+
+   SDL_mutexP( q->t_lock );
+   q->last->next = n;
+   q->last       = n;
+   SDL_SemPost( q->semaphore );
+   SDL_mutexV( q->t_lock );
+}
+
+/**
+ * @brief Dequeues data from an old thread queue, the semaphore has to have
+ * been waited on.
+ */
+static void *legacy_dequeue( LegacyQueue *q )
+{
+   LegacyNode *node;
+   void       *d;
+
+   SDL_mutexP( q->h_lock );
+   node     = q->first;
+   d        = node->next->data;
+   q->first = node->next;
+   SDL_mutexV( q->h_lock );
+
+   SDL_mutexP( q->r_lock );
+   node->next = q->reserve;
+   q->reserve = node;
+   SDL_mutexV( q->r_lock );
+   return d;
+}
+
+/**
+ * @brief Frees an old thread queue.
+ */
+static void legacy_destroy( LegacyQueue *q )
+{
+   while ( q->first != NULL ) {
+      LegacyNode *n = q->first;
+      q->first      = n->next;
+      free( n );
+   }
+   while ( q->reserve != NULL ) {
+      LegacyNode *n = q->reserve;
+      q->reserve    = n->next;
+      free( n );
+   }
+   SDL_DestroySemaphore( q->semaphore );
+   SDL_DestroyMutex( q->h_lock );
+   SDL_DestroyMutex( q->t_lock );
+   SDL_DestroyMutex( q->r_lock );
+   free( q );
+}
+
+/**
+ * @brief Worker of the old threadpool.
+ */
+static int legacy_worker( void *data )
+{
+   LegacyWorker *w = data;
+   while ( 1 ) {
+      SDL_SemWait( w->semaphore );
+      if ( w->stop )
+         break;
+      w->job.function( w->job.data );
+      legacy_enqueue( w->idle, w );
+   }
+   return 0;
+}
+
+/**
+ * @brief Handler of the old threadpool, stops when NULL is enqueued.
+ */
+static int legacy_handler( void *data )
+{
+   LegacyQueue  *global   = data;
+   LegacyQueue  *idle     = legacy_create();
+   int           nthreads = SDL_GetCPUCount() + 1;
+   int           nrunning = 0;
+   LegacyWorker *workers  = calloc( nthreads, sizeof( LegacyWorker ) );
+
+   while ( 1 ) {
+      LegacyData   *node;
+      LegacyWorker *w;
+
+      SDL_SemWait( global->semaphore );
+      node = legacy_dequeue( global );
+      if ( node == NULL )
+         break;
+
+      /* Idle worker, new worker, or wait for a worker to be idle. */
+      if ( SDL_SemTryWait( idle->semaphore ) == 0 )
+         w = legacy_dequeue( idle );
+      else if ( nrunning < nthreads ) {
+         w            = &workers[nrunning++];
+         w->semaphore = SDL_CreateSemaphore( 0 );
+         w->idle      = idle;
+         w->thread = SDL_CreateThread( legacy_worker, "legacy_worker", w );
+      } else {
+         SDL_SemWait( idle->semaphore );
+         w = legacy_dequeue( idle );
+      }
+      w->job = *node;
+      SDL_SemPost( w->semaphore );
+   }
+
+   for ( int i = 0; i < nrunning; i++ ) {
+      workers[i].stop = 1;
+      SDL_SemPost( workers[i].semaphore );
+      SDL_WaitThread( workers[i].thread, NULL );
+      SDL_DestroySemaphore( workers[i].semaphore );
+   }
+   legacy_destroy( idle );
+   free( workers );
+   return 0;
+}
+
+/**
+ * @brief Runs a job of an old vpool and signals the waiting thread when all
+ * the jobs are done.
+ */
+static int legacy_vpoolWorker( void *data )
+{
+   LegacyVpoolJob *work = data;
+   work->node.function( work->node.data );
+   SDL_mutexP( work->mutex );
+   if ( --( *work->count ) <= 0 )
+      SDL_CondSignal( work->cond );
+   SDL_mutexV( work->mutex );
+   return 0;
+}
+
+/**
+ * @brief Runs the same jobs as an old vpool would.
+ */
+static void legacy_vpool( LegacyQueue *global, int njobs,
+                          int ( *function )( void * ), void *data )
+{
+   LegacyVpoolJob *jobs  = calloc( njobs, sizeof( LegacyVpoolJob ) );
+   SDL_cond       *cond  = SDL_CreateCond();
+   SDL_mutex      *mutex = SDL_CreateMutex();
+   SDL_sem        *sem   = SDL_CreateSemaphore( 0 );
+   int             count = njobs;
+
+   /* vpool_enqueue */
+   for ( int i = 0; i < njobs; i++ ) {
+      jobs[i].cond             = cond;
+      jobs[i].mutex            = mutex;
+      jobs[i].count            = &count;
+      jobs[i].node.function    = function;
+      jobs[i].node.data        = data;
+      jobs[i].wrapper.function = legacy_vpoolWorker;
+      jobs[i].wrapper.data     = &jobs[i];
+      SDL_SemPost( sem );
+   }
+
+   /* vpool_wait */
+   SDL_mutexP( mutex );
+   for ( int i = 0; i < njobs; i++ ) {
+      SDL_SemWait( sem );
+      legacy_enqueue( global, &jobs[i].wrapper );
+   }
+   while ( count > 0 )
+      SDL_CondWait( cond, mutex );
+   SDL_mutexV( mutex );
+
+   SDL_DestroySemaphore( sem );
+   SDL_DestroyMutex( mutex );
+   SDL_DestroyCond( cond );
+   free( jobs );
+}
+
+/**
+ * @brief Benchmark job that does close to nothing.
+ */
+static int threadpool_benchVpool( void *data )
+{
+   ThreadBenchmark *tb = data;
+   SDL_AtomicAdd( &tb->count, 1 );
+   return 0;
+}
+
+/**
+ * @brief Benchmark job that does close to nothing.
+ */
+static void threadpool_benchJob( Job *job, void *data )
+{
+   (void)job;
+   ThreadBenchmark *tb = data;
+   SDL_AtomicAdd( &tb->count, 1 );
+}
+
+/**
+ * @brief Benchmark parallel for that does close to nothing.
+ */
+static void threadpool_benchFor( void *data, int start, int end )
+{
+   ThreadBenchmark *tb = data;
+   SDL_AtomicAdd( &tb->count, end - start );
+}
+
+/**
+ * @brief Logs the time taken by a benchmark.
+ *
+ *    @param name Name of the benchmark.
+ *    @param t Time taken.
+ *    @param base Time taken by the old queue, or 0 to not compare.
+ *    @param njobs Number of items processed.
+ *    @param tb Benchmark data.
+ */
+static void threadpool_benchLog( const char *name, Uint64 t, Uint64 base,
+                                 int njobs, const ThreadBenchmark *tb )
+{
+   double ms = 1000. * (double)t / (double)SDL_GetPerformanceFrequency();
+   if ( base > 0 )
+      LOG( _( "   %s: %.3f ms (%.1f ns per item, %.1fx faster than the old "
+              "queue)" ),
+           name, ms, 1e6 * ms / (double)njobs,
+           (double)base / (double)MAX( t, 1 ) );
+   else
+      LOG( _( "   %s: %.3f ms (%.1f ns per item)" ), name, ms,
+           1e6 * ms / (double)njobs );
+   if ( SDL_AtomicGet( (SDL_atomic_t *)&tb->count ) != njobs )
+      WARN( _( "Threadpool benchmark '%s' processed %d items instead of %d!" ),
+            name, SDL_AtomicGet( (SDL_atomic_t *)&tb->count ), njobs );
+}
+
+/**
+ * @brief Measures the dispatch overhead of the threadpool.
+ *
+ * Runs the same trivial work through a copy of the old single queue
+ * threadpool, the vpool interface, one job per item through the job interface,
+ * and through a parallel for.
+ *
+ *    @param njobs Number of items to process.
+ */
+void threadpool_benchmark( int njobs )
+{
+   ThreadBenchmark tb;
+   ThreadQueue    *tq;
+   LegacyQueue    *global;
+   SDL_Thread     *handler;
+   Job            *root;
+   Uint64          t, base;
+
+   if ( threadpool_threads() <= 0 ) {
+      WARN( _( "Threadpool has not been initialized yet!" ) );
+      return;
+   }
+   njobs = MAX( njobs, 1 );
+   LOG( _( "Threadpool benchmark with %d items and %d threads:" ), njobs,
+        threadpool_threads() );
+
+   /* Old queue, the first run is not timed as it starts the workers. */
+   global  = legacy_create();
+   handler = SDL_CreateThread( legacy_handler, "legacy_handler", global );
+   legacy_vpool( global, njobs, threadpool_benchVpool, &tb );
+   SDL_AtomicSet( &tb.count, 0 );
+   t = SDL_GetPerformanceCounter();
+   legacy_vpool( global, njobs, threadpool_benchVpool, &tb );
+   base = SDL_GetPerformanceCounter() - t;
+   threadpool_benchLog( "old queue", base, 0, njobs, &tb );
+   legacy_enqueue( global, NULL );
+   SDL_WaitThread( handler, NULL );
+   legacy_destroy( global );
+
+   /* vpool. */
+   SDL_AtomicSet( &tb.count, 0 );
+   t  = SDL_GetPerformanceCounter();
+   tq = vpool_create();
+   for ( int i = 0; i < njobs; i++ )
+      vpool_enqueue( tq, threadpool_benchVpool, &tb );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   threadpool_benchLog( "vpool", SDL_GetPerformanceCounter() - t, base, njobs,
+                        &tb );
+
+   /* Jobs. */
+   SDL_AtomicSet( &tb.count, 0 );
+   t    = SDL_GetPerformanceCounter();
+   root = job_create( NULL, NULL, NULL );
+   for ( int i = 0; i < njobs; i++ )
+      job_run( job_create( threadpool_benchJob, &tb, root ) );
+   job_run( root );
+   job_wait( root );
+   threadpool_benchLog( "jobs", SDL_GetPerformanceCounter() - t, base, njobs,
+                        &tb );
+
+   /* Parallel for. */
+   SDL_AtomicSet( &tb.count, 0 );
+   t = SDL_GetPerformanceCounter();
+   job_parallelFor( njobs, 64, threadpool_benchFor, &tb );
+   threadpool_benchLog( "parallel for", SDL_GetPerformanceCounter() - t, base,
+                        njobs, &tb );
+}
+#endif /* DEBUGGING */
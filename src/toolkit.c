@@ -1298,7 +1298,7 @@ void toolkit_drawOutlineThick( int x, int y, int w, int h, int b, int thick,
                                GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
                                toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 10 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 10 );
    gl_endSmoothProgram();
 }
 
@@ -1352,7 +1352,7 @@ void toolkit_drawOutline( int x, int y, int w, int h, int b, const glColour *c,
                                GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
                                toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_LOOP, 0, 4 );
+   gl_drawArrays( GL_LINE_LOOP, 0, 4 );
    gl_endSmoothProgram();
 }
 /**
@@ -1402,7 +1402,7 @@ void toolkit_drawRect( int x, int y, int w, int h, const glColour *c,
                                GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
                                toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    gl_endSmoothProgram();
 }
 
@@ -1446,7 +1446,7 @@ void toolkit_drawTriangle( int x1, int y1, int x2, int y2, int x3, int y3,
                                GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
                                toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 3 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 3 );
    gl_endSmoothProgram();
 }
 
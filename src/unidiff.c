@@ -21,6 +21,7 @@
 #include "economy.h"
 #include "log.h"
 #include "map_overlay.h"
+#include "mission.h"
 #include "ndata.h"
 #include "nxml.h"
 #include "player.h"
@@ -775,6 +776,9 @@ static int diff_applyInternal( const char *name, int oneshot )
    /* Update overlay map just in case. */
    ovr_refresh();
 
+   /* Mission conditionals may depend on the diff. */
+   missions_stateChanged();
+
    /* Update universe. */
    if ( oneshot )
       diff_checkUpdateUniverse();
@@ -1897,6 +1901,7 @@ static int diff_removeDiff( UniDiff_t *diff )
 
    diff_cleanup( diff );
    array_erase( &diff_stack, diff, &diff[1] );
+   missions_stateChanged();
    return 0;
 }
 
@@ -10,8 +10,10 @@
  * on the outfit that created them.
  */
 /** @cond */
+#include "SDL_cpuinfo.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "naev.h"
 /** @endcond */
@@ -19,9 +21,11 @@
 #include "weapon.h"
 
 #include "ai.h"
+#include "arena.h"
 #include "array.h"
 #include "camera.h"
 #include "collision.h"
+#include "conf.h"
 #include "damagetype.h"
 #include "gui.h"
 #include "input.h"
@@ -38,6 +42,7 @@
 #include "rng.h"
 #include "sound.h"
 #include "spfx.h"
+#include "threadpool.h"
 
 /**
  * @brief Struct useful for generalization of weapno collisions.
@@ -68,6 +73,49 @@ typedef struct WeaponHit_ {
       *pos; /* Location of the hit, can be 2d array in the case of beams. */
 } WeaponHit;
 
+/**
+ * @brief Potential hit found by the collision broadphase.
+ *
+ * Only stores indices and identifiers so it can be validated again after
+ * other weapons have been handled.
+ */
+typedef struct WeaponCollideHit_ {
+   int        weapon; /**< Index of the weapon in the stack. */
+   TargetType type;   /**< Class of object hit. */
+   union {
+      unsigned int plt; /**< ID of the pilot hit. */
+      Asteroid    *ast; /**< Asteroid hit. */
+      int          wpn; /**< Index of the weapon hit. */
+   } u;
+   vec2 crash[2]; /**< Location of the hit. */
+} WeaponCollideHit;
+
+/**
+ * @brief Range of weapons handled by a single collision worker.
+ */
+typedef struct WeaponCollideChunk_ {
+   int               start; /**< First weapon index. */
+   int               end;   /**< Last weapon index (exclusive). */
+   QuadtreeTemp      tmp;   /**< Quadtree temporary buffer. */
+   IntList           il;    /**< Quadtree query results. */
+   WeaponCollideHit *hits;  /**< Hits found, ordered by weapon index. */
+} WeaponCollideChunk;
+
+/**
+ * @brief Projectile of a quadtree benchmark trace.
+ */
+typedef struct WeaponQtTrace_ {
+   vec2   pos;   /**< Current position. */
+   vec2   pre;   /**< Previous position. */
+   vec2   vel;   /**< Velocity. */
+   vec2   start; /**< Position it gets fired from again. */
+   double range; /**< Collision size. */
+   double life;  /**< Time it flies for. */
+   double timer; /**< Time left to fly. */
+   int    fired; /**< Whether it was fired again this frame. */
+   int    elem;  /**< Element in the incremental quadtree. */
+} WeaponQtTrace;
+
 /* Weapon layers. */
 static Weapon *weapon_stack =
    NULL; /**< All the weapon munitions are piled up here. */
@@ -83,6 +131,18 @@ static int      qt_init = 0; /**< Whether or not the quadtree was created. */
 static Quadtree weapon_quadtree; /**< Quadtree for weapons. */
 static IntList  weapon_qtquery;  /**< For querying collisions. */
 static IntList  weapon_qtexp; /**< For querying collisions from explosions. */
+static QuadtreeTemp weapon_qttemp; /**< For querying serial collisions. */
+
+/* Collision broadphase. */
+static WeaponCollideHit   *weapon_hitBuf = NULL; /**< Serial collision hits. */
+static WeaponCollideHit   *weapon_collideHits   = NULL; /**< Parallel hits. */
+static WeaponCollideChunk *weapon_collideChunks = NULL; /**< Workers. */
+static ThreadQueue        *weapon_vpool         = NULL; /**< Worker queue. */
+#define WEAPON_COLLIDE_PARALLEL_MIN                                            \
+   64 /**< Minimum weapons to bother finding collisions in parallel. */
+#define WEAPON_COLLIDE_CHUNK_MIN 16 /**< Minimum weapons per worker. */
+#define WEAPON_QT_MARGIN                                                       \
+   16 /**< Distance weapons move before being reinserted in the quadtree. */
 
 /*
  * Prototypes
@@ -113,6 +173,14 @@ static double weapon_computeTimes( double rdir, double rx, double ry,
 /* Updating. */
 static void weapon_render( Weapon *w, double dt );
 static void weapon_updateCollide( Weapon *w, double dt );
+static void weapon_collideSetup( Weapon *w, WeaponCollision *wc, int *x1,
+                                 int *y1, int *x2, int *y2 );
+static void weapon_collideFind( int idx, QuadtreeTemp *tmp, IntList *il,
+                                WeaponCollideHit **hits );
+static int  weapon_collideFindChunk( void *data );
+static void weapons_collideFind( int n );
+static int  weapon_collideApply( Weapon *w, const WeaponCollideHit *hits, int n,
+                                 double dt );
 static void weapon_update( Weapon *w, double dt );
 static void weapon_sample_trail( Weapon *w );
 /* Destruction. */
@@ -137,6 +205,13 @@ void weapon_minimap( double res, double w, double h, const RadarShape shape,
 /* movement. */
 static void weapon_setAccel( Weapon *w, double accel );
 static void weapon_setTurn( Weapon *w, double turn );
+/* Quadtree. */
+static void weapon_qtBox( const vec2 *pos, const vec2 *pre, double range,
+                          int *x1, int *y1, int *x2, int *y2 );
+static int  weapon_qtTrace( WeaponQtTrace *trace, int n );
+static int  weapon_qtCmp( const void *p1, const void *p2 );
+static int  weapon_qtCheck( Quadtree *a, Quadtree *b, IntList *ila,
+                            IntList *ilb, const WeaponQtTrace *trace, int n );
 
 /**
  * @brief Initializes the weapon stuff.
@@ -146,6 +221,10 @@ void weapon_init( void )
    weapon_stack = array_create( Weapon );
    il_create( &weapon_qtquery, 1 );
    il_create( &weapon_qtexp, 1 );
+   weapon_hitBuf        = array_create( WeaponCollideHit );
+   weapon_collideHits   = array_create( WeaponCollideHit );
+   weapon_collideChunks = array_create( WeaponCollideChunk );
+   weapon_vpool         = vpool_create();
 }
 
 /**
@@ -209,6 +288,7 @@ void weapon_newSystem( void )
       qt_destroy( &weapon_quadtree );
    qt_create( &weapon_quadtree, -r, -r, r, r, 4,
               6 ); /* TODO tune parameters. */
+   qt_set_margin( &weapon_quadtree, WEAPON_QT_MARGIN );
    qt_init = 1;
 
    NTracingZoneEnd( _ctx );
@@ -311,7 +391,7 @@ void weapon_minimap( double res, double w, double h, const RadarShape shape,
                                   GL_FLOAT, 0 );
       gl_vboActivateAttribOffset( weapon_vbo, shaders.points.vertex_colour,
                                   offset * sizeof( GLfloat ), 4, GL_FLOAT, 0 );
-      glDrawArrays( GL_POINTS, 0, p );
+      gl_drawArrays( GL_POINTS, 0, p );
       glDisableVertexAttribArray( shaders.points.vertex );
       glDisableVertexAttribArray( shaders.points.vertex_colour );
       glUseProgram( 0 );
@@ -602,34 +682,60 @@ static void think_beam( Weapon *w, double dt )
    }
 }
 
+/**
+ * @brief Gets the quadtree box of something moving from pre to pos.
+ */
+static void weapon_qtBox( const vec2 *pos, const vec2 *pre, double range,
+                          int *x1, int *y1, int *x2, int *y2 )
+{
+   int x  = round( pos->x );
+   int y  = round( pos->y );
+   int px = round( pre->x );
+   int py = round( pre->y );
+   int w2 = ceil( range * 0.5 );
+   int h2 = ceil( range * 0.5 );
+   *x1    = MIN( x, px ) - w2;
+   *y1    = MIN( y, py ) - h2;
+   *x2    = MAX( x, px ) + w2;
+   *y2    = MAX( y, py ) + h2;
+}
+
 /**
  * @brief Purges unnecessary weapons.
+ *
+ * The quadtree is updated in place instead of being rebuilt, as most weapons
+ * stay within the margin of their element from one frame to the next.
  */
 void weapons_updatePurge( void )
 {
    NTracingZone( _ctx, 1 );
 
-   /* Clear quadtree. */
-   qt_clear( &weapon_quadtree );
-
    /* Actually purge and remove weapons. */
    for ( int i = array_size( weapon_stack ) - 1; i >= 0; i-- ) {
       Weapon *w = &weapon_stack[i];
       if ( !weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
          continue;
+      if ( w->qt_elem >= 0 )
+         qt_remove( &weapon_quadtree, w->qt_elem );
       weapon_free( w );
       array_erase( &weapon_stack, &weapon_stack[i], &weapon_stack[i + 1] );
    }
 
-   /* Do a second pass to add the quadtree elements. */
+   /* Do a second pass to move the quadtree elements, which also updates the
+    * indices of the weapons that were shifted. */
    for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
-      const Weapon    *w = &weapon_stack[i];
-      int              x, y, px, py, w2, h2;
+      Weapon          *w = &weapon_stack[i];
+      int              x1, y1, x2, y2;
       const OutfitGFX *gfx;
       double           range;
 
-      if ( !weapon_isFlag( w, WEAPON_FLAG_HITTABLE ) )
+      if ( !weapon_isFlag( w, WEAPON_FLAG_HITTABLE ) ) {
+         if ( w->qt_elem >= 0 ) {
+            qt_remove( &weapon_quadtree, w->qt_elem );
+            w->qt_elem = -1;
+         }
          continue;
+      }
 
       gfx = outfit_gfx( w->outfit );
       if ( gfx->tex != NULL )
@@ -637,16 +743,15 @@ void weapons_updatePurge( void )
       else
          range = gfx->col_size;
 
-      /* Determine quadtree location, and insert. */
-      x  = round( w->solid.pos.x );
-      y  = round( w->solid.pos.y );
-      px = round( w->solid.pre.x );
-      py = round( w->solid.pre.y );
-      w2 = ceil( range * 0.5 );
-      h2 = ceil( range * 0.5 );
-      qt_insert( &weapon_quadtree, i, MIN( x, px ) - w2, MIN( y, py ) - h2,
-                 MAX( x, px ) + w2, MAX( y, py ) + h2 );
+      /* Determine quadtree location, and insert or move. */
+      weapon_qtBox( &w->solid.pos, &w->solid.pre, range, &x1, &y1, &x2, &y2 );
+      if ( w->qt_elem < 0 )
+         w->qt_elem = qt_insert( &weapon_quadtree, i, x1, y1, x2, y2 );
+      else
+         w->qt_elem =
+            qt_move( &weapon_quadtree, w->qt_elem, i, x1, y1, x2, y2 );
    }
+   qt_cleanup_lazy( &weapon_quadtree );
 
    NTracingZoneEnd( _ctx );
 }
@@ -656,9 +761,21 @@ void weapons_updatePurge( void )
  */
 void weapons_updateCollide( double dt )
 {
+   int n, h;
+
    NTracingZone( _ctx, 1 );
    NTracingPlotI( "weapons", array_size( weapon_stack ) );
 
+   /* Find the potential hits of all the weapons in parallel first. The hits
+    * are then applied serially in stack order, the same as the serial
+    * update. */
+   n = array_size( weapon_stack );
+   if ( conf.deterministic || ( n < WEAPON_COLLIDE_PARALLEL_MIN ) )
+      n = 0;
+   else
+      weapons_collideFind( n );
+
+   h = 0;
    for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
       Weapon *w = &weapon_stack[i];
 
@@ -724,8 +841,94 @@ void weapons_updateCollide( double dt )
       }
 
       /* Only increment if weapon wasn't destroyed. */
-      if ( !weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+      if ( weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+         continue;
+
+      /* Weapons created during the update were not in the broadphase. */
+      if ( i >= n ) {
+         weapon_updateCollide( w, dt );
+         continue;
+      }
+
+      /* Look up the hits found for the weapon. */
+      int nh;
+      while ( ( h < array_size( weapon_collideHits ) ) &&
+              ( weapon_collideHits[h].weapon < i ) )
+         h++;
+      for ( nh = 0; h + nh < array_size( weapon_collideHits ); nh++ )
+         if ( weapon_collideHits[h + nh].weapon != i )
+            break;
+      if ( weapon_collideApply( w, &weapon_collideHits[h], nh, dt ) )
          weapon_updateCollide( w, dt );
+      h += nh;
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Finds the potential hits of a range of weapons.
+ *
+ *    @param data Chunk to process.
+ *    @return 0 on success.
+ */
+static int weapon_collideFindChunk( void *data )
+{
+   WeaponCollideChunk *chunk = data;
+   array_erase( &chunk->hits, array_begin( chunk->hits ),
+                array_end( chunk->hits ) );
+   for ( int i = chunk->start; i < chunk->end; i++ )
+      if ( !weapon_isFlag( &weapon_stack[i], WEAPON_FLAG_DESTROYED ) )
+         weapon_collideFind( i, &chunk->tmp, &chunk->il, &chunk->hits );
+   return 0;
+}
+
+/**
+ * @brief Runs the collision broadphase of the first weapons on the thread
+ * pool.
+ *
+ * Results are stored in weapon_collideHits ordered by weapon index.
+ *
+ *    @param n Number of weapons to process.
+ */
+static void weapons_collideFind( int n )
+{
+   int nchunks, chunksize;
+
+   NTracingZone( _ctx, 1 );
+
+   nchunks   = MIN( SDL_GetCPUCount(), n / WEAPON_COLLIDE_CHUNK_MIN );
+   nchunks   = MAX( nchunks, 1 );
+   chunksize = ( n + nchunks - 1 ) / nchunks;
+
+   /* Chunks keep their buffers between frames. */
+   for ( int i = array_size( weapon_collideChunks ); i < nchunks; i++ ) {
+      WeaponCollideChunk *chunk = &array_grow( &weapon_collideChunks );
+      memset( chunk, 0, sizeof( WeaponCollideChunk ) );
+      il_create( &chunk->il, 1 );
+      chunk->hits = array_create( WeaponCollideHit );
+   }
+
+   for ( int i = 0; i < nchunks; i++ ) {
+      WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+      chunk->start              = MIN( i * chunksize, n );
+      chunk->end                = MIN( chunk->start + chunksize, n );
+      vpool_enqueue( weapon_vpool, weapon_collideFindChunk, chunk );
+   }
+   vpool_wait( weapon_vpool );
+
+   /* Merge in order. */
+   array_erase( &weapon_collideHits, array_begin( weapon_collideHits ),
+                array_end( weapon_collideHits ) );
+   for ( int i = 0; i < nchunks; i++ ) {
+      const WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+      int                       nh    = array_size( chunk->hits );
+      if ( nh <= 0 )
+         continue;
+      int off = array_size( weapon_collideHits );
+      array_resize( &weapon_collideHits, off + nh );
+      memcpy( &weapon_collideHits[off], chunk->hits,
+              nh * sizeof( WeaponCollideHit ) );
    }
 
    NTracingZoneEnd( _ctx );
@@ -760,11 +963,14 @@ void weapons_render( const WeaponLayer layer, double dt )
 {
    NTracingZone( _ctx, 1 );
 
+   /* Most weapons are sprites, so batch them up. */
+   gl_batchBegin();
    for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
       Weapon *w = &weapon_stack[i];
       if ( w->layer == layer )
          weapon_render( w, dt );
    }
+   gl_batchEnd();
 
    NTracingZoneEnd( _ctx );
 }
@@ -811,7 +1017,7 @@ static void weapon_renderBeam( Weapon *w, double dt )
                                &w->outfit->u.bem.shader );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.beam.vertex );
@@ -851,6 +1057,7 @@ static void weapon_render( Weapon *w, double dt )
          col_blend( &col, &cYellow, &cRed, st );
          col.a = 0.5;
 
+         gl_batchFlush();
          glUseProgram( shaders.iflockon.program );
          glUniform1f( shaders.iflockon.paramf, st );
          gl_renderShader( x, y, r, r, r, &shaders.iflockon, &col, 1 );
@@ -888,6 +1095,7 @@ static void weapon_render( Weapon *w, double dt )
               ( y > SCREEN_H + r ) )
             return;
 
+         gl_batchFlush();
          mat4 projection = gl_view_matrix;
          mat4_translate_xy( &projection, x, y );
          mat4_rotate2d( &projection, w->solid.dir );
@@ -904,7 +1112,7 @@ static void weapon_render( Weapon *w, double dt )
          gl_vboActivateAttribOffset( gl_circleVBO, gfx->vertex, 0, 2, GL_FLOAT,
                                      0 );
 
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          glDisableVertexAttribArray( gfx->vertex );
          glUseProgram( 0 );
@@ -915,6 +1123,7 @@ static void weapon_render( Weapon *w, double dt )
    /* Beam weapons. */
    case OUTFIT_TYPE_BEAM:
    case OUTFIT_TYPE_TURRET_BEAM:
+      gl_batchFlush();
       weapon_renderBeam( w, dt );
       break;
 
@@ -1176,62 +1385,62 @@ static int weapon_testCollision( const WeaponCollision *wc,
 }
 
 /**
- * @brief Updates an individual weapon.
+ * @brief Sets up the collision data and bounding box of a weapon.
  *
- *    @param w Weapon to update.
- *    @param dt Current delta tick.
+ *    @param w Weapon to set up.
+ *    @param[out] wc Collision data of the weapon.
+ *    @param[out] x1 Left side of the bounding box.
+ *    @param[out] y1 Bottom side of the bounding box.
+ *    @param[out] x2 Right side of the bounding box.
+ *    @param[out] y2 Top side of the bounding box.
  */
-static void weapon_updateCollide( Weapon *w, double dt )
+static void weapon_collideSetup( Weapon *w, WeaponCollision *wc, int *x1,
+                                 int *y1, int *x2, int *y2 )
 {
-   vec2            crash[2];
-   WeaponCollision wc;
-   Pilot *const   *pilot_stack = pilot_getAll();
-   int             x1, y1, x2, y2;
-
    /* Get the sprite direction to speed up calculations. */
-   wc.explosion = 0;
-   wc.w         = w;
-   wc.beam      = outfit_isBeam( w->outfit );
-   if ( !wc.beam ) {
+   wc->explosion = 0;
+   wc->w         = w;
+   wc->beam      = outfit_isBeam( w->outfit );
+   if ( !wc->beam ) {
       int x, y, w2, h2, px, py;
-      wc.gfx = outfit_gfx( w->outfit );
+      wc->gfx = outfit_gfx( w->outfit );
       if ( outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_COLLISION_OVERRIDE ) ) {
-         wc.polygon  = NULL;
-         wc.polyview = NULL;
-         wc.range    = wc.gfx->col_size;
-         wc.gfx      = NULL;
+         wc->polygon  = NULL;
+         wc->polyview = NULL;
+         wc->range    = wc->gfx->col_size;
+         wc->gfx      = NULL;
       } else {
-         if ( wc.gfx->tex != NULL ) {
+         if ( wc->gfx->tex != NULL ) {
             const CollPoly *plg = outfit_plg( w->outfit );
             if ( plg != NULL ) {
-               wc.polygon  = plg;
-               wc.polyview = poly_view( plg, w->solid.dir );
+               wc->polygon  = plg;
+               wc->polyview = poly_view( plg, w->solid.dir );
             } else {
-               wc.polygon  = NULL;
-               wc.polyview = NULL;
+               wc->polygon  = NULL;
+               wc->polyview = NULL;
             }
-            wc.range = wc.gfx->size; /* Range is set to size in this case. */
+            wc->range = wc->gfx->size; /* Range is set to size in this case. */
          } else {
-            wc.polygon  = NULL;
-            wc.polyview = NULL;
-            wc.range    = wc.gfx->col_size;
+            wc->polygon  = NULL;
+            wc->polyview = NULL;
+            wc->range    = wc->gfx->col_size;
          }
       }
-      wc.beamrange = 0.;
+      wc->beamrange = 0.;
 
       /* Determine quadtree location. */
-      x  = round( w->solid.pos.x );
-      y  = round( w->solid.pos.y );
-      px = x + round( w->solid.pre.x );
-      py = y + round( w->solid.pre.y );
-      w2 = ceil( wc.range * 0.5 );
-      h2 = ceil( wc.range * 0.5 );
-      x1 = MIN( x, px ) - w2;
-      y1 = MIN( y, py ) - h2;
-      x2 = MAX( x, px ) + w2;
-      y2 = MAX( y, py ) + h2;
+      x   = round( w->solid.pos.x );
+      y   = round( w->solid.pos.y );
+      px  = x + round( w->solid.pre.x );
+      py  = y + round( w->solid.pre.y );
+      w2  = ceil( wc->range * 0.5 );
+      h2  = ceil( wc->range * 0.5 );
+      *x1 = MIN( x, px ) - w2;
+      *y1 = MIN( y, py ) - h2;
+      *x2 = MAX( x, px ) + w2;
+      *y2 = MAX( y, py ) + h2;
    } else {
-      Pilot *p = pilot_get( w->parent );
+      const Pilot *p = pilot_get( w->parent );
       /* Beams have to update properties as necessary. */
       if ( p != NULL ) {
          /* Beams need to update their properties online. */
@@ -1246,36 +1455,60 @@ static void weapon_updateCollide( Weapon *w, double dt )
          }
          w->dam_as_dis_mod = CLAMP( 0., 1., w->dam_as_dis_mod );
       }
-      wc.gfx      = NULL;
-      wc.polygon  = NULL;
-      wc.polyview = NULL;
-      wc.range    = w->outfit->u.bem.width * 0.5; /* Set beam width. */
-      wc.beamrange =
+      wc->gfx      = NULL;
+      wc->polygon  = NULL;
+      wc->polyview = NULL;
+      wc->range    = w->outfit->u.bem.width * 0.5; /* Set beam width. */
+      wc->beamrange =
          w->outfit->u.bem.range * w->range_mod; /* Set beam range. */
 
       /* Determine quadtree location. */
-      x1 = round( w->solid.pos.x );
-      y1 = round( w->solid.pos.y );
-      x2 = x1 + ceil( wc.beamrange * cos( w->solid.dir ) );
-      y2 = y1 + ceil( wc.beamrange * sin( w->solid.dir ) );
-      if ( x1 > x2 ) {
-         int t = x1;
-         x1    = x2;
-         x2    = t;
+      *x1 = round( w->solid.pos.x );
+      *y1 = round( w->solid.pos.y );
+      *x2 = *x1 + ceil( wc->beamrange * cos( w->solid.dir ) );
+      *y2 = *y1 + ceil( wc->beamrange * sin( w->solid.dir ) );
+      if ( *x1 > *x2 ) {
+         int t = *x1;
+         *x1   = *x2;
+         *x2   = t;
       }
-      if ( y1 > y2 ) {
-         int t = y1;
-         y1    = y2;
-         y2    = t;
+      if ( *y1 > *y2 ) {
+         int t = *y1;
+         *y1   = *y2;
+         *y2   = t;
       }
    }
+}
+
+/**
+ * @brief Finds what a weapon collides with without applying any hits.
+ *
+ * Only modifies the weapon itself, so different weapons can be processed from
+ * different threads as long as each uses its own buffers. Non-beam weapons
+ * only report their first hit.
+ *
+ *    @param idx Index of the weapon in the stack.
+ *    @param tmp Quadtree temporary buffer to use.
+ *    @param il List to use for quadtree queries.
+ *    @param[out] hits Array to append the hits to.
+ */
+static void weapon_collideFind( int idx, QuadtreeTemp *tmp, IntList *il,
+                                WeaponCollideHit **hits )
+{
+   Weapon          *w = &weapon_stack[idx];
+   WeaponCollision  wc;
+   WeaponCollideHit hit;
+   Pilot *const    *pilot_stack = pilot_getAll();
+   int              x1, y1, x2, y2;
+
+   weapon_collideSetup( w, &wc, &x1, &y1, &x2, &y2 );
+   hit.weapon = idx;
 
    /* Get colliding pilots. */
    if ( !outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_MISS_SHIPS ) ) {
-      pilot_collideQueryIL( &weapon_qtquery, x1, y1, x2, y2 );
-      for ( int i = 0; i < il_size( &weapon_qtquery ); i++ ) {
-         Pilot    *p = pilot_stack[il_get( &weapon_qtquery, i, 0 )];
-         WeaponHit hit;
+      pilot_collideQueryTemp( tmp, il, x1, y1, x2, y2 );
+      for ( int i = 0; i < il_size( il ); i++ ) {
+         const Pilot *p = pilot_stack[il_get( il, i, 0 )];
 
          /* Ignore pilots being deleted. */
          if ( pilot_isFlag( p, PILOT_DELETE ) )
@@ -1308,28 +1541,23 @@ static void weapon_updateCollide( Weapon *w, double dt )
          /* Test if hit. */
          if ( !weapon_testCollision(
                  &wc, p->ship->gfx_space, p->tsx, p->tsy, &p->solid,
-                 poly_view( &p->ship->polygon, p->solid.dir ), 0., crash ) )
+                 poly_view( &p->ship->polygon, p->solid.dir ), 0.,
+                 hit.crash ) )
             continue;
 
-         /* Handle the hit. */
+         /* Store the hit. */
          hit.type  = TARGET_PILOT;
-         hit.u.plt = p;
-         hit.pos   = crash;
-         if ( wc.beam )
-            weapon_hitBeam( w, &hit, dt );
-         /* No return because beam can still think, it's not
-          * destroyed like the other weapons.*/
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
-         }
+         hit.u.plt = p->id;
+         array_push_back( hits, hit );
+         if ( !wc.beam )
+            return; /* Weapon will be destroyed. */
       }
    }
 
    /* Collide with asteroids. */
    if ( !outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_MISS_ASTEROIDS ) ) {
       for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
-         AsteroidAnchor *ast = &cur_system->asteroids[i];
+         const AsteroidAnchor *ast = &cur_system->asteroids[i];
 
          /* Early in-range check with the asteroid field.
           * Since range for beam weapons is set to width, we have to use the
@@ -1340,52 +1568,46 @@ static void weapon_updateCollide( Weapon *w, double dt )
             continue;
 
          /* Quadtree collisions. */
-         asteroid_collideQueryIL( ast, &weapon_qtquery, x1, y1, x2, y2 );
-         for ( int j = 0; j < il_size( &weapon_qtquery ); j++ ) {
-            Asteroid *a = &ast->asteroids[il_get( &weapon_qtquery, j, 0 )];
+         asteroid_collideQueryTemp( ast, tmp, il, x1, y1, x2, y2 );
+         for ( int j = 0; j < il_size( il ); j++ ) {
+            Asteroid *a = &ast->asteroids[il_get( il, j, 0 )];
             int       coll;
-            WeaponHit hit;
 
             if ( a->state != ASTEROID_FG )
                continue;
 
             if ( array_size( a->polygon->views ) > 0 ) {
                CollPolyView rpoly;
-               poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang );
+               poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang,
+                            NULL );
                coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, &rpoly,
-                                            0., crash );
-               free( rpoly.x );
-               free( rpoly.y );
+                                            0., hit.crash );
             } else
                coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, NULL,
-                                            0., crash );
+                                            0., hit.crash );
 
             /* Missed. */
             if ( !coll )
                continue;
 
-            /* Handle the hit. */
+            /* Store the hit. */
             hit.type  = TARGET_ASTEROID;
             hit.u.ast = a;
-            hit.pos   = crash;
-            if ( wc.beam )
-               weapon_hitBeam( w, &hit, dt );
-            else {
-               weapon_hit( w, &hit );
-               return; /* Weapon is destroyed. */
-            }
+            array_push_back( hits, hit );
+            if ( !wc.beam )
+               return; /* Weapon will be destroyed. */
          }
       }
    }
 
    /* Finally do a point defense test. */
    if ( outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_POINTDEFENSE ) ) {
-      qt_query( &weapon_quadtree, &weapon_qtquery, x1, y1, x2, y2 );
-      for ( int i = 0; i < il_size( &weapon_qtquery ); i++ ) {
-         Weapon         *whit = &weapon_stack[il_get( &weapon_qtquery, i, 0 )];
+      qt_query_temp( &weapon_quadtree, tmp, il, x1, y1, x2, y2 );
+      for ( int i = 0; i < il_size( il ); i++ ) {
+         int             widx = il_get( il, i, 0 );
+         const Weapon   *whit = &weapon_stack[widx];
          WeaponCollision wchit;
          int             coll;
-         WeaponHit       hit;
 
          /* We can only hit ammo weapons, so no beams. */
          wchit.w         = whit;
@@ -1406,22 +1628,96 @@ static void weapon_updateCollide( Weapon *w, double dt )
          /* Do the real collision test. */
          coll = weapon_testCollision( &wc, wchit.gfx->tex, whit->sx, whit->sy,
                                       &whit->solid, wchit.polyview, wchit.range,
-                                      crash );
+                                      hit.crash );
          if ( !coll )
             continue;
 
-         /* Handle the hit. */
+         /* Store the hit. */
          hit.type  = TARGET_WEAPON;
-         hit.u.wpn = whit;
-         hit.pos   = crash;
-         if ( wc.beam )
-            weapon_hitBeam( w, &hit, dt );
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
-         }
+         hit.u.wpn = widx;
+         array_push_back( hits, hit );
+         if ( !wc.beam )
+            return; /* Weapon will be destroyed. */
+      }
+   }
+}
+
+/**
+ * @brief Applies the hits found for a weapon.
+ *
+ * Targets are checked again, since other weapons may have changed them after
+ * the hits were found.
+ *
+ *    @param w Weapon that hit.
+ *    @param hits Hits found for the weapon.
+ *    @param n Number of hits.
+ *    @param dt Current delta tick.
+ *    @return 1 if the collisions of the weapon have to be computed again.
+ */
+static int weapon_collideApply( Weapon *w, const WeaponCollideHit *hits, int n,
+                                double dt )
+{
+   int beam = outfit_isBeam( w->outfit );
+
+   for ( int i = 0; i < n; i++ ) {
+      const WeaponCollideHit *wch = &hits[i];
+      WeaponHit               hit;
+      int                     valid;
+
+      hit.type = wch->type;
+      hit.pos  = wch->crash;
+      switch ( wch->type ) {
+      case TARGET_PILOT:
+         hit.u.plt = pilot_get( wch->u.plt );
+         valid = ( hit.u.plt != NULL ) &&
+                 !pilot_isFlag( hit.u.plt, PILOT_DELETE ) &&
+                 weapon_checkCanHit( w, hit.u.plt );
+         break;
+      case TARGET_ASTEROID:
+         hit.u.ast = wch->u.ast;
+         valid     = ( hit.u.ast->state == ASTEROID_FG );
+         break;
+      case TARGET_WEAPON:
+         hit.u.wpn = &weapon_stack[wch->u.wpn];
+         valid     = 1;
+         break;
+      default:
+         valid = 0;
+         break;
+      }
+
+      /* Target is no longer valid. */
+      if ( !valid ) {
+         if ( beam )
+            continue;
+         return 1; /* May have hit something else instead. */
+      }
+
+      if ( beam )
+         weapon_hitBeam( w, &hit, dt );
+      /* No return because beam can still think, it's not
+       * destroyed like the other weapons.*/
+      else {
+         weapon_hit( w, &hit );
+         return 0; /* Weapon is destroyed. */
       }
    }
+   return 0;
+}
+
+/**
+ * @brief Updates an individual weapon.
+ *
+ *    @param w Weapon to update.
+ *    @param dt Current delta tick.
+ */
+static void weapon_updateCollide( Weapon *w, double dt )
+{
+   array_erase( &weapon_hitBuf, array_begin( weapon_hitBuf ),
+                array_end( weapon_hitBuf ) );
+   weapon_collideFind( w - weapon_stack, &weapon_qttemp, &weapon_qtquery,
+                       &weapon_hitBuf );
+   weapon_collideApply( w, weapon_hitBuf, array_size( weapon_hitBuf ), dt );
 }
 
 /**
@@ -1661,11 +1957,12 @@ static void weapon_hitExplode( Weapon *w, const Damage *dmg, double radius,
 
             if ( array_size( a->polygon->views ) > 0 ) {
                CollPolyView rpoly;
-               poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang );
+               ArenaMark    mark = arena_mark( arena_scratch() );
+               poly_rotate( &rpoly, &a->polygon->views[0], (float)a->ang,
+                            mark.arena );
                coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, &rpoly,
                                             0., crash );
-               free( rpoly.x );
-               free( rpoly.y );
+               arena_release( &mark );
             } else
                coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, NULL,
                                             0., crash );
@@ -2539,6 +2836,7 @@ static int weapon_create( Weapon *w, PilotOutfitSlot *po, const Outfit *ref,
 
    /* Create basic features */
    memset( w, 0, sizeof( Weapon ) );
+   w->qt_elem = -1;
    w->id      = ++weapon_idgen;
    w->layer   = ( parent->id == PLAYER_ID ) ? WEAPON_LAYER_FG : WEAPON_LAYER_BG;
    w->mount   = po;
@@ -2831,6 +3129,230 @@ static void weapon_free( Weapon *w )
 #endif /* DEBUGGING */
 }
 
+/**
+ * @brief Sets up the projectiles of a quadtree benchmark.
+ *
+ * The weapons currently flying are used first. The rest are fired between
+ * random pilots in the system, like in a battle.
+ *
+ *    @param[out] trace Projectiles to set up.
+ *    @param n Number of projectiles.
+ *    @return Number of projectiles taken from the current weapons.
+ */
+static int weapon_qtTrace( WeaponQtTrace *trace, int n )
+{
+   Pilot *const *pilots  = pilot_getAll();
+   int           npilots = array_size( pilots );
+   double        r       = ( cur_system != NULL ) ? cur_system->radius : 10e3;
+   int           nlive   = 0;
+
+   for ( int i = 0; ( i < array_size( weapon_stack ) ) && ( nlive < n );
+         i++ ) {
+      const Weapon    *w = &weapon_stack[i];
+      WeaponQtTrace   *t = &trace[nlive];
+      const OutfitGFX *gfx;
+      if ( !weapon_isFlag( w, WEAPON_FLAG_HITTABLE ) ||
+           weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+         continue;
+      gfx      = outfit_gfx( w->outfit );
+      t->pos   = w->solid.pos;
+      t->vel   = w->solid.vel;
+      t->range = ( gfx->tex != NULL ) ? gfx->size : gfx->col_size;
+      t->life  = MAX( w->life, 0.1 );
+      t->timer = CLAMP( 0.01, t->life, w->timer );
+      vec2_cset( &t->start, t->pos.x - t->vel.x * ( t->life - t->timer ),
+                 t->pos.y - t->vel.y * ( t->life - t->timer ) );
+      nlive++;
+   }
+
+   for ( int i = nlive; i < n; i++ ) {
+      WeaponQtTrace *t = &trace[i];
+      vec2           to;
+      double         speed = 600. + 900. * RNGF();
+      double         dir;
+      if ( npilots >= 2 ) {
+         const Pilot *from = pilots[RNG( 0, npilots - 1 )];
+         const Pilot *tgt  = pilots[RNG( 0, npilots - 1 )];
+         t->start          = from->solid.pos;
+         to                = tgt->solid.pos;
+      } else {
+         vec2_pset( &t->start, r * RNGF(), 2. * M_PI * RNGF() );
+         vec2_pset( &to, r * RNGF(), 2. * M_PI * RNGF() );
+      }
+      dir = atan2( to.y - t->start.y + 100. * ( RNGF() - 0.5 ),
+                   to.x - t->start.x + 100. * ( RNGF() - 0.5 ) );
+      vec2_pset( &t->vel, speed, dir );
+      t->range = 8. + 24. * RNGF();
+      t->life  = 1. + 2. * RNGF();
+      t->timer = t->life * RNGF(); /* Don't all fire at once. */
+      vec2_cset( &t->pos, t->start.x + t->vel.x * ( t->life - t->timer ),
+                 t->start.y + t->vel.y * ( t->life - t->timer ) );
+   }
+
+   for ( int i = 0; i < n; i++ ) {
+      trace[i].pre   = trace[i].pos;
+      trace[i].fired = 0;
+      trace[i].elem  = -1;
+   }
+   return nlive;
+}
+
+/**
+ * @brief Compares projectile ids for qsort.
+ */
+static int weapon_qtCmp( const void *p1, const void *p2 )
+{
+   return *(const int *)p1 - *(const int *)p2;
+}
+
+/**
+ * @brief Checks that two quadtrees find the same projectiles.
+ *
+ * The quadtrees can return the results in a different order, so they are
+ * sorted before being compared.
+ *
+ *    @return Number of queries that didn't match.
+ */
+static int weapon_qtCheck( Quadtree *a, Quadtree *b, IntList *ila,
+                           IntList *ilb, const WeaponQtTrace *trace, int n )
+{
+   int mismatch = 0;
+   for ( int i = 0; i < 64; i++ ) {
+      const WeaponQtTrace *t = &trace[RNG( 0, n - 1 )];
+      int                  x = round( t->pos.x );
+      int                  y = round( t->pos.y );
+      int                  na, nb;
+      qt_query( a, ila, x - 200, y - 200, x + 200, y + 200 );
+      qt_query( b, ilb, x - 200, y - 200, x + 200, y + 200 );
+      na = il_size( ila );
+      nb = il_size( ilb );
+      if ( na != nb ) {
+         mismatch++;
+         continue;
+      }
+      /* The lists only have one field, so the data is contiguous. */
+      qsort( ila->data, na, sizeof( int ), weapon_qtCmp );
+      qsort( ilb->data, nb, sizeof( int ), weapon_qtCmp );
+      for ( int j = 0; j < na; j++ ) {
+         if ( il_get( ila, j, 0 ) != il_get( ilb, j, 0 ) ) {
+            mismatch++;
+            break;
+         }
+      }
+   }
+   return mismatch;
+}
+
+/**
+ * @brief Benchmarks rebuilding the weapon quadtree every frame against
+ * updating it in place, logging the results.
+ *
+ * Replays the same projectiles on both quadtrees. Projectiles that run out of
+ * time are fired again, which removes and inserts them like new weapons.
+ *
+ *    @param n Number of projectiles.
+ *    @param frames Number of frames to simulate at 60 FPS.
+ */
+void weapons_benchmarkQuadtree( int n, int frames )
+{
+   const double   dt       = 1. / 60.;
+   double         trebuild = 0., tincremental = 0., inplace, r;
+   int            nlive, mismatch = 0, reinserted = 0, fired = 0;
+   Quadtree       qtrebuild, qtincremental;
+   IntList        ila, ilb;
+   WeaponQtTrace *trace;
+
+   n      = MAX( n, 1 );
+   frames = MAX( frames, 1 );
+   trace  = malloc( sizeof( WeaponQtTrace ) * n );
+   nlive  = weapon_qtTrace( trace, n );
+   r      = ( cur_system != NULL ) ? cur_system->radius * 1.1 : 11e3;
+
+   /* Same parameters as weapon_newSystem. */
+   qt_create( &qtrebuild, -r, -r, r, r, 4, 6 );
+   qt_create( &qtincremental, -r, -r, r, r, 4, 6 );
+   qt_set_margin( &qtincremental, WEAPON_QT_MARGIN );
+   il_create( &ila, 1 );
+   il_create( &ilb, 1 );
+
+   for ( int f = 0; f < frames; f++ ) {
+      Uint64 t;
+      int    removed;
+
+      /* Move the projectiles. */
+      for ( int i = 0; i < n; i++ ) {
+         WeaponQtTrace *w = &trace[i];
+         w->pre           = w->pos;
+         w->fired         = 0;
+         w->timer -= dt;
+         if ( w->timer < 0. ) {
+            w->timer = w->life;
+            w->pos   = w->start;
+            w->pre   = w->start;
+            w->fired = 1;
+            continue;
+         }
+         vec2_cadd( &w->pos, w->vel.x * dt, w->vel.y * dt );
+      }
+
+      /* Rebuild. */
+      t = SDL_GetPerformanceCounter();
+      qt_clear( &qtrebuild );
+      for ( int i = 0; i < n; i++ ) {
+         int x1, y1, x2, y2;
+         weapon_qtBox( &trace[i].pos, &trace[i].pre, trace[i].range, &x1, &y1,
+                       &x2, &y2 );
+         qt_insert( &qtrebuild, i, x1, y1, x2, y2 );
+      }
+      trebuild += (double)( SDL_GetPerformanceCounter() - t );
+
+      /* Incremental. */
+      t       = SDL_GetPerformanceCounter();
+      removed = qtincremental.removed;
+      for ( int i = 0; i < n; i++ ) {
+         WeaponQtTrace *w = &trace[i];
+         int            x1, y1, x2, y2;
+         weapon_qtBox( &w->pos, &w->pre, w->range, &x1, &y1, &x2, &y2 );
+         if ( ( w->elem >= 0 ) && w->fired ) {
+            qt_remove( &qtincremental, w->elem );
+            w->elem = -1;
+            fired++;
+         }
+         if ( w->elem < 0 )
+            w->elem = qt_insert( &qtincremental, i, x1, y1, x2, y2 );
+         else
+            w->elem = qt_move( &qtincremental, w->elem, i, x1, y1, x2, y2 );
+      }
+      reinserted += qtincremental.removed - removed;
+      qt_cleanup_lazy( &qtincremental );
+      tincremental += (double)( SDL_GetPerformanceCounter() - t );
+
+      if ( ( f % 60 == 0 ) || ( f == frames - 1 ) )
+         mismatch += weapon_qtCheck( &qtrebuild, &qtincremental, &ila, &ilb,
+                                     trace, n );
+   }
+   reinserted -= fired;
+   inplace = 1. - (double)reinserted / MAX( (double)n * frames - fired, 1. );
+
+   trebuild *= 1000. / (double)SDL_GetPerformanceFrequency() / frames;
+   tincremental *= 1000. / (double)SDL_GetPerformanceFrequency() / frames;
+   LOG( _( "Weapon quadtree benchmark with %d projectiles (%d flying) over %d "
+           "frames:" ),
+        n, nlive, frames );
+   LOG( _( "   rebuild: %.3f ms per frame" ), trebuild );
+   LOG( _( "   incremental: %.3f ms per frame, %.1f%% of the moves in place" ),
+        tincremental, 100. * inplace );
+   if ( mismatch > 0 )
+      WARN( _( "Weapon quadtree benchmark had %d mismatched queries!" ),
+            mismatch );
+
+   qt_destroy( &qtrebuild );
+   qt_destroy( &qtincremental );
+   il_destroy( &ila );
+   il_destroy( &ilb );
+   free( trace );
+}
+
 /**
  * @brief Clears all the weapons, does NOT free the layers.
  */
@@ -2846,6 +3368,8 @@ void weapon_clear( void )
    }
    array_erase( &weapon_stack, array_begin( weapon_stack ),
                 array_end( weapon_stack ) );
+   if ( qt_init )
+      qt_clear( &weapon_quadtree );
    /* We can restart the idgen. */
    weapon_idgen = 0; /* May mess up Lua stuff... */
 
@@ -2872,6 +3396,24 @@ void weapon_exit( void )
    qt_destroy( &weapon_quadtree );
    il_destroy( &weapon_qtquery );
    il_destroy( &weapon_qtexp );
+   qt_temp_free( &weapon_qttemp );
+
+   /* Clean up the broadphase. */
+   for ( int i = 0; i < array_size( weapon_collideChunks ); i++ ) {
+      WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+      qt_temp_free( &chunk->tmp );
+      il_destroy( &chunk->il );
+      array_free( chunk->hits );
+   }
+   array_free( weapon_collideChunks );
+   weapon_collideChunks = NULL;
+   array_free( weapon_collideHits );
+   weapon_collideHits = NULL;
+   array_free( weapon_hitBuf );
+   weapon_hitBuf = NULL;
+   if ( weapon_vpool != NULL )
+      vpool_cleanup( weapon_vpool );
+   weapon_vpool = NULL;
 }
 
 const IntList *weapon_collideQuery( int x1, int y1, int x2, int y2 )
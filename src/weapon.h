@@ -87,7 +87,8 @@ typedef struct Weapon_ {
 
    void ( *think )( struct Weapon_ *, double ); /**< for the smart missiles */
 
-   WeaponStatus status; /**< Weapon status - to check for jamming */
+   WeaponStatus status;  /**< Weapon status - to check for jamming */
+   int          qt_elem; /**< Element in the quadtree or -1. */
 } Weapon;
 
 Weapon *weapon_getStack( void );
@@ -120,6 +121,9 @@ void weapons_updateCollide( double dt );
 void weapons_update( double dt );
 void weapons_render( const WeaponLayer layer, double dt );
 
+/* Benchmark. */
+void weapons_benchmarkQuadtree( int n, int frames );
+
 /* Clean. */
 void weapon_init( void );
 void weapon_newSystem( void );